@@ -65,8 +65,10 @@ namespace triqs { namespace lattice_tools {
   const size_t ndim=TB.lattice().dim();
   array<double,2> eval(norb,n_pts);
   K_type dk = (K2 - K1)/double(n_pts), k = K1;
+  linalg::eigenelements_worker<matrix_view<dcomplex>,false> W(norb); // the lapack workspace is kept for all k
   for (size_t i =0; i<n_pts; ++i, k += dk) {
-   eval(range(),i) = linalg::eigenvalues( TK( k (range(0,ndim))), false);
+   W.invoke( TK( k (range(0,ndim))));
+   eval(range(),i) = W.values_view();
   }
   return eval;
  }
@@ -79,8 +81,10 @@ namespace triqs { namespace lattice_tools {
   const size_t ndim=TB.lattice().dim();
   grid_generator grid(ndim,n_pts);
   array<double,2> eval(norb,grid.size());
+  linalg::eigenelements_worker<matrix_view<dcomplex>,false> W(norb);
   for (; grid ; ++grid)  {
-   eval(range(),grid.index()) = linalg::eigenvalues( TK( (*grid) (range(0,ndim))), false);
+   W.invoke( TK( (*grid) (range(0,ndim))));
+   eval(range(),grid.index()) = W.values_view();
   }
   return eval;
  }
@@ -106,14 +110,18 @@ namespace triqs { namespace lattice_tools {
 		  eval(0,grid.index()) =ee;
 		  evec(0,0,grid.index()) =1;
 	  }
-  else 
+  else {
+	  linalg::eigenelements_worker<matrix_view<dcomplex>,true> W(norb);
 	  for (; grid ; ++grid)  {
 		  //cerr<<" index = "<<grid.index()<<endl;
 		  array_view <double,1> eval_sl = eval(range(),grid.index());
 		  array_view <dcomplex,2> evec_sl =  evec(range(),range(),grid.index());
-		  boost::tie (eval_sl,evec_sl) = linalg::eigenelements( TK( (*grid) (range(0,ndim)))); //,  true);
+		  matrix_view<dcomplex> H = TK( (*grid) (range(0,ndim)));
+		  W.invoke(H); // in place : H is now the eigenvectors
+		  eval_sl = W.values_view(); evec_sl = H;
 		  //cerr<< " point "<< *grid <<  " value "<< eval_sl<< endl; //" "<< (*grid) (range(0,ndim)) << endl;
 	  }
+  }
 
   // define the epsilon mesh, etc.
   array<double,1> epsilon(neps); 
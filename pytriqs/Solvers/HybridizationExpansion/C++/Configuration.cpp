@@ -37,6 +37,7 @@ Configuration::Configuration(triqs::python_tools::improved_python_dict params):
   Delta_tau_proxy(Na,(Delta_Proxy*) NULL), 
   info (H.N_Operators()),
   RecordStatisticConfigurations(params["Record_Statistics_Configurations"]),
+  Segments(NULL),
   CurrentSign(1),
   OldSign(1)
 {
@@ -66,6 +67,14 @@ Configuration::Configuration(triqs::python_tools::improved_python_dict params):
     Delta_tau_proxy[a] = new Delta_Proxy(Delta_tau[a],info);
     dets[a] = new DET_TYPE(*Delta_tau_proxy[a],Nmax,Eta);
   }
+
+  // In the segment picture, the trace is computed from the segments if Hloc is density-density,
+  // provided that no measure or move needs the slices of the DT.
+  const bool need_slices = bool(params["Use_F"]) 
+    || (python::len(params.dict()["Global_Moves_Mapping_List"])>0)
+    || (python::len(params.dict()["Operators_To_Average_List"])>0)
+    || (python::len(params.dict()["OpCorr_To_Average_List"])>0);
+  if (bool(params["Use_Segment_Picture"]) && !need_slices) Segments = SegmentTrace::make(H,COps,CdagOps,Beta);
   
 }
 
@@ -73,6 +82,7 @@ Configuration::Configuration(triqs::python_tools::improved_python_dict params):
 
 Configuration::~Configuration() { 
   for (uint i =0; i<dets.size();i++) {delete dets[i];delete Delta_tau_proxy[i];} 
+  delete Segments;
 }
  
 //********************************************************
@@ -138,3 +148,66 @@ void Configuration::update_Sign() {
   CurrentSign = (s%2==0 ? 1 : -1);
 
 }
+
+//********************************************************
+
+void Configuration::get_operators(vector<RecordedOperator> & ops) { 
+  ops.clear();
+  for (Configuration::OP_REF op = DT.OpRef_begin(); ! op.atEnd(); ++op) {
+    const BlockInfo & op_info(info[op->Op->Number]);
+    if (op_info.isFundamental()) ops.push_back(RecordedOperator(op_info.a, op_info.alpha, op_info.dagger, op->tau));
+  }
+}
+
+//********************************************************
+
+bool Configuration::set_operators(vector<RecordedOperator> const & ops, double * weight) { 
+
+  vector<double> taus; vector<const Hloc::Operator *> Ops;
+  for (uint k=0; k<ops.size(); ++k) { 
+    const RecordedOperator & op(ops[k]);
+    if ((op.a<0) || (op.a>=Na) || (op.alpha<0) || (op.alpha>=int(COps[op.a].size()))) return false;
+    taus.push_back(op.tau); 
+    Ops.push_back(op.dagger ? CdagOps[op.a][op.alpha] : COps[op.a][op.alpha]);
+  }
+  if (!DT.resetOperators(taus,Ops,(Segments!=NULL))) return false;
+
+  // The segments : the operators of each flavour alternate, so I insert them 
+  // by pairs of consecutive operators in time, each pair being a segment or an anti-segment.
+  double trace = (Segments ? 1 : DT.currentTrace());
+  if (Segments) { 
+    Segments->clear();
+    vector<vector<std::pair<double,bool> > > T(Na);
+    for (uint k=0; k<ops.size(); ++k) T[ops[k].a].push_back(std::make_pair(ops[k].tau, ops[k].dagger));
+    for (int a =0; a<Na;++a) { 
+      std::sort(T[a].begin(), T[a].end());
+      if (T[a].size()%2 !=0) return false;
+      for (uint k=0; k<T[a].size(); k+=2) { 
+	if (T[a][k].second == T[a][k+1].second) return false; 
+	const bool first_is_dagger = T[a][k].second;
+	trace *= Segments->try_insert(a, T[a][k+ (first_is_dagger ? 0 : 1)].first, T[a][k + (first_is_dagger ? 1 : 0)].first);
+	Segments->confirm();
+      }
+    }
+  }
+
+  // The determinants store the operators in decreasing time, cf Global_Move
+  vector<vector<OP_REF> > C(Na), Cdag(Na);
+  for (OP_REF it = DT.OpRef_begin(); ! it.atEnd(); ++it) { 
+    const BlockInfo & op_info(info[it->Op->Number]);
+    (op_info.dagger ? Cdag : C)[op_info.a].push_back(it);
+  }
+  for (int a =0; a<Na;++a) { 
+    if (C[a].size() != Cdag[a].size()) return false;
+    std::reverse(C[a].begin(),C[a].end());
+    std::reverse(Cdag[a].begin(),Cdag[a].end());
+    dets[a]->recomputeFrom(Cdag[a],C[a]);
+  }
+
+  update_Sign();
+  if (weight) { 
+    *weight = trace * CurrentSign;
+    for (int a =0; a<Na;++a) *weight *= dets[a]->determinant();
+  }
+  return true;
+}
@@ -27,6 +27,7 @@
 #include <triqs/gf_local/GF_C.hpp>
 #include "detManip.hpp"
 #include "DynamicTrace.hpp"
+#include "SegmentTrace.hpp"
 #include <triqs/mc_tools/mc_generic.hpp>
 #include <map>
 #include "gf_binner_and_eval.hpp"
@@ -55,7 +56,7 @@ struct Configuration {
  /// Proxy to call Delta with 2 OP_REF
  struct Delta_Proxy { 
   const GF_Bloc_ImTime & Delta;
-  gf_grid_evaluator<GF_Bloc_ImTime> Delta_eval; 
+  gf_cubic_evaluator<GF_Bloc_ImTime> Delta_eval; 
   const vector<BlockInfo> & info;
   Delta_Proxy (const GF_Bloc_ImTime & Delta_, const vector<BlockInfo> & info_ ):
    Delta(Delta_),Delta_eval(Delta_), 
@@ -63,6 +64,28 @@ struct Configuration {
   double operator()(OP_REF A, OP_REF B) const { 
    return Delta_eval(info[A->Op->Number].alpha,A->tau, 
      info[B->Op->Number].alpha,B->tau);}
+
+  /// res[i*stride] = Delta(A, B[i]) for 0<= i < n : a row of the det
+  void fill_row(OP_REF A, const OP_REF * B, int n, double * res, int stride) const { 
+   if (n==0) return;
+   resize_work(n);
+   const int alpha = info[A->Op->Number].alpha;
+   for (int i=0; i<n; ++i) { OP_REF b = B[i]; a1[i] = alpha; t1[i] = A->tau; a2[i] = info[b->Op->Number].alpha; t2[i] = b->tau;}
+   Delta_eval(n,&a1[0],&t1[0],&a2[0],&t2[0],res,stride);
+  }
+
+  /// res[i*stride] = Delta(A[i], B) for 0<= i < n : a column of the det
+  void fill_col(const OP_REF * A, int n, OP_REF B, double * res, int stride) const { 
+   if (n==0) return;
+   resize_work(n);
+   const int alpha = info[B->Op->Number].alpha;
+   for (int i=0; i<n; ++i) { OP_REF a = A[i]; a1[i] = info[a->Op->Number].alpha; t1[i] = a->tau; a2[i] = alpha; t2[i] = B->tau;}
+   Delta_eval(n,&a1[0],&t1[0],&a2[0],&t2[0],res,stride);
+  }
+
+  private: 
+  mutable vector<int> a1, a2; mutable vector<double> t1, t2; // work arrays for fill_row, fill_col 
+  void resize_work(int n) const { if (int(a1.size())<n) { a1.resize(2*n); a2.resize(2*n); t1.resize(2*n); t2.resize(2*n);}}
  };
 
  typedef detManip<Delta_Proxy,double,OP_REF> DET_TYPE;
@@ -111,8 +134,32 @@ struct Configuration {
  vector<BlockInfo> info; // info[number_of_an_op] gives access to its a, alpha, dagger 
  const bool RecordStatisticConfigurations;
 
+ /** 
+   Trace engine for the segment picture with a density-density Hloc (NULL otherwise). 
+   When it is used, the DT contains only the list of operators : the traces are computed by Segments.
+ */
+ SegmentTrace * Segments;
+
  int ratioNewSign_OldSign() const { return CurrentSign/OldSign; }
 
+ /// A fundamental operator of a configuration, as recorded for a later replay of the measures
+ struct RecordedOperator { 
+  int a, alpha; bool dagger; double tau;
+  RecordedOperator(int a_, int alpha_, bool dagger_, double tau_): a(a_), alpha(alpha_), dagger(dagger_), tau(tau_) {}
+ };
+
+ /// The fundamental operators of the current configuration, in the order of the DT
+ void get_operators(vector<RecordedOperator> & ops);
+
+ /** 
+   Replaces the current configuration by ops (e.g. a recorded one) : the DT (or the segments), 
+   the determinants and the sign are recomputed from scratch. No move must be pending. 
+   Returns false if ops is not a valid configuration.
+   If weight is not NULL, it receives the weight of the new configuration (trace * determinants * sign),
+   up to a positive factor : 0 means the configuration can not be sampled with the current Delta.
+ */
+ bool set_operators(vector<RecordedOperator> const & ops, double * weight = NULL);
+
  void update_Sign();
 
  private:
@@ -26,6 +26,8 @@
 #include "TraceSliceStack.hpp"
 #include "Time_Ordered_Operator_List.hpp"
 #include "TimeEvolution.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <boost/noncopyable.hpp>
 
 /** 
    Stores a time ordered list of local operators and the trace of their product, with precomputation system for this trace.
@@ -75,6 +77,19 @@ protected:
   const myTraceSlice * TraceSliceBoundary_ptr; // a special traceslice to handle the boundary
 public:
 
+  /**
+     A temporary slice with its own workspace, owned by the caller of the const trace ratio queries
+     (e.g. a measure) : the queries then leave the DynamicTrace untouched, 
+     and several queries with different ScratchSlices can run on the same DynamicTrace.
+   */
+  class ScratchSlice : boost::noncopyable { 
+    Hloc::DiagonalOperator workspace;
+    boost::scoped_ptr<myTraceSlice> slice;
+    friend class DynamicTrace;
+  public:
+    explicit ScratchSlice(DynamicTrace const & DT) : workspace(DT.hloc), slice(DT.SliceStack.new_slice(workspace)) {}
+  };
+
   /**
      Construct a DynamicTrace in Matsubara...
    */
@@ -129,6 +144,9 @@ public:
   /// Ratio current value of trace / preceding one
   REAL_OR_COMPLEX ratioNewTrace_OldTrace() const { 
     assert(lastop!=None); return CurrentTrace/OldTrace;}
+
+  /// The trace of the current configuration
+  REAL_OR_COMPLEX currentTrace() const { return CurrentTrace;}
  
   /// OP_REF to the first element of the list (or to END if it is empty)
   const OP_REF OpRef_begin() const { return OpList->begin();}
@@ -583,10 +601,39 @@ public:
     recomputeTrace_L2R(it2_bis);
     recomputeTrace_R2L(++it2_bis);
   }
- 
+
 
   /* *****************************************************
-     
+
+     Insertion/Removal in the list only
+
+  *****************************************************/
+
+  /**
+     Same as insertTwoOperators, but only the list of operators is changed :
+     no slice and no trace is computed. This is used when the trace is computed
+     by another engine (cf SegmentTrace) : all the other functions of this class,
+     which rely on the slices, must not be used then.
+  */
+  tuples::tuple<bool,OP_REF,OP_REF> insertTwoOperators_ListOnly (TAUTYPE tau1, const Hloc::Operator & OP1, TAUTYPE tau2, const Hloc::Operator & OP2) {
+    assert(lastop==None);
+    bool ok; OP_REF r1, r2;
+    tie(ok,r1) = OpList->insert(tau1,OP1);
+    if (!ok)  return tuples::make_tuple (false,r1,r1);
+    tie(ok,r2) = OpList->insert(tau2,OP2);
+    if (!ok) { OpList->remove(r1); return tuples::make_tuple (false,r1,r2);}
+    return tuples::make_tuple (true,r1,r2);
+  }
+
+  /// Removes 2 operators from the list, cf insertTwoOperators_ListOnly
+  void removeTwoOperators_ListOnly (OP_REF OP1, OP_REF OP2) {
+    assert(lastop==None);
+    remove_and_clean_slices(OP1);
+    remove_and_clean_slices(OP2);
+  }
+
+  /* *****************************************************
+
      ApplyGlobalFunction
      
   *****************************************************/
@@ -646,7 +693,35 @@ public:
     recomputeTrace_L2R(it);
     assert (OpList_save->size()==0); // cleaned by accept and reject
   }
-  
+
+ /* *****************************************************
+
+    Replacement of the whole list of operators
+
+  *****************************************************/
+
+  /**
+      Replaces the list of operators by Ops[k] at times taus[k] (e.g. a recorded configuration)
+      and recomputes all the slices and the trace from scratch.
+      If ListOnly, the slices are not computed, cf insertTwoOperators_ListOnly.
+      Returns false (and leaves an empty list) if two operators are at the same time.
+   */
+  bool resetOperators (std::vector<TAUTYPE> const & taus, std::vector<const Hloc::Operator *> const & Ops, bool ListOnly = false) {
+    assert(lastop==None); assert(taus.size()==Ops.size());
+    for (OP_REF p = OpList->begin(); p!= OpList->end(); ++p) clean_slices(p);
+    OpList->clear();
+    CurrentTrace = OldTrace = 1;
+    bool ok = true;
+    for (uint k=0; (k<taus.size()) && ok; ++k) ok = OpList->insert(taus[k], *Ops[k]).first;
+    if (!ok) { OpList->clear(); return false;}
+    if (ListOnly || (OpList->size()==0)) return true;
+    recomputeTrace_R2L(OpList->begin());
+    OP_REF it(OpList->end()); --it; // list is not empty
+    CurrentTrace = OldTrace = TimeEvolution.Slice_U_Slice(TraceSliceBoundary_ptr, OpList->tmax, it->tau, it->data->R2L_slice);
+    recomputeTrace_L2R(it);
+    return true;
+  }
+
 
  /* *****************************************************
 
@@ -654,12 +729,9 @@ public:
 
   *****************************************************/
 
-  REAL_OR_COMPLEX traceRatioWithOneOperatorReplaced (OP_REF OP, const Hloc::Operator & Replacement) const {
+  REAL_OR_COMPLEX traceRatioWithOneOperatorReplaced (OP_REF OP, const Hloc::Operator & Replacement, ScratchSlice & scratch) const {
     assert(lastop==None);
-    // I overrule the const for TSS. The operation at the end will NOT change TSS
-    TraceSlice_Stack<myTraceSlice>  * TSS = const_cast<TraceSlice_Stack<myTraceSlice> *> (&SliceStack);
-    // new slice for temporary calculation
-    myTraceSlice * tmp = TSS->pop(); 
+    myTraceSlice * tmp = scratch.slice.get(); 
     // get the slices around the operator
     const myTraceSlice * sliL, * sliR; TAUTYPE tr, tl;
     tie(tl,sliL) = L2R_slice_at_left_of  (OP);
@@ -667,11 +739,57 @@ public:
     // Compute sliL Replacement sliR, via tmp
     TimeEvolution.Op_U_Slice( &Replacement, OP->tau, tr,sliR, tmp);
     REAL_OR_COMPLEX res = TimeEvolution.Slice_U_Slice(sliL, tl, OP->tau, tmp);
-    TSS->push(tmp); // give back the temporary slice
     assert(isfinite(CurrentTrace));
     return res/CurrentTrace;
   }
 
+ /* *****************************************************
+
+    Compute the trace with operators inserted at some times,
+    without modifying the configuration.
+
+  *****************************************************/
+
+  /**
+     Returns Tr( ... Op(tau) ... ) / current trace.
+     Only the L2R and R2L slices already computed around tau are used :
+     the list of operators, the slices and the trace are left untouched.
+     The computation is done in the scratch slice of the caller.
+   */
+  REAL_OR_COMPLEX traceRatioWithOneOperatorInserted (TAUTYPE tau, const Hloc::Operator & Op, ScratchSlice & scratch) const {
+    std::vector<TAUTYPE> taus(1,tau);
+    std::vector<const Hloc::Operator *> Ops(1,&Op);
+    std::vector<REAL_OR_COMPLEX> res;
+    traceRatiosWithOperatorsInserted(taus,Ops,res,scratch);
+    return res[0];
+  }
+
+  /**
+     Same as traceRatioWithOneOperatorInserted for a list of operators and a list of times.
+     On exit, res[n * taus.size() + t] is the ratio for Ops[n] inserted at taus[t].
+     The slices surrounding each time are looked up once and reused for all operators.
+   */
+  void traceRatiosWithOperatorsInserted (std::vector<TAUTYPE> const & taus, std::vector<const Hloc::Operator *> const & Ops,
+      std::vector<REAL_OR_COMPLEX> & res, ScratchSlice & scratch) const {
+    assert(lastop==None);
+    assert(isfinite(CurrentTrace));
+    res.assign(Ops.size() * taus.size(), 0);
+    myTraceSlice * tmp = scratch.slice.get();
+    for (uint t=0; t<taus.size(); ++t) {
+      // get the slices around tau : the R2L slice of the operator just before tau,
+      // and the L2R slice of the first operator after tau (or the boundaries).
+      OP_REF it = OpList->first_operator_after(taus[t]);
+      const myTraceSlice * sliL, * sliR; TAUTYPE tr, tl;
+      tie(tr,sliR) = R2L_slice_at_right_of (it);
+      if (it.atEnd()) { tl = OpList->tmax; sliL = TraceSliceBoundary_ptr;}
+      else { tl = it->tau; sliL = it->data->L2R_slice;}
+      for (uint n=0; n<Ops.size(); ++n) {
+	TimeEvolution.Op_U_Slice( Ops[n], taus[t], tr,sliR, tmp);
+	res[n*taus.size() + t] = TimeEvolution.Slice_U_Slice(sliL, tl, taus[t], tmp) / CurrentTrace;
+      }
+    }
+  }
+
   //---------------------------------------------------
 
   ///
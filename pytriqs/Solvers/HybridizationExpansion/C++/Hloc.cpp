@@ -25,19 +25,21 @@
 #include <algorithm>
 #include <functional>
 #include <numeric>
+#include <boost/unordered_map.hpp>
 
 using namespace triqs::python_tools;
 
 // I define a more tolerant comparison between vectors for the AllBlocs map.
 // This is really not so nice, using a key which is a vector<double> is
 // probably a bad idea
+const double qn_tolerance = 1e-8;
 struct lt {
-  bool operator()(vector<double> v1, vector<double> v2) const {
+  bool operator()(vector<double> const & v1, vector<double> const & v2) const {
     int i=0;
-    for(vector<double>::iterator it = v1.begin(); it != v1.end(); ++it, ++i) {
-      if(*it < (v2[i] - 1e-8)) {
+    for(vector<double>::const_iterator it = v1.begin(); it != v1.end(); ++it, ++i) {
+      if(*it < (v2[i] - qn_tolerance)) {
         return true;
-      } else if(v2[i] < (*it - 1e-8)) {
+      } else if(v2[i] < (*it - qn_tolerance)) {
         return false;
       }
     }
@@ -45,6 +47,11 @@ struct lt {
   }
 };
 
+// the same for sorting (quantum numbers, n) pairs
+struct lt_first {
+  bool operator()(std::pair<vector<double>,int> const & x, std::pair<vector<double>,int> const & y) const { return lt()(x.first, y.first);}
+};
+
 using boost::tuples::tie;
 typedef Hloc::Bloc Bloc;
 typedef Hloc::Operator Operator;
@@ -169,27 +176,30 @@ namespace Hloc_construction {
       return (B<X.B);
     }
 
+    // The number of the state in the sweep of PureStateGenerator : F + 2^NF * (B written in base MaxNbosons+1)
+    size_t index() const { 
+      size_t r=0;
+      for (int i = OpFundamental::NB-1; i >= 0; --i) r = r*(OpFundamental::MaxNbosons+1) + B[i];
+      return (r << OpFundamental::NF) + F;
+    }
+
     // action of a fundamental operator : returns the sign : -1, 1 or 0 if 0 vector is 0.
     int apply(OpFundamental C) { 
-      //cout<<"apply "<<"  "<<F << " "<<C.number <<endl;
-      int sign = 0;
       if (C.isfermion()) { 
 	int NC= 1<<C.number;
 	if (C.isdagger) // F & NC : bit number C.number is at 1
 	  { if (F & NC) return 0; else F ^= NC;}
 	else
 	  { if (!(F & NC)) return 0; else F ^= NC;}
-	// compute signe
-	for (int i =0, k = F; i<C.number; ++i, k>>=1) { if (k & 1) sign++;}
-      }
-      else { // operator is bosonic
-	if (C.isdagger)
-	  { if (B[C.number] < NBmax) B[C.number]++; else  return 0;}
-	else
-	  { if (B[C.number] >0)  B[C.number]--; else return 0;}
+	// the sign is the parity of the number of occupied states below C.number
+	return (__builtin_popcount(F & (NC-1))%2 == 0 ? 1 : -1);
       }
-      //cout<<"apply "<< F << " "<<C.number << " IS "<< (sign%2 == 0 ? 1 : -1)<<endl;
-      return (sign%2 == 0 ? 1 : -1);
+      // operator is bosonic
+      if (C.isdagger)
+	{ if (B[C.number] < NBmax) B[C.number]++; else  return 0;}
+      else
+	{ if (B[C.number] >0)  B[C.number]--; else return 0;}
+      return 1;
     }
 
     /// Given a symmetry defined by : number of the Cdagger -> character
@@ -213,14 +223,14 @@ namespace Hloc_construction {
   };
   
   //--------------------------------------
-  // An "iterator" that sweeps over all PureStates
+  // An "iterator" that sweeps over all PureStates, in the order of PureState::index
   class PureStateGenerator { 
     PureState ps;
     bool fini;
   public : 
     PureStateGenerator(int NmaxBosons){
       OpFundamental::MaxNbosons = NmaxBosons;
-      ps.F = 0; ps.B.resize(OpFundamental::NB,0);
+      ps.F = 0; ps.B.resize(OpFundamental::NB,0); ps.NBmax = NmaxBosons;
       fini=false;
     }
     //------------------
@@ -247,11 +257,14 @@ namespace Hloc_construction {
   //-----------------------------------------------
   
   /* 
-     A state of the Fock space is a sum_i lambda_i |i> where |i> is a pure state
-     so it is simply a map i-> lambda_i
+     A state of the Fock space is a sum_i lambda_i |i> where |i> is a pure state.
+     It is stored as a list of (index of |i>, lambda_i) sorted by index : the operators
+     have only a few terms, so this is much cheaper than a map of PureStates.
   */
-  typedef map<PureState, REAL_OR_COMPLEX> State;
-  typedef map<PureState, REAL_OR_COMPLEX>::const_iterator StateIterator;
+  typedef vector<std::pair<size_t, REAL_OR_COMPLEX> > State;
+  typedef State::const_iterator StateIterator;
+
+  inline bool index_lt(std::pair<size_t, REAL_OR_COMPLEX> const & x, std::pair<size_t, REAL_OR_COMPLEX> const & y) { return x.first < y.first;}
   
   /*
     Now I need to define the operators and to apply them to the states.
@@ -300,8 +313,16 @@ namespace Hloc_construction {
 	// iterate on the monomial
 	for (vector<OpFundamental>::const_iterator C = term->second.begin(); sign && (C !=term->second.end()); ++C) 
 	  sign *= etat.apply(*C);
-	if (sign !=0) res[etat] += sign*term->first;
+	if (sign !=0) res.push_back(std::make_pair(etat.index(), sign*term->first));
+      }
+      // sum the terms which give the same pure state
+      std::sort(res.begin(), res.end(), index_lt);
+      uint n=0;
+      for (uint i=0; i<res.size(); ++i) { 
+	if ((n>0) && (res[n-1].first == res[i].first)) res[n-1].second += res[i].second;
+	else res[n++] = res[i];
       }
+      res.resize(n);
     }
   }; // end FullOperator
   
@@ -315,15 +336,22 @@ namespace Hloc_construction {
     // BlocContents [B->num] is the list of the Pure Fock state contained in B. This vector defined their order.
     vector< vector<PureState> > BlocContents;
     
-    // number of the pure Fock state  ---> (Bloc number, number in the bloc)
-    map<PureState, std::pair<int, int> > MapStateBlocs;
+    // index of the pure Fock state  ---> (Bloc number, number in the bloc), (-1,-1) if it is removed by SelectQN
+    vector<std::pair<int, int> > MapStateBlocs;
     
     // is a state s entirely in Bloc B ?
-    inline bool IsStateInBloc(const State & s, const Bloc * B) {
+    inline bool IsStateInBloc(const State & s, const Bloc * B) const {
       for (StateIterator p=s.begin(); p!=s.end(); ++p)
       	if (MapStateBlocs[p->first].first != B->num) return false;
       return true;
     }
+
+    // removes the components of s on the pure states removed by SelectQN
+    inline void Project(State & s) const { 
+      uint n=0;
+      for (uint i=0; i<s.size(); ++i) if (MapStateBlocs[s[i].first].first != -1) s[n++] = s[i];
+      s.resize(n);
+    }
     
     // Data constructed for Hloc : 
     vector<Bloc> BlocList;
@@ -340,6 +368,81 @@ namespace Hloc_construction {
       assert(Pinv.size()==P.size());
       for (uint i=0; i<Pinv.size(); ++i) {delete Pinv[i]; delete P[i];}
     }
+
+    //---------------------------
+    
+    // Diagonalize the Hamiltonian Hop in the bloc B : computes the energies and P, Pinv
+    void Diagonalize(Bloc & B, const FullOperator & Hop) { 
+      Array<REAL_OR_COMPLEX,2> Hmat(B.dim,B.dim); Hmat =0;
+      const vector<PureState> & BContent (BlocContents[B.num]);  // A basis of the blocs as pure states.
+      State S2;
+      for (uint j=0;j<BContent.size(); ++j) {  // for all vector of the basis
+	Hop(BContent[j],S2);                  // action of Operator
+	if (S2.size()==0) continue; // operator gives 0. no matrixelement computed (more exactly an empty one)
+	if (!IsStateInBloc(S2,&B))  TRIQS_RUNTIME_ERROR<<"Hamiltonian is not diagonal in the blocks";
+	for (StateIterator p=S2.begin(); p != S2.end(); ++p)  { 
+	  Hmat(MapStateBlocs[p->first].second, int(j) ) = p->second;
+	}
+      }
+      // call lapack to diagonalize
+      Array <double,1> ev(B.dim,fortranArray);
+      Diagonalise_with_lapack(Hmat, ev, true); 
+      // ev is the list of eigenvalues.
+      // prepare to sort them
+      vector< std::pair<double,int> > tmp(B.dim);
+      for (int i =0; i<B.dim; ++i) tmp[i] = std::make_pair(ev(i+1),i);
+
+      std::sort(tmp.begin(),tmp.end());
+      for (int i=0; i<B.dim; i++) { B.H_[i]= tmp[i].first; B.deltaH_[i]=B.H[i] - B.H[0];}
+
+      // I need to modify the P matrix
+      Hmat.transposeSelf(1,0);
+      Array<REAL_OR_COMPLEX,2> Mtmp(Hmat.copy());
+      for (int i=0; i<B.dim; i++)
+	for (int j=0; j<B.dim; j++)
+	  Mtmp ( tmp[i].second, tmp[j].second) = Hmat(i,j);
+
+      Pinv[B.num] = new Array<REAL_OR_COMPLEX,2>(Mtmp.copy());
+      P[B.num]    = new Array<REAL_OR_COMPLEX,2>(Mtmp.copy());
+      Inverse_Matrix_with_lapack(*(P[B.num]));
+    }
+
+    //---------------------------
+
+    // Compute the matrix elements of the operator OP (named name) between all the blocs and their image, in the eigenbasis of H
+    void ComputeMatrixElements(const string & name, FullOperator & OP, vector<vector<REAL_OR_COMPLEX> > & AllMatrixElements) { 
+      AllMatrixElements.clear(); OP.BlocCorrespondance.clear();
+      State S2;
+      for (vector<Bloc>::const_iterator B = BlocList.begin(); B != BlocList.end(); ++B) {
+	//Compute the matrix element of an operator OP 
+	//between bloc B and its image Bp in the Fock basis.
+	///It checks that B is mapped to exactly one bloc.
+	const Bloc * Bp=NULL;
+	for (uint j=0;j<uint(B->dim); ++j) {  // for all vector of the basis
+	  OP(BlocContents[B->num][j],S2);                  // action of Operator
+	  Project(S2);
+	  if (S2.size()==0) { continue;} // operator gives 0. no matrix element computed (more exactly an empty one)
+	  if (Bp==NULL)  { // first determination of Bp
+	    Bp= &BlocList[MapStateBlocs[S2.begin()->first].first]; 
+	    AllMatrixElements .push_back(vector<REAL_OR_COMPLEX> (B->dim *Bp->dim,0));
+	  }
+	  if (!IsStateInBloc(S2,Bp))  TRIQS_RUNTIME_ERROR<<"Operator "<<name<<" does not connect one bloc to one bloc";
+
+	  SmallMatrix<REAL_OR_COMPLEX,ByLines> SM  (Bp->dim, B->dim,AllMatrixElements.back());
+	  for (StateIterator p=S2.begin(); p != S2.end(); ++p) SM  (MapStateBlocs[p->first].second, int(j) ) = p->second;
+	}
+	if (Bp==NULL)  { 
+	  AllMatrixElements .push_back(vector<REAL_OR_COMPLEX> (0));
+	  OP.BlocCorrespondance.push_back(-1);
+	}
+	else { 
+	  OP.BlocCorrespondance.push_back(Bp->num);
+	  SmallMatrix<REAL_OR_COMPLEX,ByLines> SM  (Bp->dim, B->dim,AllMatrixElements .back());
+	  Array<REAL_OR_COMPLEX,2> M1(SM  .BlitzView());
+	  Blitz_OP::matmul_A_M_B(*(Pinv[Bp->num]), M1,*(P[B->num]));
+	}
+      }
+    }
      
     //---------------------------------
     
@@ -358,10 +461,23 @@ namespace Hloc_construction {
       Operator::_number=0;
 
       // I construct the bloc by sorting the pure state by their quantum numbers.
-      // AllBlocs a map (string key computed from quantum numbers) -> a list of PureStates
-      // with these quantum numbers, after truncation by SelectQN
-      map<vector<double> , vector<PureState>, lt > AllBlocs; 
+      // The quantum numbers are rounded to cells of size qn_tolerance and hashed : QNs[n] are the quantum numbers 
+      // of the n-th bloc found and Contents[n] the list of PureStates with these quantum numbers, after truncation by SelectQN.
+      // QNs in the same cell are equal for lt. QNs equal for lt may fall in neighbouring cells : 
+      // a new cell is therefore first looked up in BlocOfQNs_lt (once per cell), so the blocs are the ones of lt.
+      boost::unordered_map<vector<long long>, int> BlocOfQNs;
+      map<vector<double>, int, lt> BlocOfQNs_lt;
+      vector<vector<double> > QNs;
+      vector<vector<PureState> > Contents;
+      size_t NStates = 0;
       
+      // the quantum numbers operators
+      vector<const FullOperator *> QNOps; vector<string> QNNames;
+      for (IteratorOnPythonDict<string,python::object> p(QuantumNumbersList); !p.atEnd(); ++p) {
+	QNOps.push_back(&myfind(FullOperatorMap,p->key));
+	QNNames.push_back(p->key);
+      }
+
       // transcribe the symmetries into C++
       vector< map<int,COMPLEX> > SymChar;
       for (IteratorOnPythonList<python::dict> p(Symmetries); !p.atEnd(); ++p) {
@@ -371,129 +487,87 @@ namespace Hloc_construction {
       }
 
       // We iterate on all PureStates
-      for (PureStateGenerator PS(Nmaxbosons); !PS.atEnd(); ++PS) { 
-	python::list allqns_py; vector<double> allqns;
-	stringstream fs; fs.setf(ios::fixed,ios::floatfield); fs.precision(3);
-	State s2;
+      State s2; vector<COMPLEX> allqns_c; vector<double> allqns; vector<long long> key;
+      for (PureStateGenerator PS(Nmaxbosons); !PS.atEnd(); ++PS, ++NStates) { 
+	allqns_c.clear();
 	// iterate on QN.	
-	for (IteratorOnPythonDict<string,python::object> p(QuantumNumbersList); !p.atEnd(); ++p) {
-	  myfind(FullOperatorMap,p->key)(*PS,s2);
-	  if (s2.size()>1) TRIQS_RUNTIME_ERROR<<"Hloc : "<<p->key<<" is not a quantum number or  it does not leave pure state pure";
-	  COMPLEX val = (s2.size()==0 ? 0 : s2.begin()->second);
-	  allqns_py.append(val);
-	  allqns.push_back(real(val));allqns.push_back(imag(val));
+	for (uint u =0; u<QNOps.size(); ++u) { 
+	  (*QNOps[u])(*PS,s2);
+	  if (s2.size()>1) TRIQS_RUNTIME_ERROR<<"Hloc : "<<QNNames[u]<<" is not a quantum number or  it does not leave pure state pure";
+	  allqns_c.push_back(s2.size()==0 ? 0 : s2.begin()->second);
 	}
 	// iterate on QN given by .Symmetry action
-	for (uint u =0; u<SymChar.size(); ++u) { 
-	  COMPLEX val = PS->ActWithSymmetry(SymChar[u]);
-	  allqns_py.append(val);
-	  allqns.push_back(real(val));allqns.push_back(imag(val));
-	}
-	//copy(allqns.begin(), allqns.end(),ostream_iterator<double>(cout, " "));cout<<endl;
+	for (uint u =0; u<SymChar.size(); ++u) allqns_c.push_back(PS->ActWithSymmetry(SymChar[u]));
+
 	// I filter out the pure state where SelectQN  is false if it exists.
-	//if  ( (SelectQN ==python::PythonNone()) || python::extract<bool>(SelectQN(allqns_py))) 
-	if  ( (SelectQN.is_none()) || python::extract<bool>(SelectQN(allqns_py))) 
-	  AllBlocs[allqns].push_back(*PS);
+	if (!SelectQN.is_none()) { 
+	  python::list allqns_py;
+	  for (uint u =0; u<allqns_c.size(); ++u) allqns_py.append(allqns_c[u]);
+	  if (!python::extract<bool>(SelectQN(allqns_py))) continue;
+	}
+
+	allqns.clear(); key.clear();
+	for (uint u =0; u<allqns_c.size(); ++u) { allqns.push_back(real(allqns_c[u])); allqns.push_back(imag(allqns_c[u]));}
+	for (uint u =0; u<allqns.size(); ++u) key.push_back((long long)(floor(allqns[u]/qn_tolerance + 0.5)));
+	boost::unordered_map<vector<long long>, int>::iterator r = BlocOfQNs.find(key);
+	if (r == BlocOfQNs.end()) { 
+	  std::pair<map<vector<double>, int, lt>::iterator, bool> r_lt = BlocOfQNs_lt.insert(make_pair(allqns,int(QNs.size())));
+	  if (r_lt.second) { QNs.push_back(allqns); Contents.push_back(vector<PureState>());}
+	  r = BlocOfQNs.insert(make_pair(key,r_lt.first->second)).first;
+	}
+	Contents[r->second].push_back(*PS);
       }
+
+      // The blocs are numbered in increasing order of their quantum numbers
+      vector<std::pair<vector<double>, int> > order;
+      for (uint n=0; n<QNs.size(); ++n) order.push_back(make_pair(QNs[n],n));
+      std::sort(order.begin(), order.end(), lt_first());
           
       // I now have the blocks, so I can build BlocList and MapStateBlocs
       // Build the blocs BlocList :  bloc.number -> bloc *
-      int NBlocs =AllBlocs.size();
+      int NBlocs =order.size();
       P.resize(NBlocs,NULL); Pinv.resize(NBlocs,NULL);
-      int num=0; // number of the bloc
-      for (map< vector<double> , vector< PureState >, lt >::const_iterator p=AllBlocs.begin(); p!=AllBlocs.end(); ++p, ++num) {
-	Bloc B(p->second.size(),num);    
+      MapStateBlocs.resize(NStates, std::make_pair(-1,-1));
+      for (int num=0; num<NBlocs; ++num) {  // number of the bloc
+	BlocContents.push_back(vector<PureState>());
+	BlocContents.back().swap(Contents[order[num].second]);
+	Bloc B(BlocContents.back().size(),num);    
 	assert(B.dim>0);
 	BlocList.push_back(B);
-	BlocContents.push_back(p->second);
 	for (int i=0; i<B.dim; ++i)
-	  MapStateBlocs[p->second[i]] = std::make_pair(num,i);
+	  MapStateBlocs[BlocContents.back()[i].index()] = std::make_pair(num,i);
       } 
     
-      // Now diagonalize the H
-      for (vector<Bloc>::iterator B = BlocList.begin(); B!=BlocList.end(); ++B) {
-	Array<REAL_OR_COMPLEX,2> Hmat(B->dim,B->dim); Hmat =0;
-	const vector<PureState> & BContent (BlocContents[B->num]);  // A basis of the blocs as pure states.
-	FullOperator & Hop(myfind(FullOperatorMap,string("Hamiltonian")));    // the operator
-	for (uint j=0;j<BContent.size(); ++j) {  // for all vector of the basis
-	  State S2;
-	  Hop(BContent[j],S2);                  // action of Operator
-	  if (S2.size()==0) continue; // operator gives 0. no matrixelement computed (more exactly an empty one)
-	  if (!IsStateInBloc(S2,&(*B)))  TRIQS_RUNTIME_ERROR<<"Hamiltonian is not diagonal in the blocks";
-	  for (State::const_iterator p=S2.begin(); p != S2.end(); ++p)  { 
-	    Hmat(MapStateBlocs[p->first].second, int(j) ) = p->second;
-	  }
+      // Now diagonalize the H : the blocs are independent
+      const FullOperator & Hop(myfind(FullOperatorMap,string("Hamiltonian")));    // the operator
+      string error;
+#pragma omp parallel for schedule(dynamic)
+      for (int num=0; num<NBlocs; ++num) { 
+	try { Diagonalize(BlocList[num], Hop);}
+	catch (std::exception const & e) { 
+#pragma omp critical
+	  error = e.what();
 	}
-	// call lapack to diagonalize
-	Array <double,1> ev(B->dim,fortranArray);
-	Diagonalise_with_lapack(Hmat, ev, true); 
-	// ev is the list of eigenvalues.
-	// prepare to sort them
-	vector< std::pair<double,int> > tmp(B->dim);
-	for (int i =0; i<B->dim; ++i)  { 
-	  tmp[i] = std::make_pair(ev(i+1),i);
-	  // cout<<" PERM"<<i <<"  "<< tmp[i].first<< "  "<<tmp[i].second<<endl;
-	}
-
-	std::sort(tmp.begin(),tmp.end());
-	for (int i=0; i<B->dim; i++) { B->H_[i]= tmp[i].first; B->deltaH_[i]=B->H[i] - B->H[0];}
-      
-	// I need to modify the P matrix
-	Hmat.transposeSelf(1,0);
-	Array<REAL_OR_COMPLEX,2> Mtmp(Hmat.copy());
-	for (int i=0; i<B->dim; i++)
-	  for (int j=0; j<B->dim; j++)
-	    {
-	      //   cout<<" PERM"<<i <<"  "<< tmp[i].first<< "  "<<tmp[i].second<<endl;
-	      Mtmp ( tmp[i].second, tmp[j].second) = Hmat(i,j);
-	    }
-
-	Pinv[B->num] = new Array<REAL_OR_COMPLEX,2>(Mtmp.copy());
-	P[B->num]    = new Array<REAL_OR_COMPLEX,2>(Mtmp.copy());
-	Inverse_Matrix_with_lapack(*(P[B->num]));
-
       }
+      if (error!="") TRIQS_RUNTIME_ERROR << error;
       // end diagonalization of Hamiltonian
  
-      // Compute the elements matrices of all operators
-      for (map<string,FullOperator>::iterator OP= FullOperatorMap.begin(); OP != FullOperatorMap.end(); ++OP) {
-      
-	// a vector of MatrixElements stored in 1d vectors
-	vector<vector<REAL_OR_COMPLEX> > AllMatrixElements;
-      
-	for (vector<Bloc>::const_iterator B = BlocList.begin(); B != BlocList.end(); ++B) {
-	  //Compute the matrix element of an operator OP 
-	  //between bloc B and its image Bp in the Fock basis.
-	  ///It checks that B is mapped to exactly one bloc.
-	  const Bloc * Bp=NULL;
-	  for (uint j=0;j<uint(B->dim); ++j) {  // for all vector of the basis
-	    State S2;
-	    OP->second(BlocContents[B->num][j],S2);                  // action of Operator
-	    if (S2.size()==0) { continue;} // operator gives 0. no matrix element computed (more exactly an empty one)
-	    if (Bp==NULL)  { // first determination of Bp
-	      Bp= &BlocList[MapStateBlocs[S2.begin()->first].first]; 
-	      AllMatrixElements .push_back(vector<REAL_OR_COMPLEX> (B->dim *Bp->dim,0));
-	    }
-	    if (!IsStateInBloc(S2,Bp))  TRIQS_RUNTIME_ERROR<<"Operator "<<OP->first<<" does not connect one bloc to one bloc";
-	    
-	    for (State::const_iterator p=S2.begin(); p != S2.end(); ++p)  {
-	      SmallMatrix<REAL_OR_COMPLEX,ByLines> SM  (Bp->dim, B->dim,AllMatrixElements.back());
-	      SM  (MapStateBlocs[p->first].second, int(j) ) = p->second;
-	    }
-	  }
-	  if (Bp==NULL)  { 
-	    AllMatrixElements .push_back(vector<REAL_OR_COMPLEX> (0));
-	    OP->second.BlocCorrespondance.push_back(-1);
-	  }
-	  else { 
-	    OP->second.BlocCorrespondance.push_back(Bp->num);
-	    SmallMatrix<REAL_OR_COMPLEX,ByLines> SM  (Bp->dim, B->dim,AllMatrixElements .back());
-	    Array<REAL_OR_COMPLEX,2> M1(SM  .BlitzView());
-	    Blitz_OP::matmul_A_M_B(*(Pinv[Bp->num]), M1,*(P[B->num]));
-	  }
+      // Compute the elements matrices of all operators : the operators are independent. 
+      // The Operators are then constructed in the order of the map (it defines their Number).
+      vector<map<string,FullOperator>::iterator> AllFullOps;
+      for (map<string,FullOperator>::iterator OP= FullOperatorMap.begin(); OP != FullOperatorMap.end(); ++OP) AllFullOps.push_back(OP);
+      vector<vector<vector<REAL_OR_COMPLEX> > > AllMatrixElements(AllFullOps.size());
+#pragma omp parallel for schedule(dynamic)
+      for (int n=0; n<int(AllFullOps.size()); ++n) { 
+	try { ComputeMatrixElements(AllFullOps[n]->first, AllFullOps[n]->second, AllMatrixElements[n]);}
+	catch (std::exception const & e) { 
+#pragma omp critical
+	  error = e.what();
 	}
-	OperatorMap.insert(make_pair(OP->first,Operator(OP->first,OP->second.Statistic,AllMatrixElements )));
-      } // loop on operators.
+      }
+      if (error!="") TRIQS_RUNTIME_ERROR << error;
+      for (uint n=0; n<AllFullOps.size(); ++n) 
+	OperatorMap.insert(make_pair(AllFullOps[n]->first,Operator(AllFullOps[n]->first,AllFullOps[n]->second.Statistic,AllMatrixElements[n])));
     
       // Construct the transpose of the operators
       for (map<string,Operator>::iterator OP = OperatorMap.begin(); OP != OperatorMap.end(); ++OP) {
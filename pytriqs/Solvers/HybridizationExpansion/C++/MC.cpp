@@ -22,6 +22,7 @@
 
 // include first because of a namespace clash.. to be fixed...
 #include <triqs/arrays/h5/array_stack.hpp>
+#include <triqs/arrays/h5/simple_read_write.hpp>
 #include "MC.hpp"
 #include <triqs/python_tools/IteratorOnPythonSequences.hpp>
 #include <triqs/utility/callbacks.hpp>
@@ -42,11 +43,14 @@ using namespace triqs;
 
 // The measures.
 #include "Measures_G.hpp"
+#include "Measures_G_iw.hpp"
+#include "Measures_G2.hpp"
 #include "Measures_F.hpp"
 #include "Measures_OpAv.hpp"
 #include "Measures_Legendre.hpp"
 #include "Measures_Legendre_allseries.hpp"
 #include "Measures_OpCorr.hpp"
+#include "Measures_Record_Configurations.hpp"
 
 template<typename T1> 
 std::string make_string( T1 const & x1) { 
@@ -69,8 +73,11 @@ MC_Hybridization_Matsubara::MC_Hybridization_Matsubara(triqs::python_tools::impr
  Gc_w (extract<GF_C<GF_Bloc_ImFreq> > (params.dict()["G"])),
  TimeAccumulation (params["Time_Accumulation"]),
  LegendreAccumulation (params["Legendre_Accumulation"]),
+ FrequencyAccumulation (params["Frequency_Accumulation"]),
  N_Frequencies_Accu (params["N_Frequencies_Accumulated"]),
- Freq_Fit_Start (params["Fitting_Frequency_Start"])
+ Freq_Fit_Start (params["Fitting_Frequency_Start"]),
+ warm_started(false),
+ warmup_done(false), n_warmup_cycles(0), order_sum(0)
 
 {
 
@@ -97,7 +104,11 @@ MC_Hybridization_Matsubara::MC_Hybridization_Matsubara(triqs::python_tools::impr
 
  this->add_move(AllInserts, "INSERT", p_ir);
  this->add_move(AllRemoves, "REMOVE", p_ir);
- this->add_move(new Move_C_Delta(Config, this->RandomGenerator), "Move C Delta", p_mv);
+ // the move of operators needs the slices of the DT, not computed by the segment engine
+ if (Config.Segments) 
+  report << "Density-density Hloc : the traces are computed from the segments (no Move C Delta)"<<endl;
+ else 
+  this->add_move(new Move_C_Delta(Config, this->RandomGenerator), "Move C Delta", p_mv);
 
  // Register the Global moves
  python::list GM_List = python::extract<python::list>(params.dict()["Global_Moves_Mapping_List"]);
@@ -120,7 +131,10 @@ MC_Hybridization_Matsubara::MC_Hybridization_Matsubara(triqs::python_tools::impr
   ****************/
 
  for (int a =0; a<Config.Na;++a) { 
-   if (LegendreAccumulation) {
+   // Frequency_Accumulation takes precedence (Legendre_Accumulation is True by default), then Legendre, then Time
+   if (FrequencyAccumulation) {
+     this->add_measure(new Measure_G_iw(Config, a, Gc_w[a], N_Frequencies_Accu), make_string("G(iw) ",a));
+   } else if (LegendreAccumulation) {
      this->add_measure(new Measure_G_Legendre(Config, a, G_legendre[a]), make_string("G Legendre ",a));
      if (bool(params["Keep_Full_MC_Series"])) 
       this->add_measure(new Measure_G_Legendre_all(Config, a, G_legendre[a]), make_string("G Legendre (all) ",a));
@@ -132,6 +146,11 @@ MC_Hybridization_Matsubara::MC_Hybridization_Matsubara(triqs::python_tools::impr
  }
 
 
+ // register the measure of the two-particle Green function
+ if (bool(params["Measure_G2"]))
+   this->add_measure(new Measure_G2(Config, params["N_Fermionic_Frequencies_G2"], params["N_Bosonic_Frequencies_G2"], 
+      params.value_or_default("G2_File","G2.h5")), "G2");
+
  // register the measure of F
  if (bool(params["Use_F"]))
    for (int a =0; a<Config.Na;++a) 
@@ -140,9 +159,10 @@ MC_Hybridization_Matsubara::MC_Hybridization_Matsubara(triqs::python_tools::impr
  // register the measures of the average of some operators
  python::dict opAv_results = python::extract<python::dict>(params.dict()["Measured_Operators_Results"]);
  python::list opAv_List = python::extract<python::list>(params.dict()["Operators_To_Average_List"]);
- for (triqs::python_tools::IteratorOnPythonList<string> g(opAv_List); !g.atEnd(); ++g) {
-  this->add_measure(new Measure_OpAv(*g, Config, opAv_results), *g);
- }
+ vector<string> opAv_names;
+ for (triqs::python_tools::IteratorOnPythonList<string> g(opAv_List); !g.atEnd(); ++g) opAv_names.push_back(*g);
+ if (opAv_names.size()>0)
+  this->add_measure(new Measure_OpAv(opAv_names, Config, opAv_results, params["N_Tau_Operators_Average"]), "Operators averages");
 
  // register the measures for the time correlators:
  python::list opCorr_List = python::extract<python::list>(params.dict()["OpCorr_To_Average_List"]);
@@ -154,6 +174,13 @@ MC_Hybridization_Matsubara::MC_Hybridization_Matsubara(triqs::python_tools::impr
   this->add_measure(new Measure_OpCorr(str1, *g, Config, OpCorrToAverage[a], OpCorrToAverage[a].mesh.len()), str1);
  }
 
+ // record the sampled configurations (one file per node), for a later replay of the measures
+ const std::string record_file = params.value_or_default("Record_Configurations_File","");
+ if ((record_file != "") && (python::len(params.dict()["Replay_Configurations_Files"])==0)) { 
+  boost::mpi::communicator c;
+  this->add_measure(new Measure_Record_Configurations(Config, make_string(record_file + "_", c.rank()) + ".h5"), "Record configurations");
+ }
+
 }
 
 
@@ -163,9 +190,82 @@ void MC_Hybridization_Matsubara::finalize (boost::mpi::communicator const & c) {
 
   report<<"Monte-Carlo : Time measurements (cpu time) : "<<endl;
   report<<"   time elapsed total : " << this->Timer << " seconds" << endl;
+  if (warm_started && warmup_done && (n_warmup_cycles < NWarmIterations)) 
+   report<<"Warm start : the expansion order was stationary after " << n_warmup_cycles << " warm-up cycles" << endl;
+
+}
+
+
+//********************************************************
+
+void MC_Hybridization_Matsubara::replay(std::vector<std::string> const & files, boost::mpi::communicator const & c) { 
+
+  Timer.start();
+  nmeasures = 0; sum_sign = 0;
+  vector<Configuration::RecordedOperator> ops;
+
+  // the files are independent : they are distributed over the nodes
+  for (size_t f = c.rank(); f < files.size(); f += c.size()) { 
+    arrays::h5::H5File file(files[f].c_str(), H5F_ACC_RDONLY);
+    arrays::array<double,2> confs, all_ops;
+    h5_read(arrays::h5::group_or_file(file), "configurations", confs);
+    size_t n_ops = 0;
+    for (size_t n=0; n<confs.shape()[0]; ++n) n_ops += size_t(confs(n,0));
+    if (n_ops>0) h5_read(arrays::h5::group_or_file(file), "operators", all_ops);
+    report << "Replay of "<< confs.shape()[0] << " configurations from " << files[f] << endl;
+
+    for (size_t n=0, k=0; n<confs.shape()[0]; ++n) {
+      ops.clear();
+      for (size_t u=0; u<size_t(confs(n,0)); ++u, ++k) 
+	ops.push_back(Configuration::RecordedOperator(int(all_ops(k,0)), int(all_ops(k,1)), (all_ops(k,2)!=0), all_ops(k,3)));
+      if (!Config.set_operators(ops)) TRIQS_RUNTIME_ERROR << "Replay : configuration " << n << " of " << files[f] << " is not valid";
+      SignType sign(confs(n,1), confs(n,2));
+      nmeasures++;
+      sum_sign += sign;
+      AllMeasures.accumulate(sign);
+    }
+  }
+  Timer.stop();
+}
+
+//********************************************************
 
+SignType MC_Hybridization_Matsubara::set_configuration(std::vector<Configuration::RecordedOperator> const & ops) { 
+  double w = 0;
+  if (!Config.set_operators(ops, &w) || (w==0) || !std::isfinite(w)) { 
+    Config.set_operators(std::vector<Configuration::RecordedOperator>());
+    report << "Warm start : the configuration of the previous run can not be used, starting from the empty one" << endl;
+    return 0;
+  }
+  report << "Warm start from a configuration with " << ops.size() << " operators" << endl;
+  warm_started = (ops.size()>0); // from the empty configuration, the usual warm-up is needed
+  return (w>0 ? 1 : -1);
 }
 
+//********************************************************
+
+bool MC_Hybridization_Matsubara::thermalized() const { 
+  if (warmup_done || BaseType::thermalized()) return (warmup_done = true);
+  if (!warm_started) return false;
+
+  // average the expansion order over bins of B cycles
+  const uint64_t B = std::max(uint64_t(10), NWarmIterations/200);
+  for (int a =0; a<Config.Na;++a) order_sum += Config.dets[a]->NumberOfC();
+  if (++n_warmup_cycles % B) return false;
+  order_bins.push_back(order_sum/B); order_sum = 0;
+
+  // compare the means of two consecutive windows of n_bins bins, with the spread of the bin means as error
+  const size_t n_bins = 10;
+  if (order_bins.size() < 2*n_bins) return false;
+  double m1=0, m2=0, v1=0, v2=0;
+  for (size_t i=0; i<n_bins; ++i) { m1 += order_bins[i]; v1 += order_bins[i]*order_bins[i];}
+  for (size_t i=n_bins; i<2*n_bins; ++i) { m2 += order_bins[i]; v2 += order_bins[i]*order_bins[i];}
+  m1 /= n_bins; m2 /= n_bins; v1 = (v1/n_bins - m1*m1)/(n_bins-1); v2 = (v2/n_bins - m2*m2)/(n_bins-1);
+  order_bins.erase(order_bins.begin());
+  if (std::abs(m2-m1) > 2*std::sqrt(std::max(v1+v2,0.0))) return false;
+  order_bins.clear();
+  return (warmup_done = true);
+}
 
 //********************************************************
 
@@ -181,8 +281,38 @@ void solve(boost::python::object parent) {
   // construct the QMC
   MC_Hybridization_Matsubara QMC(parms);
 
-  // run!! The empty configuration has sign = 1
-  QMC.start(1.0, triqs::utility::clock_callback(parms.value_or_default("MAX_TIME",-1)));
+  // warm start from the last configuration of the previous solve on this node, or from the empty one (sign = 1)
+  SignType sign_init = 1;
+  const bool warm_start = parms["Warm_Start"];
+  if (warm_start && python::dict(parms.dict()).has_key("Final_Configuration")) { 
+   std::vector<Configuration::RecordedOperator> ops;
+   python::list FC = python::extract<python::list>(parms.dict()["Final_Configuration"]);
+   for (int k=0; k<python::len(FC); ++k) { 
+    python::tuple t = python::extract<python::tuple>(FC[k]);
+    ops.push_back(Configuration::RecordedOperator(extract<int>(t[0]), extract<int>(t[1]), extract<bool>(t[2]), extract<double>(t[3])));
+   }
+   sign_init = QMC.set_configuration(ops);
+   if (sign_init == SignType(0)) sign_init = 1;
+  }
+
+  // replay recorded configurations, or run!!
+  std::vector<std::string> replay_files;
+  python::list RF = python::extract<python::list>(parms.dict()["Replay_Configurations_Files"]);
+  for (triqs::python_tools::IteratorOnPythonList<string> g(RF); !g.atEnd(); ++g) replay_files.push_back(*g);
+  if (replay_files.size()>0) 
+   QMC.replay(replay_files, c);
+  else 
+   QMC.start(sign_init, triqs::utility::clock_callback(parms.value_or_default("MAX_TIME",-1)));
+
+  // keep the last configuration for the warm start of the next solve
+  if (warm_start) { 
+   std::vector<Configuration::RecordedOperator> ops;
+   QMC.get_configuration(ops);
+   python::list FC;
+   for (size_t k=0; k<ops.size(); ++k) FC.append(python::make_tuple(ops[k].a, ops[k].alpha, ops[k].dagger, ops[k].tau));
+   parms.dict()["Final_Configuration"] = FC;
+  }
+
   QMC.collect_results(c);
   QMC.finalize(c);
 
@@ -46,13 +46,41 @@ protected:
   GF_C<GF_Bloc_ImFreq> Gc_w;
   const bool TimeAccumulation;
   const bool LegendreAccumulation;
+  const bool FrequencyAccumulation;
   const int N_Frequencies_Accu,Freq_Fit_Start;
+  bool warm_started; // a configuration of a previous run was restored by set_configuration
+  mutable bool warmup_done;
+  mutable uint64_t n_warmup_cycles;
+  mutable double order_sum;                // sum of the expansion orders in the current bin of cycles
+  mutable std::vector<double> order_bins;  // mean expansion order of the last bins of the warm-up
+
+  /** 
+    After a warm start, the warm-up stops as soon as the expansion order is stationary (at most N_Warmup_Cycles cycles).
+    The orders are averaged over bins of cycles, and the means of two consecutive windows of bins are compared 
+    with the error bar given by the spread of the bin means : consecutive cycles are correlated, the bins much less.
+   */
+  virtual bool thermalized() const;
+
+  /// After a warm-up shortened by a warm start, the run stops after N_Cycles measures instead of N_Warmup_Cycles + N_Cycles cycles
+  virtual bool converged() const { return (warm_started && (nmeasures >= NCycles));}
 
 public : 
 
   MC_Hybridization_Matsubara(triqs::python_tools::improved_python_dict const & params);
   void finalize(boost::mpi::communicator const & c);
 
+  /// Accumulates the measures on the configurations recorded in the files (cf Measure_Record_Configurations), without any move
+  void replay(std::vector<std::string> const & files, boost::mpi::communicator const & c);
+
+  /** 
+    Starts the chain from ops (e.g. the last configuration of the previous solve), re-evaluated with the current Delta. 
+    Returns the sign of its weight, or 0 if it can not be sampled : the configuration is then left empty.
+   */
+  SignType set_configuration(std::vector<Configuration::RecordedOperator> const & ops);
+
+  /// The current configuration
+  void get_configuration(std::vector<Configuration::RecordedOperator> & ops) { Config.get_operators(ops);}
+
 };
 
 
@@ -34,19 +34,20 @@ class Measure_F_tau : public Measure_acc_sign<COMPLEX> {
   typedef Measure_acc_sign<COMPLEX> BaseType;
   const std::string name;
   const Configuration & Config;
+  Configuration::DYNAMIC_TRACE::ScratchSlice scratch; // for the trace ratios
   GF_Bloc_ImTime F_tau;
   gf_binner<GF_Bloc_ImTime> F_tau_bin;
   const int a_level;
 public :   
 
   Measure_F_tau(const Configuration & Config_,int a, GF_Bloc_ImTime & Ftau_):
-    BaseType(), name(to_string("G(tau)",a)), Config(Config_), F_tau(Ftau_), F_tau_bin(F_tau), a_level(a) { }
+    BaseType(), name(to_string("G(tau)",a)), Config(Config_), scratch(Config_.DT), F_tau(Ftau_), F_tau_bin(F_tau), a_level(a) { }
 
   void accumulate(COMPLEX signe) {
     BaseType::accumulate(signe);
     const double s(real(signe)); // not elegant !
     for (Configuration::DET_TYPE::C_Cdagger_M_iterator p(*Config.dets[a_level]); !p.atEnd(); ++p) {
-      double r = Config.DT.traceRatioWithOneOperatorReplaced(p.C() , Config.H[p.C()->Op->name + "_Comm_Hloc"]);
+      double r = Config.DT.traceRatioWithOneOperatorReplaced(p.C() , Config.H[p.C()->Op->name + "_Comm_Hloc"], scratch);
       F_tau_bin(Config.info[p.C()->Op->Number].alpha, p.C()->tau, 
 	      Config.info[p.Cdagger()->Op->Number].alpha, p.Cdagger()->tau, 
 	      s * r * p.M());
@@ -0,0 +1,161 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIQS_CTHYB1_MEASURES_G2_H
+#define TRIQS_CTHYB1_MEASURES_G2_H
+
+#include <triqs/arrays/array.hpp>
+#include <triqs/arrays/h5/simple_read_write.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "Configuration.hpp"
+#include "Measures_Z.hpp"
+#include "nfft_binner.hpp"
+
+namespace tqa=triqs::arrays;
+
+/**
+   Measure the two-particle Green function in the particle-hole channel, for all couples of blocks (a,b) :
+
+    G2^{ab}_{alpha1 alpha2 alpha3 alpha4} (nu,nu',omega) = 
+      1/Beta < M^a_{alpha1 alpha2}(nu+omega,nu) M^b_{alpha3 alpha4}(nu',nu'+omega) 
+               - delta_ab M^a_{alpha1 alpha4}(nu+omega,nu'+omega) M^a_{alpha3 alpha2}(nu',nu) >
+ 
+   with M(nu1,nu2) = sum_{ij} M_ji exp(i nu1 tau_i - i nu2 tau'_j) (tau_i : time of C, tau'_j : time of Cdagger).
+   With this convention G(i nu) = - <M(nu,nu)>/Beta.
+
+   The frequency box is nu, nu' = (2n+1) Pi/Beta with -n_nu <= n < n_nu and omega = 2 m Pi/Beta with 0 <= m < n_omega.
+
+   M(nu1,nu2) is computed once per measure with a 2d non-equispaced FFT (cf nfft_binner_2d) in O(k^2 + n_f^2 log n_f),
+   instead of O(k^4 n_nu^2 n_omega) for the direct sum. The assembly of G2 is then O(n_nu^2 n_omega) : 
+   the transposed M(nu',nu) is stored once so that all the inner loops are contiguous.
+
+   The results are written in the hdf5 file filename, in datasets G2_a_b of shape 
+   (N_a^2, N_b^2, n_omega, 2 n_nu, 2 n_nu), with (alpha1,alpha2) and (alpha3,alpha4) grouped in C order.
+*/
+class Measure_G2 : public Measure_acc_sign<COMPLEX> {
+  typedef Measure_acc_sign<COMPLEX> BaseType;
+  const Configuration & Config;
+  const int n_nu, n_omega, n_f; 
+  const std::string filename;
+  std::vector<int> N;
+  std::vector<boost::shared_ptr<nfft_binner_2d> > M_iw_bin;
+  std::vector<tqa::array<COMPLEX,3> > M_iw, M_iw_t; // M_iw[a](alpha1 * N + alpha2, n1, n2) and its transpose in the nu box
+  std::vector<tqa::array<COMPLEX,5> > G2;            // G2[a*Na +b]
+ public :   
+
+  Measure_G2(const Configuration & Config_, int n_nu_, int n_omega_, std::string const & filename_):
+   BaseType(), Config(Config_), n_nu(n_nu_), n_omega(n_omega_), n_f(2*n_nu_+n_omega_), filename(filename_) {
+    // any positive box is fine, even when it is smaller than the gaussian of the nfft (cf nfft_details::gaussian_axis::wrap)
+    if ( (n_nu<=0) || (n_omega<=0)) TRIQS_RUNTIME_ERROR << "Measure_G2 : the numbers of fermionic ("<< n_nu <<") and bosonic ("<< n_omega << ") frequencies must be positive";
+    for (int a=0; a<Config.Na; ++a) { 
+     N.push_back(Config.Delta_tau[a].N1);
+     M_iw_bin.push_back(boost::shared_ptr<nfft_binner_2d>(new nfft_binner_2d(Config.Beta, -n_nu, n_f, N[a]*N[a])));
+     M_iw.push_back(tqa::array<COMPLEX,3>(N[a]*N[a], n_f, n_f));
+     M_iw_t.push_back(tqa::array<COMPLEX,3>(N[a]*N[a], 2*n_nu, 2*n_nu));
+    }
+    for (int a=0; a<Config.Na; ++a) 
+     for (int b=0; b<Config.Na; ++b) { 
+      G2.push_back(tqa::array<COMPLEX,5>(N[a]*N[a], N[b]*N[b], n_omega, 2*n_nu, 2*n_nu));
+      G2.back()() = 0;
+     }
+   }
+
+  void accumulate(COMPLEX signe)  { 
+   BaseType::accumulate(signe);
+   const double s(real(signe)); // not elegant !
+   const int n_nu2 = 2*n_nu;
+
+   // M(nu1,nu2) for all the blocks
+   for (int a=0; a<Config.Na; ++a) { 
+    nfft_binner_2d & bin (*M_iw_bin[a]);
+    bin.clear();
+    for (Configuration::DET_TYPE::C_Cdagger_M_iterator p(*Config.dets[a]); !p.atEnd(); ++p) 
+     bin(Config.info[p.C()->Op->Number].alpha * N[a] + Config.info[p.Cdagger()->Op->Number].alpha, 
+       p.C()->tau, - p.Cdagger()->tau, p.M());
+    for (int ab=0; ab<N[a]*N[a]; ++ab) { 
+     COMPLEX * restrict m = M_iw[a].data_start() + ab*n_f*n_f;
+     COMPLEX * restrict mt = M_iw_t[a].data_start() + ab*n_nu2*n_nu2;
+     bin.transform(ab, m);
+     for (int i=0; i<n_nu2; ++i) 
+      for (int j=0; j<n_nu2; ++j) mt[i*n_nu2+j] = m[j*n_f+i];
+    }
+   }
+
+   const int n_box = n_omega*n_nu2*n_nu2;
+   for (int a=0; a<Config.Na; ++a) 
+    for (int b=0; b<Config.Na; ++b) 
+     for (int ab1=0; ab1<N[a]*N[a]; ++ab1) 
+      for (int ab2=0; ab2<N[b]*N[b]; ++ab2) { 
+       COMPLEX * restrict g0 = G2[a*Config.Na+b].data_start() + (ab1*N[b]*N[b] + ab2)*n_box;
+
+       // direct term M^a_{alpha1 alpha2}(nu+omega,nu) M^b_{alpha3 alpha4}(nu',nu'+omega)
+       const COMPLEX * restrict ma = M_iw[a].data_start() + ab1*n_f*n_f; 
+       const COMPLEX * restrict mb = M_iw[b].data_start() + ab2*n_f*n_f; 
+       COMPLEX * restrict g = g0;
+       for (int w=0; w<n_omega; ++w) 
+	for (int i=0; i<n_nu2; ++i, g+=n_nu2) { 
+	 const COMPLEX d = s * ma[(i+w)*n_f + i];
+	 for (int j=0; j<n_nu2; ++j) g[j] += d * mb[j*n_f + j+w];
+	}
+       if (a!=b) continue;
+
+       // exchange term - M^a_{alpha1 alpha4}(nu+omega,nu'+omega) M^a_{alpha3 alpha2}(nu',nu)
+       const int a1 = ab1/N[a], a2 = ab1%N[a], a3 = ab2/N[a], a4 = ab2%N[a];
+       const COMPLEX * restrict m14 = M_iw[a].data_start() + (a1*N[a]+a4)*n_f*n_f; 
+       const COMPLEX * restrict t32 = M_iw_t[a].data_start() + (a3*N[a]+a2)*n_nu2*n_nu2; 
+       g = g0;
+       for (int w=0; w<n_omega; ++w) 
+	for (int i=0; i<n_nu2; ++i, g+=n_nu2) { 
+	 const COMPLEX * restrict r14 = m14 + (i+w)*n_f + w;
+	 const COMPLEX * restrict r32 = t32 + i*n_nu2;
+	 for (int j=0; j<n_nu2; ++j) g[j] -= s * r14[j] * r32[j];
+	}
+      }
+  }
+
+  void collect_results( boost::mpi::communicator const & c){
+   BaseType::collect_results(c);
+   mc_weight_type Z_qmc ( this->acc_sign);
+   boost::scoped_ptr<tqa::h5::H5File> file;
+   if (c.rank()==0) { 
+    file.reset(new tqa::h5::H5File(filename.c_str(), H5F_ACC_TRUNC));
+    tqa::h5::h5_write(*file, "Beta", Config.Beta);
+    tqa::h5::h5_write(*file, "n_nu", n_nu);
+    tqa::h5::h5_write(*file, "n_omega", n_omega);
+   }
+   for (int a=0; a<Config.Na; ++a) 
+    for (int b=0; b<Config.Na; ++b) { 
+     tqa::array<COMPLEX,5> const & g (G2[a*Config.Na+b]); // the accumulator is left untouched
+     tqa::array<COMPLEX,5> g_tot(g.shape());
+     boost::mpi::reduce(c, g.data_start(), g.num_elements(), g_tot.data_start(), std::plus<COMPLEX>(), 0);
+     if (c.rank()!=0) continue;
+     const double f = 1/(real(Z_qmc) * Config.Beta);
+     for (size_t i=0; i<g_tot.num_elements(); ++i) g_tot.data_start()[i] *= f;
+     std::stringstream fs; fs<<"G2_"<<a<<"_"<<b;
+     tqa::h5_write(*file, fs.str(), g_tot);
+    }
+  }
+
+};
+
+#endif
@@ -0,0 +1,84 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIQS_CTHYB1_MEASURES_G_IW_H
+#define TRIQS_CTHYB1_MEASURES_G_IW_H
+
+#include "Configuration.hpp"
+#include "Measures_Z.hpp"
+#include "nfft_binner.hpp"
+#include <algorithm>
+#include <triqs/gf_local/GF_Bloc_ImFreq.hpp>
+
+/**
+   Measure the Green function (one bloc only) directly in Matsubara frequencies : 
+
+     G(i omega_n) = - 1/ (Z Beta)  sum  s M_ji exp(i omega_n (tau_i - tau'_j))
+
+   The sum is accumulated with a non-equispaced FFT (cf nfft_binner) on the first N_Frequencies_Accumulated 
+   frequencies of the mesh, at a cost O(k^2) per measure. There is no binning in time, hence no binning error.
+   Above, G is set to its leading tail delta_{alpha,alpha'}/(i omega_n) (the solver fits the tail there anyway).
+*/
+class Measure_G_iw : public Measure_acc_sign<COMPLEX> {
+  typedef Measure_acc_sign<COMPLEX> BaseType;
+  const std::string name;  
+  const Configuration & Config;
+  GF_Bloc_ImFreq & G_iw;
+  const int a_level;
+  nfft_binner G_iw_bin;
+ public :   
+
+  Measure_G_iw(const Configuration & Config_,int a, GF_Bloc_ImFreq & Giw_, int N_Frequencies_Accumulated):
+   BaseType(), name(to_string("G(iw)",a)), Config(Config_), G_iw(Giw_), a_level(a), 
+   G_iw_bin(Config_.Beta, std::max(1,std::min(N_Frequencies_Accumulated, Giw_.mesh.len())), Giw_.N1*Giw_.N2) { 
+    assert (G_iw.mesh.index_min==0); 
+   }
+
+  void accumulate(COMPLEX signe)  { 
+   BaseType::accumulate(signe);
+   const double s(real(signe)); // not elegant !
+   for (Configuration::DET_TYPE::C_Cdagger_M_iterator p(*Config.dets[a_level]); !p.atEnd(); ++p) 
+    G_iw_bin(Config.info[p.C()->Op->Number].alpha * G_iw.N2 + Config.info[p.Cdagger()->Op->Number].alpha, 
+      p.C()->tau - p.Cdagger()->tau, s* p.M());
+  }
+
+  void collect_results( boost::mpi::communicator const & c){
+   BaseType::collect_results(c);
+   mc_weight_type Z_qmc ( this->acc_sign);
+   // sum the grids over the nodes : the transform is linear. The accumulator is left untouched.
+   std::vector<COMPLEX> const & grid (G_iw_bin.grid_data());
+   std::vector<COMPLEX> grid_tot(grid.size());
+   boost::mpi::all_reduce(c, &grid[0], grid.size(), &grid_tot[0], std::plus<COMPLEX>());
+   const int n_acc = G_iw_bin.n_frequencies();
+   std::vector<COMPLEX> res(n_acc);
+   for (int n1=1; n1<=G_iw.N1;n1++)
+    for (int n2=1; n2<=G_iw.N2;n2++) { 
+     G_iw_bin.transform((n1-1)*G_iw.N2 + n2-1, &res[0], grid_tot);
+     for (int n=0; n<n_acc; ++n) G_iw.data(n1,n2,n) = - res[n] / (real(Z_qmc) * Config.Beta);
+     for (int n=n_acc; n<G_iw.mesh.len(); ++n) 
+      G_iw.data(n1,n2,n) = (n1==n2 ? 1/COMPLEX(0,(2*n+1)*M_PI/Config.Beta) : 0);
+    }
+  }
+
+};
+
+#endif
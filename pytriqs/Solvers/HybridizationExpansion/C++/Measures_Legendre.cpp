@@ -27,31 +27,54 @@
 
 using namespace triqs::utility;
 
-void Measure_G_Legendre::accumulate(COMPLEX signe) {
-
-  const double s(real(signe)); // not elegant !
-  BaseType::accumulate(s);
+void Legendre_accumulator::operator()(double s, double * res) {
 
-  legendre_generator Tn = legendre_generator();
-  double delta_tau;
-  short st;
+  const int Nab = N1*N2;
+  x_tmp.clear(); w_tmp.clear(); ab_tmp.clear();
+  for (int u=0; u<=Nab; ++u) count[u]=0;
 
+  // gather all the pairs (x, s * sign * M, alpha1, alpha2) 
   for (Configuration::DET_TYPE::C_Cdagger_M_iterator p(*conf.dets[a_level]); !p.atEnd(); ++p) {
+    short st=1;
+    double delta_tau=p.C()->tau-p.Cdagger()->tau;
+    if (delta_tau<0.0) {
+      delta_tau+=conf.Beta;
+      st=-1;
+    }
+    const int ab = conf.info[p.C()->Op->Number].alpha * N2 + conf.info[p.Cdagger()->Op->Number].alpha;
+    x_tmp.push_back(2*delta_tau/conf.Beta-1);
+    w_tmp.push_back(s*st*p.M());
+    ab_tmp.push_back(ab);
+    count[ab+1]++;
+  }
+  const int N = x_tmp.size();
+  if (N==0) return;
+  if (int(work1.size())<N) { work1.resize(N); work2.resize(N);}
 
-      st=1;
-      delta_tau=p.C()->tau-p.Cdagger()->tau;
-      if (delta_tau<0.0) {
-        delta_tau+=conf.Beta;
-        st=-1;
-      }
-
-      const double x=2*delta_tau/conf.Beta-1;
-      Tn.reset(x);
-      const double temp=s*st*p.M();
-      for (int n=0; n<Gl.numberLegendreCoeffs; n++) {
-        Gl.data(conf.info[p.C()->Op->Number].alpha+1, conf.info[p.Cdagger()->Op->Number].alpha+1, n) += temp*Tn.next();
-      }
+  // one block of size 1 : nothing to sort
+  if (Nab==1) { 
+    legendre_accumulate(N, &x_tmp[0], &w_tmp[0], n_legendre, res, &work1[0], &work2[0]);
+    return;
+  }
 
+  // counting sort of the pairs by (alpha1,alpha2)
+  for (int u=0; u<Nab; ++u) count[u+1] += count[u];
+  x_buf.resize(N); w_buf.resize(N);
+  for (int i=0; i<N; ++i) { 
+    const int pos = count[ab_tmp[i]]++; 
+    x_buf[pos] = x_tmp[i]; w_buf[pos] = w_tmp[i];
   }
+  // now count[ab] is the end of the ab segment
+  for (int ab=0, start=0; ab<Nab; start = count[ab], ++ab) 
+    if (count[ab]>start) 
+      legendre_accumulate(count[ab]-start, &x_buf[start], &w_buf[start], n_legendre, res + ab*n_legendre, &work1[0], &work2[0]);
 }
 
+//-----------------------------------------------------
+
+void Measure_G_Legendre::accumulate(COMPLEX signe) {
+
+  const double s(real(signe)); // not elegant !
+  BaseType::accumulate(s);
+  acc(s, &data[0]);
+}
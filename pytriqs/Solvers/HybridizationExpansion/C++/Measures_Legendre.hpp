@@ -24,6 +24,27 @@
 #define TRIQS_CTHYB1_MEASURES_LEGENDRE_H
 #include <triqs/gf_local/GF_Bloc_ImLegendre.hpp>
 #include "Measures_Z.hpp"
+#include "Configuration.hpp"
+
+/**
+  Accumulates the Legendre coefficients of one block of G for the current configuration, 
+  i.e. for all the (C, Cdagger) pairs of the determinant : 
+    res[ (alpha1 * N2 + alpha2) * n_legendre + l ] += s * sign * M * P_l(x)
+  The pairs are first gathered by (alpha1,alpha2) into contiguous buffers (x, s * sign * M), 
+  then the recurrence is run for all points of each (alpha1,alpha2) at once (cf legendre_accumulate).
+*/
+class Legendre_accumulator { 
+ const Configuration & conf;
+ const int a_level, N1, N2, n_legendre;
+ std::vector<double> x_tmp, w_tmp, x_buf, w_buf, work1, work2;
+ std::vector<int> ab_tmp, count;
+ public:
+ Legendre_accumulator (Configuration const & conf_, int a, int N1_, int N2_, int n_legendre_):
+  conf(conf_), a_level(a), N1(N1_), N2(N2_), n_legendre(n_legendre_), count(N1_*N2_+1) {}
+
+ /// res must be of size N1*N2*n_legendre
+ void operator()(double s, double * res);
+};
 
 /* Measure in Legendre Polynoms.  */
 class Measure_G_Legendre : public Measure_acc_sign<COMPLEX> { 
@@ -32,12 +53,16 @@ class Measure_G_Legendre : public Measure_acc_sign<COMPLEX> {
  const int a_level;
  GF_Bloc_ImLegendre & Gl;
  typedef Measure_acc_sign<COMPLEX> BaseType;  
+ Legendre_accumulator acc;
+ std::vector<double> data; // contiguous (alpha1,alpha2,l), folded into Gl at the end
 
  public:
  const std::string name;  
 
  Measure_G_Legendre (Configuration const & conf_, int a, GF_Bloc_ImLegendre & Gl_):
-  BaseType(), conf(conf_), a_level(a), Gl(Gl_), name(to_string("G(legendre)",a)){Gl.data=0;}
+  BaseType(), conf(conf_), a_level(a), Gl(Gl_), 
+  acc(conf_, a, Gl_.N1, Gl_.N2, Gl_.numberLegendreCoeffs), data(Gl_.N1*Gl_.N2*Gl_.numberLegendreCoeffs, 0.0),
+  name(to_string("G(legendre)",a)){Gl.data=0;}
 
  void accumulate(COMPLEX signe);
 
@@ -45,10 +70,10 @@ class Measure_G_Legendre : public Measure_acc_sign<COMPLEX> {
    BaseType::collect_results(c);
    double Z_qmc ( real(this->acc_sign));
 
-   for (int n1=1; n1<=Gl.N1;n1++)
+   for (int n1=1, u=0; n1<=Gl.N1;n1++)
      for (int n2=1; n2<=Gl.N2;n2++)
-       for (int l = Gl.mesh.index_min; l <= Gl.mesh.index_max; l++)
-         Gl.data(n1,n2,l) = -(sqrt(2.0*l+1.0)/(Z_qmc*conf.Beta)) * Gl.data(n1,n2,l);
+       for (int l = 0; l < Gl.numberLegendreCoeffs; l++, u++)
+         Gl.data(n1,n2,l) = -(sqrt(2.0*l+1.0)/(Z_qmc*conf.Beta)) * data[u];
    Gl.MPI_reduce_sum_onsite();
    Gl.MPI_bcast();
    Gl.determine_tail();
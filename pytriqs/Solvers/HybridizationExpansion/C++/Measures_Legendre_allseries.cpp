@@ -30,29 +30,9 @@ void Measure_G_Legendre_all::accumulate(COMPLEX signe) {
   const double s(real(signe)); // not elegant !
   BaseType::accumulate(s);
 
-  legendre_generator Tn = legendre_generator();
-  double delta_tau;
-  short st;
-
+  // data_part is C ordered (alpha1,alpha2,l) hence contiguous as expected by acc
   data_part()=0;
-  for (Configuration::DET_TYPE::C_Cdagger_M_iterator p(*conf.dets[a_level]); !p.atEnd(); ++p) {
-
-      st=1;
-      delta_tau=p.C()->tau-p.Cdagger()->tau;
-      if (delta_tau<0.0) {
-        delta_tau+=conf.Beta;
-        st=-1;
-      }
-
-      const double x=2*delta_tau/conf.Beta-1;
-      Tn.reset(x);
-      const double temp=s*st*p.M();
-      for (int n=0; n<Gl.numberLegendreCoeffs; n++) {
-        double a =  temp*Tn.next();
-        data_part(conf.info[p.C()->Op->Number].alpha, conf.info[p.Cdagger()->Op->Number].alpha, n) += a;
-      }
-
-  }
+  acc(s, data_part.data_start());
   data +=data_part;
   data_stack << data_part;
   
@@ -26,6 +26,7 @@
 #include <triqs/arrays/h5/array_stack.hpp>
 #include <triqs/gf_local/GF_Bloc_ImLegendre.hpp>
 #include "Measures_Z.hpp"
+#include "Measures_Legendre.hpp"
 #include "Configuration.hpp"
 
 namespace tqa=triqs::arrays;
@@ -37,6 +38,7 @@ class Measure_G_Legendre_all : public Measure_acc_sign<COMPLEX> {
  const int a_level;
  GF_Bloc_ImLegendre & Gl;
  typedef Measure_acc_sign<COMPLEX> BaseType;  
+ Legendre_accumulator acc;
 
  tqa::array<double,3> data,data_part;
  tqa::h5::H5File outfile;
@@ -45,19 +47,26 @@ class Measure_G_Legendre_all : public Measure_acc_sign<COMPLEX> {
  template<class T1, class T2, class T3, class T4>
   static std::string filename(T1 x1, T2 x2, T3 x3, T4 x4) { std::stringstream f; f<<x1<<x2<<x3<<x4; return f.str(); }
 
+ // the series is written in the background (the chain does not wait for the disk), and compressed
+ static tqa::h5::array_stack_options stack_options() { 
+  tqa::h5::array_stack_options r; r.asynchronous = true; r.deflate_level = 1; r.shuffle = true; return r;
+ }
+
  public:
  const std::string name;  
 
  // PUT the file out to keep the node...
  // multinode....
  Measure_G_Legendre_all (Configuration const & conf_, int a, GF_Bloc_ImLegendre & Gl_):
-  BaseType(), conf(conf_), a_level(a), Gl(Gl_), name(to_string("G(legendre)",a)), 
+  BaseType(), conf(conf_), a_level(a), Gl(Gl_), 
+  acc(conf_, a, Gl_.N1, Gl_.N2, Gl_.numberLegendreCoeffs),
+  name(to_string("G(legendre)",a)), 
  //data (Gl.data.shape()), // need triqs::arrays for this
  //data_part (Gl.data.shape())
   data(Gl.N1, Gl.N2, Gl.mesh.index_max+1),  
   data_part(Gl.N1, Gl.N2, Gl.mesh.index_max+1) ,  
   outfile(filename("Gl_stack",a,".h5","").c_str(), H5F_ACC_TRUNC ) ,
-  data_stack(outfile, "Gl",data.shape(), 1000)
+  data_stack(outfile, "Gl",data.shape(), 1000, stack_options())
  {
   assert( Gl.mesh.index_min ==0);
   data()=0;
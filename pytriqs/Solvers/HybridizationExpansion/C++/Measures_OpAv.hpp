@@ -27,37 +27,48 @@
 #include "Measures_Z.hpp"
 
 /**
-   Measure the average of an operator
+   Measure the average of a list of operators.
+   The operators are inserted at N_tau equidistant times (N_tau=1 : tau = Beta/2) and the ratios of the traces
+   are computed from the slices already stored in the DynamicTrace : the configuration is not modified.
 */
 class Measure_OpAv : public Measure_acc_sign<COMPLEX> {
-  Configuration & Config;
-  double opAv;
+  const Configuration & Config;
+  Configuration::DYNAMIC_TRACE::ScratchSlice scratch; // for the trace ratios
+  const vector<string> names;
+  vector<const Hloc::Operator *> Ops;
+  vector<double> taus, opAv;
+  vector<Hloc::REAL_OR_COMPLEX> ratios;
   python::dict opAv_res;
   typedef Measure_acc_sign<COMPLEX> BaseType;  
 public :   
-  Measure_OpAv(string opName, Configuration & Config_, python::dict opAv_results):
-   BaseType(), Config(Config_), opAv(0.0), opAv_res(opAv_results) , name(opName){}
-
-  const string name;
+  Measure_OpAv(vector<string> const & opNames, const Configuration & Config_, python::dict opAv_results, int N_tau=1):
+   BaseType(), Config(Config_), scratch(Config_.DT), names(opNames), taus(N_tau), opAv(opNames.size(),0.0), opAv_res(opAv_results) {
+   assert(N_tau>0);
+   for (uint n=0; n<names.size(); ++n) Ops.push_back(&Config.H[names[n]]);
+   for (int t=0; t<N_tau; ++t) taus[t] = (t+0.5)*Config.Beta/N_tau;
+  }
 
   void accumulate(COMPLEX signe) {
    BaseType::accumulate(signe);
    const double s(real(signe)); // not elegant !
-   double tau = Config.Beta/2.0;
-   Config.DT.insertOneOperator(tau, Config.H[name]);
-   double r = Config.DT.ratioNewTrace_OldTrace();
-   Config.DT.undo_insertOneOperator();
-   opAv += s*r;
+   Config.DT.traceRatiosWithOperatorsInserted(taus,Ops,ratios,scratch);
+   for (uint n=0, u=0; n<Ops.size(); ++n) { 
+    double r=0;
+    for (uint t=0; t<taus.size(); ++t, ++u) r += ratios[u];
+    opAv[n] += s*r/taus.size();
+   }
   }
 
   void collect_results( boost::mpi::communicator const & c){
    BaseType::collect_results(c);
    double Z_qmc ( real(this->acc_sign));
-   double op_average;
-   boost::mpi::reduce(c, opAv, op_average, std::plus<double>(), 0);
-   op_average /= Z_qmc;
-   if (c.rank()==0) std::cout << "< " << name << " > = " << op_average << endl;
-   opAv_res[name] = op_average; // master only
+   for (uint n=0; n<names.size(); ++n) { 
+    double op_average;
+    boost::mpi::reduce(c, opAv[n], op_average, std::plus<double>(), 0);
+    op_average /= Z_qmc;
+    if (c.rank()==0) std::cout << "< " << names[n] << " > = " << op_average << endl;
+    opAv_res[names[n]] = op_average; // master only
+   }
   }
 };
 
@@ -0,0 +1,80 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef TRIQS_CTHYB1_MEASURES_RECORD_CONFIGURATIONS_H
+#define TRIQS_CTHYB1_MEASURES_RECORD_CONFIGURATIONS_H
+#include <triqs/arrays/array.hpp>
+#include <triqs/arrays/h5/array_stack.hpp>
+#include "Configuration.hpp"
+
+namespace tqa=triqs::arrays;
+
+/**
+  Records the sampled configurations in an hdf5 file, for a later replay of the measures 
+  (cf MC_Hybridization_Matsubara::replay). The file contains two stacks : 
+   - "configurations" : for each configuration, (number of operators, real part, imaginary part of the sign)
+   - "operators" : the operators of all the configurations, one after the other : (a, alpha, dagger, tau)
+  The stacks are buffered, so that the file is written by large blocks, and asynchronous : a full buffer is 
+  written in the background while the chain goes on (cf array_stack_options). They are flushed in collect_results.
+  NB : as for Measure_G_Legendre_all, an HDF5 write of another measure while a buffer is written in the background 
+  (e.g. the G2 file in collect_results) requires an HDF5 library compiled thread-safe.
+*/
+class Measure_Record_Configurations { 
+
+ Configuration & conf;
+ tqa::h5::H5File outfile;
+ tqa::h5::array_stack< tqa::array<double,1> > conf_stack, op_stack;
+ vector<Configuration::RecordedOperator> ops;
+
+ static tqa::h5::array_stack_options stack_options() { 
+  tqa::h5::array_stack_options r; r.asynchronous = true; return r;
+ }
+
+ public:
+
+ Measure_Record_Configurations (Configuration & conf_, std::string const & filename):
+  conf(conf_), 
+  outfile(filename.c_str(), H5F_ACC_TRUNC ),
+  conf_stack(outfile, "configurations", tqa::mini_vector<size_t,1>(3), 1000, stack_options()),
+  op_stack(outfile, "operators", tqa::mini_vector<size_t,1>(4), 10000, stack_options()) {}
+
+ void accumulate(COMPLEX signe) { 
+  conf.get_operators(ops);
+  tqa::array_view<double,1> c(conf_stack()); 
+  c(0) = ops.size(); c(1) = real(signe); c(2) = imag(signe); 
+  ++conf_stack;
+  for (uint k=0; k<ops.size(); ++k) { 
+   tqa::array_view<double,1> o(op_stack()); 
+   o(0) = ops[k].a; o(1) = ops[k].alpha; o(2) = (ops[k].dagger ? 1 : 0); o(3) = ops[k].tau;
+   ++op_stack;
+  }
+ }
+
+ void collect_results( boost::mpi::communicator const &){ // each node writes its own file
+  conf_stack.flush(); op_stack.flush();
+  outfile.flush(H5F_SCOPE_GLOBAL);
+ }
+
+};
+
+#endif
@@ -27,12 +27,23 @@
 #include "triqs/mc_tools/random_generator.hpp"
 
 
+/**
+   Global move : applies a mapping operator -> operator to all the operators of the configuration.
+
+   When the mapping sends all the operators of block a to the operators of block pi(a) with the same alpha
+   (e.g. a spin flip or an orbital swap), and pi is a bijection, the determinants of a cycle of pi whose blocks all have 
+   the same Delta are simply permuted (and their operators relabeled) : they are not recomputed.
+   Only the other blocks are recomputed from scratch, in O(k^3).
+*/
 class Global_Move { 
   const std::string name;
   Configuration & Config;
   mc_tools::random_generator & Random;  
   const vector<const Hloc::Operator*> mapping;
-  vector<Configuration::DET_TYPE*> dets_save;
+  vector<Configuration::DET_TYPE*> dets_save, dets_old;
+  vector<int> image;   // image[a] = pi(a), or -1 if the mapping is not a permutation of the blocks
+  vector<bool> relabel; // relabel[a] : the det of a is moved to pi(a) without recomputation
+  vector< vector<Configuration::OP_REF> > C, Cdag; // work arrays
 public :  
   
   typedef std::complex<double> mc_weight_type;
@@ -43,12 +54,17 @@ public :
     name(string("Global_Move_") + name_),
     Config(Config_), Random(RNG),
     mapping(mapping_),
-    dets_save(Config.Na,(Configuration::DET_TYPE*)NULL)  {
+    dets_save(Config.Na,(Configuration::DET_TYPE*)NULL),
+    dets_old(Config.Na,(Configuration::DET_TYPE*)NULL),
+    image(Config.Na,-1), relabel(Config.Na,false),
+    C(Config.Na), Cdag(Config.Na) {
     // build auxiliary determinants (empty)
     for (int a= 0; a<Config.Na; ++a) {
       Configuration::DET_TYPE * d = Config.dets[a];
       dets_save[a] = new Configuration::DET_TYPE(d->delta, d->Nmax_current(), d->Eta);
+      C[a].reserve(100); Cdag[a].reserve(100);
     }
+    analyse_mapping();
   }
 
   //---------------------
@@ -69,38 +85,22 @@ public :
  
     // Now, we will look at the new operators in the trace and reconstruct
     // the other structure of the configuration, like the determinants, Insertions list etc....
-
-    // reserve space to gather the OP_REF on the new operators C, Cdagger.
-    vector< vector<Configuration::OP_REF> > C1(Config.Na),Cdag1(Config.Na),C(Config.Na),Cdag(Config.Na);
-    for (int a= 0; a<Config.Na; ++a) {
-      C1[a].reserve(100); Cdag1[a].reserve(100);
-      C[a].reserve(100); Cdag[a].reserve(100);
-    }
-
-    // Go over the list of local operators in DT
-    for (Configuration::OP_REF it=Config.DT.OpRef_begin(); ! it.atEnd(); ++it) {
-      Configuration::BlockInfo & INFO(Config.info[it->Op->Number]); 
-      if (!INFO.isFundamental()) continue;
-      if (INFO.dagger) 
-	Cdag1[INFO.a].push_back(it);
-      else 
-	C1[INFO.a].push_back(it);
-    }
+    gather_operators();
     
     //-----------------------------------------
     //    Starts recomputation of determinants 
     //-----------------------------------------
 
-    // reverse the order of the C, since they are stored in decreasing time.
-    for (int a= 0; a<Config.Na; ++a) {
-      for (uint u =0; u<C1[a].size(); ++u) C[a].push_back(C1[a][C1[a].size() - u -1]);
-      for (uint u =0; u<Cdag1[a].size(); ++u) Cdag[a].push_back(Cdag1[a][Cdag1[a].size() - u -1]);
-    }
-    
-    // I stored the current det into a copy and 
-    // recompute the determinants
+    // The permuted determinants are moved and relabeled : their product is unchanged.
+    // For the others, I store the current det into a copy and recompute the determinants
+    dets_old = Config.dets;
     double r1=1, r2=1;
     for (int a= 0; a<Config.Na; ++a) {
+      if (relabel[a]) { 
+	Config.dets[image[a]] = dets_old[a];
+	dets_old[a]->relabel(Cdag[image[a]],C[image[a]]);
+	continue;
+      }
       swap(dets_save[a],Config.dets[a]);
       Config.dets[a]->recomputeFrom(Cdag[a],C[a]);
       r1 *= Config.dets[a]->determinant();
@@ -162,7 +162,78 @@ public :
     std::cout << "CONFIG AFTER: " << Config.DT << std::endl;
 #endif
 
-    for (int a= 0; a<Config.Na; ++a) std::swap(dets_save[a],Config.dets[a]);
+    bool relabeled = false;
+    for (int a= 0; a<Config.Na; ++a) {
+      if (relabel[a]) { Config.dets[a] = dets_old[a]; relabeled = true;}
+      else std::swap(dets_save[a],Config.dets[a]);
+    }
+    if (!relabeled) return;
+    // the permuted determinants point to the operators of the rejected configuration 
+    gather_operators();
+    for (int a= 0; a<Config.Na; ++a) if (relabel[a]) Config.dets[a]->relabel(Cdag[a],C[a]);
+  }
+
+ private:
+
+  // gather the OP_REF on the C, Cdagger of each block in decreasing time, as stored in the determinants.
+  void gather_operators() { 
+    for (int a= 0; a<Config.Na; ++a) { C[a].clear(); Cdag[a].clear();}
+    for (Configuration::OP_REF it=Config.DT.OpRef_begin(); ! it.atEnd(); ++it) {
+      Configuration::BlockInfo & INFO(Config.info[it->Op->Number]); 
+      if (!INFO.isFundamental()) continue;
+      if (INFO.dagger) 
+	Cdag[INFO.a].push_back(it);
+      else 
+	C[INFO.a].push_back(it);
+    }
+    for (int a= 0; a<Config.Na; ++a) { 
+      std::reverse(C[a].begin(),C[a].end());
+      std::reverse(Cdag[a].begin(),Cdag[a].end());
+    }
+  }
+
+  //---------------------
+
+  // computes image and relabel
+  void analyse_mapping() { 
+    for (int a= 0; a<Config.Na; ++a) {
+      int b = -1; bool ok = true;
+      for (uint alpha=0; alpha<Config.COps[a].size(); ++alpha) 
+	for (int dag=0; dag<2; ++dag) { 
+	  const Hloc::Operator * Op = (dag ? Config.CdagOps[a][alpha] : Config.COps[a][alpha]);
+	  const Configuration::BlockInfo & INFO(Config.info[mapping[Op->Number]->Number]);
+	  ok = ok && INFO.isFundamental() && (INFO.alpha == int(alpha)) && (INFO.dagger == bool(dag)) && ((b==-1) || (b==INFO.a));
+	  b = INFO.a;
+	}
+      if (ok && (b>=0) && (Config.COps[b].size()==Config.COps[a].size())) image[a] = b; 
+    }
+    // pi must be a bijection
+    vector<bool> reached(Config.Na,false);
+    for (int a= 0; a<Config.Na; ++a) { 
+      if ((image[a]<0) || reached[image[a]]) { image.assign(Config.Na,-1); return;}
+      reached[image[a]] = true;
+    }
+    // the determinants of a cycle of pi are permuted if Delta is the same on all the blocks of the cycle
+    vector<bool> done(Config.Na,false);
+    for (int a= 0; a<Config.Na; ++a) { 
+      if (done[a]) continue;
+      bool same = true;
+      int b=a;
+      do { same = same && same_Delta(b,image[b]); done[b] = true; b = image[b];} while (b!=a);
+      do { relabel[b] = same; b = image[b];} while (b!=a);
+    }
+  }
+
+  //---------------------
+
+  bool same_Delta(int a, int b) const { 
+    const GF_Bloc_ImTime & D1 (Config.Delta_tau[a]), & D2 (Config.Delta_tau[b]);
+    if ((D1.N1 != D2.N1) || (D1.N2 != D2.N2) || (D1.mesh.len() != D2.mesh.len())) return false;
+    for (int n1=1; n1<=D1.N1; ++n1)
+      for (int n2=1; n2<=D1.N2; ++n2)
+	for (int n=D1.mesh.index_min; n<=D1.mesh.index_max; ++n)
+	  if (D1.data_const(n1,n2,n) != D2.data_const(n1,n2,n)) return false;
+    return true;
   }
   
 };
@@ -32,6 +32,8 @@ using OP_Tools::map_insert_check;
 /*
   Implementation of the Segment Picture version of the Insert/remove Moves.
   This is only valid if C Cdag alternate for each a level.
+  If Config.Segments is set (density-density Hloc), the trace ratio is computed from the segments,
+  and only the list of operators of the DT is updated.
  */
 
 /************************
@@ -48,6 +50,7 @@ class Insert_Cdag_C_Delta_SegmentPicture {
   const std::string name;
   mc_tools::histogram_binned & HISTO_Length_Kinks_Proposed, & HISTO_Length_Kinks_Accepted;
   Configuration::DET_TYPE * det;
+  Configuration::OP_REF O1, O2;
   double try_insert_length_max;
 public :  
   typedef std::complex<double> mc_weight_type;
@@ -124,17 +127,18 @@ public :
     Op1_is_dagger = INFO.dagger;
    }
 
+   double tauCdag = (Op1_is_dagger ? tau1 : tau2);
+   double tauC = (Op1_is_dagger ? tau2 : tau1);
+
    // Insert the operators Op1 and Op2. 
    // O1 will always be the dagger : 
    // Cf doc of insertTwoOperators, order of output OPREF is the same as input operators 
-   Configuration::OP_REF O1, O2;
-   tie (no_trivial_reject,O1,O2) = (Op1_is_dagger ? 
-     Config.DT.insertTwoOperators(tau1,OpCdag,tau2,OpC) : 
-     Config.DT.insertTwoOperators(tau2,OpCdag,tau1,OpC));
+   tie (no_trivial_reject,O1,O2) = (Config.Segments ? 
+     Config.DT.insertTwoOperators_ListOnly(tauCdag,OpCdag,tauC,OpC) : 
+     Config.DT.insertTwoOperators(tauCdag,OpCdag,tauC,OpC));
    if (!no_trivial_reject) return 0;
-
-   double tauCdag = (Op1_is_dagger ? tau1 : tau2);
-   double tauC = (Op1_is_dagger ? tau2 : tau1);
+   mc_weight_type trace_ratio = (Config.Segments ? 
+     Config.Segments->try_insert(a_level,tauCdag,tauC) : Config.DT.ratioNewTrace_OldTrace());
 
    // Find the position for insertion in the determinant
    // NB : the determinant store the C in decreasing order.
@@ -146,13 +150,13 @@ public :
      (p != det->C_end()) &&  (p->tau > tauC) ; ++p, ++numC) {}
 
    // acceptance probability
-   mc_weight_type p = Config.DT.ratioNewTrace_OldTrace() * det->try_insert(numCdag,numC,O1,O2);
+   mc_weight_type p = trace_ratio * det->try_insert(numCdag,numC,O1,O2);
    int Na(det->NumberOfC()+1); 
    // !!! det not modified until det->accept_move is called, so I need to compensate by +1
    double Tratio = Config.Beta * try_insert_length_max / (Na ==1 ? 1 : 2*Na);
    // (Na... term : cf remove move...
 #ifdef DEBUG
-   std::cout << "Trace Ratio: " << Config.DT.ratioNewTrace_OldTrace() << std::endl;
+   std::cout << "Trace Ratio: " << trace_ratio << std::endl;
    std::cout << "p*T: " << p*Tratio << std::endl;
    std::cout << "CONFIG AFTER: " << Config.DT << std::endl;
    //for (int a = 0; a<Config.Na; ++a) print_det(Config.dets[a]);
@@ -164,7 +168,7 @@ public :
   //----------------
 
   mc_weight_type Accept() { 
-   Config.DT.confirm_insertTwoOperators();
+   if (Config.Segments) Config.Segments->confirm(); else Config.DT.confirm_insertTwoOperators();
    det->accept_move(); 
    if (Config.RecordStatisticConfigurations) {
     HISTO_Length_Kinks_Accepted << deltaTau;
@@ -181,7 +185,8 @@ public :
 
   void Reject() {
    if (no_trivial_reject) { 
-    Config.DT.undo_insertTwoOperators(); //nothing to be done for the det 
+    if (Config.Segments) Config.DT.removeTwoOperators_ListOnly(O1,O2); 
+    else Config.DT.undo_insertTwoOperators(); //nothing to be done for the det 
    }
 #ifdef DEBUG
    std::cout << "CONFIG REJECT: " << Config.DT << std::endl;
@@ -202,6 +207,7 @@ class Remove_Cdag_C_Delta_SegmentPicture  {
  mc_tools::random_generator & Random;
  const int a_level, Nalpha;
  Configuration::DET_TYPE * det;
+ Configuration::OP_REF OpCdag, OpC;
  public :  
 
  typedef std::complex<double> mc_weight_type;
@@ -265,7 +271,13 @@ class Remove_Cdag_C_Delta_SegmentPicture  {
   Configuration::DET_TYPE::C_reverse_iterator           itC = det->select_reverse_C( numC );
 
   // Remove the operators from the traces
-  Config.DT.removeTwoOperators(*itCdag,*itC);
+  OpCdag = *itCdag; OpC = *itC;
+  mc_weight_type trace_ratio;
+  if (Config.Segments) trace_ratio = Config.Segments->try_remove(a_level,OpCdag->tau,OpC->tau);
+  else { 
+   Config.DT.removeTwoOperators(OpCdag,OpC);
+   trace_ratio = Config.DT.ratioNewTrace_OldTrace();
+  }
 
   // first_point is the first of the couple, next_point is the op on a_level *after* the second
   // with cyclicity
@@ -288,13 +300,13 @@ class Remove_Cdag_C_Delta_SegmentPicture  {
     Config.CyclicOrientedTimeDistance(next_point->tau- first_point->tau) );
 
   // Acceptance probability
-  mc_weight_type p = Config.DT.ratioNewTrace_OldTrace() * det->try_remove(Na + 1- numCdag,Na + 1- numC);
+  mc_weight_type p = trace_ratio * det->try_remove(Na + 1- numCdag,Na + 1- numC);
   double Tratio  =  (Na ==1 ? 1 : 2*Na) / (Config.Beta * length_max);      
   // (Na term : because if we have only 1 couple of C Cdagger, n = 0 and 1 will lead to the same couple
   // and this is the only case like this.
 #ifdef DEBUG
   cout<< " length_max "<<length_max<<endl;
-  std::cout << "RATIO: " << Config.DT.ratioNewTrace_OldTrace() << std::endl;
+  std::cout << "RATIO: " << trace_ratio << std::endl;
   std::cout << "CONFIG AFTER: " << Config.DT << std::endl;
 #endif
   return p*Tratio;
@@ -303,7 +315,11 @@ class Remove_Cdag_C_Delta_SegmentPicture  {
 //----------------
 
 mc_weight_type Accept() { 
- Config.DT.confirm_removeTwoOperators(); 
+ if (Config.Segments) { 
+  Config.Segments->confirm(); 
+  Config.DT.removeTwoOperators_ListOnly(OpCdag,OpC);
+ }
+ else Config.DT.confirm_removeTwoOperators(); 
  det->accept_move(); 
 #ifdef DEBUG
  std::cout << "CONFIG ACCEPT: " << Config.DT << std::endl;
@@ -316,7 +332,7 @@ mc_weight_type Accept() {
 //----------------
 
 void Reject() { 
- Config.DT.undo_removeTwoOperators(); //nothing to be done for the det 
+ if (!Config.Segments) Config.DT.undo_removeTwoOperators(); //nothing to be done for the det 
 }
 
 };
@@ -0,0 +1,90 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "SegmentTrace.hpp"
+#include <map>
+
+using std::vector;
+
+namespace { 
+ bool nearly_equal(double x, double y) { return std::abs(x-y) <= 1.e-10 * (1 + std::abs(x) + std::abs(y));}
+}
+
+SegmentTrace * SegmentTrace::make (const Hloc & H, vector<vector<const Hloc::Operator *> > const & COps,
+  vector<vector<const Hloc::Operator *> > const & CdagOps, double Beta) { 
+
+ const int N = COps.size();
+ for (int a=0; a<N; ++a) if ((COps[a].size()!=1) || (CdagOps[a].size()!=1)) return NULL;
+ // the blocs must be the 2^N states of the occupation basis
+ if ((N>16) || (H.MaxDimBlock!=1) || (H.NBlocks != (1<<N))) return NULL;
+
+ // the occupation of each bloc, read from the C operators
+ std::map<unsigned int, const Hloc::Bloc *> states;
+ for (Hloc::BlocIterator B = H.BlocBegin(); B != H.BlocEnd(); ++B) { 
+  unsigned int n=0;
+  for (int a=0; a<N; ++a) { 
+   const bool occupied = ((*COps[a][0])[&(*B)].Btarget !=NULL);
+   if (occupied == ((*CdagOps[a][0])[&(*B)].Btarget !=NULL)) return NULL;
+   if (occupied) n |= (1u<<a);
+  }
+  if (!states.insert(std::make_pair(n,&(*B))).second) return NULL;
+ }
+ 
+ // energies : E(n) must be E0 + sum_a eps_a n_a + sum_{a<b} U_ab n_a n_b
+ vector<double> eps(N);
+ vector<vector<double> > U(N,vector<double>(N,0));
+ const double E0 = states[0]->H[0];
+ for (int a=0; a<N; ++a) eps[a] = states[1u<<a]->H[0] - E0;
+ for (int a=0; a<N; ++a)
+  for (int b=0; b<a; ++b) U[a][b] = U[b][a] = states[(1u<<a)|(1u<<b)]->H[0] - E0 - eps[a] - eps[b];
+ for (unsigned int n=0; n< (1u<<N); ++n) { 
+  double E = E0;
+  for (int a=0; a<N; ++a) { 
+   if (!(n & (1u<<a))) continue;
+   E += eps[a];
+   for (int b=0; b<a; ++b) if (n & (1u<<b)) E += U[a][b];
+  }
+  if (!nearly_equal(E, states[n]->H[0])) return NULL;
+ }
+
+ // signs of the matrix elements : s(n) = sigma_a prod_{b in S_a} (-1)^n_b for C_a and Cdagger_a
+ vector<int> sigma(N);
+ vector<vector<bool> > S(N,vector<bool>(N,false));
+ for (int a=0; a<N; ++a) { 
+  const unsigned int bit = 1u<<a;
+  const Hloc::Operator & C (*COps[a][0]), & Cdag(*CdagOps[a][0]);
+  const double sC = C[states[bit]].M(0,0), sCdag = Cdag[states[0]].M(0,0);
+  sigma[a] = (sC * sCdag > 0 ? 1 : -1);
+  for (int b=0; b<N; ++b) 
+   if (b!=a) S[a][b] = (C[states[bit | (1u<<b)]].M(0,0) * sC < 0);
+  for (unsigned int n=0; n< (1u<<N); ++n) { 
+   int s=1;
+   for (int b=0; b<N; ++b) if (S[a][b] && (n & (1u<<b))) s = -s;
+   const Hloc::Operator & Op ( n & bit ? C : Cdag);
+   const double ref ( n & bit ? sC : sCdag);
+   if (!nearly_equal(Op[states[n]].M(0,0), s*ref)) return NULL; // this also checks |M|=1 up to the sign of ref
+  }
+  if (!nearly_equal(std::abs(sC),1) || !nearly_equal(std::abs(sCdag),1)) return NULL;
+ }
+
+ return new SegmentTrace(Beta,eps,U,sigma,S);
+}
@@ -0,0 +1,269 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIQS_CTHYB1_SEGMENT_TRACE_H
+#define TRIQS_CTHYB1_SEGMENT_TRACE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "Hloc.hpp"
+
+/**
+   Trace engine for density-density local Hamiltonians, in the segment picture : 
+
+     H_loc = E_0 + sum_a eps_a n_a + sum_{a<b} U_ab n_a n_b 
+
+   with one C, Cdagger couple per block a (called a flavour here).
+   The trace of a configuration is then
+
+     sign * sum_{n_e} exp( - sum_a eps_a l_a - sum_{a<b} U_ab O_ab )
+
+   where l_a is the total length of the segments of flavour a, O_ab the overlap of the segments of a and b, 
+   and n_e = 0,1 is the occupation of the flavours with no operators (the line is either full or empty).
+   The sign comes from the matrix elements of the C, Cdagger in the occupation basis (typically the Jordan-Wigner signs).
+
+   The times of the operators of each flavour are stored in a sorted array, with the occupied length 
+   at the left of each operator : the occupation, the overlap of a segment with a flavour and the 
+   number of operators of a flavour in an interval are found by bisection in O(log k).
+   The insertion/removal of a segment is simply a flip of the occupation of a flavour on an interval,
+   so the trace ratio costs O(N_flavours log k) and involves no matrix product at all : the weight is updated
+   from the change of the length and of the overlaps of the flavour moved. Only the 2^(number of empty flavours)
+   occupations of the empty flavours are summed at each try (none in the usual case where all flavours have operators).
+   The confirmation costs O(k) (insertion in the sorted array and update of the occupied lengths after it),
+   which is negligible compared to the O(k^2) update of the determinant of the same move.
+
+   Usage is the same as the DynamicTrace : try_insert/try_remove returns the ratio new trace/old trace,
+   and the change is done by confirm() (or forgotten if the move is rejected).
+*/
+class SegmentTrace { 
+ public:
+
+ /** 
+   Returns a new SegmentTrace if H is density-density in the occupation basis of the C operators, NULL otherwise.
+   COps[a], CdagOps[a] are the operators of block a : there must be exactly one of each per block.
+  */
+ static SegmentTrace * make (const Hloc & H, std::vector<std::vector<const Hloc::Operator *> > const & COps,
+   std::vector<std::vector<const Hloc::Operator *> > const & CdagOps, double Beta);
+
+ /**
+   - eps[a], U[a][b] (symmetric) : the parameters of H_loc
+   - sigma[a] : product of the signs of the matrix elements of C_a and Cdagger_a on the empty state 
+   - S[a][b] : the matrix elements of C_a, Cdagger_a change sign with n_b (b != a) 
+  */
+ SegmentTrace(double Beta_, std::vector<double> const & eps_, std::vector<std::vector<double> > const & U_,
+   std::vector<int> const & sigma_, std::vector<std::vector<bool> > const & S_) : 
+  Beta(Beta_), N(eps_.size()), eps(eps_), U(U_), sigma(sigma_), S(S_), 
+  flavours(N), L(N,0), O(N,std::vector<double>(N,0)), dO(N,0) {
+   log_weight = compute_log_weight(L,O,-1,-1, base, E, lin);
+  }
+
+ /// Ratio of the traces for the insertion of Cdagger_a(tau_cdag) C_a(tau_c)
+ double try_insert (int a, double tau_cdag, double tau_c) { return try_change(a,tau_cdag,tau_c,true);}
+
+ /// Ratio of the traces for the removal of Cdagger_a(tau_cdag) C_a(tau_c), which must be consecutive operators of flavour a
+ double try_remove (int a, double tau_cdag, double tau_c) { return try_change(a,tau_cdag,tau_c,false);}
+
+ /// Confirms the last try_insert/try_remove
+ void confirm() { 
+  const int a = a_last;
+  flavour & f (flavours[a]);
+  // the occupied lengths are unchanged before the first time modified
+  const int i0 = std::lower_bound(f.times.begin(), f.times.end(), std::min(td_last,tc_last)) - f.times.begin();
+  if (insert_last) {
+   if (f.times.size()==0) f.n0 = (tc_last < td_last);
+   else if (wraps) f.n0 = !f.n0;
+   f.times.insert(std::upper_bound(f.times.begin(), f.times.end(), td_last), td_last);
+   f.times.insert(std::upper_bound(f.times.begin(), f.times.end(), tc_last), tc_last);
+  }
+  else {
+   if (wraps) f.n0 = !f.n0;
+   f.times.erase(std::lower_bound(f.times.begin(), f.times.end(), td_last));
+   f.times.erase(std::lower_bound(f.times.begin(), f.times.end(), tc_last));
+  }
+  f.update_prefix(wraps ? 0 : i0); // if n0 has changed, all the lengths have
+  if (becomes_empty) {
+   L[a] = 0;
+   for (int b=0; b<N; ++b) O[a][b] = O[b][a] = 0;
+  }
+  else {
+   L[a] += dL;
+   for (int b=0; b<N; ++b) if (dO[b]!=0) { O[a][b] += dO[b]; O[b][a] = O[a][b];}
+  }
+  base = base_new; std::swap(E,E_new); std::swap(lin,lin_new);
+  log_weight = log_weight_new;
+ }
+
+ /// Number of operators of flavour a
+ int n_operators(int a) const { return flavours[a].times.size();}
+
+ /// Removes all the segments
+ void clear() {
+  for (int a=0; a<N; ++a) { flavours[a] = flavour(); L[a] = 0; std::fill(O[a].begin(), O[a].end(), 0);}
+  log_weight = compute_log_weight(L,O,-1,-1, base, E, lin);
+ }
+
+ private: 
+
+ // the operators of one flavour
+ struct flavour { 
+  std::vector<double> times, P; // sorted times, P[i] = occupied length in [0,times[i][
+  bool n0;                      // occupation at tau=0
+  flavour() : n0(false) {}
+
+  bool empty() const { return times.size()==0;}
+  // number of operators at time < t
+  int n_before (double t) const { return std::lower_bound(times.begin(), times.end(), t) - times.begin(); }
+  // occupation just after t (t is not an operator time)
+  bool occupation(double t) const { return n0 != (n_before(t)%2==1); }
+  // occupied length in [0,t[
+  double F(double t) const { 
+   const int i = n_before(t);
+   if (i==0) return (n0 ? t : 0);
+   return P[i-1] + ( (n0 != (i%2==1)) ? t - times[i-1] : 0);
+  }
+  // recomputes P[i] for i >= i0
+  void update_prefix(int i0) {
+   P.resize(times.size());
+   bool n = (n0 != (i0%2==1)); double l= (i0>0 ? P[i0-1] : 0), t= (i0>0 ? times[i0-1] : 0);
+   for (unsigned int i=i0; i<times.size(); ++i) { if (n) l+= times[i] - t; P[i] = l; t = times[i]; n = !n;}
+  }
+ };
+
+ // oriented interval ]t1,t2[ with cyclicity
+ double overlap (flavour const & f, double t1, double t2) const { 
+  return (t1<t2 ? f.F(t2) - f.F(t1) : f.F(Beta) - f.F(t1) + f.F(t2));
+ }
+ int count (flavour const & f, double t1, double t2) const { 
+  // the extremities are excluded : they are operators of another flavour or the operators removed
+  const int n1 = std::upper_bound(f.times.begin(), f.times.end(), t1) - f.times.begin(); 
+  const int n2 = f.n_before(t2);
+  return (t1<t2 ? n2 - n1 : int(f.times.size()) - n1 + n2);
+ }
+
+ double try_change (int a, double tau_cdag, double tau_c, bool insert) { 
+  a_last = a; td_last = tau_cdag; tc_last = tau_c; insert_last = insert;
+  flavour const & f (flavours[a]);
+
+  // the interval ]t1,t2[ on which the occupation of a is flipped : the one without other operators of a
+  // occ is its occupation before the move
+  double t1 = tau_cdag, t2 = tau_c; bool occ = !insert;
+  if (!f.empty() && (count(f,t1,t2) != 0)) { std::swap(t1,t2); occ = !occ;}
+  wraps = (t1 > t2);
+  const double l = (t1<t2 ? t2 - t1 : Beta - t1 + t2);
+  becomes_empty = (!insert) && (f.times.size()==2);
+  const bool was_empty = f.empty();
+
+  // sign
+  int s = sigma[a];
+  for (int b=0; b<N; ++b) { 
+   if ((b==a) || flavours[b].empty()) continue;
+   if (S[a][b] && (flavours[b].occupation(t1) != flavours[b].occupation(t2))) s = -s;
+   if (S[b][a] && (count(flavours[b],t1,t2)%2==1)) s = -s;
+  }
+
+  // change of the length of a and of its overlaps (O_ab = 0 as soon as a or b is empty)
+  const double sgn = (occ ? -1 : 1);
+  dL = (becomes_empty ? -L[a] : sgn*l);
+  for (int b=0; b<N; ++b)
+   dO[b] = (becomes_empty ? -O[a][b] : ( ((b==a) || flavours[b].empty()) ? 0 : sgn * overlap(flavours[b],t1,t2)));
+
+  if (was_empty || becomes_empty) {
+   // the set of the empty flavours changes : the weight is recomputed (rare : a has at most 2 operators)
+   std::vector<double> L_new(L); std::vector<std::vector<double> > O_new(O);
+   L_new[a] += dL;
+   for (int b=0; b<N; ++b) { O_new[a][b] += dO[b]; O_new[b][a] = O_new[a][b];}
+   log_weight_new = compute_log_weight(L_new, O_new, (was_empty ? a : -1), (becomes_empty ? a : -1), base_new, E_new, lin_new);
+  }
+  else {
+   // E is unchanged, only the energies of the full empty lines depend on l_a
+   base_new = base + eps[a]*dL;
+   for (int b=0; b<N; ++b) base_new += U[a][b]*dO[b];
+   E_new = E; lin_new = lin;
+   for (unsigned int e=0; e<E.size(); ++e) lin_new[e] += U[E[e]][a]*dL;
+   log_weight_new = log_sum_empty(E_new, lin_new) - base_new;
+  }
+  return s * std::exp(log_weight_new - log_weight);
+ }
+
+ /*
+   log of sum_{n_e} exp(- sum eps_a l_a - sum_{a<b} U_ab O_ab) = log_sum_empty(E_,lin_) - base_, with
+     - base_ = sum_{a not empty} eps_a l_a + sum_{a<b} U_ab O_ab
+     - E_ : the empty flavours, lin_[e] = eps_e Beta + sum_{b not empty} U_eb l_b, the energy of a full line e.
+   The flavour added is considered as non empty, the flavour removed as empty.
+ */
+ double compute_log_weight (std::vector<double> const & L_, std::vector<std::vector<double> > const & O_, int added, int removed,
+   double & base_, std::vector<int> & E_, std::vector<double> & lin_) const {
+  E_.clear(); lin_.clear();
+  base_ =0;
+  for (int a=0; a<N; ++a) {
+   const bool is_empty = (a==removed) || ( flavours[a].empty() && (a!=added));
+   if (is_empty) { E_.push_back(a); continue;}
+   base_ += eps[a]*L_[a];
+   for (int b=0; b<a; ++b) base_ += U[a][b]*O_[a][b];
+  }
+  for (unsigned int e=0; e<E_.size(); ++e) {
+   double x = eps[E_[e]]*Beta;
+   for (int b=0; b<N; ++b) {
+    if (std::find(E_.begin(),E_.end(),b)!=E_.end()) continue;
+    x += U[E_[e]][b]*L_[b];
+   }
+   lin_.push_back(x);
+  }
+  return log_sum_empty(E_,lin_) - base_;
+ }
+
+ // log of the sum over the occupations n_e of the empty flavours of exp(- sum_e n_e lin_[e] - sum_{e<e'} U_ee' n_e n_e' Beta)
+ double log_sum_empty (std::vector<int> const & E_, std::vector<double> const & lin_) const {
+  if (E_.size()==0) return 0;
+  const unsigned int n_states = 1u<<E_.size();
+  std::vector<double> x(n_states,0);
+  for (unsigned int n=0; n<n_states; ++n)
+   for (unsigned int e=0; e<E_.size(); ++e) {
+    if (!(n & (1u<<e))) continue;
+    x[n] += lin_[e];
+    for (unsigned int e2=0; e2<e; ++e2) if (n & (1u<<e2)) x[n] += U[E_[e]][E_[e2]]*Beta;
+   }
+  const double xmin = *std::min_element(x.begin(),x.end());
+  double r=0;
+  for (unsigned int n=0; n<n_states; ++n) r += std::exp(-(x[n]-xmin));
+  return std::log(r) - xmin;
+ }
+
+ const double Beta;
+ const int N;
+ const std::vector<double> eps;
+ const std::vector<std::vector<double> > U;
+ const std::vector<int> sigma;
+ const std::vector<std::vector<bool> > S;
+ std::vector<flavour> flavours;
+ std::vector<double> L;
+ std::vector<std::vector<double> > O;
+ std::vector<double> dO;                      // change of O[a_last][b] in the last try
+ std::vector<int> E, E_new;                   // the empty flavours
+ std::vector<double> lin, lin_new;            // cf compute_log_weight
+ double base, base_new, log_weight, log_weight_new, dL;
+ int a_last; double td_last, tc_last; bool insert_last, wraps, becomes_empty;
+};
+
+#endif
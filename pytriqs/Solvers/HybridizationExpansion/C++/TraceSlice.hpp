@@ -41,14 +41,14 @@ class TraceSlice {
   vector<const Hloc::Bloc *> BlocsOut;
   vector<double> Exp_H_tau_acc;
   bool is_nul_;
-  std::vector< std::vector < const Hloc::Operator * > >  & NonVanishingOpsOnBlock;
+  const std::vector< std::vector < const Hloc::Operator * > >  & NonVanishingOpsOnBlock;
   std::set<const Hloc::Operator *> _nonVanishingOperators;
 public:
   // Constructor
   TraceSlice(const Hloc & H_,                       // Hloc
 	     Hloc::DiagonalOperator & mydiagop_,    // common workspace, located in the TraceSlice_Stack
 	     int mysize,                            // total size of the workspace
-	     std::vector< std::vector < const Hloc::Operator * > >  & NonVanishingOpsOnBlock_,// ref : in traceStack
+	     const std::vector< std::vector < const Hloc::Operator * > >  & NonVanishingOpsOnBlock_,// ref : in traceStack
 	     bool setAsBoundary = false);
   
   /// Copy Constructor (not expected to be called - no implementation}
@@ -123,7 +123,8 @@ public:
     if (S1->H.MaxDimBlock ==1) 
       return Slice_D_Slice_internal(S1,NULL,S2,Exp_H_tau_acc_bis);
     
-    Hloc::DiagonalOperator & mydiagop (const_cast<TraceSlice *>(S1)->mydiagop);
+    // the workspace of S2 : in the const queries of DynamicTrace, S2 is a scratch slice with its own workspace
+    Hloc::DiagonalOperator & mydiagop (S2->mydiagop);
     // Computes U(t1,t2) into mydiagop
     for (Hloc::BlocIterator B = S1->H.BlocBegin(); !B.atEnd(); ++B) {
 	mydiagop[B][0]=1;
@@ -152,7 +153,7 @@ private:
 template<typename VALTYPE>
 TraceSlice<VALTYPE>::TraceSlice(const Hloc & H_, Hloc::DiagonalOperator & mydiagop_,
 				int mysize,
-				std::vector< std::vector < const Hloc::Operator * > >  & NonVanishingOpsOnBlock_,// ref : in traceStack
+				const std::vector< std::vector < const Hloc::Operator * > >  & NonVanishingOpsOnBlock_,// ref : in traceStack
 				bool setAsBoundary): 
   H(H_), mydiagop(mydiagop_), memChunk(mysize), 
   BlocsOut(H.NBlocks,(Hloc::Bloc*)NULL),
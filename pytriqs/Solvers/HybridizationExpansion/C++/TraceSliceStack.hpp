@@ -72,6 +72,11 @@ public:
     }
   }
   
+  /// A new TraceSlice which is not managed by the stack, with the workspace w instead of the common one
+  inline TRACE_SLICE_TYPE * new_slice(Hloc::DiagonalOperator & w) const { 
+    return new TRACE_SLICE_TYPE(H,w,slice_size,NonVanishingOpsOnBlock);
+  }
+
   /// Push a pointer to TraceSlice in the stack
   inline void push(TRACE_SLICE_TYPE * p) { 
     if (p!=NULL) { content.push(p);}
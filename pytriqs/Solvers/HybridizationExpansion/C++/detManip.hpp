@@ -51,6 +51,9 @@
 
      types : 
       - DELTATYPE : The matrix is Minv_ij = Delta(tau_i,tauprime_j)
+        It must also provide the batched evaluations of a row and a column : 
+          fill_row(tau, const TAUTYPE_PTR * taup, n, VALTYPE * res, stride) : res[i*stride] = Delta(tau, taup[i]) 
+          fill_col(const TAUTYPE_PTR * tau, n, taup, VALTYPE * res, stride) : res[i*stride] = Delta(tau[i], taup) 
       - VALTYPE : COMPLEX or double
       - TAUTYPE : must have a default constructor, operator =
 
@@ -185,6 +188,17 @@ public:
   */
   void recomputeFrom(std::vector<TAUTYPE_PTR> Tau, std::vector<TAUTYPE_PTR> Taup);
 
+  /**
+     Replaces the TAUTYPE_PTR of the rows and the columns, given in the order of the
+     Cdagger_iterator and of the C_iterator, without recomputing the matrix.
+     The new Tau, Taup must give the same matrix (e.g. same times and same Delta) : 
+     this is used when the operators are only relabeled, cf Global_Move.
+  */
+  void relabel(std::vector<TAUTYPE_PTR> const & Tau, std::vector<TAUTYPE_PTR> const & Taup) { 
+    assert ((int(Tau.size()) == N) && (int(Taup.size()) == N));
+    for (int i=1; i<=N; ++i) { tau[row_num(i)] = Tau[i-1]; tauprime[col_num(i)] = Taup[i-1];}
+  }
+
   /**
      Put to size 0
   */
@@ -501,9 +515,7 @@ void detManip<DELTATYPE,VALTYPE,TAUTYPE_PTR>::recomputeFrom(std::vector<TAUTYPE_
    if  (N>Nmax) resize(2*N); // put some margin..
   
    for (int i=1; i<=N; ++i) { tau[i] = Tau[i-1];tauprime[i] = Taup[i-1];}
-   for (int i=1; i<=N; ++i) 
-     for (int j=1; j<=N; ++j)
-       _Minv(i,j) =delta(tau[i],tauprime[j]);
+   for (int j=1; j<=N; ++j) delta.fill_col(&tau[1], N, tauprime[j], MinvptrC(j), 1);
    _M = _Minv;
    //    cout<<"Minv  "<<_Minv(Range(1,N),Range(1,N))<<" "<<N<<"  "<<Nmax<<endl;
    if (N==0) 
@@ -550,15 +562,10 @@ VALTYPE detManip<DELTATYPE,VALTYPE,TAUTYPE_PTR>::try_insert(int i0, int j0, TAUT
     // no effect since N will not be changed : Minv(i,j) for i,j>N 
     // has no meaning.
     
-    VALTYPE * restrict C = MinvptrC(N+1), * restrict L = MinvptrL(N+1);
-    
-    for (int i= 1; i<=N;i++, C++, L+=Nmax)
-      {
-	//_Minv(i,N+1) = delta(tau[i] , Taup);
-	//_Minv(N+1,i) = delta(Tau , tauprime[i]);
-        *C  = delta(tau[i] , tmp_taup);
-	*L  = delta(tmp_tau , tauprime[i]);
-      }
+    //_Minv(i,N+1) = delta(tau[i] , Taup);
+    //_Minv(N+1,i) = delta(Tau , tauprime[i]);
+    delta.fill_col(&tau[1], N, tmp_taup, MinvptrC(N+1), 1);
+    delta.fill_row(tmp_tau, &tauprime[1], N, MinvptrL(N+1), Nmax);
 
     // MB(i) = sum_j M(i,j) Minv(j,N+1) using BLAS
     const char CN = 'N';
@@ -619,8 +626,9 @@ VALTYPE detManip<DELTATYPE,VALTYPE,TAUTYPE_PTR>::try_change_col(int j0, TAUTYPE_
   tmp_taup = Taup;
 
   // Compute the col B.
+  delta.fill_col(&tau[1], N, tmp_taup, MCfirst, 1);
   for (int i= 1; i<=N;i++)
-    MC(i) = delta(tau[i] , tmp_taup) - _Minv(i,jreal);
+    MC(i) -= _Minv(i,jreal);
 
   // MB(i) = sum_j M(i,j) *MC(j) using BLAS 
   const char CN = 'N';
@@ -650,8 +658,9 @@ VALTYPE detManip<DELTATYPE,VALTYPE,TAUTYPE_PTR>::try_change_row(int i0, TAUTYPE_
   tmp_tau = Tau;
 
   // Compute the col B.
+  delta.fill_row(tmp_tau, &tauprime[1], N, MBfirst, 1);
   for (int i= 1; i<=N;i++)
-    MB(i) = delta(tmp_tau, tauprime[i] ) - _Minv(ireal,i);
+    MB(i) -= _Minv(ireal,i);
 
   // MC(i) = sum_j M(j,i) *MB(j) using BLAS !! transposed !
   const char CT = 'T';
@@ -23,6 +23,12 @@
 #ifndef TRIQS_CTHYB1_BINNER_H
 #define TRIQS_CTHYB1_BINNER_H
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <triqs/utility/compiler_details.hpp>
+#include <triqs/utility/exceptions.hpp>
+
 template< class GFType>
 class gf_binner {
  GFType & G;
@@ -60,5 +66,75 @@ class gf_grid_evaluator {
 
 }; 
 
+/**
+   Evaluates G(tau1 - tau2) (antiperiodic) with a piecewise cubic interpolation of G on its mesh (n+0.5)*Beta/L.
+
+   The coefficients of the cubic on each bin are precomputed, and stored contiguously 
+   for each (alpha1,alpha2), i.e. 4 numbers per bin. The same accuracy as the grid evaluator
+   is reached with a much coarser mesh, hence a much smaller table.
+   alpha starts at ZERO.
+*/
+template< class GFType>
+class gf_cubic_evaluator {
+ typedef typename GFType::element_value_type value_type;
+ const int L, N2;
+ const double Beta, L_over_Beta;
+ std::vector<value_type> coef;
+ public : 
+
+ gf_cubic_evaluator ( GFType const  & G): 
+  L(G.mesh.len()), N2(G.N2), Beta(G.Beta), L_over_Beta(G.mesh.len()/G.Beta), coef(4*G.N1*G.N2*G.mesh.len(),0) {
+  if (L<4) TRIQS_RUNTIME_ERROR<<"gf_cubic_evaluator : the mesh must have at least 4 points";
+  for (int n1=0; n1<G.N1; ++n1)
+   for (int n2=0; n2<G.N2; ++n2) 
+    for (int k=0; k<L; ++k) { 
+     // Lagrange polynomial on the 4 points m..m+3 around bin k, in the variable s = u - k 
+     const int m = std::min(std::max(k-1,0),L-4);
+     value_type * c = &coef[4*((n1*N2+n2)*L + k)];
+     for (int j=0; j<4; ++j) { 
+      double p[4] = {1,0,0,0}; double den=1; int deg=0;
+      for (int i=0; i<4; ++i) { 
+       if (i==j) continue;
+       const double x = m + i - k;
+       // p *= (s - x)
+       ++deg; for (int d=deg; d>0; --d) p[d] = p[d-1] - x*p[d]; p[0] *= -x;
+       den *= (j-i);
+      }
+      const value_type y = G.data_const(n1+1,n2+1,G.mesh.index_min + m + j)/den;
+      for (int d=0; d<4; ++d) c[d] += y*p[d];
+     }
+    }
+ }
+
+ value_type operator() (int alpha1, double tau1, int alpha2, double tau2 ) const { 
+  double x = tau1 - tau2;
+  const bool neg = (x<0);
+  if (neg) x += Beta;
+  const double u = x*L_over_Beta - 0.5;
+  const int k = std::min(std::max(int(floor(u)),0),L-1);
+  const double s = u - k;
+  const value_type * c = &coef[4*((alpha1*N2+alpha2)*L + k)];
+  const value_type r = c[0] + s*(c[1] + s*(c[2] + s*c[3]));
+  return (neg ? -r : r);
+ }
+
+ /// Batched version : res[i*stride] = G(alpha1[i],tau1[i],alpha2[i],tau2[i]) for 0<= i < n
+ void operator() (int n, const int * restrict alpha1, const double * restrict tau1, 
+   const int * restrict alpha2, const double * restrict tau2, value_type * restrict res, int stride) const { 
+  const value_type * restrict c0 = &coef[0];
+  for (int i=0; i<n; ++i) { 
+   double x = tau1[i] - tau2[i];
+   const double sgn = (x<0 ? -1 : 1);
+   if (x<0) x += Beta;
+   const double u = x*L_over_Beta - 0.5;
+   const int k = std::min(std::max(int(floor(u)),0),L-1);
+   const double s = u - k;
+   const value_type * c = c0 + 4*((alpha1[i]*N2+alpha2[i])*L + k);
+   res[i*stride] = sgn*(c[0] + s*(c[1] + s*(c[2] + s*c[3])));
+  }
+ }
+
+}; 
+
 #endif
 
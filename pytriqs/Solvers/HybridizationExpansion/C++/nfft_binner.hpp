@@ -0,0 +1,235 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIQS_CTHYB1_NFFT_BINNER_H
+#define TRIQS_CTHYB1_NFFT_BINNER_H
+
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <cassert>
+#include <fftw3.h>
+#include <boost/noncopyable.hpp>
+#include <triqs/utility/compiler_details.hpp>
+
+namespace nfft_details { 
+
+ /**
+   The gaussian gridding along one time axis, for the fermionic frequencies 
+   omega_n = (2n+1) Pi/Beta,  n_min <= n < n_min + n_freq.
+
+   The frequency omega_c of the center of the window is put in the weight : the remaining
+   frequencies omega_n - omega_c = 2 Pi k/Beta are periodic in delta_tau, with -M/2 <= k < M/2.
+   Hence delta_tau can be anywhere in ]-Beta,Beta[.
+ */
+ struct gaussian_axis { 
+  typedef std::complex<double> COMPLEX;
+  const int n_spread, M, Mr;
+  const double h, tau, omega_c;
+  std::vector<double> E3;
+
+  gaussian_axis(double Beta, int n_min, int n_freq, int n_spread_) : 
+   n_spread(n_spread_), M(n_freq + n_freq%2), Mr(2*M), h(2*pi()/Mr), 
+   tau(pi()*n_spread_/(double(M)*M*2*(2-0.5))), 
+   omega_c ( (2*(n_min + M/2)+1)*pi()/Beta), 
+   E3(2*n_spread_), Beta_(Beta) {
+    for (int l=-n_spread+1; l<=n_spread; ++l) E3[l+n_spread-1] = exp(-(l*h)*(l*h)/(4*tau));
+   }
+
+  /** 
+    For a point delta_tau, returns the phase exp(i omega_c delta_tau) and computes 
+    the 2*n_spread weights w of the grid points m0 -n_spread +1, ..., m0 + n_spread (modulo Mr).
+  */ 
+  COMPLEX weights (double delta_tau, int & m0, double * restrict w) const { 
+   const double om_dt = omega_c*delta_tau;
+   double x = 2*pi()*delta_tau/Beta_; 
+   if (x<0) x+= 2*pi();
+   m0 = int(floor(x/h));
+   const double delta = x - m0*h;
+   // exp( -(l h - delta)^2/(4 tau) ) = E1 * E2^l * E3[l]
+   const double E1 = exp(-delta*delta/(4*tau)), E2 = exp(h*delta/(2*tau));
+   double E2l = E1 * exp( (-n_spread+1)*h*delta/(2*tau)); 
+   for (int u=0; u<2*n_spread; ++u) { w[u] = E2l * E3[u]; E2l *= E2; }
+   return COMPLEX(cos(om_dt),sin(om_dt));
+  }
+
+  /** 
+    Position of the grid point m0 + l, l = u - n_spread +1. 
+    For a small window (Mr < 2 n_spread), the gaussian goes around the grid several times : 
+    a true modulo is needed, not a single fold.
+  */
+  int wrap(int m) const { return ((m>=0) && (m<Mr) ? m : ((m % Mr) + Mr) % Mr); }
+
+  /// For the n-th frequency of the window, the index j in the FFT and the deconvolution factor
+  double deconvolution (int n, int & j) const { 
+   const int k = n - M/2; // k is the frequency on the grid, the deconvolution is exp(k^2 tau)  
+   j = (k>=0 ? k : k + Mr);
+   return sqrt(pi()/tau) * exp(k*k*tau) / Mr;
+  }
+
+  static double pi() { return acos(-1.0);}
+  private: 
+  const double Beta_;
+ };
+}
+
+/**
+   Accumulates sums of the form 
+
+     S_ab(n) = sum_p  val_p exp(i omega_n delta_tau_p),    omega_n = (2n+1) Pi/Beta,  0 <= n < n_freq
+
+   for delta_tau_p in ]-Beta,Beta[, without computing the exponentials for each frequency.
+   It is a non-equispaced FFT : each point is spread on an oversampled regular grid with a gaussian 
+   (cf Greengard and Lee, SIAM Review 46, 443 (2004)), the FFT and the deconvolution are done only
+   in transform(). The cost of accumulating one point is O(n_spread), independently of n_freq.
+
+   Since everything is linear, the grid can be accumulated over many Monte Carlo samples (and summed over 
+   the nodes) and transformed only once at the end.
+*/
+class nfft_binner { 
+ public:
+ typedef std::complex<double> COMPLEX;
+
+ /** 
+   - n_ab : number of independent sums (e.g. the number of (alpha1,alpha2) couples)
+   - n_spread : half-width of the gaussian in grid points. 12 gives a relative precision around 1e-12.
+ */
+ nfft_binner (double Beta, int n_freq_, int n_ab_, int n_spread = 12) :
+  n_freq(n_freq_), n_ab(n_ab_), ax(Beta, 0, n_freq_, n_spread), 
+  grid(n_ab_*ax.Mr,0), w(2*n_spread) {}
+
+ /// Adds val * exp(i omega_n delta_tau) to S_ab(n), for all n. delta_tau in ]-Beta,Beta[.
+ void operator() (int ab, double delta_tau, COMPLEX val) { 
+  assert ( (ab>=0) && (ab<n_ab));
+  int m0;
+  val *= ax.weights(delta_tau, m0, &w[0]);
+  COMPLEX * restrict g = &grid[ab*ax.Mr];
+  for (int u=0; u<2*ax.n_spread; ++u) g[ax.wrap(m0 + u - ax.n_spread + 1)] += val * w[u];
+ }
+
+ /// Resets all the sums to 0
+ void clear() { for (unsigned int i=0; i<grid.size(); ++i) grid[i] =0; }
+
+ /** 
+   Computes res[n] = S_ab(n) for 0<= n < n_freq. 
+   One FFT of size 2*n_freq is done at each call.
+ */
+ void transform(int ab, COMPLEX * res) const { transform(ab,res,grid);}
+
+ /// Same as transform(ab,res), but from a grid g laid out as grid_data() (e.g. the grid summed over the nodes)
+ void transform(int ab, COMPLEX * res, std::vector<COMPLEX> const & g) const { 
+  const int Mr = ax.Mr;
+  assert (g.size()==grid.size());
+  fftw_complex * data = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * Mr);
+  for (int m=0; m<Mr; ++m) { data[m][0] = real(g[ab*Mr+m]); data[m][1] = imag(g[ab*Mr+m]);}
+  fftw_plan p = fftw_plan_dft_1d(Mr, data, data, FFTW_BACKWARD, FFTW_ESTIMATE); // sum_m exp(+2 i Pi m j/Mr)
+  fftw_execute(p); 
+  for (int n=0; n<n_freq; ++n) { 
+   int j; const double f = ax.deconvolution(n,j);
+   res[n] = f * COMPLEX(data[j][0],data[j][1]); 
+  }
+  fftw_destroy_plan(p); 
+  fftw_free(data);
+ }
+
+ /// The underlying grid (e.g. to sum it over the nodes)
+ std::vector<COMPLEX> & grid_data() { return grid;}
+ std::vector<COMPLEX> const & grid_data() const { return grid;}
+
+ /// Number of frequencies computed by transform
+ int n_frequencies() const { return n_freq;}
+
+ private:
+ const int n_freq, n_ab;
+ const nfft_details::gaussian_axis ax;
+ std::vector<COMPLEX> grid;
+ std::vector<double> w;
+};
+
+/**
+   Two dimensional version of nfft_binner : computes 
+
+     S_ab(n1,n2) = sum_p  val_p exp(i omega_n1 tau1_p + i omega_n2 tau2_p),   n_min <= n1,n2 < n_min + n_freq
+
+   for tau1_p, tau2_p in ]-Beta,Beta[. 
+   The gaussian is separable, so spreading one point costs (2 n_spread)^2 operations. 
+   It is meant to be cleared and transformed at each measure (e.g. M(i nu, i nu') for each configuration) : 
+   the FFTW plan is hence prepared once for all in the constructor.
+*/
+class nfft_binner_2d : boost::noncopyable { 
+ public:
+ typedef std::complex<double> COMPLEX;
+
+ nfft_binner_2d (double Beta, int n_min, int n_freq_, int n_ab_, int n_spread = 12) :
+  n_freq(n_freq_), n_ab(n_ab_), ax(Beta, n_min, n_freq_, n_spread), Mr2(ax.Mr*ax.Mr),
+  grid(n_ab_*Mr2,0), w1(2*n_spread), w2(2*n_spread), m2(2*n_spread) { 
+   data = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * Mr2);
+   plan = fftw_plan_dft_2d(ax.Mr, ax.Mr, data, data, FFTW_BACKWARD, FFTW_ESTIMATE); 
+  }
+
+ ~nfft_binner_2d() { fftw_destroy_plan(plan); fftw_free(data);}
+
+ /// Adds val * exp(i omega_n1 tau1 + i omega_n2 tau2) to S_ab(n1,n2), for all n1,n2
+ void operator() (int ab, double tau1, double tau2, COMPLEX val) { 
+  assert ( (ab>=0) && (ab<n_ab));
+  const int ns = 2*ax.n_spread;
+  int m01, m02;
+  val *= ax.weights(tau1, m01, &w1[0]) * ax.weights(tau2, m02, &w2[0]);
+  for (int u=0; u<ns; ++u) m2[u] = ax.wrap(m02 + u - ax.n_spread + 1);
+  COMPLEX * restrict g = &grid[ab*Mr2];
+  for (int u1=0; u1<ns; ++u1) { 
+   COMPLEX * restrict row = g + ax.wrap(m01 + u1 - ax.n_spread + 1) * ax.Mr;
+   const COMPLEX v = val * w1[u1];
+   for (int u2=0; u2<ns; ++u2) row[m2[u2]] += v * w2[u2];
+  }
+ }
+
+ /// Resets all the sums to 0
+ void clear() { for (unsigned int i=0; i<grid.size(); ++i) grid[i] =0; }
+
+ /// Computes res[ (n1 -n_min) * n_freq + (n2 - n_min)] = S_ab(n1,n2)
+ void transform(int ab, COMPLEX * res) { 
+  const COMPLEX * g = &grid[ab*Mr2];
+  for (int m=0; m<Mr2; ++m) { data[m][0] = real(g[m]); data[m][1] = imag(g[m]);}
+  fftw_execute(plan); 
+  for (int n1=0; n1<n_freq; ++n1) { 
+   int j1; const double f1 = ax.deconvolution(n1,j1);
+   for (int n2=0; n2<n_freq; ++n2) { 
+    int j2; const double f = f1 * ax.deconvolution(n2,j2);
+    const int j = j1 * ax.Mr + j2;
+    res[n1*n_freq + n2] = f * COMPLEX(data[j][0],data[j][1]); 
+   }
+  }
+ }
+
+ private:
+ const int n_freq, n_ab;
+ const nfft_details::gaussian_axis ax;
+ const int Mr2;
+ std::vector<COMPLEX> grid;
+ std::vector<double> w1, w2;
+ std::vector<int> m2;
+ fftw_complex * data;
+ fftw_plan plan;
+};
+
+#endif
@@ -53,8 +53,9 @@ class Solver(Solver_Base):
                 "Legendre_Accumulation" : ("Do we accumulate in legendre?", True, BooleanType),
                 "N_Legendre_Coeffs" : ("Number of Legendre coefficients that are used in practice", 50, IntType),
                 "Time_Accumulation" : ("Do we accumulate in imaginary-time?", False, BooleanType),
+                "Frequency_Accumulation" : ("Do we accumulate directly in Matsubara frequencies? (takes precedence over the other modes)", False, BooleanType),
                 "N_Warmup_Cycles" : ("Number of warming iterations (cycles)", 1000, IntType),
-                "N_Frequencies_Accumulated" : ("Number of frequencies to accumulate", 100, IntType),
+                "N_Frequencies_Accumulated" : ("Number of frequencies to accumulate (with Frequency_Accumulation)", 100, IntType),
                 "Fitting_Frequency_Start" : ("Frequency at which the fit starts", 50, IntType),
                 "N_Time_Slices_Delta" : ("Number of times slices in Delta", 10000, IntType),
                 "N_Time_Slices_Gtau" : ("Number of times slices in G_tau", 10000, IntType),
@@ -64,9 +65,17 @@ class Solver(Solver_Base):
                 "Proba_Insert_Remove" : ("Probability to insert/remove operators", 1.0, FloatType),
                 "Proba_Move" : ("Probability to move operators", 1.0, FloatType),
                 "Measured_Operators" : ("A dict of operators that will be averaged", {}, DictType),
+                "N_Tau_Operators_Average" : ("Number of times at which the measured operators are evaluated", 1, IntType),
                 "Measured_Time_Correlators" : ("A dict of operators, whose time correlations are to be measured", {}, DictType),
+                "Measure_G2" : ("Do we measure the two-particle Green function?", False, BooleanType),
+                "N_Fermionic_Frequencies_G2" : ("Number of positive fermionic frequencies of G2 (nu, nu' in [-N,N[)", 10, IntType),
+                "N_Bosonic_Frequencies_G2" : ("Number of bosonic frequencies of G2 (omega in [0,N[)", 1, IntType),
+                "G2_File" : ("Name of the hdf5 file in which G2 is written", "G2.h5", StringType),
                 "Record_Statistics_Configurations" : ("(Expert only) Get the kink length statistics", False, BooleanType),
                 "Keep_Full_MC_Series" : ("(Expert only) Store the Green's function for later analysis", False, BooleanType),
+                "Record_Configurations_File" : ("(Expert only) If set, the sampled configurations are written in <name>_<rank>.h5", "", StringType),
+                "Replay_Configurations_Files" : ("(Expert only) Files of recorded configurations : the measures are done on them, without MC moves", [], ListType),
+                "Warm_Start" : ("Start the Markov chain from the last configuration of the previous Solve, with an adaptive warm-up", False, BooleanType),
                 "Use_F" : ("(Expert only) Compute F", False, BooleanType),
                 "Eta": ("(Expert only) Value of eta, the minimum value of the det", 0.0, FloatType),
                 "Quantum_Numbers_Selection" : ("(Prototype) A function to select quantum numbers", lambda qn: True, FunctionType),
@@ -144,6 +153,10 @@ class Solver(Solver_Base):
         # Test all a parameters before solutions
         MPI.report(Parameters.check(self.__dict__,self.Required,self.Optional))
 
+        # Frequency_Accumulation takes precedence over the other modes (Legendre_Accumulation is True by default)
+        if self.Frequency_Accumulation:
+            self.Legendre_Accumulation, self.Time_Accumulation = False, False
+
         # We have to add the Hamiltonian the epsilon part of G0
         if type(self.H_Local) != type(Operator()) : raise "H_Local is not an operator"
         H = self.H_Local
@@ -314,6 +327,7 @@ class Solver(Solver_Base):
               g._tail.zero()
               g._tail[1] = identity
               self.G[name].setFromFourierOf(g)
+          # with Frequency_Accumulation, G has been measured directly on the first N_Frequencies_Accumulated frequencies
 
           # This is very sick... but what can we do???
           self.Sigma <<= self.G0_inv - inverse(self.G)
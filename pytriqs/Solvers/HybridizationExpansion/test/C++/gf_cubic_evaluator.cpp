@@ -0,0 +1,95 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "gf_binner_and_eval.hpp"
+#include <triqs/mc_tools/random_generator.hpp>
+#include <cmath>
+#include <iostream>
+
+/*
+  A free fermion G_{ab}(tau) = - exp(-eps_ab tau) / (1 + exp(-Beta eps_ab)) on the mesh (n+0.5)*Beta/L of GF_Bloc_ImTime.
+  Only the part of the interface of GF_Bloc_ImTime used by the evaluators is provided.
+*/
+struct free_fermion_gf { 
+ typedef double element_value_type;
+ struct mesh_type { int L, index_min; int len() const { return L;} };
+ const int N1, N2; const double Beta; const mesh_type mesh;
+ free_fermion_gf(int N, double Beta_, int L) : N1(N), N2(N), Beta(Beta_) , mesh(mesh_type{L,0}) {}
+
+ double eps(int a, int b) const { return 1.3 - a + 0.4*b;} // a, b start at 0 
+ double operator()(int a, int b, double tau) const { return - std::exp(-eps(a,b)*tau)/(1 + std::exp(-Beta*eps(a,b)));}
+ // max of |d^4 G/ dtau^4| on [0,Beta]
+ double max_d4(int a, int b) const { return std::pow(eps(a,b),4) * std::max(std::abs((*this)(a,b,0)), std::abs((*this)(a,b,Beta)));}
+ // as G.data_const, indices of the matrix start at 1
+ double data_const(int a, int b, int n) const { return (*this)(a-1,b-1,(n+0.5)*Beta/mesh.L);}
+};
+
+/*
+  Lagrange interpolation on 4 points : the error is |G''''| h^4 /4! |prod_i (s-x_i)|, 
+  with max |prod_i (s-x_i)| = 9/16 for the centered stencils, and 105/16 for the one sided stencils of the first and 
+  last bins, which extrapolate within h/2 of tau=0 and tau=Beta
+*/
+int main(int argc, char **argv) {
+
+ const double Beta = 10;
+ const int N = 2, n_points = 2000;
+ triqs::mc_tools::random_generator RNG("mt19937", 23432);
+
+ double err_prev = 0;
+ for (int L = 50; L<= 400; L*=2) { 
+  free_fermion_gf G(N,Beta,L);
+  gf_cubic_evaluator<free_fermion_gf> eval(G);
+  const double h = Beta/L;
+  double max_err = 0;
+  std::vector<int> a1(n_points), a2(n_points); 
+  std::vector<double> t1(n_points), t2(n_points), res(2*n_points);
+
+  for (int p=0; p<n_points; ++p) { 
+   const int a = RNG(N), b = RNG(N);
+   // tau1 - tau2 anywhere in ]-Beta,Beta[, or within h/2 of 0 or +-Beta, i.e. outside the mesh points
+   double x;
+   switch (p%3) { 
+    case 0 : x = RNG(Beta); break;
+    case 1 : x = RNG(h/2); break;
+    case 2 : x = Beta - RNG(h/2); break;
+   }
+   const double tau2 = RNG(Beta), tau1 = (x + tau2 < Beta ? x + tau2 : x + tau2 - Beta);
+   const double exact = (tau1 >= tau2 ? G(a,b,tau1 - tau2) : - G(a,b,tau1 - tau2 + Beta));
+   const double r = eval(a,tau1,b,tau2);
+   const double bound = G.max_d4(a,b) * std::pow(h,4)/24 * ( (x > 1.5*h) && (x < Beta - 1.5*h) ? 9/16.0 : 105/16.0);
+   if (std::abs(r - exact) > bound) 
+    TRIQS_RUNTIME_ERROR << "L = "<< L <<" tau1 - tau2 = "<< tau1 - tau2 << " : error "<< std::abs(r-exact)<< " > O(h^4) bound "<< bound;
+   max_err = std::max(max_err, std::abs(r - exact));
+   a1[p] = a; a2[p] = b; t1[p] = tau1; t2[p] = tau2; res[2*p+1] = r;
+  }
+
+  // the batched evaluation gives the same numbers
+  eval(n_points, &a1[0], &t1[0], &a2[0], &t2[0], &res[0], 2);
+  for (int p=0; p<n_points; ++p) 
+   if (std::abs(res[2*p] - res[2*p+1]) > 1.e-14) TRIQS_RUNTIME_ERROR << "batched evaluation : "<< res[2*p] << " != "<< res[2*p+1];
+
+  // 4th order : the error is divided by 16 when h is halved (asymptotically)
+  std::cerr << "L = "<< L << " max error = "<< max_err << std::endl;
+  if ((err_prev > 0) && (err_prev/max_err < 10)) TRIQS_RUNTIME_ERROR << "the error decreases too slowly with h : "<< err_prev << " -> "<< max_err;
+  err_prev = max_err;
+ }
+}
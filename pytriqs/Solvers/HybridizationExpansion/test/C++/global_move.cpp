@@ -0,0 +1,219 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "Hloc.hpp"
+#include "DynamicTrace.hpp"
+#include <boost/mpi/communicator.hpp> // for detManip
+#include "detManip.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <triqs/utility/exceptions.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iostream>
+
+typedef DynamicTrace< TimeEvolutionSimpleExp <Hloc::REAL_OR_COMPLEX> > DT_type;
+typedef DT_type::OP_REF OP_REF;
+
+/*
+  Two orbitals with spin : C_k, k = 0,1 (spin up, block a=0), 2,3 (spin down, block a=1), alpha = k%2.
+  Monomials as in Transcribe_OpList_for_C : k+1 stands for C_k and -(k+1) for Cdagger_k, in the order they are applied.
+*/
+const int NF = 4;
+typedef std::vector<std::pair<double, std::vector<int> > > op_t;
+
+op_t mono(double c, int o1, int o2=0, int o3=0, int o4=0) {
+ const int o[4] = {o1,o2,o3,o4};
+ std::vector<int> m; for (int i=0; (i<4) && o[i]; ++i) m.push_back(o[i]);
+ return op_t(1, std::make_pair(c,m));
+}
+op_t & operator += (op_t & A, op_t const & B) { A.insert(A.end(), B.begin(), B.end()); return A;}
+
+python::list to_python(op_t const & O) {
+ python::list L;
+ for (size_t u=0; u<O.size(); ++u) {
+  python::list m;
+  for (size_t i=0; i<O[u].second.size(); ++i) m.append(O[u].second[i]);
+  L.append(python::make_tuple(O[u].first, m));
+ }
+ return L;
+}
+
+std::string name(bool dagger, int k) { std::stringstream fs; fs<< (dagger ? "Cdag" : "C") << k; return fs.str();}
+
+// not spin symmetric, so that the spin flip changes the trace
+Hloc * make_hloc() {
+ const double eps[NF] = {-0.3, 0.2, -0.25, 0.35}, U = 2.1, t = 0.4, J = 0.6;
+ op_t H, N_up, N_dn;
+ for (int k=0; k<NF; ++k) H += mono(eps[k], k+1, -(k+1));
+ for (int o=0; o<2; ++o) H += mono(U, o+1, -(o+1), o+3, -(o+3));
+ for (int s=0; s<2; ++s) { H += mono(t, 2*s+2, -(2*s+1)); H += mono(t, 2*s+1, -(2*s+2));}
+ H += mono(J, 2, -4, 3, -1); H += mono(J, 1, -3, 4, -2);
+ N_up += mono(1,1,-1); N_up += mono(1,2,-2); N_dn += mono(1,3,-3); N_dn += mono(1,4,-4);
+ python::dict ops, qns;
+ ops["Hamiltonian"] = to_python(H); ops["N_up"] = to_python(N_up); ops["N_dn"] = to_python(N_dn);
+ qns["N_up"] = ops["N_up"]; qns["N_dn"] = ops["N_dn"];
+ for (int k=0; k<NF; ++k) { ops[name(false,k)] = to_python(mono(1,k+1)); ops[name(true,k)] = to_python(mono(1,-(k+1)));}
+ return new Hloc(NF, 0, ops, qns, python::list(), python::object(), 0);
+}
+
+// the same Delta on the two blocks, as required for the relabeling
+struct delta_t {
+ std::vector<int> const & alpha; const double Beta;
+ delta_t(std::vector<int> const & alpha_, double Beta_) : alpha(alpha_), Beta(Beta_) {}
+ double f(int a1, double t1, int a2, double t2) const {
+  double dt = t1 - t2, s = 1;
+  if (dt<0) { dt += Beta; s = -1;}
+  return s * ( (1 + a1 + 2*a2) * std::exp(-0.7*dt) + 0.3 * std::cos((a1+1)*dt));
+ }
+ double operator()(OP_REF A, OP_REF B) const { return f(alpha[A->Op->Number], A->tau, alpha[B->Op->Number], B->tau);}
+ void fill_row(OP_REF A, const OP_REF * B, int n, double * res, int stride) const {
+  for (int i=0; i<n; ++i) res[i*stride] = (*this)(A,B[i]);
+ }
+ void fill_col(const OP_REF * A, int n, OP_REF B, double * res, int stride) const {
+  for (int i=0; i<n; ++i) res[i*stride] = (*this)(A[i],B);
+ }
+};
+typedef detManip<delta_t,double,OP_REF> det_type;
+
+void assert_close(double A, double B, double precision, std::string const & what) {
+ if ( std::abs(A-B) > precision) TRIQS_RUNTIME_ERROR<< what <<" : "<<A<<" != "<<B;
+}
+
+// the C, Cdagger of each block in decreasing time, as in Global_Move::gather_operators
+void gather(DT_type const & DT, std::vector<int> const & block, std::vector<std::vector<OP_REF> > & C, std::vector<std::vector<OP_REF> > & Cdag,
+  std::vector<bool> const & is_dagger) {
+ for (size_t a=0; a<C.size(); ++a) { C[a].clear(); Cdag[a].clear();}
+ for (OP_REF it=DT.OpRef_begin(); ! it.atEnd(); ++it) (is_dagger[it->Op->Number] ? Cdag : C)[block[it->Op->Number]].push_back(it);
+ for (size_t a=0; a<C.size(); ++a) { std::reverse(C[a].begin(),C[a].end()); std::reverse(Cdag[a].begin(),Cdag[a].end());}
+}
+
+// d against a det recomputed from scratch on Cdag, C, and against it for the insertion of a row and a column at (1,1)
+void check_det(det_type & d, delta_t const & Delta, std::vector<OP_REF> const & Cdag, std::vector<OP_REF> const & C,
+  OP_REF new_cdag, OP_REF new_c, std::string const & what) {
+ det_type ref(Delta, 10, 0);
+ ref.recomputeFrom(Cdag, C);
+ const double det = ref.determinant();
+ assert_close(d.determinant(), det, 1.e-10*std::abs(det), what + " : determinant");
+ for (int i=1; i<=int(C.size()); ++i)
+  for (int j=1; j<=int(C.size()); ++j) assert_close(d.M(i,j), ref.M(i,j), 1.e-10*(1+std::abs(ref.M(i,j))), what + " : M");
+ // the times and the alpha of the rows and the columns of d are read from its operators
+ const double r = ref.try_insert(1,1,new_cdag,new_c);
+ assert_close(d.try_insert(1,1,new_cdag,new_c), r, 1.e-10*std::abs(r), what + " : insertion ratio");
+}
+
+/*
+  The spin flip C_k <-> C_{k+2} as a Global_Move does it when the blocks have the same Delta :
+  the trace is recomputed by applyGlobalFunction, the determinants of the two blocks are exchanged and
+  relabeled (detManip::relabel) instead of being recomputed.
+  They are compared with a trace and determinants rebuilt from scratch on the permuted configuration,
+  after a rejected move (relabeled back) and after an accepted one.
+*/
+int main(int argc, char **argv) {
+ Py_Initialize();
+ try {
+  const double Beta = 5;
+  boost::scoped_ptr<Hloc> H (make_hloc());
+  std::vector<const Hloc::Operator *> Cop(NF), Cdagop(NF);
+  int n_max = 0;
+  for (int k=0; k<NF; ++k) {
+   Cop[k] = &(*H)[name(false,k)]; Cdagop[k] = &(*H)[name(true,k)];
+   n_max = std::max(n_max, std::max(Cop[k]->Number, Cdagop[k]->Number));
+  }
+  std::vector<int> alpha(n_max+1,-1), block(n_max+1,-1);
+  std::vector<bool> is_dagger(n_max+1,false);
+  std::vector<const Hloc::Operator *> spin_flip(n_max+1, (const Hloc::Operator *)NULL);
+  for (int k=0; k<NF; ++k) {
+   alpha[Cop[k]->Number] = alpha[Cdagop[k]->Number] = k%2;
+   block[Cop[k]->Number] = block[Cdagop[k]->Number] = k/2;
+   is_dagger[Cdagop[k]->Number] = true;
+   spin_flip[Cop[k]->Number] = Cop[(k+2)%NF]; spin_flip[Cdagop[k]->Number] = Cdagop[(k+2)%NF];
+  }
+  delta_t Delta(alpha, Beta);
+
+  // a configuration with 3 C, Cdagger in each block, alternating in time in each block
+  const double t[12] = { 0.3, 0.9, 1.7, 2.4, 3.1, 4.2,   0.5, 1.2, 2.0, 2.9, 3.6, 4.6};
+  const int  ops[12] = { -1,   2,  -2,   1,  -1,   1,    -3,   4,  -4,   3,  -4,   4}; // as in the monomials
+  std::vector<double> taus(t, t+12), taus_flip(taus);
+  std::vector<const Hloc::Operator *> O, O_flip;
+  for (int i=0; i<12; ++i) {
+   const int k = std::abs(ops[i])-1;
+   O.push_back(ops[i]<0 ? Cdagop[k] : Cop[k]);
+   O_flip.push_back(spin_flip[O.back()->Number]);
+  }
+
+  DT_type DT(*H, Beta);
+  if (!DT.resetOperators(taus, O)) TRIQS_RUNTIME_ERROR << "resetOperators";
+  const double trace = DT.currentTrace();
+  std::vector<std::vector<OP_REF> > C(2), Cdag(2);
+  gather(DT, block, C, Cdag, is_dagger);
+
+  // the determinants, built by insertions in a scrambled order as in the Monte Carlo :
+  // their storage is then permuted, which relabel must take into account
+  std::vector<det_type *> dets(2);
+  const int order[3] = {1, 2, 0}, col_order[3] = {2, 0, 1};
+  for (int a=0; a<2; ++a) {
+   dets[a] = new det_type(Delta, 10, 0);
+   for (int u=0; u<3; ++u) {
+    int i0 = 1, j0 = 1;
+    for (int v=0; v<u; ++v) { if (order[v] < order[u]) ++i0; if (col_order[v] < col_order[u]) ++j0;}
+    dets[a]->try_insert(i0, j0, Cdag[a][order[u]], C[a][col_order[u]]);
+    dets[a]->accept_move();
+   }
+  }
+
+  // an extra C, Cdagger couple in the list for the insertion ratios
+  DT_type DT_extra(*H, Beta);
+  std::vector<double> taus_extra(2); taus_extra[0] = 1.45; taus_extra[1] = 3.35;
+  std::vector<const Hloc::Operator *> O_extra(2); O_extra[0] = Cdagop[0]; O_extra[1] = Cop[1];
+  DT_extra.resetOperators(taus_extra, O_extra, true);
+  OP_REF extra_cdag = DT_extra.OpRef_begin(), extra_c = extra_cdag; ++extra_c;
+
+  // the reference : the permuted configuration from scratch
+  DT_type DT_flip(*H, Beta);
+  if (!DT_flip.resetOperators(taus_flip, O_flip)) TRIQS_RUNTIME_ERROR << "resetOperators (flipped)";
+  std::vector<std::vector<OP_REF> > C_flip(2), Cdag_flip(2);
+  gather(DT_flip, block, C_flip, Cdag_flip, is_dagger);
+
+  for (int accept=0; accept<2; ++accept) {
+   DT.applyGlobalFunction(spin_flip);
+   const double r = DT.ratioNewTrace_OldTrace(), r_ref = DT_flip.currentTrace()/trace;
+   assert_close(r, r_ref, 1.e-10*std::abs(r_ref), "trace ratio");
+   gather(DT, block, C, Cdag, is_dagger);
+   std::vector<det_type *> dets_old(dets);
+   for (int a=0; a<2; ++a) { dets[1-a] = dets_old[a]; dets[1-a]->relabel(Cdag[1-a], C[1-a]);}
+   for (int a=0; a<2; ++a) check_det(*dets[a], Delta, Cdag_flip[a], C_flip[a], extra_cdag, extra_c, "permuted det");
+   if (accept) { DT.confirm_applyGlobalFunction(); break;}
+   // rejected : the determinants are put back and relabeled on the operators of the original configuration
+   DT.undo_applyGlobalFunction();
+   gather(DT, block, C, Cdag, is_dagger);
+   for (int a=0; a<2; ++a) { dets[a] = dets_old[a]; dets[a]->relabel(Cdag[a], C[a]);}
+   for (int a=0; a<2; ++a) check_det(*dets[a], Delta, Cdag[a], C[a], extra_cdag, extra_c, "det after reject");
+   assert_close(DT.currentTrace(), trace, 1.e-12*std::abs(trace), "trace after reject");
+  }
+  assert_close(DT.currentTrace(), DT_flip.currentTrace(), 1.e-10*std::abs(trace), "trace after accept");
+  gather(DT, block, C, Cdag, is_dagger);
+  for (int a=0; a<2; ++a) check_det(*dets[a], Delta, Cdag[a], C[a], extra_cdag, extra_c, "det after accept");
+  for (int a=0; a<2; ++a) delete dets[a];
+  std::cerr << "spin flip : trace ratio "<< DT_flip.currentTrace()/trace << " OK" << std::endl;
+ }
+ catch (python::error_already_set const &) { PyErr_Print(); return 1;}
+}
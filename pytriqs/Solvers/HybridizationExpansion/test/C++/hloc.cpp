@@ -0,0 +1,345 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "Hloc.hpp"
+#include "SegmentTrace.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <triqs/utility/exceptions.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iostream>
+
+// a small dense matrix
+struct matrix_t { 
+ int n, m; std::vector<double> d;
+ matrix_t(int n_=0, int m_=-1) : n(n_), m(m_<0 ? n_ : m_), d(n*m,0) {}
+ double & operator()(int i, int j) { return d[i*m+j];}
+ double operator()(int i, int j) const { return d[i*m+j];}
+ matrix_t operator*(matrix_t const & B) const { 
+  matrix_t R(n,B.m);
+  for (int i=0; i<n; ++i) for (int k=0; k<m; ++k) for (int j=0; j<B.m; ++j) R(i,j) += (*this)(i,k) * B(k,j);
+  return R;
+ }
+};
+
+// Jacobi diagonalization of the symmetric matrix A : A = V diag(E) V^T
+void jacobi(matrix_t A, std::vector<double> & E, matrix_t & V) { 
+ const int n = A.n;
+ V = matrix_t(n); for (int i=0; i<n; ++i) V(i,i) = 1;
+ for (int sweep=0; sweep<100; ++sweep) { 
+  double off = 0;
+  for (int p=0; p<n; ++p) for (int q=p+1; q<n; ++q) off += A(p,q)*A(p,q);
+  if (off < 1.e-30) break;
+  for (int p=0; p<n; ++p) 
+   for (int q=p+1; q<n; ++q) { 
+    if (A(p,q)==0) continue;
+    const double theta = (A(q,q) - A(p,p))/(2*A(p,q));
+    const double t = (theta>=0 ? 1 : -1)/(std::abs(theta) + std::sqrt(theta*theta+1)), c = 1/std::sqrt(t*t+1), s = t*c;
+    for (int k=0; k<n; ++k) { const double akp = A(k,p), akq = A(k,q); A(k,p) = c*akp - s*akq; A(k,q) = s*akp + c*akq;}
+    for (int k=0; k<n; ++k) { const double apk = A(p,k), aqk = A(q,k); A(p,k) = c*apk - s*aqk; A(q,k) = s*apk + c*aqk;}
+    for (int k=0; k<n; ++k) { const double vkp = V(k,p), vkq = V(k,q); V(k,p) = c*vkp - s*vkq; V(k,q) = s*vkp + c*vkq;}
+   }
+ }
+ E.resize(n); for (int i=0; i<n; ++i) E[i] = A(i,i);
+}
+
+typedef std::vector<std::pair<double, std::vector<int> > > op_t; // sum of coef * monomial, cf Transcribe_OpList_for_C
+
+/*
+  A two orbital model with spin : C_k, k = 0,1 (orbitals 0,1 spin up), 2,3 (orbitals 0,1 spin down).
+  As in Transcribe_OpList_for_C, a monomial is the list of the operators in the order they are applied, 
+  k+1 stands for C_k and -(k+1) for Cdagger_k.
+*/
+const int NF = 4;
+const double eps[NF] = {-0.3, 0.2, -0.25, 0.35}, U = 2.1, t = 0.4, J = 0.6;
+
+op_t mono(double c, int o1, int o2, int o3=0, int o4=0) { 
+ std::vector<int> m; m.push_back(o1); m.push_back(o2); if (o3) { m.push_back(o3); m.push_back(o4);}
+ return op_t(1, std::make_pair(c,m));
+}
+op_t & operator += (op_t & A, op_t const & B) { A.insert(A.end(), B.begin(), B.end()); return A;}
+op_t n(int k) { return mono(1, k+1, -(k+1));}
+op_t cdag_c(double c, int a, int b) { return mono(c, b+1, -(a+1));} // c Cdag_a C_b
+
+op_t hamiltonian() { 
+ op_t H;
+ for (int k=0; k<NF; ++k) { op_t h(n(k)); h[0].first = eps[k]; H += h;}
+ for (int o=0; o<2; ++o) H += mono(U, o+1, -(o+1), o+3, -(o+3)); // U n_up n_dn
+ for (int s=0; s<2; ++s) { H += cdag_c(t, 2*s, 2*s+1); H += cdag_c(t, 2*s+1, 2*s);} // hopping
+ H += mono(J, 2, -4, 3, -1); // spin flip J Cdag_0 C_2 Cdag_3 C_1 
+ H += mono(J, 1, -3, 4, -2); // and its conjugate
+ return H;
+}
+
+// The operator in the occupation basis |F>, bit k of F = occupation of C_k, restricted to the states kept
+matrix_t dense(op_t const & O, std::vector<int> const & kept) { 
+ matrix_t M(kept.size());
+ for (size_t i0 =0; i0 < kept.size(); ++i0) { 
+  for (size_t u=0; u<O.size(); ++u) { 
+   int F = kept[i0]; double c = O[u].first;
+   for (size_t i=0; (i<O[u].second.size()) && (c!=0); ++i) { 
+    const int k = std::abs(O[u].second[i]) - 1, bit = 1<<k;
+    const bool dagger = (O[u].second[i] < 0);
+    if (bool(F & bit) == dagger) { c = 0; break;}
+    if (__builtin_popcount(F & (bit-1))%2) c = -c; // Jordan-Wigner sign
+    F ^= bit;
+   }
+   const size_t i = std::find(kept.begin(), kept.end(), F) - kept.begin();
+   if ((c!=0) && (i < kept.size())) M(i,i0) += c;
+  }
+ }
+ return M;
+}
+
+python::list to_python(op_t const & O) { 
+ python::list L;
+ for (size_t u=0; u<O.size(); ++u) { 
+  python::list m; 
+  for (size_t i=0; i<O[u].second.size(); ++i) m.append(O[u].second[i]);
+  L.append(python::make_tuple(O[u].first, m));
+ }
+ return L;
+}
+
+std::string name(bool dagger, int k) { std::stringstream fs; fs<< (dagger ? "Cdag" : "C") << k; return fs.str();}
+
+void assert_close(double A, double B, double precision, std::string const & what) { 
+ if ( std::abs(A-B) > precision) TRIQS_RUNTIME_ERROR<< what <<" : "<<A<<" != "<<B;
+}
+
+/*
+  The traces Tr ( e^{-(Beta - tau_1) H} O_1 e^{-(tau_1 - tau_2) H} O_2 ... O_n e^{-tau_n H} ) are invariant 
+  under a change of basis in the degenerate eigenspaces, so they can be compared with the direct computation.
+  The eigenvalues are compared directly.
+*/
+struct reference { 
+ std::vector<double> E; matrix_t V; // H = V diag(E) V^T on the kept states
+ reference(matrix_t const & H) { 
+  jacobi(H, E, V);
+ }
+ matrix_t expH(double tau) const { 
+  matrix_t R(V.n);
+  for (int k=0; k<V.n; ++k) 
+   for (int i=0; i<R.n; ++i) 
+    for (int j=0; j<R.n; ++j) R(i,j) += std::exp(-tau*E[k]) * V(i,k) * V(j,k);
+  return R;
+ }
+ double trace(double Beta, std::vector<matrix_t const *> const & O, std::vector<double> const & tau) const { 
+  matrix_t R (expH(Beta - (O.size() ? tau[0] : 0)));
+  for (size_t n=0; n<O.size(); ++n) R = R * (*O[n]) * expH(tau[n] - (n+1 < O.size() ? tau[n+1] : 0));
+  double r = 0;
+  for (int i=0; i<R.n; ++i) r += R(i,i);
+  return r;
+ }
+};
+
+// the same trace, with the blocs and the matrix elements of Hloc
+double hloc_trace(Hloc const & H, double Beta, std::vector<const Hloc::Operator *> const & O, std::vector<double> const & tau) { 
+ double r = 0;
+ for (Hloc::BlocIterator B = H.BlocBegin(); !B.atEnd(); ++B) { 
+  // R = the product from the right, on the bloc B : Bcur x B matrix 
+  const Hloc::Bloc * Bcur = &(*B);
+  matrix_t R(B->dim);
+  for (int i=0; i<B->dim; ++i) R(i,i) = std::exp(- (O.size() ? tau.back() : Beta) * B->H[i]);
+  for (int n= int(O.size())-1; (n>=0) && Bcur; --n) { 
+   Hloc::Operator::BlocMatrixElement ME ((*O[n])[Bcur]);
+   if (!ME.Btarget) { Bcur = NULL; break;}
+   const double dtau = (n>0 ? tau[n-1] : Beta) - tau[n];
+   matrix_t X(ME.Btarget->dim, B->dim);
+   for (int i=0; i<ME.Btarget->dim; ++i) 
+    for (int j=0; j<B->dim; ++j) { 
+     double s = 0;
+     for (int k=0; k<Bcur->dim; ++k) s += ME.M(i,k) * R(k,j);
+     X(i,j) = std::exp(-dtau * ME.Btarget->H[i]) * s;
+    }
+   R = X; Bcur = ME.Btarget;
+  }
+  if (Bcur != &(*B)) continue;
+  for (int i=0; i<B->dim; ++i) r += R(i,i);
+ }
+ return r;
+}
+
+// Hloc against the direct diagonalization, with and without a truncation by SelectQN
+void check (python::object SelectQN, int max_N) { 
+ python::dict ops, qns; 
+ ops["Hamiltonian"] = to_python(hamiltonian());
+ op_t N_up(n(0)); N_up += n(1);
+ op_t N_dn(n(2)); N_dn += n(3);
+ ops["N_up"] = to_python(N_up); ops["N_dn"] = to_python(N_dn);
+ qns["N_up"] = ops["N_up"]; qns["N_dn"] = ops["N_dn"];
+ std::vector<op_t> C(2*NF);
+ for (int k=0; k<NF; ++k) { 
+  C[k] = mono(1, k+1, 0); C[k][0].second.resize(1); 
+  C[k+NF] = mono(1, -(k+1), 0); C[k+NF][0].second.resize(1); 
+  ops[name(false,k)] = to_python(C[k]); ops[name(true,k)] = to_python(C[k+NF]);
+ }
+ Hloc H(NF, 0, ops, qns, python::list(), SelectQN, 0);
+
+ std::vector<int> kept;
+ for (int F=0; F< (1<<NF); ++F) if (__builtin_popcount(F) <= max_N) kept.push_back(F);
+ reference R(dense(hamiltonian(), kept));
+ std::vector<matrix_t> Cd; 
+ for (int k=0; k<2*NF; ++k) Cd.push_back(dense(C[k],kept));
+
+ // the spectrum
+ std::vector<double> E;
+ for (Hloc::BlocIterator B = H.BlocBegin(); !B.atEnd(); ++B) E.insert(E.end(), B->H, B->H + B->dim);
+ std::sort(E.begin(), E.end());
+ if (E.size() != kept.size()) TRIQS_RUNTIME_ERROR << "Hloc : "<< E.size()<< " states instead of "<< kept.size();
+ std::vector<double> Eref(R.E); std::sort(Eref.begin(), Eref.end());
+ for (size_t i=0; i<E.size(); ++i) assert_close(E[i], Eref[i], 1.e-10, "eigenvalue");
+
+ // the traces with 0, 2 and 4 operators : all the matrix elements of the C, Cdagger in the eigenbasis are involved
+ const double Beta = 5;
+ std::vector<double> tau; tau.push_back(3.7); tau.push_back(2.2); tau.push_back(1.1); tau.push_back(0.3);
+ const double Z = R.trace(Beta, std::vector<matrix_t const *>(), tau);
+ assert_close(hloc_trace(H, Beta, std::vector<const Hloc::Operator *>(), tau), Z, 1.e-10*Z, "Z");
+ for (int a=0; a<NF; ++a) 
+  for (int b=0; b<NF; ++b) { 
+   std::vector<matrix_t const *> O2; O2.push_back(&Cd[a]); O2.push_back(&Cd[NF+b]);
+   std::vector<const Hloc::Operator *> H2; H2.push_back(&H[name(false,a)]); H2.push_back(&H[name(true,b)]);
+   std::vector<double> tau2(tau.begin()+1, tau.begin()+3);
+   assert_close(hloc_trace(H, Beta, H2, tau2), R.trace(Beta, O2, tau2), 1.e-10*Z, "<C Cdag>");
+   for (int c=0; c<NF; ++c) 
+    for (int d=0; d<NF; ++d) { 
+     std::vector<matrix_t const *> O4(O2); O4.push_back(&Cd[NF+c]); O4.push_back(&Cd[d]);
+     std::vector<const Hloc::Operator *> H4(H2); H4.push_back(&H[name(true,c)]); H4.push_back(&H[name(false,d)]);
+     assert_close(hloc_trace(H, Beta, H4, tau), R.trace(Beta, O4, tau), 1.e-10*Z, "<C Cdag Cdag C>");
+    }
+  }
+ std::cerr << H.NBlocks << " blocs, " << kept.size() << " states : OK" << std::endl;
+}
+
+/*
+  The blocs are the classes of the quantum numbers for the tolerant comparison of Hloc.cpp (1e-8), 
+  also when the QNs of a bloc fall on both sides of a rounding boundary : Q = 0.5e-6 N_up - 0.4e-8 N_dn 
+  gives the blocs of N_up.
+*/
+void check_qn_tolerance() { 
+ python::dict ops, qns; 
+ ops["Hamiltonian"] = to_python(hamiltonian());
+ op_t Q(n(0)); Q += n(1); Q += n(2); Q += n(3);
+ for (int k=0; k<NF; ++k) Q[k].first = (k<2 ? 0.5e-6 : -0.4e-8);
+ ops["Q"] = to_python(Q); qns["Q"] = ops["Q"];
+ for (int k=0; k<NF; ++k) { 
+  op_t c(mono(1, k+1, 0)), cdag(mono(1, -(k+1), 0)); c[0].second.resize(1); cdag[0].second.resize(1); 
+  ops[name(false,k)] = to_python(c); ops[name(true,k)] = to_python(cdag);
+ }
+ Hloc H(NF, 0, ops, qns, python::list(), python::object(), 0);
+ std::vector<int> dims;
+ for (Hloc::BlocIterator B = H.BlocBegin(); !B.atEnd(); ++B) dims.push_back(B->dim);
+ std::sort(dims.begin(), dims.end());
+ const int dims_N_up[] = {4,4,8};
+ if (dims != std::vector<int>(dims_N_up, dims_N_up+3)) TRIQS_RUNTIME_ERROR << "QN tolerance : "<< dims.size() << " blocs instead of 3";
+ std::cerr << "QN tolerance : OK" << std::endl;
+}
+
+// Hloc of the hamiltonian Hop, with all the C, Cdagger and the occupations n_k (or N_up, N_dn) as quantum numbers
+Hloc * make_hloc(op_t const & Hop, bool occupations_as_qn) { 
+ python::dict ops, qns; 
+ ops["Hamiltonian"] = to_python(Hop);
+ if (occupations_as_qn) 
+  for (int k=0; k<NF; ++k) { std::stringstream fs; fs<<"N"<<k; ops[fs.str()] = to_python(n(k)); qns[fs.str()] = ops[fs.str()];}
+ else { 
+  op_t N_up(n(0)); N_up += n(1);
+  op_t N_dn(n(2)); N_dn += n(3);
+  ops["N_up"] = to_python(N_up); ops["N_dn"] = to_python(N_dn);
+  qns["N_up"] = ops["N_up"]; qns["N_dn"] = ops["N_dn"];
+ }
+ for (int k=0; k<NF; ++k) { 
+  op_t c(mono(1, k+1, 0)), cdag(mono(1, -(k+1), 0)); c[0].second.resize(1); cdag[0].second.resize(1); 
+  ops[name(false,k)] = to_python(c); ops[name(true,k)] = to_python(cdag);
+ }
+ return new Hloc(NF, 0, ops, qns, python::list(), python::object(), 0);
+}
+
+SegmentTrace * make_segment_trace(Hloc const & H, double Beta) { 
+ std::vector<std::vector<const Hloc::Operator *> > COps(NF), CdagOps(NF);
+ for (int k=0; k<NF; ++k) { COps[k].push_back(&H[name(false,k)]); CdagOps[k].push_back(&H[name(true,k)]);}
+ return SegmentTrace::make(H, COps, CdagOps, Beta);
+}
+
+/*
+  SegmentTrace::make : the segment picture is used for a density-density Hloc only, 
+  and its trace ratios are then the ones of the traces computed with the Hloc.
+*/
+void check_segment_picture() { 
+ const double Beta = 5, V = 1.3, W = 0.7;
+ op_t Hdd;
+ for (int k=0; k<NF; ++k) { op_t h(n(k)); h[0].first = eps[k]; Hdd += h;}
+ for (int o=0; o<2; ++o) Hdd += mono(U, o+1, -(o+1), o+3, -(o+3)); // U n_up n_dn
+ for (int s=0; s<2; ++s) Hdd += mono(V, 2*s+1, -(2*s+1), 2*s+2, -(2*s+2)); // V n_0s n_1s
+
+ boost::scoped_ptr<Hloc> H (make_hloc(Hdd,true));
+ boost::scoped_ptr<SegmentTrace> T (make_segment_trace(*H, Beta));
+ if (!T) TRIQS_RUNTIME_ERROR << "density-density Hloc : no segment picture";
+
+ // segments, anti-segments, a segment winding around Beta, and removals, for the flavours k = C_k, Cdagger_k
+ struct move_t { int k; double tau_cdag, tau_c; bool insert;};
+ const move_t moves[] = { {0, 1.0, 3.0, true}, {2, 2.0, 4.5, true}, {1, 4.0, 0.5, true}, {0, 2.5, 1.5, true}, 
+  {3, 0.2, 4.8, true}, {2, 2.0, 4.5, false}, {0, 2.5, 1.5, false}, {1, 3.5, 3.8, true}};
+ std::vector<std::pair<double, const Hloc::Operator *> > config; // sorted by decreasing times
+ double trace = hloc_trace(*H, Beta, std::vector<const Hloc::Operator *>(), std::vector<double>());
+ for (size_t m=0; m< sizeof(moves)/sizeof(move_t); ++m) { 
+  const move_t & mv (moves[m]);
+  const std::pair<double, const Hloc::Operator *> cdag(mv.tau_cdag, &(*H)[name(true,mv.k)]), c(mv.tau_c, &(*H)[name(false,mv.k)]);
+  const double r = (mv.insert ? T->try_insert(mv.k, mv.tau_cdag, mv.tau_c) : T->try_remove(mv.k, mv.tau_cdag, mv.tau_c));
+  if (mv.insert) { config.push_back(cdag); config.push_back(c);}
+  else { 
+   config.erase(std::find(config.begin(), config.end(), cdag)); 
+   config.erase(std::find(config.begin(), config.end(), c));
+  }
+  std::sort(config.rbegin(), config.rend());
+  std::vector<double> tau; std::vector<const Hloc::Operator *> O;
+  for (size_t i=0; i<config.size(); ++i) { tau.push_back(config[i].first); O.push_back(config[i].second);}
+  const double trace_new = hloc_trace(*H, Beta, O, tau);
+  assert_close(r, trace_new/trace, 1.e-10*std::abs(r), "segment trace ratio");
+  T->confirm(); trace = trace_new;
+ }
+
+ // a 3-body term : the states are still the occupation states, but the energies are not density-density
+ op_t H3(Hdd); 
+ H3 += op_t(1, std::make_pair(W, std::vector<int>()));
+ const int m3[] = {1,-1,2,-2,3,-3}; H3.back().second.assign(m3, m3+6); // W n_0 n_1 n_2
+ boost::scoped_ptr<Hloc> H3loc (make_hloc(H3,true));
+ if (boost::scoped_ptr<SegmentTrace>(make_segment_trace(*H3loc, Beta))) TRIQS_RUNTIME_ERROR << "3-body term : segment picture used";
+
+ // hopping and spin flip : the eigenstates are not occupation states
+ boost::scoped_ptr<Hloc> Hfull (make_hloc(hamiltonian(),false));
+ if (boost::scoped_ptr<SegmentTrace>(make_segment_trace(*Hfull, Beta))) TRIQS_RUNTIME_ERROR << "spin flip : segment picture used";
+ std::cerr << "segment picture : OK" << std::endl;
+}
+
+int main(int argc, char **argv) {
+ Py_Initialize();
+ try { 
+  check(python::object(), NF);
+  // only the states with at most 2 electrons
+  python::object main_namespace = python::import("__main__").attr("__dict__");
+  check(python::eval("lambda qn : sum(qn).real <= 2", main_namespace), 2);
+  check_qn_tolerance();
+  check_segment_picture();
+ }
+ catch (python::error_already_set const &) { PyErr_Print(); return 1;}
+}
@@ -0,0 +1,78 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "nfft_binner.hpp"
+#include <triqs/mc_tools/random_generator.hpp>
+#include <triqs/utility/exceptions.hpp>
+#include <iostream>
+
+typedef std::complex<double> COMPLEX;
+
+void assert_close( COMPLEX const & A, COMPLEX const & B, double precision) {
+ if ( std::abs(A-B) > precision) TRIQS_RUNTIME_ERROR<<"assert_close error : "<<A<<"\n"<<B;
+}
+
+/*
+  The nfft against the direct sums, on the frequency boxes of Measure_G2 : 
+  n_f = 2 n_nu + n_omega down to 3 frequencies, i.e. a grid smaller than the gaussian (2 n_spread points).
+*/
+int main(int argc, char **argv) {
+
+ const double Beta = 10, pi = acos(-1.0);
+ const int n_points = 40;
+ triqs::mc_tools::random_generator RNG("mt19937", 23432);
+
+ for (int n_nu =1; n_nu<=3; ++n_nu) 
+  for (int n_omega =1; n_omega<=2; ++n_omega) { 
+   const int n_f = 2*n_nu + n_omega;
+   nfft_binner bin(Beta, n_f, 1);
+   nfft_binner_2d bin2(Beta, -n_nu, n_f, 1);
+
+   std::vector<double> tau1, tau2; 
+   std::vector<COMPLEX> val;
+   for (int p=0; p<n_points; ++p) { 
+    tau1.push_back(RNG(2*Beta) - Beta); tau2.push_back(RNG(2*Beta) - Beta);
+    val.push_back(COMPLEX(RNG(1.0),RNG(1.0)));
+    bin(0, tau1[p], val[p]);
+    bin2(0, tau1[p], tau2[p], val[p]);
+   }
+
+   std::vector<COMPLEX> res(n_f), res2(n_f*n_f);
+   bin.transform(0, &res[0]);
+   bin2.transform(0, &res2[0]);
+
+   for (int n=0; n<n_f; ++n) { 
+    COMPLEX s = 0;
+    for (int p=0; p<n_points; ++p) s += val[p] * std::polar(1.0, (2*n+1)*pi/Beta*tau1[p]);
+    assert_close(res[n], s, 1.e-8);
+   }
+
+   for (int n1=0; n1<n_f; ++n1) 
+    for (int n2=0; n2<n_f; ++n2) { 
+     const double om1 = (2*(n1-n_nu)+1)*pi/Beta, om2 = (2*(n2-n_nu)+1)*pi/Beta;
+     COMPLEX s = 0;
+     for (int p=0; p<n_points; ++p) s += val[p] * std::polar(1.0, om1*tau1[p] + om2*tau2[p]);
+     assert_close(res2[n1*n_f+n2], s, 1.e-8);
+    }
+   std::cerr << "n_nu = "<< n_nu << " n_omega = "<< n_omega << " OK"<< std::endl;
+  }
+}
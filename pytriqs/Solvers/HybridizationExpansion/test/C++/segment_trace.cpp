@@ -0,0 +1,141 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "SegmentTrace.hpp"
+#include <triqs/mc_tools/random_generator.hpp>
+#include <triqs/utility/exceptions.hpp>
+#include <iostream>
+
+using std::vector;
+typedef vector<std::pair<double,bool> > flavour_ops; // sorted (tau, dagger)
+
+// A density-density Hloc, with random signs for the matrix elements of the C, Cdagger
+struct model { 
+ int N; double Beta;
+ vector<double> eps; vector<vector<double> > U;
+ vector<int> sC, sCdag; vector<vector<bool> > S;
+
+ model(int N_, double Beta_, triqs::mc_tools::random_generator & RNG) : 
+  N(N_), Beta(Beta_), eps(N), U(N,vector<double>(N,0)), sC(N), sCdag(N), S(N,vector<bool>(N,false)) { 
+   for (int a=0; a<N; ++a) { 
+    eps[a] = RNG(2.0) - 1; sC[a] = (RNG(2) ? 1 : -1); sCdag[a] = (RNG(2) ? 1 : -1);
+    for (int b=0; b<a; ++b) U[a][b] = U[b][a] = RNG(2.0);
+    for (int b=0; b<N; ++b) S[a][b] = (b!=a) && RNG(2);
+   }
+  }
+
+ double energy(unsigned int n) const { 
+  double E = 0;
+  for (int a=0; a<N; ++a) { 
+   if (!(n & (1u<<a))) continue;
+   E += eps[a];
+   for (int b=0; b<a; ++b) if (n & (1u<<b)) E += U[a][b];
+  }
+  return E;
+ }
+
+ // Tr ( e^{-(Beta - tau_k) H} O_k ... O_1 e^{-tau_1 H} ), computed state by state in the occupation basis
+ double brute_force_trace (vector<flavour_ops> const & F) const { 
+  vector<std::pair<double,std::pair<int,bool> > > ops;
+  for (int a=0; a<N; ++a) 
+   for (size_t k=0; k<F[a].size(); ++k) ops.push_back(std::make_pair(F[a][k].first, std::make_pair(a, F[a][k].second)));
+  std::sort(ops.begin(), ops.end());
+  double tr = 0;
+  for (unsigned int n0=0; n0< (1u<<N); ++n0) { 
+   unsigned int n = n0; double w = 1, t = 0;
+   for (size_t k=0; (k<ops.size()) && (w!=0); ++k) { 
+    const int a = ops[k].second.first; const bool dagger = ops[k].second.second;
+    w *= std::exp(- energy(n) * (ops[k].first - t)); t = ops[k].first;
+    if (bool(n & (1u<<a)) == dagger) { w = 0; break;}
+    w *= (dagger ? sCdag[a] : sC[a]);
+    for (int b=0; b<N; ++b) if (S[a][b] && (n & (1u<<b))) w = -w;
+    n ^= (1u<<a);
+   }
+   if (n==n0) tr += w * std::exp(- energy(n) * (Beta - t));
+  }
+  return tr;
+ }
+};
+
+/*
+  The trace ratios and signs of the SegmentTrace, against the brute force trace, 
+  on random insertions and removals of segments and anti-segments, for a few random density-density Hloc.
+*/
+int main(int argc, char **argv) {
+
+ const int N = 3, n_models = 5, n_moves = 300;
+ const double Beta = 10;
+ triqs::mc_tools::random_generator RNG("mt19937", 23432);
+
+ for (int m=0; m<n_models; ++m) { 
+  model M(N, Beta, RNG);
+  vector<int> sigma(N);
+  for (int a=0; a<N; ++a) sigma[a] = M.sC[a] * M.sCdag[a];
+  SegmentTrace T(Beta, M.eps, M.U, sigma, M.S);
+  vector<flavour_ops> F(N);
+  double trace = M.brute_force_trace(F);
+  int n_insert = 0, n_remove = 0;
+
+  for (int i=0; i<n_moves; ++i) { 
+   const int a = RNG(N);
+   flavour_ops & f (F[a]);
+   vector<flavour_ops> F_new(F);
+   double r;
+   if ( f.empty() || ((f.size() < 12) && RNG(2))) { 
+    // two times in the same interval between consecutive operators of a. 
+    // If the line is occupied there, it is an anti-segment : C first, Cdagger second.
+    double t1 = RNG(Beta), t2;
+    bool occupied = false;
+    if (f.empty()) { t2 = RNG(Beta); occupied = RNG(2);} 
+    else { 
+     const size_t k = std::upper_bound(f.begin(), f.end(), std::make_pair(t1,true)) - f.begin();
+     const double prev = (k==0 ? f.back().first - Beta : f[k-1].first), next = (k==f.size() ? f[0].first + Beta : f[k].first);
+     t2 = prev + RNG(next - prev); 
+     if (t1 < prev) t1 += Beta; // t1 and t2 in [prev,next]
+     occupied = !f[k%f.size()].second;
+     if (t1 > t2) std::swap(t1,t2);
+     t1 = std::fmod(t1 + Beta, Beta); t2 = std::fmod(t2 + Beta, Beta);
+    }
+    const double td = (occupied ? t2 : t1), tc = (occupied ? t1 : t2);
+    r = T.try_insert(a, td, tc);
+    F_new[a].push_back(std::make_pair(td,true)); F_new[a].push_back(std::make_pair(tc,false));
+    std::sort(F_new[a].begin(), F_new[a].end());
+    ++n_insert;
+   }
+   else { 
+    // two consecutive operators of a 
+    const size_t k = RNG(f.size()), k2 = (k+1)%f.size();
+    const double td = (f[k].second ? f[k].first : f[k2].first), tc = (f[k].second ? f[k2].first : f[k].first);
+    r = T.try_remove(a, td, tc);
+    F_new[a].erase(F_new[a].begin() + std::max(k,k2)); F_new[a].erase(F_new[a].begin() + std::min(k,k2));
+    ++n_remove;
+   }
+   const double trace_new = M.brute_force_trace(F_new);
+   if (std::abs(r - trace_new/trace) > 1.e-10 * std::abs(r)) 
+    TRIQS_RUNTIME_ERROR << "model "<< m << " move "<< i << " : trace ratio "<< r << " != brute force "<< trace_new/trace;
+   // rejects a few moves, to test that a rejected try leaves the engine untouched
+   if (RNG(4)==0) continue; 
+   T.confirm(); F.swap(F_new); trace = trace_new;
+  }
+  std::cerr << "model "<< m <<" : "<< n_insert << " insertions, "<< n_remove << " removals OK"<< std::endl;
+ }
+}
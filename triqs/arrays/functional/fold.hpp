@@ -23,6 +23,7 @@
 #include <boost/type_traits/remove_const.hpp>
 #include <boost/type_traits/remove_reference.hpp>
 #include <boost/function.hpp>
+#include <vector>
 #include "../array.hpp"
 
 namespace triqs { namespace arrays {
@@ -39,12 +40,48 @@ namespace triqs { namespace arrays {
      template<class KT> void operator()(A const & b, KT &) { r = f(r,b);}
     };
 
+   // fold of a part of the array, with no initial value
+   template<class A>
+    struct partial_fold_func_adaptor { 
+     F f; result_type r; bool empty;
+     partial_fold_func_adaptor(F f_):f(f_), empty(true) {}
+     template<class KT> void operator()(A const & b, KT &) { if (empty) { r = b; empty = false;} else r = f(r,b);}
+    };
+
+   // with TRIQS_ARRAYS_FOREACH_USE_OPENMP, a large array is folded by slices on the threads, 
+   // and the partial results are folded in the order of the slices : f must be associative.
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+   template<class A>
+    typename boost::disable_if<boost::is_base_of<Tag::indexmap_storage_pair,A>, bool>::type 
+    parallel_fold (A const &, result_type &) const { return false;}
+
+   template<class A>
+    typename boost::enable_if<boost::is_base_of<Tag::indexmap_storage_pair,A>, bool>::type 
+    parallel_fold (A const & a, result_type & r) const { 
+     if (!indexmaps::foreach_in_parallel(a)) return false;
+     typedef partial_fold_func_adaptor<typename A::value_type> adaptor;
+     const indexmaps::foreach_int_type n = indexmaps::foreach_n_rows(a);
+     std::vector<adaptor> partials(omp_get_max_threads(), adaptor(f));
+#pragma omp parallel
+     { 
+      const indexmaps::foreach_int_type nt = omp_get_num_threads(), it = omp_get_thread_num();
+      indexmaps::foreach_rows(boost::ref(partials[it]), a, (n*it)/nt, (n*(it+1))/nt);
+     }
+     for (size_t u=0; u<partials.size(); ++u) if (!partials[u].empty) r = f(r, partials[u].r);
+     return true;
+    }
+#else
+   template<class A> bool parallel_fold (A const &, result_type &) const { return false;}
+#endif
+
    public:
 
    fold_worker ( F const & f_):f(f_) {} 
 
    template<class A>   
     result_type operator() (A const & a, typename A::value_type init = typename A::value_type() )  const { 
+     result_type r = init;
+     if (parallel_fold(a,r)) return r;
      fold_func_adaptor<typename A::value_type> func(f,init);
      indexmaps::foreach(boost::ref(func),a);
      return func.r;
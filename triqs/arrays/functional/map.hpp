@@ -26,6 +26,7 @@
 #include <boost/type_traits/remove_reference.hpp>
 #include <boost/function.hpp>
 #include "../impl/common.hpp"
+#include "../impl/flat_evaluation.hpp"
 namespace triqs { namespace arrays { 
  
  template<class F, int arity=F::arity> class map_impl;
@@ -38,6 +39,31 @@ namespace triqs { namespace arrays {
 
  // ----------- implementation  -------------------------------------
 
+ namespace details { 
+  // flat evaluation of map(f)(a) and map(f)(a,b) : cf impl/flat_evaluation.hpp
+  template<class F, class A, class R> struct map1_flat_evaluation { 
+   typedef flat_evaluation<A> FA;
+   static const bool value = FA::value;
+   template<class M, class T> static bool compatible(M const & m, T const & t) { return FA::compatible(m.a,t);}
+   struct type { 
+    F f; typename FA::type a;
+    template<class M> type(M const & m) : f(m.f), a(m.a) {}
+    R operator()(std::ptrdiff_t n) const { return f(a(n));}
+   };
+  };
+
+  template<class F, class A, class B, class R> struct map2_flat_evaluation { 
+   typedef flat_evaluation<A> FA; typedef flat_evaluation<B> FB;
+   static const bool value = FA::value && FB::value;
+   template<class M, class T> static bool compatible(M const & m, T const & t) { return FA::compatible(m.a,t) && FB::compatible(m.b,t);}
+   struct type { 
+    F f; typename FA::type a; typename FB::type b;
+    template<class M> type(M const & m) : f(m.f), a(m.a), b(m.b) {}
+    R operator()(std::ptrdiff_t n) const { return f(a(n),b(n));}
+   };
+  };
+ }
+
  template<class F> class map_impl<F,1>  { 
   F f;
   public :   
@@ -49,6 +75,7 @@ namespace triqs { namespace arrays {
     public:
      typedef typename boost::result_of<F(typename A::value_type)>::type value_type;
      typedef typename A::domain_type domain_type;
+     typedef details::map1_flat_evaluation<F,A,value_type> flat_evaluation_type;
      A const & a; F f;
      m_result(F const & f_, A const & a_):a(a_),f(f_) {}
      domain_type domain() const { return a.domain(); } 
@@ -60,6 +87,7 @@ namespace triqs { namespace arrays {
     public:
      typedef typename boost::result_of<F(typename A::value_type)>::type value_type;
      typedef typename A::domain_type domain_type;
+     typedef details::map1_flat_evaluation<F,A,value_type> flat_evaluation_type;
      A const & a; F f;
      m_result(F const & f_, A const & a_):a(a_),f(f_) {}
      domain_type domain() const { return a.domain(); } 
@@ -73,6 +101,7 @@ namespace triqs { namespace arrays {
     public:
      typedef typename boost::result_of<F(typename A::value_type)>::type value_type;
      typedef typename A::domain_type domain_type;
+     typedef details::map1_flat_evaluation<F,A,value_type> flat_evaluation_type;
      A const & a; F f;
      m_result(F const & f_, A const & a_):a(a_),f(f_) {}
      domain_type domain() const { return a.domain(); } 
@@ -105,6 +134,7 @@ namespace triqs { namespace arrays {
    public:
     typedef typename boost::result_of<F(typename A::value_type,typename B::value_type)>::type value_type;
     typedef typename A::domain_type domain_type;
+    typedef details::map2_flat_evaluation<F,A,B,value_type> flat_evaluation_type;
     A const & a; B const & b; F f;
     m_result(F const & f_, A const & a_, B const & b_):a(a_),b(b_),f(f_) {
      if (a.domain() != b.domain()) TRIQS_RUNTIME_ERROR<<"map2 : domain mismatch";
@@ -21,11 +21,26 @@
 #ifndef TRIQS_ARRAYS_HDF5_ARRAY_PROXY_H
 #define TRIQS_ARRAYS_HDF5_ARRAY_PROXY_H
 #include "./array_proxy_impl.hpp"
+#include "./proxy_cache.hpp"
 
 namespace triqs { namespace arrays { 
  namespace h5 { 
 
-  /// The array proxy
+  /// The storage of the proxy : the file/group, the name of the dataset and the cache (shared by the slices)
+  template<typename ValueType, int Rank_f> struct array_proxy_storage { 
+   boost::shared_ptr<H5::CommonFG> file_group; 
+   std::string name;
+   boost::shared_ptr<proxy_cache<ValueType,Rank_f> > cache;
+   array_proxy_storage(boost::shared_ptr<H5::CommonFG> const & fg, std::string const & n) : file_group(fg), name(n) {}
+  };
+
+  /**
+   * The array proxy
+   *
+   * The slices are read from the file at each assignment, unless a cache is enabled (enable_cache) :  
+   * the blocks of rows (first index) of the dataset are then kept in memory and shared by the slices taken afterwards,  
+   * and can be loaded in advance (read_ahead, prefetch).
+   */
   template<typename ValueType, int Rank, int Rank_f = Rank >
    class array_proxy : TRIQS_MODEL_CONCEPT(ImmutableCuboidArray), // WRONG ! IT does not yet implement [ ] 
    public sliceable_object < ValueType,
@@ -38,7 +53,8 @@ namespace triqs { namespace arrays {
   {
    public :    
     typedef ValueType value_type;
-    typedef std::pair< boost::shared_ptr<H5::CommonFG> ,std::string> storage_type; 
+    typedef array_proxy_storage<ValueType,Rank_f> storage_type; 
+    typedef proxy_cache<ValueType,Rank_f> cache_type;
     static const bool T_is_complex = boost::is_complex<ValueType>::value;
     typedef index_system< Rank, Rank_f> indexmap_type;
     static const unsigned int rank = Rank;
@@ -46,9 +62,9 @@ namespace triqs { namespace arrays {
     /// Opens a proxy on an existing array. The dataset must exists
     template< class FileGroupType >
      array_proxy ( FileGroupType file_group, std::string const & name) :
-      indexmap_ ( indexmap_type(file_group.openDataSet( name.c_str() ).getSpace(),T_is_complex) ) { 
+      indexmap_ ( indexmap_type(file_group.openDataSet( name.c_str() ).getSpace(),T_is_complex) ), 
+      storage_ ( boost::make_shared<FileGroupType>(file_group),name) { 
        if (!h5::exists(file_group, name)) TRIQS_RUNTIME_ERROR<< " h5 : no dataset"<< name << " in file "; 
-       storage_ = std::make_pair( boost::make_shared<FileGroupType>(file_group),name);
        DataSet dataset = file_group.openDataSet( name.c_str() );
        try { if (T_is_complex) write_attribute(dataset,"__complex__","1"); } 
        catch (...) {} // catch if the attribute already exists...
@@ -57,13 +73,12 @@ namespace triqs { namespace arrays {
     /// Constructs a proxy on a new data set of the dimension of the domain D.  The data must not exist. 
     template< class FileGroupType, class LengthType >
      array_proxy ( FileGroupType file_group, std::string const & name_, LengthType L, bool overwrite = false) :
-      indexmap_ ( indexmap_type (L) ) 
+      indexmap_ ( indexmap_type (L) ), storage_ ( boost::make_shared<FileGroupType>(file_group),name_) 
    { 
     if (h5::exists(file_group, name_)) {
      if (overwrite) file_group.unlink(name_.c_str());  
      else TRIQS_RUNTIME_ERROR<< " h5 : dataset"<< name_ << " already exists in the file "; 
     }
-    storage_ = std::make_pair( boost::make_shared<FileGroupType>(file_group),name_);
     DataSpace ds  = indexmap_.template dataspace<T_is_complex>(); //(indexmap_type::rank_full, &indexmap_.lengths()[0], &indexmap_.strides()[0]  );
     DataSet dataset = file_group.createDataSet( name_.c_str(), data_type_file(ValueType()), ds);
     if (T_is_complex) write_attribute(dataset,"__complex__","1");
@@ -79,8 +94,40 @@ namespace triqs { namespace arrays {
     indexmap_type const & indexmap() const {return indexmap_;}
     storage_type const & storage() const {return storage_;}
     storage_type & storage() {return storage_;}
-    const H5::CommonFG * file_group() const { return storage_.first.get();}
-    std::string const & name() const { return storage_.second;}
+    const H5::CommonFG * file_group() const { return storage_.file_group.get();}
+    std::string const & name() const { return storage_.name;}
+
+    /**
+     * \brief Enables the cache of the dataset, for this proxy and the slices taken from it afterwards.
+     * \param max_bytes The maximal size of the blocks kept in memory (the least recently used blocks are evicted)
+     * \param read_ahead When the slices are read in sequence along the first index, the read_ahead next blocks 
+     *        are loaded in the background
+     * \param block_rows Number of rows (first index) of the blocks. 0 : the hdf5 chunk size if the dataset is chunked, else about 1 MB.
+     * NB : the other proxies on the same dataset do not see the cache : a write through them is not seen by this proxy.
+     */
+    void enable_cache (size_t max_bytes, size_t read_ahead = 0, size_t block_rows = 0) { 
+     DataSet dataset;
+     try { std::lock_guard<std::mutex> lock(details::h5_lock()); dataset = file_group()->openDataSet( name().c_str() );}
+     TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+     storage_.cache = boost::make_shared<cache_type>(dataset, max_bytes, read_ahead, block_rows);
+    }
+
+    /// Disables the cache (for this proxy only, the slices keep it)
+    void disable_cache () { storage_.cache.reset();}
+
+    /// The cache, or NULL
+    cache_type * cache() const { return storage_.cache.get();}
+
+    /**
+     * Starts loading in the background the data of this proxy (typically a slice that will be read next), 
+     * if the cache is enabled. Does nothing otherwise.
+     */
+    void prefetch () const { 
+     if ((!cache()) || is_empty()) return;
+     const size_t first = indexmap().offsets()[0], last = first + (indexmap().lengths()[0] - 1)* indexmap().strides()[0];
+     if (indexmap().strides()[0] == 1) cache()->prefetch(first, last);
+     else for (size_t i = first; i<= last; i+= indexmap().strides()[0]) cache()->prefetch(i,i);
+    }
 
     typedef typename indexmap_type::domain_type domain_type; 
     domain_type const & domain() const { return indexmap_.domain();}
@@ -96,17 +143,25 @@ namespace triqs { namespace arrays {
       try { 
        BOOST_AUTO(C,  make_const_cache(X, Option::C()));
        //typename result_of::cache<false,Tag::C, ISP >::type C(X);
+       std::lock_guard<std::mutex> lock(details::h5_lock());
        DataSet dataset = file_group()->openDataSet( name().c_str() );
        dataset.write( h5::data(C.view()), h5::data_type_mem(C.view()),h5::data_space(C.view()),indexmap().template dataspace<T_is_complex>()); 
       } 
       TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+      if (cache()) cache()->clear();
      }
 
     template<typename LHS> // from the file to the array or the array_view... 
      friend void triqs_arrays_assign_delegation (LHS & lhs, array_proxy const & rhs)  {
       static_assert((is_amv_value_or_view_class<LHS>::value), "LHS is not a value or a view class "); 
       h5::resize_or_check(lhs,  rhs.indexmap().domain().lengths());
+      if (rhs.cache()) { 
+       BOOST_AUTO(C,  make_cache(lhs, Option::C() ));
+       rhs.cache()->read(rhs.indexmap().lengths(), rhs.indexmap().strides(), rhs.indexmap().offsets(), C.view().data_start());
+       return;
+      }
       try { 
+       std::lock_guard<std::mutex> lock(details::h5_lock());
        DataSet dataset = rhs.file_group()->openDataSet( rhs.name().c_str() );
        BOOST_AUTO(C,  make_cache(lhs, Option::C() ));
        //typename result_of::cache<true,Tag::C, LHS >::type C(lhs);
@@ -77,6 +77,7 @@ namespace triqs { namespace arrays {
      mini_vector<size_t, rank_full> total_lengths() const { return this->total_lens_;}
      mini_vector<size_t, rank_full> lengths() const { return this->lens_;}
      mini_vector<size_t, rank_full> strides() const { return this->stri_;}
+     mini_vector<size_t, rank_full> offsets() const { return this->off_;}
 
     private: 
      mini_vector<hsize_t,rank_full> lens_, off_, stri_; 
@@ -103,7 +104,7 @@ namespace triqs { namespace arrays {
      static void invoke(i_type li, i_type si, os_type lo_c, o_type lo,  o_type so, o_type offset, ArgsTuple const & args ) {
       const int dP = boost::is_base_of<typename boost::tuples::element<N,ArgsTuple>::type, range >::type::value ;
       one_step(li[N], si[N],lo[N],so[N], offset[N] ,boost::tuples::get<N>(args));
-      lo_c[P] = lo[N];
+      if (dP) lo_c[P] = lo[N]; // only the ranges give a dimension of the result
       slice_calc<Rank_in,Rank_out,N+1,P+dP,c-1, BoundCheck>::invoke(li,si,lo_c,lo,so, offset, args);
      }
 
@@ -22,6 +22,11 @@
 #define TRIQS_ARRAYS_H5_STACK_H
 #include "../array.hpp"
 #include "./group_or_file.hpp" 
+#include <boost/noncopyable.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
 
 namespace triqs { namespace arrays { namespace h5 { 
  using namespace H5;
@@ -41,17 +46,33 @@ namespace triqs { namespace arrays { namespace h5 {
   template<typename B> struct get_value_type<B, typename boost::enable_if<is_amv_value_class<B> >::type > { 
    typedef typename B::value_type type;static const size_t rank = B::rank;};
 
+  // the chunks are limited to this size (in bytes)
+  static const size_t max_chunk_bytes = 16*1024*1024;
  }
 
+ /// Options of the array_stack
+ struct array_stack_options { 
+  bool asynchronous; ///< Write the full buffers in a background thread, while the other buffer is filled [default : false]
+  int deflate_level; ///< Level of the deflate (gzip) filter 1-9, 0 for no compression [default : 0]
+  bool shuffle;      ///< Add the shuffle filter before deflate (improves the compression of floating point numbers) [default : false]
+  size_t flush_every;///< Flush the file to the disk after every flush_every buffer writes. 0 : only in flush() and at destruction [default : 0]
+  array_stack_options() : asynchronous(false), deflate_level(0), shuffle(false), flush_every(0) {}
+ };
+
  /**
   *  \brief Hdf5 array stack
   *  \tparam  BaseElementType The type of the base element of the stack. Can be an array/matrix/vector or a scalar.
   *           If it in a scalar, the array_stack will write an hdf5 array of dimension 1
   *           If it in an array/matrix/vector, the array_stack will write an hdf5 array of dimension BaseElementType::rank +1 
   *
+  *  The hdf5 array is chunked along the stacking dimension with the size of the buffer, and can be compressed 
+  *  (cf array_stack_options). In asynchronous mode, the stack has two buffers : when one is full, it is written by 
+  *  a background thread while the other one is filled, so that operator ++ (or <<) only waits if both buffers are full.
+  *  NB : all the HDF5 calls of the array_stacks are serialized with a lock, but in asynchronous mode, 
+  *  the other HDF5 operations done in parallel by the calling code require an HDF5 library compiled thread-safe.
   */
  template< typename BaseElementType>
-  class array_stack {
+  class array_stack : boost::noncopyable {
    typedef BaseElementType base_element_type;
    static_assert( (is_amv_value_class<BaseElementType>::value || is_scalar<BaseElementType>::value), "BaseElementType must be an array/matrix/vector or a simple number");
    typedef typename details::get_value_type<BaseElementType>::type T;
@@ -62,26 +83,49 @@ namespace triqs { namespace arrays { namespace h5 {
    static const unsigned int RANK = dim + 1 + (T_is_complex ? 1 : 0);
    mini_vector<hsize_t,RANK> dims, offset, maxdims, dim_chunk, buffer_dim, zero;
    DataSet dataset;
-   array<T,dim+1> buffer;
+   array_stack_options opt;
+   array<T,dim+1> buffer[2];
+   int current;           // index of the buffer being filled
+   size_t n_writes;       // number of buffers written
+   bool dirty;            // something was written since the last flush of the file
+
+   // the writer thread 
+   std::thread writer;
+   std::mutex mutex;
+   std::condition_variable cond;
+   int pending;           // index of the buffer to be written by the writer, -1 if none
+   size_t pending_size;   // its number of elements
+   bool stop_writer;
+   std::string writer_error;
 
    template <typename FileGroupType >
-    void construct_delegate ( FileGroupType file_or_group, std::string const & name, mini_vector<size_t,dim> const & a_dims, size_t bufsize)  {
-     mini_vector<hsize_t,RANK> dim_chunk;
-     bufsize_ = bufsize; step = 0; _size =0; 
+    void construct_delegate ( FileGroupType file_or_group, std::string const & name, mini_vector<size_t,dim> const & a_dims, size_t bufsize, array_stack_options const & opt_)  {
+     if (bufsize==0) TRIQS_RUNTIME_ERROR << "array_stack : bufsize must be > 0";
+     bufsize_ = bufsize; step = 0; _size =0; opt = opt_; current =0; n_writes =0; dirty = false; 
+     pending = -1; pending_size =0; stop_writer = false;
      for (size_t i =1; i<=dim; ++i) { dims[i] = a_dims[i-1];}
      if (T_is_complex) { dims[RANK-1] =2; }
      maxdims = dims; buffer_dim = dims; dim_chunk = dims;
-     dims[0] = 0; maxdims[0] = H5S_UNLIMITED; dim_chunk[0]=1; buffer_dim[0] = bufsize_;
+     dims[0] = 0; maxdims[0] = H5S_UNLIMITED; buffer_dim[0] = bufsize_;
+     // chunk of the size of the buffer, if not too large
+     size_t slice_bytes = sizeof(typename remove_complex<T>::type);
+     for (size_t i =1; i<RANK; ++i) slice_bytes *= dims[i];
+     dim_chunk[0] = std::max(size_t(1), std::min(bufsize_, details::max_chunk_bytes / std::max(size_t(1),slice_bytes)));
      mini_vector<size_t,dim+1> s; for (size_t i =0; i<=dim; ++i) {s[i] =  buffer_dim[i];} 
-     buffer.resize(s);
-     DataSpace mspace1( RANK, dims.ptr(), maxdims.ptr());
-     DSetCreatPropList cparms; cparms.setChunk( RANK, dim_chunk.ptr() ); // Modify dataset creation properties, i.e. enable chunking.
+     buffer[0].resize(s);
+     if (opt.asynchronous) buffer[1].resize(s);
+     std::lock_guard<std::mutex> lock(details::h5_lock());
      try { 
+      DataSpace mspace1( RANK, dims.ptr(), maxdims.ptr());
+      DSetCreatPropList cparms; cparms.setChunk( RANK, dim_chunk.ptr() ); // Modify dataset creation properties, i.e. enable chunking.
+      if (opt.shuffle) cparms.setShuffle();
+      if (opt.deflate_level>0) cparms.setDeflate(opt.deflate_level);
       if (h5::exists(file_or_group, name.c_str())) file_or_group.unlink( name.c_str());  
       dataset = file_or_group.createDataSet( name.c_str(), native_type_from_C(typename remove_complex<T>::type()), mspace1, cparms );
       if (boost::is_complex<T>::value)  write_attribute(dataset,"__complex__","1");
      }
      TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+     if (opt.asynchronous) writer = std::thread( [this]() { this->writer_loop();} );
     }
 
    public :
@@ -91,29 +135,40 @@ namespace triqs { namespace arrays { namespace h5 {
     *  \param file_or_group The h5 file or group, of type FileGroupType
     *  \param name The name of the hdf5 array in the file/group where the stack will be stored
     *  \param base_element_shape The shape of the base array/matrix/vector [or mini_vector<size_t,0>() for a scalar]
-    *  \param bufsize The size of the bufferThe name of the hdf5 array in the file/group where the stack will be stored
+    *  \param bufsize The size of the buffer (number of elements), which is also the size of the hdf5 chunks
+    *  \param opt Options : asynchronous writing, compression, flush policy 
     *  \exception The HDF5 exceptions will be caught and rethrown as TRIQS_RUNTIME_ERROR (with stackstrace, cf doc). 
     */
    template <typename FileGroupType >
-    array_stack( FileGroupType file_or_group, std::string const & name, mini_vector<size_t,dim> const & base_element_shape, size_t bufsize)  {
-     construct_delegate ( file_or_group, name, base_element_shape, bufsize);
+    array_stack( FileGroupType file_or_group, std::string const & name, mini_vector<size_t,dim> const & base_element_shape, size_t bufsize,
+      array_stack_options const & opt = array_stack_options())  {
+     construct_delegate ( file_or_group, name, base_element_shape, bufsize, opt);
     }
 
    /** 
     * \brief Constructor : valid only if the base is a scalar
     *  \param file_or_group The h5 file or group, of type FileGroupType
     *  \param name The name of the hdf5 array in the file/group where the stack will be stored
-    *  \param bufsize The size of the bufferThe name of the hdf5 array in the file/group where the stack will be stored
+    *  \param bufsize The size of the buffer (number of elements), which is also the size of the hdf5 chunks
+    *  \param opt Options : asynchronous writing, compression, flush policy 
     *  \exception The HDF5 exceptions will be caught and rethrown as TRIQS_RUNTIME_ERROR (with stackstrace, cf doc). 
     */
    template <typename FileGroupType >
-    array_stack( FileGroupType file_or_group, std::string const & name, size_t bufsize)  {
+    array_stack( FileGroupType file_or_group, std::string const & name, size_t bufsize, array_stack_options const & opt = array_stack_options())  {
      static_assert( (is_scalar<BaseElementType>::value), "This constructor is only available for a scalar BaseElementType");
-     construct_delegate ( file_or_group, name,mini_vector<size_t,0>() , bufsize);
+     construct_delegate ( file_or_group, name,mini_vector<size_t,0>() , bufsize, opt);
     }
 
-   ///
-   ~array_stack() {flush();}
+   /** 
+    * Flushes the stack and stops the writer thread. 
+    * The errors can not be thrown from here : they are only reported on std::cerr. Call flush() before to catch them.
+    */
+   ~array_stack() { 
+    try { flush();}
+    catch (std::exception const & e) { std::cerr << "array_stack : error while flushing at destruction : " << e.what() << std::endl;}
+    catch (...) { std::cerr << "array_stack : unknown error while flushing at destruction" << std::endl;}
+    try { join_writer();} catch (...) {} // the writer thread must be joined in any case
+   }
 
    /// The type of the base of the stack (a view or a reference)
    typedef typename boost::mpl::if_c< base_is_array , array_view<T,dim>, T &>::type slice_type;
@@ -122,13 +177,21 @@ namespace triqs { namespace arrays { namespace h5 {
     * \return A view (for an array/matrix/vector base) or a reference (for a scalar base) to the top of the stack
     *         i.e. the next element to be assigned to
     */
-   slice_type operator() () { return details::slice0(buffer, step); } 
+   slice_type operator() () { return details::slice0(buffer[current], step); } 
 
    /// Advance the stack by one
-   void operator++() { ++step; ++_size; if (step==bufsize_) flush();  } 
+   void operator++() { ++step; ++_size; if (step==bufsize_) write_current();  } 
 
-   /// Flush the buffer to the disk. Automatically called at destruction. 
-   void flush() { save_buffer(); step=0;}
+   /**
+    * Flush the buffer to the disk : waits for the writer thread, writes the buffer and flushes the hdf5 file. 
+    * Automatically called at destruction, where the errors are only reported. 
+    */
+   void flush() { 
+    write_current();
+    if (opt.asynchronous) wait_writer();
+    std::lock_guard<std::mutex> lock(details::h5_lock());
+    if (dirty) { H5Fflush(dataset.getId(), H5F_SCOPE_LOCAL); dirty = false;}
+   }
 
    /** 
     * \brief Add a element onto the stack and advance it by one.
@@ -139,18 +202,79 @@ namespace triqs { namespace arrays { namespace h5 {
    /// Current size of the stack
    size_t size() const { return _size;}
 
+   /// Options of the stack
+   array_stack_options const & options() const { return opt;}
+
    private:
-   void save_buffer () {
+
+   // write the current buffer, directly or through the writer, and switch to the other buffer
+   void write_current() { 
     if (step==0) return;
-    dims[0] += step;
-    buffer_dim[0] = step; 
-    dataset.extend(dims.ptr());
-    DataSpace fspace1 = dataset.getSpace (), mspace = data_space(buffer); 
-    fspace1.selectHyperslab( H5S_SELECT_SET, buffer_dim.ptr(), offset.ptr() );
-    mspace.selectHyperslab(  H5S_SELECT_SET, buffer_dim.ptr(), zero.ptr() );
-    try { dataset.write( data(buffer), data_type_mem(buffer), mspace, fspace1 ); }
+    if (!opt.asynchronous) save_buffer(current,step);
+    else { 
+     std::unique_lock<std::mutex> lock(mutex);
+     cond.wait(lock, [this]() { return this->pending <0;}); // the other buffer is free again
+     check_writer_error();
+     pending = current; pending_size = step; 
+     cond.notify_all();
+     current = 1 - current;
+    }
+    step=0;
+   }
+
+   void wait_writer() { 
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this]() { return this->pending <0;});
+    check_writer_error();
+   }
+
+   void check_writer_error() { // mutex is locked
+    if (writer_error.empty()) return;
+    std::string s = writer_error; writer_error.clear();
+    TRIQS_RUNTIME_ERROR << "array_stack : error while writing : " << s;
+   }
+
+   void join_writer() { 
+    if (!writer.joinable()) return;
+    { std::lock_guard<std::mutex> lock(mutex); stop_writer = true; }
+    cond.notify_all();
+    writer.join();
+   }
+
+   void writer_loop() { 
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) { 
+     cond.wait(lock, [this]() { return this->stop_writer || (this->pending >=0);});
+     if (pending <0) return; // stop, nothing left to write
+     int b = pending; size_t n = pending_size; 
+     lock.unlock();
+     std::string err;
+     try { save_buffer(b,n);} 
+     catch (std::exception const & e) { err = e.what();} 
+     catch (...) { err = "unknown error";}
+     lock.lock();
+     if (!err.empty()) writer_error = err;
+     pending = -1; 
+     cond.notify_all();
+    }
+   }
+
+   // write the n first elements of buffer b
+   void save_buffer (int b, size_t n) {
+    std::lock_guard<std::mutex> lock(details::h5_lock());
+    dims[0] += n;
+    buffer_dim[0] = n; 
+    try { 
+     dataset.extend(dims.ptr());
+     DataSpace fspace1 = dataset.getSpace (), mspace = data_space(buffer[b]); 
+     fspace1.selectHyperslab( H5S_SELECT_SET, buffer_dim.ptr(), offset.ptr() );
+     mspace.selectHyperslab(  H5S_SELECT_SET, buffer_dim.ptr(), zero.ptr() );
+     dataset.write( data(buffer[b]), data_type_mem(buffer[b]), mspace, fspace1 ); 
+    }
     TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
-    offset [0] += step;
+    offset [0] += n;
+    dirty = true; ++n_writes;
+    if (opt.flush_every && (n_writes % opt.flush_every ==0)) { H5Fflush(dataset.getId(), H5F_SCOPE_LOCAL); dirty = false;}
    }
   };
 }}} // namespace
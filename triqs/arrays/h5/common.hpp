@@ -25,6 +25,7 @@
 #include "../cache.hpp"
 #include <boost/type_traits/is_complex.hpp>
 #include <boost/utility/enable_if.hpp>
+#include <mutex>
 
 namespace triqs { namespace arrays { namespace h5 { 
  using namespace H5;
@@ -158,6 +159,12 @@ namespace triqs { namespace arrays { namespace h5 {
   myatt_in.write(strdatatype, (void *)(value.c_str()));
  } 
 
+ namespace details { 
+  // The HDF5 calls which may run in a background thread (array_stack writer, array_proxy prefetch) and the ones 
+  // they can overlap with are serialized with this lock, since the HDF5 library is in general not compiled thread-safe.
+  inline std::mutex & h5_lock() { static std::mutex m; return m;}
+ }
+
 #define TRIQS_ARRAYS_H5_CATCH_EXCEPTION \
  catch( triqs::runtime_error error)  { throw triqs::runtime_error() << error.what();}\
  catch( FileIException error ) { error.printError(); TRIQS_RUNTIME_ERROR<<"H5 File error"; }\
@@ -0,0 +1,277 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef TRIQS_ARRAYS_H5_PARALLEL_H
+#define TRIQS_ARRAYS_H5_PARALLEL_H
+#include "./simple_read_write.hpp"
+#include "./array_stack.hpp"
+#include "../mpi/common.hpp"
+
+#ifndef H5_HAVE_PARALLEL
+#error "triqs/arrays/h5/parallel.hpp requires an HDF5 library compiled with MPI (parallel HDF5)"
+#endif
+
+/*
+ * Collective writing/reading of arrays and stacks with parallel HDF5 (MPI-IO) : 
+ * the file is opened by all the nodes of a communicator, and each node writes/reads its part of the dataset. 
+ * All the functions below are collective : they must be called by all the nodes, with the same names.
+ */
+namespace triqs { namespace arrays { namespace h5 { namespace mpi { 
+
+ /**
+  * \brief Open (or create) an hdf5 file on all the nodes of the communicator c, with the MPI-IO driver.
+  * \param flags As for H5::H5File (H5F_ACC_TRUNC, H5F_ACC_RDONLY, ...)
+  */
+ inline H5File open_file (boost::mpi::communicator const & c, std::string const & name, unsigned int flags) { 
+  try { 
+   FileAccPropList fapl;
+   H5Pset_fapl_mpio(fapl.getId(), c, MPI_INFO_NULL);
+   return H5File(name.c_str(), flags, FileCreatPropList::DEFAULT, fapl);
+  }
+  TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+ }
+
+ namespace details { 
+
+  // the collective transfer property list
+  inline DSetMemXferPropList collective_transfer() { 
+   DSetMemXferPropList r; H5Pset_dxpl_mpio(r.getId(), H5FD_MPIO_COLLECTIVE); return r;
+  }
+
+  // the same value on all nodes ? (decided on all nodes, so that they throw together)
+  inline bool same_on_all_nodes (boost::mpi::communicator const & c, unsigned long long x) { 
+   unsigned long long mm[2] = {x, ~x}, r[2];
+   MPI_Allreduce(mm, r, 2, MPI_UNSIGNED_LONG_LONG, MPI_MAX, c);
+   return (r[0] == ~r[1]);
+  }
+
+  // (total number of rows, first row of this node) for the rows of n nodes placed in the order of the ranks
+  inline std::pair<hsize_t,hsize_t> place_rows (boost::mpi::communicator const & c, size_t n) { 
+   unsigned long long x = n, tot, first = 0;
+   MPI_Allreduce(&x, &tot, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, c);
+   MPI_Exscan(&x, &first, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, c);
+   if (c.rank()==0) first = 0; // MPI_Exscan leaves it undefined on the first node
+   return std::make_pair(hsize_t(tot), hsize_t(first));
+  }
+
+  // the dataspace of the n first rows of a contiguous array (a node with no row selects nothing)
+  template <typename ArrayType> DataSpace rows_space (ArrayType const & A, size_t n) { 
+   DataSpace r = data_space(A);
+   if (n==0) { r.selectNone(); return r;}
+   const int R = r.getSimpleExtentNdims();
+   std::vector<hsize_t> L(R), zero(R,0); 
+   r.getSimpleExtentDims(&L[0]); L[0] = n;
+   r.selectHyperslab(H5S_SELECT_SET, &L[0], &zero[0]);
+   return r;
+  }
+
+  // a pointer to the data, valid also for an empty array
+  template <typename ArrayType> void * data_or_dummy (ArrayType const & A) { 
+   static double dummy; 
+   return (A.indexmap().domain().number_of_elements() ? data(A) : (void *)(&dummy));
+  }
+ }
+
+ /**
+  * \brief Write the rows (first index) of A on all the nodes, in the order of the ranks, as one dataset.
+  * The result is the same as triqs::arrays::mpi::gather followed by h5::write_array on one node, 
+  * but each node writes its own rows, and nothing is gathered.
+  * The nodes can have different numbers of rows (possibly 0), the other lengths must be the same on all nodes.
+  * \exception The HDF5 exceptions will be caught and rethrown as TRIQS_RUNTIME_ERROR (with a full stackstrace, cf triqs doc).
+  */
+ template <typename ArrayType>
+  void h5_write (boost::mpi::communicator const & c, group_or_file f, std::string const & name, ArrayType const & A) {
+   typedef typename ArrayType::value_type V;
+   static const unsigned int R = ArrayType::rank;
+   static const bool is_complex = boost::is_complex<V>::value;
+   mini_vector<size_t,R> L = A.indexmap().domain().lengths();
+   for (size_t u=1; u<R; ++u) 
+    if (!details::same_on_all_nodes(c, L[u])) TRIQS_RUNTIME_ERROR << "h5::mpi::h5_write : the arrays of "<< name << " have different shapes on the nodes";
+   std::pair<hsize_t,hsize_t> tot_first = details::place_rows(c, L[0]);
+   mini_vector<hsize_t,R> Ltot, Lloc, S, offset; 
+   for (size_t u=0; u<R; ++u) { Ltot[u] = Lloc[u] = L[u]; S[u] = 1;}
+   Ltot[0] = tot_first.first; offset[0] = tot_first.second;
+   BOOST_AUTO(C, make_const_cache(A,Option::C()));
+   try {
+    if (h5::exists(f, name)) f->unlink( name.c_str()); 
+    DataSpace fspace = dataspace_from_LS<R,is_complex>(Ltot, Ltot, S);
+    DataSet ds = f->createDataSet( name.c_str(), data_type_file(V()), fspace);
+    if (L[0]>0) fspace = dataspace_from_LS<R,is_complex>(Ltot, Lloc, S, offset); else fspace.selectNone();
+    ds.write( details::data_or_dummy(C.view()), data_type_mem(A), details::rows_space(C.view(), L[0]), fspace, details::collective_transfer());
+    if (is_complex) write_attribute(ds,"__complex__","1");
+   }
+   TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+  }
+
+ /**
+  * \brief Read the dataset on all the nodes : each node reads a slice of rows (first index), 
+  * with the same distribution as triqs::arrays::mpi::scatter. 
+  * A is resized (or checked for a view) to the shape of the slice. 
+  * \exception The HDF5 exceptions will be caught and rethrown as TRIQS_RUNTIME_ERROR (with a full stackstrace, cf triqs doc).
+  */
+ template <typename ArrayType>
+  void h5_read (boost::mpi::communicator const & c, group_or_file f, std::string const & name, ArrayType & A) {
+   typedef typename ArrayType::value_type V;
+   static const unsigned int R = ArrayType::rank;
+   static const bool is_complex = boost::is_complex<V>::value;
+   if (!h5::exists(f, name))  TRIQS_RUNTIME_ERROR << "no such dataset : "<<name <<" in file ";
+   try {
+    DataSet ds = f->openDataSet( name.c_str() );
+    DataSpace fspace = ds.getSpace();
+    static const int Rank = R + (is_complex ? 1 : 0);
+    int rank = fspace.getSimpleExtentNdims();
+    if (rank != Rank) TRIQS_RUNTIME_ERROR << "triqs::array::h5::mpi::read. Rank mismatch : the array has rank = "
+     <<Rank<<" while the array stored in the hdf5 file has rank = "<<rank;
+    mini_vector<hsize_t,Rank> dims_out;
+    fspace.getSimpleExtentDims( &dims_out[0], NULL);
+    std::pair<int,int> mine = triqs::arrays::mpi::slice_rows(dims_out[0], c.size(), c.rank());
+    mini_vector<size_t,R> d2; for (size_t u=0; u<R ; ++u) d2[u] = dims_out[u];
+    d2[0] = mine.first;
+    resize_or_check(A, d2);
+    mini_vector<hsize_t,R> Ltot, Lloc, S, offset; 
+    for (size_t u=0; u<R; ++u) { Ltot[u] = Lloc[u] = dims_out[u]; S[u] = 1;}
+    Lloc[0] = mine.first; offset[0] = mine.second;
+    if (mine.first>0) fspace = dataspace_from_LS<R,is_complex>(Ltot, Lloc, S, offset); else fspace.selectNone();
+    BOOST_AUTO(C, make_cache(A, Option::C()));
+    ds.read( details::data_or_dummy(C.view()), data_type_mem(C.view()), details::rows_space(C.view(), mine.first), fspace, details::collective_transfer());
+   }
+   TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+  }
+
+ /**
+  *  \brief Hdf5 array stack written by all the nodes of a communicator.
+  *  \tparam BaseElementType As for h5::array_stack.
+  *
+  *  Each node piles up its elements in memory, at its own pace : the nodes may advance the stack a different 
+  *  number of times. Nothing is written before flush(), which is collective : the elements of all the nodes 
+  *  are appended to the dataset in the order of the ranks (the offsets come from an MPI_Exscan), each node writing 
+  *  its own part, without any communication of the data. The dataset has the shape (size of the stack, shape of the base), 
+  *  as if the elements had been gathered on one node at each flush().
+  *  The destructor does no I/O (it is not collective) : the elements not flushed are lost, with a warning.
+  *  NB : contrary to h5::array_stack, there is no compression and no background writer.
+  */
+template< typename BaseElementType>
+ class array_stack : boost::noncopyable {
+  static_assert( (is_amv_value_class<BaseElementType>::value || is_scalar<BaseElementType>::value), "BaseElementType must be an array/matrix/vector or a simple number");
+  typedef typename h5::details::get_value_type<BaseElementType>::type T;
+  static const size_t dim = h5::details::get_value_type<BaseElementType>::rank; 
+  static const bool base_is_array = dim >0;
+  static const bool T_is_complex = boost::is_complex<T>::value;
+  static const unsigned int RANK = dim + 1 + (T_is_complex ? 1 : 0);
+  boost::mpi::communicator comm;
+  size_t step, _size; 
+  mini_vector<hsize_t,RANK> dims, offset, maxdims, dim_chunk, buffer_dim;
+  DataSet dataset;
+  array<T,dim+1> buffer;
+
+  void construct_delegate (group_or_file f, std::string const & name, mini_vector<size_t,dim> const & a_dims, size_t bufsize)  {
+   if (bufsize==0) TRIQS_RUNTIME_ERROR << "h5::mpi::array_stack : bufsize must be > 0";
+   if (!details::same_on_all_nodes(comm, bufsize)) TRIQS_RUNTIME_ERROR << "h5::mpi::array_stack : the nodes have different bufsize";
+   for (size_t i =0; i<dim; ++i) 
+    if (!details::same_on_all_nodes(comm, a_dims[i])) TRIQS_RUNTIME_ERROR << "h5::mpi::array_stack : the nodes have different shapes";
+   step = 0; _size =0; 
+   for (size_t i =1; i<=dim; ++i) { dims[i] = a_dims[i-1];}
+   if (T_is_complex) { dims[RANK-1] =2; }
+   maxdims = dims; buffer_dim = dims; dim_chunk = dims;
+   dims[0] = 0; maxdims[0] = H5S_UNLIMITED; 
+   dim_chunk[0] = bufsize; 
+   mini_vector<size_t,dim+1> s; s[0] = bufsize; for (size_t i =1; i<=dim; ++i) {s[i] =  a_dims[i-1];} 
+   buffer.resize(s);
+   try { 
+    DataSpace mspace1( RANK, dims.ptr(), maxdims.ptr());
+    DSetCreatPropList cparms; cparms.setChunk( RANK, dim_chunk.ptr() ); 
+    if (h5::exists(f, name.c_str())) f->unlink( name.c_str());  
+    dataset = f->createDataSet( name.c_str(), native_type_from_C(typename remove_complex<T>::type()), mspace1, cparms );
+    if (T_is_complex)  write_attribute(dataset,"__complex__","1");
+   }
+   TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+  }
+
+  public :
+
+  /** 
+   * \brief Constructor (collective)
+   *  \param c The communicator (the file must have been opened with h5::mpi::open_file on the same nodes)
+   *  \param f The h5 file or group
+   *  \param name The name of the hdf5 array in the file/group where the stack will be stored
+   *  \param base_element_shape The shape of the base array/matrix/vector [or mini_vector<size_t,0>() for a scalar]
+   *  \param bufsize The initial size of the buffer (number of elements), which is also the size of the hdf5 chunks
+   */
+  array_stack (boost::mpi::communicator const & c, group_or_file f, std::string const & name, mini_vector<size_t,dim> const & base_element_shape, size_t bufsize) : comm(c) {
+   construct_delegate (f, name, base_element_shape, bufsize);
+  }
+
+  /// Constructor (collective) : valid only if the base is a scalar
+  array_stack (boost::mpi::communicator const & c, group_or_file f, std::string const & name, size_t bufsize) : comm(c) {
+   static_assert( (is_scalar<BaseElementType>::value), "This constructor is only available for a scalar BaseElementType");
+   construct_delegate (f, name, mini_vector<size_t,0>(), bufsize);
+  }
+
+  /// Not collective, hence no I/O : call flush() on all the nodes before.
+  ~array_stack() { 
+   if (step>0) std::cerr << "h5::mpi::array_stack : destroyed with "<< step << " elements not written on node "<< comm.rank()
+    << " (flush() must be called on all the nodes before the destruction)" << std::endl;
+  }
+
+  /// The type of the base of the stack (a view or a reference)
+  typedef typename boost::mpl::if_c< base_is_array , array_view<T,dim>, T &>::type slice_type;
+
+  /// The top of the stack, i.e. the next element to be assigned to
+  slice_type operator() () { return h5::details::slice0(buffer, step); } 
+
+  /// Advance the stack by one (not collective). When the buffer is full, it grows : only flush() writes.
+  void operator++() { ++step; ++_size; if (step==buffer.shape()[0]) grow_buffer();  } 
+
+  /// Write the elements of all the nodes and flush the file (collective). 
+  void flush() { 
+   std::pair<hsize_t,hsize_t> tot_first = details::place_rows(comm, step);
+   if (tot_first.first==0) return; // on all nodes
+   offset[0] = dims[0] + tot_first.second;
+   dims[0] += tot_first.first;
+   buffer_dim[0] = step; 
+   try { 
+    dataset.extend(dims.ptr());
+    DataSpace fspace = dataset.getSpace ();
+    if (step>0) fspace.selectHyperslab( H5S_SELECT_SET, buffer_dim.ptr(), offset.ptr() ); else fspace.selectNone();
+    dataset.write( data(buffer), data_type_mem(buffer), details::rows_space(buffer, step), fspace, details::collective_transfer()); 
+   }
+   TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+   H5Fflush(dataset.getId(), H5F_SCOPE_LOCAL);
+   step = 0;
+  }
+
+  /// S << A is equivalent to S() = A; ++S;
+  template<class AType> void operator << ( AType const & A) { (*this)() = A; ++(*this);}
+  
+  /// Current size of the stack on this node (flushed or not)
+  size_t size() const { return _size;}
+
+  private:
+  // double the buffer, keeping the step first elements
+  void grow_buffer() { 
+   array<T,dim+1> old(buffer);
+   mini_vector<size_t,dim+1> s = buffer.shape(); s[0] *= 2;
+   buffer.resize(s);
+   std::copy(old.data_start(), old.data_start() + old.num_elements(), buffer.data_start());
+  }
+ };
+
+}}}}
+#endif
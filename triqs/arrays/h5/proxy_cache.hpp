@@ -0,0 +1,209 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef TRIQS_ARRAYS_H5_PROXY_CACHE_H
+#define TRIQS_ARRAYS_H5_PROXY_CACHE_H
+#include "../array.hpp"
+#include "./common.hpp"
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <future>
+#include <mutex>
+#include <list>
+#include <map>
+
+namespace triqs { namespace arrays { namespace h5 { 
+
+ /**
+  * In-process cache of a dataset for the array_proxy (cf array_proxy::enable_cache).
+  *
+  * The unit of the cache is a block of rows (first index), all the other indices complete, 
+  * aligned on the hdf5 chunks if the dataset is chunked. 
+  * The blocks are kept up to a total of max_bytes, the least recently used being evicted first.
+  * Blocks can be loaded asynchronously (prefetch), by a background task : all the HDF5 calls of the cache are 
+  * serialized with h5::details::h5_lock().
+  */
+ template<typename V, int Rf> class proxy_cache : boost::noncopyable { 
+  public : 
+   typedef array<V,Rf> block_type;
+   typedef boost::shared_ptr<const block_type> block_ptr;
+   typedef mini_vector<size_t,Rf> v_type;
+   static const bool T_is_complex = boost::is_complex<V>::value;
+
+   /// hits, misses (loaded on demand), prefetched (loaded in the background) and evicted blocks
+   struct statistics_type { size_t hits, misses, prefetched, evicted; statistics_type() : hits(0), misses(0), prefetched(0), evicted(0){} };
+
+   /**
+    * \param ds The dataset
+    * \param max_bytes The maximal size of the blocks kept in memory (at least one block is kept)
+    * \param read_ahead When the slices are read sequentially along the first index, the read_ahead next blocks are prefetched
+    * \param block_rows Number of rows of a block. 0 : the size of the hdf5 chunks along the first index if the dataset is chunked, 
+    *        else about 1 MB.
+    */
+   proxy_cache (DataSet const & ds, size_t max_bytes, size_t read_ahead, size_t block_rows = 0) : 
+    dataset(ds), max_bytes_(max_bytes), read_ahead_(read_ahead), bytes(0), last_block(-1) { 
+     std::lock_guard<std::mutex> lock(details::h5_lock());
+     try { 
+      DataSpace space = dataset.getSpace();
+      hsize_t L[Rf+1]; space.getSimpleExtentDims(L);
+      for (int d=0; d<Rf; ++d) lengths[d] = L[d];
+      if (block_rows==0) { 
+       DSetCreatPropList cparms = dataset.getCreatePlist();
+       if (cparms.getLayout() == H5D_CHUNKED) { hsize_t C[Rf+1]; cparms.getChunk(Rf + (T_is_complex ? 1 : 0), C); block_rows = C[0];}
+      }
+     }
+     TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+     row_size = 1; 
+     for (int d=Rf-1; d>=0; --d) { row_stride[d] = row_size; if (d>0) row_size *= lengths[d];}
+     if (block_rows==0) block_rows = std::max(size_t(1), (size_t(1)<<20) / std::max(size_t(1),row_size * sizeof(V)));
+     block_rows_ = block_rows;
+    }
+
+   ~proxy_cache() { clear();}
+
+   size_t block_rows() const { return block_rows_;}
+   size_t max_bytes() const { return max_bytes_;}
+   size_t bytes_in_cache() const { std::lock_guard<std::mutex> lock(mutex); return bytes;}
+   statistics_type statistics() const { std::lock_guard<std::mutex> lock(mutex); return stats;}
+
+   /// Removes all the blocks (waits for the loads in progress)
+   void clear() { 
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto & x : blocks) // a deferred load has not started
+     if (x.second.data.wait_for(std::chrono::seconds(0)) != std::future_status::deferred) x.second.data.wait();
+    blocks.clear(); lru.clear(); bytes = 0; last_block = -1;
+   }
+
+   /**
+    * Reads the selection of lengths L, strides S, offset O (in the dataset) into out, in C order.
+    * If the rows are read in sequence, the next blocks are prefetched. 
+    */
+   void read (v_type const & L, v_type const & S, v_type const & O, V * out) { 
+    for (int d=0; d<Rf; ++d) if (L[d]==0) return;
+    size_t current = size_t(-1); block_ptr blk; 
+    for (size_t k =0; k<L[0]; ++k) { 
+     const size_t i = O[0] + k*S[0], b = i/block_rows_;
+     if (b != current) { blk = get(b); current = b;}
+     V const * row = blk->data_start() + (i - b*block_rows_)*row_size;
+     if (Rf==1) *out++ = *row; else copy(row, 1, L, S, O, out);
+    }
+    if (!read_ahead_) return;
+    // the read ahead is loaded while the caller uses this slice (and is more recent than it in the cache)
+    const size_t b_first = O[0]/block_rows_, b_last = (O[0] + (L[0]-1)*S[0])/block_rows_;
+    std::lock_guard<std::mutex> lock(mutex);
+    const bool sequential = (last_block>=0) && ((long(b_first) == last_block) || (long(b_first) == last_block +1));
+    last_block = b_last;
+    if (sequential) for (size_t b = b_last+1; b<= b_last + read_ahead_; ++b) find_or_launch(b,true);
+   }
+
+   /// Starts loading asynchronously the blocks containing the rows [first_row, last_row] (if they are not in the cache)
+   void prefetch (size_t first_row, size_t last_row) { 
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t b = first_row/block_rows_; b<= last_row/block_rows_; ++b) find_or_launch(b,true);
+   }
+
+  private:
+   DataSet dataset;
+   v_type lengths, row_stride;
+   size_t row_size, block_rows_, max_bytes_, read_ahead_, bytes;
+   long last_block;
+   typedef std::list<size_t> lru_type; 
+   lru_type lru; // the blocks, most recently used first
+   struct entry { std::shared_future<block_ptr> data; typename lru_type::iterator pos; size_t bytes;};
+   std::map<size_t, entry> blocks; // declared after the dataset : destroyed first
+   mutable std::mutex mutex; // protects the blocks, the lru, bytes, last_block and stats
+   statistics_type stats;
+
+   size_t n_blocks() const { return (lengths[0] + block_rows_ -1)/block_rows_;}
+
+   // reads the block b from the file
+   block_ptr load (size_t b) const { 
+    v_type L = lengths, O; 
+    O[0] = b*block_rows_; L[0] = std::min(block_rows_, lengths[0] - O[0]);
+    boost::shared_ptr<block_type> r = boost::make_shared<block_type>(indexmaps::cuboid_domain<Rf>(L));
+    v_type S; for (int d=0; d<Rf; ++d) S[d]=1; 
+    std::lock_guard<std::mutex> lock(details::h5_lock());
+    try { 
+     mini_vector<hsize_t,Rf> Lt, Ll, Sh, Oh; 
+     for (int d=0; d<Rf; ++d) { Lt[d] = lengths[d]; Ll[d] = L[d]; Sh[d] = 1; Oh[d] = O[d];}
+     dataset.read( data(*r), data_type_mem(*r), data_space(*r), dataspace_from_LS<Rf,T_is_complex>(Lt,Ll,Sh,Oh));
+    }
+    TRIQS_ARRAYS_H5_CATCH_EXCEPTION;
+    return r;
+   }
+
+   // the block b, from the cache or loaded now
+   block_ptr get (size_t b) { 
+    std::shared_future<block_ptr> f;
+    { std::lock_guard<std::mutex> lock(mutex); f = find_or_launch(b,false);}
+    try { return f.get();}
+    catch(...) { // do not keep the failed load in the cache
+     std::lock_guard<std::mutex> lock(mutex);
+     typename std::map<size_t,entry>::iterator it = blocks.find(b);
+     if (it != blocks.end()) { bytes -= it->second.bytes; lru.erase(it->second.pos); blocks.erase(it);}
+     throw;
+    }
+   }
+
+   // the future of block b. If not in the cache, load it (in the background if async, else at the first get). mutex is locked.
+   std::shared_future<block_ptr> find_or_launch (size_t b, bool async) { 
+    typename std::map<size_t,entry>::iterator it = blocks.find(b);
+    if (it != blocks.end()) { 
+     if (!async) ++stats.hits;
+     lru.splice(lru.begin(), lru, it->second.pos);
+     return it->second.data;
+    }
+    if (b>= n_blocks()) return std::shared_future<block_ptr>();
+    if (async) ++stats.prefetched; else ++stats.misses;
+    entry e;
+    e.data = std::async( (async ? std::launch::async : std::launch::deferred), [this,b]() { return this->load(b);}).share();
+    e.bytes = std::min(block_rows_, lengths[0] - b*block_rows_) * row_size * sizeof(V);
+    lru.push_front(b); e.pos = lru.begin();
+    bytes += e.bytes;
+    blocks[b] = e;
+    evict();
+    return e.data;
+   }
+
+   // evicts the least recently used blocks (already loaded) while the cache is too large, keeping the most recent one.
+   void evict () { 
+    typename lru_type::iterator it = lru.end(); 
+    while ((bytes > max_bytes_) && (it != lru.begin())) { 
+     --it; 
+     if (it == lru.begin()) break;
+     entry & e = blocks[*it];
+     if (e.data.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) continue; // loading in the background
+     bytes -= e.bytes; ++stats.evicted;
+     blocks.erase(*it); it = lru.erase(it);
+    }
+   }
+
+   // copy the selection of the dimensions d, ... of a row into out
+   void copy (V const * p, int d, v_type const & L, v_type const & S, v_type const & O, V * & out) const { 
+    p += O[d]*row_stride[d];
+    const std::ptrdiff_t s = S[d]*row_stride[d];
+    if (d==Rf-1) { for (size_t k=0; k<L[d]; ++k, p+=s) *out++ = *p; return;}
+    for (size_t k=0; k<L[d]; ++k, p+=s) copy(p, d+1, L, S, O, out);
+   }
+ };
+
+}}}
+#endif
@@ -23,6 +23,7 @@
 #define TRIQS_ARRAYS_ASSIGN2_H_
 #include "iterator_adapter.hpp"
 #include "../indexmaps/cuboid/foreach.hpp"
+#include "./flat_evaluation.hpp"
 
 // two ways of doing things... optimal one depends on compiler !
 #define TRIQS_ARRAYS_ASSIGN_ISP_WITH_FOREACH
@@ -56,6 +57,44 @@ namespace triqs { namespace arrays {
   template<typename A,typename B> struct _ops_ <A,B,'M'> { static void invoke (A & a, B const & b) { a*=b;} };
   template<typename A,typename B> struct _ops_ <A,B,'D'> { static void invoke (A & a, B const & b) { a/=b;} };
 
+  /*
+   * Fast path : if the lhs is contiguous and the rhs can be evaluated in its memory order (cf flat_evaluation.hpp), 
+   * a plain 1d loop, which the compiler can vectorize. Returns false if not possible.
+   * p is not restrict : the rhs may contain the lhs itself (e.g. A = A + B).
+   */
+  template<char OP, typename LHS, typename RHS> 
+   typename boost::enable_if_c<flat_evaluation<RHS>::value, bool>::type 
+   flat_assign (LHS & lhs, RHS const & rhs) { 
+    typedef typename boost::remove_const<typename LHS::value_type>::type value_type;
+    if (!flat_evaluation_possible(lhs,rhs)) return false;
+    const typename flat_evaluation<RHS>::type e(rhs);
+    value_type * p = const_cast<value_type *>(lhs.data_start());
+    const std::ptrdiff_t N = lhs.indexmap().domain().number_of_elements();
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#pragma omp parallel for if (indexmaps::foreach_in_parallel(lhs))
+#endif
+    for (std::ptrdiff_t n=0; n<N; ++n) _ops_<value_type, typename RHS::value_type, OP>::invoke(p[n], e(n));
+    return true;
+   }
+
+  template<char OP, typename LHS, typename RHS> 
+   typename boost::disable_if_c<flat_evaluation<RHS>::value, bool>::type 
+   flat_assign (LHS &, RHS const &) { return false;}
+
+  // same for a scalar rhs
+  template<char OP, typename LHS, typename RHS> 
+   bool flat_assign_scalar (LHS & lhs, RHS const & rhs) { 
+    typedef typename boost::remove_const<typename LHS::value_type>::type value_type;
+    if (!lhs.indexmap().is_contiguous()) return false;
+    value_type * restrict p = const_cast<value_type *>(lhs.data_start());
+    const std::ptrdiff_t N = lhs.indexmap().domain().number_of_elements();
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#pragma omp parallel for if (indexmaps::foreach_in_parallel(lhs))
+#endif
+    for (std::ptrdiff_t n=0; n<N; ++n) _ops_<value_type, RHS, OP>::invoke(p[n], rhs);
+    return true;
+   }
+
   // RHS is considered to be an indexmap_storage_pair if it is one, ... except if it is the scalar type of hte LHS
   // think about an Array< Array<T,2> > e.g.
   template<class RHS,class LHS> struct is_isp : 
@@ -101,7 +140,7 @@ namespace triqs { namespace arrays {
       iterator_adapter<false, IT, typename LHS::storage_type > it_lhs(lhs.indexmap(),lhs.storage());
       for (;it_lhs; ++it_lhs, ++it_rhs) { assert(it_rhs);  _ops_<value_type, typename RHS::value_type, OP>::invoke(*it_lhs , *it_rhs); }
 #else
-      indexmaps::foreach(*this,lhs); 
+      if (!flat_assign<OP>(lhs,rhs)) indexmaps::parallel_foreach(*this,lhs); 
 #endif
      }
     }
@@ -118,8 +157,9 @@ namespace triqs { namespace arrays {
      assign_impl(LHS & lhs_, const RHS & rhs_): lhs(lhs_), rhs(rhs_) {}
      void operator()(value_type & p, index_value_type const & key) const {  _ops_<value_type, typename RHS::value_type, OP>::invoke(p,rhs[key]);}
      void invoke() { 
+      if (flat_assign<OP>(lhs,rhs)) return;
 #ifdef TRIQS_ARRAYS_ASSIGN_ISP_WITH_FOREACH 
-      indexmaps::foreach(*this,lhs); 
+      indexmaps::parallel_foreach(*this,lhs); 
 #else
       typename LHS::storage_type & S(lhs.storage());
       for (typename LHS::indexmap_type::iterator it(lhs.indexmap());it; ++it)  _ops_<value_type, typename RHS::value_type, OP>::invoke(S[*it] , rhs[it.indices()] );  
@@ -139,8 +179,9 @@ namespace triqs { namespace arrays {
      assign_impl(LHS & lhs_, const RHS & rhs_): lhs(lhs_), rhs(rhs_) {}
      void operator()(value_type & p, index_value_type const & key) const {_ops_<value_type, RHS, OP>::invoke(p, rhs);}
      void invoke() {  
+      if (flat_assign_scalar<OP>(lhs,rhs)) return; // if contiguous : plain loop else foreach...
 #ifdef TRIQS_ARRAYS_ASSIGN_ISP_WITH_FOREACH 
-      indexmaps::foreach(*this,lhs);  // if contiguous : plain loop else foreach...
+      indexmaps::parallel_foreach(*this,lhs);
 #else
       typename LHS::storage_type & S(lhs.storage());
       for (typename LHS::indexmap_type::iterator it(lhs.indexmap());it; ++it)   _ops_<value_type, RHS, OP>::invoke(S[*it], rhs);  
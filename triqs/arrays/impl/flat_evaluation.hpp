@@ -0,0 +1,189 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef TRIQS_ARRAYS_IMPL_FLAT_EVALUATION_H
+#define TRIQS_ARRAYS_IMPL_FLAT_EVALUATION_H
+#include <boost/type_traits/is_base_of.hpp>
+#include <boost/type_traits/remove_const.hpp>
+#include <boost/mpl/has_xxx.hpp>
+#include <triqs/utility/proto/tools.hpp>
+#include "./common.hpp"
+
+namespace triqs { namespace arrays {
+
+ template<typename Expr> struct array_expr;
+ template<typename Expr> struct matrix_expr;
+ template<typename Expr> struct vector_expr;
+
+ /**
+  * Evaluation of an immutable array x element by element, in the memory order of a contiguous array (the target).
+  *  - flat_evaluation<X>::value : can X be evaluated in this way ? (compile time)
+  *  - flat_evaluation<X>::compatible(x,target) : do all the arrays in x have the layout of the target 
+  *    (same lengths and strides), without overlapping it partially ? (run time)
+  *  - flat_evaluation<X>::type : a light evaluator constructed from x. e(n) is the value of x at the n-th element in memory of the target. 
+  * It is implemented for the arrays, matrices, vectors and their views, for the +,-, negation, and the * and / by a scalar
+  * in the expressions (array_expr, matrix_expr, vector_expr) and for the mapped functions (map, abs, exp, ...).
+  * It is used by the assignment to run a plain 1d loop, which the compiler can vectorize.
+  * The target may appear in x (e.g. A = 2*A + B) : the pointers are therefore not restrict. The n-th element of the target 
+  * is written after the n-th elements of x are read, so the loop is correct, and the compiler vectorizes it 
+  * after a run time check of the overlap.
+  */
+ template<typename X, typename Enable = void> struct flat_evaluation { static const bool value = false;};
+
+ /// The layout of the target of the flat evaluation
+ template<typename IndexMap> struct flat_target { 
+  IndexMap const & indexmap; const char * begin, * end;
+  template<typename T> flat_target(IndexMap const & im, T const * p) : 
+   indexmap(im), begin(reinterpret_cast<const char *>(p)), end(reinterpret_cast<const char *>(p + im.domain().number_of_elements())) {}
+ };
+
+ // arrays, matrices, vectors and their views 
+ template<typename X> struct flat_evaluation<X, typename boost::enable_if<boost::is_base_of<Tag::indexmap_storage_pair,X> >::type> { 
+  static const bool value = true;
+  typedef typename boost::remove_const<typename X::value_type>::type value_type;
+  template<typename IM> static bool compatible (X const & x, flat_target<IM> const & t) { 
+   const char * b = reinterpret_cast<const char *>(x.data_start());
+   const char * e = reinterpret_cast<const char *>(x.data_start() + x.indexmap().domain().number_of_elements());
+   return ( (x.indexmap().lengths() == t.indexmap.lengths()) && (x.indexmap().strides() == t.indexmap.strides()) 
+     && ( (b == t.begin) || (e <= t.begin) || (b >= t.end) ) ); // x is the target itself or does not overlap it
+  }
+  struct type { 
+   value_type const * p; // may be the target : not restrict
+   type(X const & x) : p(x.data_start()) {}
+   value_type const & operator()(std::ptrdiff_t n) const { return p[n];}
+  };
+ };
+
+ namespace flat_details { 
+  BOOST_MPL_HAS_XXX_TRAIT_DEF(flat_evaluation_type);
+ }
+
+ // other immutable arrays (e.g. the mapped functions) can provide their own flat_evaluation_type
+ template<typename X> struct flat_evaluation<X, typename boost::enable_if<flat_details::has_flat_evaluation_type<X> >::type> : X::flat_evaluation_type {};
+
+ // ------------  expressions of the algebras  -------------------------
+
+ namespace flat_details { 
+
+  namespace proto = boost::proto; namespace tup = triqs::utility::proto; 
+
+  struct ScalarLeaf : proto::and_< proto::terminal<proto::_>, proto::if_<tup::is_in_ZRC<proto::_value>()> > {}; 
+
+  template<typename X, long N> struct child { typedef typename tup::remove_const_and_ref<typename proto::result_of::child_c<X const &, N>::type>::type type;};
+  template<typename X> struct value_of { typedef typename tup::remove_const_and_ref<typename proto::result_of::value<X const &>::type>::type type;};
+
+  template<typename Tag> struct op;
+  template<> struct op<proto::tag::plus>       { template<typename R, typename A, typename B> static R invoke(A const & a, B const & b) { return a + b;} };
+  template<> struct op<proto::tag::minus>      { template<typename R, typename A, typename B> static R invoke(A const & a, B const & b) { return a - b;} };
+  template<> struct op<proto::tag::multiplies> { template<typename R, typename A, typename B> static R invoke(A const & a, B const & b) { return a * b;} };
+  template<> struct op<proto::tag::divides>    { template<typename R, typename A, typename B> static R invoke(A const & a, B const & b) { return a / b;} };
+
+  // Broadcast : is a scalar in a sum the constant array (array_expr) or not (it is the identity for matrix_expr)
+  template<typename X, bool Broadcast, typename Tag = typename proto::tag_of<X>::type> struct node { static const bool value = false;};
+
+  template<typename X> struct scalar_leaf { 
+   static const bool value = true;
+   typedef typename value_of<X>::type value_type;
+   template<typename T> static bool compatible (X const &, T const &) { return true;}
+   struct type { 
+    value_type s;
+    type(X const & x) : s(proto::value(x)) {}
+    value_type operator()(std::ptrdiff_t) const { return s;}
+   };
+  };
+
+  template<typename X, bool Broadcast, bool IsScalar> struct terminal_node { static const bool value = false;};
+  template<typename X, bool Broadcast> struct terminal_node<X,Broadcast,false> { 
+   typedef flat_evaluation<typename value_of<X>::type> F;
+   static const bool value = F::value;
+   template<typename T> static bool compatible (X const & x, T const & t) { return F::compatible(proto::value(x),t);}
+   struct type { 
+    typename F::type a;
+    type(X const & x) : a(proto::value(x)) {}
+    typename X::value_type operator()(std::ptrdiff_t n) const { return a(n);}
+   };
+  };
+  template<typename X> struct terminal_node<X,true,true> : scalar_leaf<X> {};
+
+  template<typename X, bool Broadcast> struct node<X,Broadcast,proto::tag::terminal> : terminal_node<X,Broadcast,proto::matches<X,ScalarLeaf>::value> {};
+
+  template<typename X, typename L, typename R, typename Tag> struct binary_node { 
+   static const bool value = L::value && R::value;
+   template<typename T> static bool compatible (X const & x, T const & t) { return L::compatible(proto::left(x),t) && R::compatible(proto::right(x),t);}
+   struct type { 
+    typename L::type l; typename R::type r;
+    type(X const & x) : l(proto::left(x)), r(proto::right(x)) {}
+    typename X::value_type operator()(std::ptrdiff_t n) const { return op<Tag>::template invoke<typename X::value_type>(l(n),r(n));}
+   };
+  };
+
+  template<typename X, bool Broadcast> struct node<X,Broadcast,proto::tag::plus> : 
+   binary_node<X, node<typename child<X,0>::type,Broadcast>, node<typename child<X,1>::type,Broadcast>, proto::tag::plus> {};
+
+  template<typename X, bool Broadcast> struct node<X,Broadcast,proto::tag::minus> : 
+   binary_node<X, node<typename child<X,0>::type,Broadcast>, node<typename child<X,1>::type,Broadcast>, proto::tag::minus> {};
+
+  // only the multiplication and division by a scalar are elementwise
+  template<typename X, bool Broadcast, bool LeftScalar, bool RightScalar> struct mult_node { static const bool value = false;};
+  template<typename X, bool Broadcast, bool RightScalar> struct mult_node<X,Broadcast,true,RightScalar> : 
+   binary_node<X, scalar_leaf<typename child<X,0>::type>, node<typename child<X,1>::type,Broadcast>, proto::tag::multiplies> {};
+  template<typename X, bool Broadcast> struct mult_node<X,Broadcast,false,true> : 
+   binary_node<X, node<typename child<X,0>::type,Broadcast>, scalar_leaf<typename child<X,1>::type>, proto::tag::multiplies> {};
+
+  template<typename X, bool Broadcast> struct node<X,Broadcast,proto::tag::multiplies> : 
+   mult_node<X,Broadcast, proto::matches<typename child<X,0>::type,ScalarLeaf>::value, proto::matches<typename child<X,1>::type,ScalarLeaf>::value> {};
+
+  template<typename X, bool Broadcast, bool RightScalar> struct div_node { static const bool value = false;};
+  template<typename X, bool Broadcast> struct div_node<X,Broadcast,true> : 
+   binary_node<X, node<typename child<X,0>::type,Broadcast>, scalar_leaf<typename child<X,1>::type>, proto::tag::divides> {};
+
+  template<typename X, bool Broadcast> struct node<X,Broadcast,proto::tag::divides> : 
+   div_node<X,Broadcast, proto::matches<typename child<X,1>::type,ScalarLeaf>::value> {};
+
+  template<typename X, bool Broadcast> struct node<X,Broadcast,proto::tag::negate> { 
+   typedef node<typename child<X,0>::type,Broadcast> C;
+   static const bool value = C::value;
+   template<typename T> static bool compatible (X const & x, T const & t) { return C::compatible(proto::child_c<0>(x),t);}
+   struct type { 
+    typename C::type c;
+    type(X const & x) : c(proto::child_c<0>(x)) {}
+    typename X::value_type operator()(std::ptrdiff_t n) const { return -c(n);}
+   };
+  };
+ }
+
+ template<typename Expr> struct flat_evaluation<array_expr<Expr> > : flat_details::node<array_expr<Expr>,true> {};
+ template<typename Expr> struct flat_evaluation<matrix_expr<Expr> > : flat_details::node<matrix_expr<Expr>,false> {};
+ template<typename Expr> struct flat_evaluation<vector_expr<Expr> > : flat_details::node<vector_expr<Expr>,false> {};
+
+ /// Can rhs be evaluated in the memory order of lhs (an array, matrix, vector or view) ?
+ template<typename LHS, typename RHS> 
+  typename boost::enable_if_c<flat_evaluation<RHS>::value, bool>::type 
+  flat_evaluation_possible (LHS const & lhs, RHS const & rhs) { 
+   return lhs.indexmap().is_contiguous() && flat_evaluation<RHS>::compatible(rhs, flat_target<typename LHS::indexmap_type>(lhs.indexmap(), lhs.data_start()));
+  }
+
+ template<typename LHS, typename RHS> 
+  typename boost::disable_if_c<flat_evaluation<RHS>::value, bool>::type 
+  flat_evaluation_possible (LHS const &, RHS const &) { return false;}
+
+}}//namespace triqs::arrays
+#endif
@@ -83,7 +83,7 @@ namespace triqs { namespace arrays {
 
     /// The storage is allocated from the size of IM.
     indexmap_storage_pair (const indexmap_type & IM): indexmap_(IM),storage_(){
-     this->storage_ = StorageType(this->indexmap_.domain().number_of_elements(), typename Opt::InitTag() );
+     this->storage_ = StorageType(this->indexmap_.domain().number_of_elements(), typename Opt::InitTag(), typename Opt::StorageTag() );
     }
 
     /// Shallow copy
@@ -173,7 +173,7 @@ namespace triqs { namespace arrays {
      this->indexmap_ = IndexMapType(d);// build a new one with the lengths of IND
      // optimisation. Construct a storage only if the new index is not compatible (size mismatch).
      if (this->storage_.size() != this->indexmap_.domain().number_of_elements())
-      this->storage_ = StorageType(this->indexmap_.domain().number_of_elements(), typename Opt::InitTag() );
+      this->storage_ = StorageType(this->indexmap_.domain().number_of_elements(), typename Opt::InitTag(), typename Opt::StorageTag() );
     }
 
     template<typename Xtype>
@@ -43,7 +43,7 @@ namespace triqs { namespace arrays {
   *
   * Parameters can be given in any order 
   *   Order in memory : Tag::C [default], Tag::Fortran, memory_order<0,2,1>, memory_order_p < a_permutation >
-  *   Storage : Tag::shared_block [default]
+  *   Storage : Tag::shared_block [default], Tag::aligned_pool (shared_block with its memory from storages::aligned_pool)
   *   BoundHandler : NoBoundCheck [default], BoundCheck
   */
 
@@ -68,6 +68,7 @@ namespace triqs { namespace arrays {
    , mpl::pair< Tag::C, _OrderTag >
    , mpl::pair< Tag::Fortran, _OrderTag >
    , mpl::pair< Tag::shared_block, _StorageTag >
+   , mpl::pair< Tag::aligned_pool, _StorageTag >
    , mpl::pair< Tag::NoBoundCheck, _BoundTag >
    , mpl::pair< Tag::BoundCheck, _BoundTag >
    , mpl::pair< Tag::no_init, _InitTag >
@@ -29,6 +29,14 @@
 #include "../../impl/mini_vector.hpp"
 #include "../permutation.hpp"
 #include "./cuboid_map.hpp"
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#include <omp.h>
+#endif
+
+// the minimal number of elements for which parallel_foreach uses the threads
+#ifndef TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD
+#define TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD 100000
+#endif
 
 namespace triqs { namespace arrays { namespace indexmaps { 
 
@@ -53,7 +61,7 @@ namespace triqs { namespace arrays { namespace indexmaps {
   * 
   *  Similar action can be obtained with iterators, but on some compilers & computations
   *  foreach can be faster (since it uses restrict pointers).
-  *  It is also easier to thread...: to be done...
+  *  It is also easier to thread : cf parallel_foreach.
   *
   *  NB : F is passed by value, hence copied by default. 
   *     to pass a reference, use boost::ref.
@@ -75,15 +83,81 @@ namespace triqs { namespace arrays { namespace indexmaps {
     boost::unwrap_ref(F)(x[*gen],*gen);
    } 
   }
+
+ /**
+  * foreach restricted to the values [first, last[ of the slowest index (in memory) of x.
+  */
+ template <typename T, typename Function> 
+  typename boost::enable_if<boost::is_base_of<Tag::indexmap_storage_pair,T> >::type 
+  foreach_rows( Function F,T & x, foreach_int_type first, foreach_int_type last) { 
+   typedef typename T::value_type v;
+   typedef typename boost::mpl::if_<boost::is_const<T>, typename boost::add_const<v>::type,v>::type value_type;
+   typedef typename T::indexmap_type indexmap_type;
+   foreach_impl<indexmap_type, Function, value_type>::invoke_rows(x.data_start(),x.indexmap(),F,first,last);
+  }
+
+ /// The length of the slowest index (in memory) of x
+ template <typename T> 
+  foreach_int_type foreach_n_rows(T const & x) { 
+   return foreach_impl<typename T::indexmap_type, void *, typename T::value_type>::n_rows(x.indexmap());
+  }
+
+ /** 
+  * Does parallel_foreach use the threads for x ? 
+  * Only if TRIQS_ARRAYS_FOREACH_USE_OPENMP is defined (with OpenMP enabled), if x has at least 
+  * TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD elements and if we are not already in a parallel region.
+  */
+ template <typename T> 
+  bool foreach_in_parallel(T const & x) { 
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+   return ( (x.indexmap().domain().number_of_elements() >= TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD) 
+     && (foreach_n_rows(x)>1) && (!omp_in_parallel()) && (omp_get_max_threads()>1) );
+#else
+   return false;
+#endif
+  }
+
+ /**
+  * Same as foreach, but when foreach_in_parallel(x), the values of the slowest index of x
+  * are split in contiguous slices over the OpenMP threads. 
+  * F is then called concurrently from several threads (on different elements) : 
+  * it must be thread-safe, e.g. with no state (like the assignment functors). 
+  */
+ template <typename T, typename Function> 
+  typename boost::enable_if<boost::is_base_of<Tag::indexmap_storage_pair,T> >::type 
+  parallel_foreach( Function F,T & x) { 
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+   if (foreach_in_parallel(x)) { 
+    const foreach_int_type n = foreach_n_rows(x);
+#pragma omp parallel
+    { 
+     const foreach_int_type nt = omp_get_num_threads(), it = omp_get_thread_num();
+     foreach_rows(F, x, (n*it)/nt, (n*(it+1))/nt);
+    }
+    return;
+   }
+#endif
+   foreach(F,x);
+  }
+
+ template <typename Expr, typename Function> 
+  typename boost::disable_if<boost::is_base_of<Tag::indexmap_storage_pair,Expr> >::type 
+  parallel_foreach( Function F,Expr const & x) { foreach(F,x);}
+
  //--------------  IMPLEMENTATION -----------------------
  //only cuboid maps is implemented.
 #define AUX0(z,P,NNN) enum { p##P = IndexOrderType::template memory_rank_to_index<BOOST_PP_SUB(NNN,P)>::value};
-#define AUX1(z,P,unused) for (t[p##P]=0; t[p##P]< l[p##P]; ++t[p##P])
+#define AUX1(z,P,unused) BOOST_PP_IF(P,for (t[p##P]=0; t[p##P]< l[p##P]; ++t[p##P]), for (t[p0]=first; t[p0]< last; ++t[p0]))
 #define AUX2(z,p,unused) BOOST_PP_IF(p,+,) t[p]* s[p] 
 #define IMPL(z, NN, unused)                                \
  template<typename IndexOrderType, bool BC, typename Function, typename ValueType>\
  struct foreach_impl <cuboid_map<IndexOrderType,BC>,Function,ValueType,typename boost::enable_if_c<(IndexOrderType::rank==BOOST_PP_INC(NN))>::type > {\
-  static void invoke ( ValueType * restrict p, cuboid_map<IndexOrderType, BC> const & CM, Function F) { \
+  static foreach_int_type n_rows (cuboid_map<IndexOrderType, BC> const & CM) { \
+   BOOST_PP_REPEAT(BOOST_PP_INC(NN),AUX0,NN)\
+   return CM.lengths()[p0];\
+  }\
+  static void invoke ( ValueType * restrict p, cuboid_map<IndexOrderType, BC> const & CM, Function F) { invoke_rows(p,CM,F,0,n_rows(CM));}\
+  static void invoke_rows ( ValueType * restrict p, cuboid_map<IndexOrderType, BC> const & CM, Function F, foreach_int_type first, foreach_int_type last) { \
    BOOST_PP_REPEAT(BOOST_PP_INC(NN),AUX0,NN)\
    mini_vector<foreach_int_type, IndexOrderType::rank> t;\
    const mini_vector<foreach_int_type, IndexOrderType::rank>  l(CM.lengths());\
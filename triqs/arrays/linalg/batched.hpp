@@ -0,0 +1,466 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef TRIQS_ARRAYS_LINALG_BATCHED_H
+#define TRIQS_ARRAYS_LINALG_BATCHED_H
+#include <complex>
+#include <utility>
+#include <algorithm>
+#include "../array.hpp"
+#include "../matrix.hpp"
+#include "../vector.hpp"
+#include "./det_and_inverse.hpp"
+#include "./matmul.hpp"
+#include "./eigenelements.hpp"
+
+namespace triqs { namespace arrays { namespace linalg { 
+
+ /**
+  * Linear algebra on a batch of small square matrices, stored in a rank 3 array A : 
+  * the k-th matrix is A(k,range(),range()) (any memory layout).
+  * 
+  *  - batched_determinant(A)          : array<T,1>, the determinants.
+  *  - batched_inverse(A)              : array<T,3>, the inverses. batched_inverse_in_place(A) for an in place inversion.
+  *  - batched_matmul(A,B [,C])        : C(k) = A(k) * B(k).
+  *  - batched_sandwich(L,A,R)         : array<T,3>, L * A(k) * R, L and R are matrices.
+  *  - batched_eigenelements(A)        : pair( array<double,2> (eigenvalues of A(k) in row k), array<T,3> (eigenvectors) ), 
+  *                                      for symmetric/hermitian matrices, with the conventions of eigenelements.
+  *  - batched_eigenvalues(A)          : array<double,2>.
+  *
+  * Compared to a loop on the single matrix functions, the LAPACK workspace (ipiv, work) is allocated once 
+  * for the batch (once per thread), and for n <= 4 the determinant, inverse and products use unrolled closed forms 
+  * (no LAPACK call). NB : the closed forms do not pivot, they are fine for the usual well conditioned small blocks.
+  * A singular matrix throws, like inverse.
+  *
+  * With TRIQS_ARRAYS_FOREACH_USE_OPENMP, the matrices of the batch are distributed over the OpenMP threads 
+  * when the batch has at least TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD elements.
+  */
+
+ namespace batched_details { 
+
+  // ------------- access to the k-th matrix of a batch --------------------
+
+  template<typename T> struct matrix_ref { 
+   T * p; std::ptrdiff_t s0, s1;
+   T & operator()(int i, int j) const { return p[i*s0 + j*s1];}
+  };
+
+  template<typename V, typename A> matrix_ref<V> get_matrix(A & a, long k) { 
+   matrix_ref<V> r = { a.data_start() + k * a.indexmap().strides()[0], a.indexmap().strides()[1], a.indexmap().strides()[2]};
+   return r;
+  }
+
+  template<typename A> void check_batch(A const & a, const char * fname) { 
+   static_assert( (A::rank==3), "batched linalg : the batch of matrices must be an array of rank 3");
+   if (a.shape()[1] != a.shape()[2]) 
+    TRIQS_RUNTIME_ERROR << fname << " : the matrices are not square : "<< a.shape()[1] << " x "<< a.shape()[2];
+  }
+
+  // ------------- lapack ---------------------
+
+  inline void getrf(fortran_int_t n, double * a, fortran_int_t * ipiv, fortran_int_t & info) { LAPACK_DGETRF(&n,&n,a,&n,ipiv,&info);}
+  inline void getrf(fortran_int_t n, std::complex<double> * a, fortran_int_t * ipiv, fortran_int_t & info) { LAPACK_ZGETRF(&n,&n,a,&n,ipiv,&info);}
+  inline void getri(fortran_int_t n, double * a, fortran_int_t const * ipiv, double * work, fortran_int_t lwork, fortran_int_t & info) { 
+   LAPACK_DGETRI(&n,a,&n,ipiv,work,&lwork,&info);
+  }
+  inline void getri(fortran_int_t n, std::complex<double> * a, fortran_int_t const * ipiv, std::complex<double> * work, fortran_int_t lwork, fortran_int_t & info) { 
+   LAPACK_ZGETRI(&n,a,&n,ipiv,work,&lwork,&info);
+  }
+  /// The buffers for the LAPACK calls on one n x n matrix, reused for all the matrices of the batch
+  template<typename T> struct workspace { 
+   fortran_int_t n, lwork;
+   matrix<T,Option::Fortran> M; // a copy of the matrix
+   vector<fortran_int_t> ipiv;
+   vector<T> work; 
+   vector<double> rwork;
+   workspace(int n_) : n(n_), lwork(1), M(n_,n_), ipiv(n_) {}
+
+   void prepare_getri() { T w = 0; fortran_int_t info = 0; getri(n, M.data_start(), ipiv.data_start(), &w, -1, info); resize_work(w);}
+   void prepare_heev(char jobz) { 
+    T w = 0; double r = 0; fortran_int_t info = 0; rwork.resize(std::max(1,3*n-2));
+    eigenelements_details::heev(jobz, n, M.data_start(), &r, &w, -1, rwork.data_start(), info); resize_work(w);
+   }
+
+   private:
+   void resize_work(T const & w) { lwork = std::max(fortran_int_t(std::real(w)), std::max(fortran_int_t(1),fortran_int_t(3*n))); work.resize(lwork);}
+  };
+
+  // copy the matrix to/from the workspace
+  template<typename T, typename V> void load(matrix<T,Option::Fortran> & M, matrix_ref<V> const & a) { 
+   for (size_t j=0; j<M.dim1(); ++j) for (size_t i=0; i<M.dim0(); ++i) M(i,j) = a(i,j);
+  }
+  template<typename T> void store(matrix_ref<T> const & a, matrix<T,Option::Fortran> const & M) { 
+   for (size_t j=0; j<M.dim1(); ++j) for (size_t i=0; i<M.dim0(); ++i) a(i,j) = M(i,j);
+  }
+
+  // ------------- closed forms for n <= 4, on a buffer b[i*n+j] ---------------------
+
+  template<typename T> T small_det(int n, T const * b) { 
+   switch(n) { 
+    case 1 : return b[0];
+    case 2 : return b[0]*b[3] - b[1]*b[2];
+    case 3 : return b[0]*(b[4]*b[8]-b[5]*b[7]) - b[1]*(b[3]*b[8]-b[5]*b[6]) + b[2]*(b[3]*b[7]-b[4]*b[6]);
+    default : { // n=4, with the 2x2 minors of the first two and last two rows
+     T s0 = b[0]*b[5] - b[4]*b[1], s1 = b[0]*b[6] - b[4]*b[2], s2 = b[0]*b[7] - b[4]*b[3];
+     T s3 = b[1]*b[6] - b[5]*b[2], s4 = b[1]*b[7] - b[5]*b[3], s5 = b[2]*b[7] - b[6]*b[3];
+     T c5 = b[10]*b[15] - b[14]*b[11], c4 = b[9]*b[15] - b[13]*b[11], c3 = b[9]*b[14] - b[13]*b[10];
+     T c2 = b[8]*b[15] - b[12]*b[11], c1 = b[8]*b[14] - b[12]*b[10], c0 = b[8]*b[13] - b[12]*b[9];
+     return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+    }
+   }
+  }
+
+  // inverse of b in r. Returns false if b is singular.
+  template<typename T> bool small_inverse(int n, T const * b, T * r) { 
+   switch(n) { 
+    case 1 : { 
+     if (b[0]==T(0)) return false;
+     r[0] = T(1)/b[0]; return true;
+    }
+    case 2 : { 
+     T d = b[0]*b[3] - b[1]*b[2];
+     if (d==T(0)) return false;
+     T u = T(1)/d;
+     r[0] = b[3]*u; r[1] = -b[1]*u; r[2] = -b[2]*u; r[3] = b[0]*u; 
+     return true;
+    }
+    case 3 : { 
+     T c0 = b[4]*b[8]-b[5]*b[7], c1 = b[5]*b[6]-b[3]*b[8], c2 = b[3]*b[7]-b[4]*b[6];
+     T d = b[0]*c0 + b[1]*c1 + b[2]*c2;
+     if (d==T(0)) return false;
+     T u = T(1)/d;
+     r[0] = c0*u; r[1] = (b[2]*b[7]-b[1]*b[8])*u; r[2] = (b[1]*b[5]-b[2]*b[4])*u;
+     r[3] = c1*u; r[4] = (b[0]*b[8]-b[2]*b[6])*u; r[5] = (b[2]*b[3]-b[0]*b[5])*u;
+     r[6] = c2*u; r[7] = (b[1]*b[6]-b[0]*b[7])*u; r[8] = (b[0]*b[4]-b[1]*b[3])*u;
+     return true;
+    }
+    default : { // n=4 : adjugate with the 2x2 minors
+     T s0 = b[0]*b[5] - b[4]*b[1], s1 = b[0]*b[6] - b[4]*b[2], s2 = b[0]*b[7] - b[4]*b[3];
+     T s3 = b[1]*b[6] - b[5]*b[2], s4 = b[1]*b[7] - b[5]*b[3], s5 = b[2]*b[7] - b[6]*b[3];
+     T c5 = b[10]*b[15] - b[14]*b[11], c4 = b[9]*b[15] - b[13]*b[11], c3 = b[9]*b[14] - b[13]*b[10];
+     T c2 = b[8]*b[15] - b[12]*b[11], c1 = b[8]*b[14] - b[12]*b[10], c0 = b[8]*b[13] - b[12]*b[9];
+     T d = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+     if (d==T(0)) return false;
+     T u = T(1)/d;
+     r[0]  = ( b[5]*c5 - b[6]*c4 + b[7]*c3)*u;
+     r[1]  = (-b[1]*c5 + b[2]*c4 - b[3]*c3)*u;
+     r[2]  = ( b[13]*s5 - b[14]*s4 + b[15]*s3)*u;
+     r[3]  = (-b[9]*s5 + b[10]*s4 - b[11]*s3)*u;
+     r[4]  = (-b[4]*c5 + b[6]*c2 - b[7]*c1)*u;
+     r[5]  = ( b[0]*c5 - b[2]*c2 + b[3]*c1)*u;
+     r[6]  = (-b[12]*s5 + b[14]*s2 - b[15]*s1)*u;
+     r[7]  = ( b[8]*s5 - b[10]*s2 + b[11]*s1)*u;
+     r[8]  = ( b[4]*c4 - b[5]*c2 + b[7]*c0)*u;
+     r[9]  = (-b[0]*c4 + b[1]*c2 - b[3]*c0)*u;
+     r[10] = ( b[12]*s4 - b[13]*s2 + b[15]*s0)*u;
+     r[11] = (-b[8]*s4 + b[9]*s2 - b[11]*s0)*u;
+     r[12] = (-b[4]*c3 + b[5]*c1 - b[6]*c0)*u;
+     r[13] = ( b[0]*c3 - b[1]*c1 + b[2]*c0)*u;
+     r[14] = (-b[12]*s3 + b[13]*s1 - b[14]*s0)*u;
+     r[15] = ( b[8]*s3 - b[9]*s1 + b[10]*s0)*u;
+     return true;
+    }
+   }
+  }
+
+  template<int N, typename T, typename V> void small_load(T * b, matrix_ref<V> const & a) { 
+   for (int i=0; i<N; ++i) for (int j=0; j<N; ++j) b[i*N+j] = a(i,j);
+  }
+  template<int N, typename T> void small_store(matrix_ref<T> const & a, T const * b) { 
+   for (int i=0; i<N; ++i) for (int j=0; j<N; ++j) a(i,j) = b[i*N+j];
+  }
+  // r = a * b (the loops are unrolled by the compiler for a fixed N)
+  template<int N, typename T> void small_product(T const * a, T const * b, T * r) { 
+   for (int i=0; i<N; ++i) for (int j=0; j<N; ++j) { 
+    T s = a[i*N]*b[j]; 
+    for (int l=1; l<N; ++l) s += a[i*N+l]*b[l*N+j]; 
+    r[i*N+j] = s;
+   }
+  }
+
+  template<int N, typename T, typename V1, typename V2> 
+   void small_matmul(matrix_ref<V1> const & a, matrix_ref<V2> const & b, matrix_ref<T> const & c) { 
+    T x[N*N], y[N*N], r[N*N];
+    small_load<N>(x,a); small_load<N>(y,b); small_product<N>(x,y,r); small_store<N>(c,r);
+   }
+
+  template<int N, typename T, typename V> 
+   void small_sandwich(T const * l, matrix_ref<V> const & a, T const * rr, matrix_ref<T> const & c) { 
+    T x[N*N], y[N*N], r[N*N];
+    small_load<N>(x,a); small_product<N>(x,rr,y); small_product<N>(l,y,r); small_store<N>(c,r);
+   }
+
+  // ------------- the loop on the batch --------------------
+
+  inline bool in_parallel(long N, long n) { 
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+   return ( (N*n*n >= TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD) && (N>1) && (!omp_in_parallel()) && (omp_get_max_threads()>1) );
+#else
+   (void)N; (void)n; 
+   return false;
+#endif
+  }
+
+  /**
+   * Calls f(k, W) for k in [0,N[, where W is a workspace<T>(n) built by f.make_workspace() 
+   * once per thread. f returns false on failure.
+   * Returns the smallest k for which f failed, or -1. 
+   * (The exceptions can not leave an OpenMP region, they are thrown by the caller).
+   */
+  template<typename F> long for_each_matrix(long N, int n, F const & f) { 
+   long failed = -1;
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#pragma omp parallel if (in_parallel(N,n))
+#else
+   (void)n; // only used to decide whether to run in parallel
+#endif
+   { 
+    typename F::workspace_type W(f.make_workspace());
+    long my_failed = -1;
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (long k=0; k<N; ++k) if (!f(k,W) && (my_failed <0)) my_failed = k;
+#ifdef TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#pragma omp critical (triqs_arrays_batched)
+#endif
+    if ((my_failed >=0) && ((failed <0) || (my_failed < failed))) failed = my_failed;
+   }
+   return failed;
+  }
+
+  // ------------- the operations on one matrix --------------------
+
+  template<typename A, typename R> struct determinant_op { 
+   typedef typename boost::remove_const<typename A::value_type>::type T;
+   typedef workspace<T> workspace_type;
+   A const & a; R & r; int n;
+   determinant_op(A const & a_, R & r_) : a(a_), r(r_), n(a_.shape()[1]) {}
+   workspace_type make_workspace() const { return workspace_type(n > 4 ? n : 0);}
+   bool operator()(long k, workspace_type & W) const { 
+    matrix_ref<const T> m = get_matrix<const T>(a,k);
+    if (n==0) { r(k) = 1; return true;}
+    if (n<=4) { T b[16]; for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) b[i*n+j] = m(i,j); r(k) = small_det(n,b); return true;}
+    load(W.M,m);
+    fortran_int_t info; 
+    getrf(n, W.M.data_start(), W.ipiv.data_start(), info);
+    if (info<0) return false;
+    T d = 1;
+    for (int i=0; i<n; ++i) d *= (W.ipiv(i) != i+1 ? -W.M(i,i) : W.M(i,i));
+    r(k) = d; 
+    return true;
+   }
+  };
+
+  template<typename A> struct inverse_op { 
+   typedef typename A::value_type T;
+   typedef workspace<T> workspace_type;
+   A & a; int n;
+   inverse_op(A & a_) : a(a_), n(a_.shape()[1]) {}
+   workspace_type make_workspace() const { workspace_type W(n > 4 ? n : 0); if (n>4) W.prepare_getri(); return W;}
+   bool operator()(long k, workspace_type & W) const { 
+    matrix_ref<T> m = get_matrix<T>(a,k);
+    if (n==0) return true;
+    if (n<=4) { 
+     T b[16] = {}, r[16]; 
+     for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) b[i*n+j] = m(i,j); 
+     if (!small_inverse(n,b,r)) return false;
+     for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) m(i,j) = r[i*n+j]; 
+     return true;
+    }
+    load(W.M,m);
+    fortran_int_t info; 
+    getrf(n, W.M.data_start(), W.ipiv.data_start(), info);
+    if (info!=0) return false;
+    getri(n, W.M.data_start(), W.ipiv.data_start(), W.work.data_start(), W.lwork, info);
+    if (info!=0) return false;
+    store(m,W.M);
+    return true;
+   }
+  };
+
+  template<typename A, typename B, typename C> struct matmul_op { 
+   typedef typename C::value_type T;
+   typedef workspace<T> workspace_type;
+   A const & a; B const & b; C & c; int n;
+   matmul_op(A const & a_, B const & b_, C & c_) : a(a_), b(b_), c(c_), n(a_.shape()[1]) {}
+   workspace_type make_workspace() const { return workspace_type(0);}
+   bool operator()(long k, workspace_type &) const { 
+    matrix_ref<const T> x = get_matrix<const T>(a,k);
+    matrix_ref<const T> y = get_matrix<const T>(b,k);
+    matrix_ref<T> z = get_matrix<T>(c,k);
+    switch(n) { 
+     case 0 : break;
+     case 1 : small_matmul<1>(x,y,z); break;
+     case 2 : small_matmul<2>(x,y,z); break;
+     case 3 : small_matmul<3>(x,y,z); break;
+     case 4 : small_matmul<4>(x,y,z); break;
+     default : { 
+      matrix_view<T> Z(c(k,range(),range())); 
+      Z = matmul(matrix_view<typename A::value_type>(a(k,range(),range())), matrix_view<typename B::value_type>(b(k,range(),range())));
+     }
+    }
+    return true;
+   }
+  };
+
+  template<typename ML, typename A, typename MR, typename C> struct sandwich_op { 
+   typedef typename C::value_type T;
+   typedef workspace<T> workspace_type;
+   ML const & l; A const & a; MR const & r; C & c; int n; 
+   T lb[16], rb[16];
+   sandwich_op(ML const & l_, A const & a_, MR const & r_, C & c_) : l(l_), a(a_), r(r_), c(c_), n(a_.shape()[1]) {
+    if (small()) for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) { lb[i*n+j] = l(i,j); rb[i*n+j] = r(i,j);}
+   }
+   bool small() const { return (n<=4) && (int(l.dim0())==n) && (int(r.dim1())==n);}
+   workspace_type make_workspace() const { 
+    workspace_type W(0); 
+    if (!small()) W.M.resize(n,r.dim1()); // for A(k) * R
+    return W;
+   }
+   bool operator()(long k, workspace_type & W) const { 
+    matrix_ref<const T> x = get_matrix<const T>(a,k);
+    matrix_ref<T> z = get_matrix<T>(c,k);
+    if (small()) { 
+     switch(n) { 
+      case 1 : small_sandwich<1>(lb,x,rb,z); break;
+      case 2 : small_sandwich<2>(lb,x,rb,z); break;
+      case 3 : small_sandwich<3>(lb,x,rb,z); break;
+      case 4 : small_sandwich<4>(lb,x,rb,z); break;
+     }
+     return true;
+    }
+    if ((n==0) || (l.dim0()==0) || (r.dim1()==0)) { c(k,range(),range()) = 0; return true;}
+    W.M = matmul(matrix_view<typename A::value_type>(a(k,range(),range())), r);
+    matrix_view<T> Z(c(k,range(),range())); 
+    Z = matmul(l, W.M);
+    return true;
+   }
+  };
+
+  template<typename A, typename V, typename E> struct eigen_op { 
+   typedef typename boost::remove_const<typename A::value_type>::type T;
+   typedef workspace<T> workspace_type;
+   A const & a; V & values; E * vectors; int n;
+   eigen_op(A const & a_, V & v, E * e) : a(a_), values(v), vectors(e), n(a_.shape()[1]) {}
+   workspace_type make_workspace() const { workspace_type W(n); if (n>0) W.prepare_heev(vectors ? 'V' : 'N'); return W;}
+   bool operator()(long k, workspace_type & W) const { 
+    if (n==0) return true;
+    // as in eigenelements : lapack works on the matrix in its C order
+    matrix_ref<const T> m = get_matrix<const T>(a,k);
+    T * M = W.M.data_start();
+    for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) M[i*n+j] = m(i,j);
+    fortran_int_t info; 
+    double * ev = &values(k,0);
+    eigenelements_details::heev((vectors ? 'V' : 'N'), n, M, ev, W.work.data_start(), W.lwork, W.rwork.data_start(), info);
+    if (info!=0) return false;
+    if (vectors) for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) (*vectors)(k,i,j) = M[i*n+j];
+    return true;
+   }
+  };
+
+ }//batched_details
+
+ // ------------------------- user functions ---------------------------------
+
+ /// The determinants of the matrices A(k,range(),range())
+ template<typename A> 
+  array<typename boost::remove_const<typename A::value_type>::type,1> batched_determinant (A const & a) { 
+   batched_details::check_batch(a,"batched_determinant");
+   array<typename boost::remove_const<typename A::value_type>::type,1> r(a.shape()[0]);
+   long f = batched_details::for_each_matrix(a.shape()[0], a.shape()[1], batched_details::determinant_op<A,array<typename boost::remove_const<typename A::value_type>::type,1> >(a,r));
+   if (f>=0) throw matrix_inverse_exception() << "batched_determinant : failure of getrf lapack routine for the matrix "<< f;
+   return r;
+  }
+
+ /// Inverts in place the matrices A(k,range(),range()). A is an array or a view.
+ template<typename A> void batched_inverse_in_place (A const & a) { 
+  batched_details::check_batch(a,"batched_inverse_in_place");
+  typename A::view_type v(a);
+  long f = batched_details::for_each_matrix(v.shape()[0], v.shape()[1], batched_details::inverse_op<typename A::view_type>(v));
+  if (f>=0) throw matrix_inverse_exception() << "batched_inverse : the matrix "<< f << " is not invertible";
+ }
+
+ /// The inverses of the matrices A(k,range(),range())
+ template<typename A> 
+  array<typename boost::remove_const<typename A::value_type>::type,3> batched_inverse (A const & a) { 
+   array<typename boost::remove_const<typename A::value_type>::type,3> r(a);
+   batched_inverse_in_place(r);
+   return r;
+  }
+
+ /// C(k) = A(k) * B(k). C is resized if it is an array, or its shape is checked if it is a view
+ template<typename A, typename B, typename C> void batched_matmul (A const & a, B const & b, C & c) { 
+  batched_details::check_batch(a,"batched_matmul"); batched_details::check_batch(b,"batched_matmul");
+  if (a.shape()!=b.shape()) TRIQS_RUNTIME_ERROR << "batched_matmul : shape mismatch "<< a.shape() << " vs "<< b.shape();
+  resize_or_check_if_view(c, a.shape());
+  batched_details::for_each_matrix(a.shape()[0], a.shape()[1], batched_details::matmul_op<A,B,C>(a,b,c));
+ }
+
+ /// The products A(k) * B(k)
+ template<typename A, typename B> 
+  array<typename boost::remove_const<typename A::value_type>::type,3> batched_matmul (A const & a, B const & b) { 
+   array<typename boost::remove_const<typename A::value_type>::type,3> r;
+   batched_matmul(a,b,r);
+   return r;
+  }
+
+ /// The products L * A(k) * R, where L, R are matrices
+ template<typename ML, typename A, typename MR> 
+  array<typename boost::remove_const<typename A::value_type>::type,3> batched_sandwich (ML const & l, A const & a, MR const & r) { 
+   batched_details::check_batch(a,"batched_sandwich");
+   if ((l.dim1() != a.shape()[1]) || (r.dim0() != a.shape()[2])) 
+    TRIQS_RUNTIME_ERROR << "batched_sandwich : dimension mismatch : L is "<< l.dim0() << " x "<< l.dim1() << ", R is "<< r.dim0() << " x "<< r.dim1() << ", the matrices are "<< a.shape()[1]<< " x "<< a.shape()[2];
+   typedef typename boost::remove_const<typename A::value_type>::type T;
+   typedef typename const_view_type_if_exists_else_type<ML>::type L_type;
+   typedef typename const_view_type_if_exists_else_type<MR>::type R_type;
+   array<T,3> res(a.shape()[0], l.dim0(), r.dim1());
+   L_type lv(l); R_type rv(r);
+   batched_details::for_each_matrix(a.shape()[0], a.shape()[1], batched_details::sandwich_op<L_type,A,R_type,array<T,3> >(lv,a,rv,res));
+   return res;
+  }
+
+ /**
+  * The eigenvalues (row k of the first array) and eigenvectors (matrix k of the second array) of the 
+  * symmetric/hermitian matrices A(k,range(),range()), with the same conventions as eigenelements. 
+  */
+ template<typename A> 
+  std::pair<array<double,2>, array<typename boost::remove_const<typename A::value_type>::type,3> > batched_eigenelements (A const & a) { 
+   batched_details::check_batch(a,"batched_eigenelements");
+   typedef typename boost::remove_const<typename A::value_type>::type T;
+   array<double,2> values(a.shape()[0], a.shape()[1]);
+   array<T,3> vectors(a.shape());
+   long f = batched_details::for_each_matrix(a.shape()[0], a.shape()[1], batched_details::eigen_op<A,array<double,2>,array<T,3> >(a,values,&vectors));
+   if (f>=0) TRIQS_RUNTIME_ERROR << "batched_eigenelements : lapack error for the matrix "<< f;
+   return std::make_pair(values, vectors);
+  }
+
+ /// The eigenvalues of the symmetric/hermitian matrices A(k,range(),range()), in row k
+ template<typename A> array<double,2> batched_eigenvalues (A const & a) { 
+  batched_details::check_batch(a,"batched_eigenvalues");
+  typedef typename boost::remove_const<typename A::value_type>::type T;
+  array<double,2> values(a.shape()[0], a.shape()[1]);
+  long f = batched_details::for_each_matrix(a.shape()[0], a.shape()[1], batched_details::eigen_op<A,array<double,2>,array<T,3> >(a,values,NULL));
+  if (f>=0) TRIQS_RUNTIME_ERROR << "batched_eigenvalues : lapack error for the matrix "<< f;
+  return values;
+ }
+
+}}} // namespace triqs::arrays::linalg
+#endif
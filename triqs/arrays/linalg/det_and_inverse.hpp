@@ -60,25 +60,43 @@ namespace triqs { namespace arrays {
  //worker takes a contiguous view and compute the det and inverse in two steps.
  //it is separated in case of multiple use (no reallocation of ipvi, etc...)
  //NB a view does not resize, only its elements can be changed
+ //For many matrices, construct the worker once and reset(M) it for each one : ipiv and the 
+ //getri workspace (sized by the lapack query) are reused as long as the dimension does not change.
  template<typename ViewType> class det_and_inverse_worker { 
   static_assert ( (is_matrix_view<ViewType>::value),"class must have be a view");
   typedef typename ViewType::value_type VT;
   typedef matrix_view<VT,Option::Fortran > V_type;
   ViewType V;
-  const size_t dim; 
+  size_t dim; 
   triqs::arrays::vector <int> ipiv;
+  triqs::arrays::vector <VT> work;
   short step; 
 
   public:
-  det_and_inverse_worker (ViewType const & a): V(a), dim(a.dim0()), ipiv(dim), step(0) { 
-   if (a.dim0()!=a.dim1()) TRIQS_RUNTIME_ERROR<<"Inverse/Det error : non-square matrix. Dimensions are : ("<<a.dim0()<<","<<a.dim1()<<")"<<"\n  ";
-   if (!(has_contiguous_data(a))) TRIQS_RUNTIME_ERROR<<"det_and_inverse_worker only takes a contiguous view";
+  det_and_inverse_worker (ViewType const & a): V(a), dim(a.dim0()), ipiv(dim), step(0) { check(a);}
+
+  /// A worker for matrices of dimension dim_, without matrix : call reset(M) before use
+  explicit det_and_inverse_worker (size_t dim_): V(typename ViewType::non_view_type()), dim(dim_), ipiv(dim_), step(0) {}
+
+  /// Use the worker (and its workspace) for the matrix a (a contiguous view, overwritten by inverse())
+  void reset (ViewType const & a) { 
+   check(a); V.rebind(a); step = 0;
+   if (a.dim0()!=dim) { dim = a.dim0(); ipiv.resize(dim); work.resize(0);}
   }
+
   VT det() { V_type W = fortran_view(V); _step1(W); _compute_det(W); return _det;}
+  /// log |det| and det/|det|, which do not overflow for large matrices
+  double log_abs_det() { V_type W = fortran_view(V); _step1(W); _compute_det(W); return _log_abs_det;}
+  VT det_phase() { V_type W = fortran_view(V); _step1(W); _compute_det(W); return _det_phase;}
   ViewType const & inverse() { if (step<2) { V_type W = fortran_view(V); _step1(W); _step2(W);} return V;}
 
   private:
-  int info; VT _det;
+  int info; VT _det, _det_phase; double _log_abs_det;
+
+  void check(ViewType const & a) const { 
+   if (a.dim0()!=a.dim1()) TRIQS_RUNTIME_ERROR<<"Inverse/Det error : non-square matrix. Dimensions are : ("<<a.dim0()<<","<<a.dim1()<<")"<<"\n  ";
+   if (!(has_contiguous_data(a))) TRIQS_RUNTIME_ERROR<<"det_and_inverse_worker only takes a contiguous view";
+  }
 
   template<typename MT>
    typename boost::enable_if<boost::is_same<typename MT::opt_type::IndexOrderTag, Tag::C>, V_type>::type 
@@ -97,18 +115,28 @@ namespace triqs { namespace arrays {
 
   void _compute_det(V_type const & W) { 
    if (step>1) return;
-   _det =1;
-   for (size_t i =0; i<dim; i++) _det *= W(i,i);
+   _det =1; _det_phase =1; _log_abs_det =0;
+   for (size_t i =0; i<dim; i++) { 
+    _det *= W(i,i);
+    _log_abs_det += std::log(std::abs(W(i,i)));
+    _det_phase *= W(i,i)/std::abs(W(i,i));
+   }
    bool flip=false;// compute the sign of the permutation
    for (size_t i=0; i<dim; i++) {if (ipiv(i)!=int(i)+1) flip = !(flip);}
    _det= (flip ? - _det : _det) ;
+   _det_phase= (flip ? - _det_phase : _det_phase) ;
   }
 
   void _step2(V_type & W) { 
    assert(step==1); //if (step==1) return;
    step=2;
    _compute_det(W); 
-   info = boost::numeric::bindings::lapack::getri(W, ipiv);
+   if (work.size()==0) { // workspace query, once for a given dimension
+    VT w; 
+    boost::numeric::bindings::lapack::detail::getri(boost::numeric::bindings::tag::column_major(), dim, W.data_start(), dim, ipiv.data_start(), &w, -1);
+    work.resize(std::max(size_t(std::real(w)),std::max(dim,size_t(1))));
+   }
+   info = boost::numeric::bindings::lapack::getri(W, ipiv, boost::numeric::bindings::lapack::workspace(work));
    //std::cerr<<" after tri "<< W<<std::endl;
    if (info!=0) throw matrix_inverse_exception() << "Inverse/Det error : matrix is not invertible";
   }
@@ -168,6 +196,15 @@ namespace triqs { namespace arrays {
    friend std::ostream & operator<<(std::ostream & out,inverse_lazy const&x){return out<<"inverse("<<x.a<<")";}
   };
 
+ /**
+  * Inverts in place the matrix M (a matrix or a contiguous view), without copy. 
+  * For repeated calls, prefer a det_and_inverse_worker, which keeps its workspace.
+  */
+ template<typename MT> void inverse_in_place (MT const & M) { 
+  static_assert(is_matrix_or_view<MT>::value, "inverse_in_place : M must be a matrix or a matrix_view");
+  det_and_inverse_worker<typename MT::view_type> W(M); W.inverse();
+ }
+
  //------------------- det   ----------------------------------------
 
  template<typename A> struct determinant_lazy  { // : { Tag::expression_terminal, Tag::scalar_expression_terminal {
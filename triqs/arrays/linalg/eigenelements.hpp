@@ -24,6 +24,7 @@
 #include <boost/type_traits/is_same.hpp>
 #include <boost/typeof/typeof.hpp>
 #include <boost/utility/enable_if.hpp>
+#include "../array.hpp"
 #include "../matrix.hpp"
 #include "../vector.hpp"
 #include <triqs/utility/exceptions.hpp>
@@ -33,6 +34,10 @@
 #define TRIQS_FORTRAN( id ) id##_
 #define dcomplex std::complex<double> 
 
+#ifndef TRIQS_ARRAYS_EIGENELEMENTS_DIVIDE_AND_CONQUER_DIM
+#define TRIQS_ARRAYS_EIGENELEMENTS_DIVIDE_AND_CONQUER_DIM 64
+#endif
+
 namespace triqs { namespace arrays { namespace linalg { 
 
  /**
@@ -46,10 +51,34 @@ namespace triqs { namespace arrays { namespace linalg {
   *  - read the eigenvalues/vectors in values and vectors resp.
   *  NB : the content of the matrix is destroyed by the computation (it is .vectors() in fact, if Compute_Eigenvectors is true).
   *  For a one shot usage, prefer eigenelements, eigenvalues functions.
+  *
+  * For many diagonalizations (e.g. on a grid of k points), construct the worker once (from a matrix or a dimension) 
+  * and call invoke(M) for each matrix M (a contiguous view, overwritten in place, by the eigenvectors if Compute_Eigenvectors) : 
+  * the workspace is sized with the lapack query at the first call and reused as long as the dimension does not change.
+  * For dimensions >= TRIQS_ARRAYS_EIGENELEMENTS_DIVIDE_AND_CONQUER_DIM, the divide and conquer routines (syevd/heevd) 
+  * are used instead of syev/heev (cf use_divide_and_conquer).
   */
  template<typename MatrixViewType, bool Compute_Eigenvectors > struct eigenelements_worker;
  template<typename T, typename Opt, bool Compute_Eigenvectors > struct eigenelements_worker_base;
 
+ namespace eigenelements_details { 
+  // syev/heev and syevd/heevd. With lwork = -1, only the workspace query.
+  inline void heev(char jobz, fortran_int_t n, double * a, double * w, double * work, fortran_int_t lwork, double *, fortran_int_t & info) { 
+   char uplo='U'; LAPACK_DSYEV(&jobz,&uplo,&n,a,&n,w,work,&lwork,&info);
+  }
+  inline void heev(char jobz, fortran_int_t n, dcomplex * a, double * w, dcomplex * work, fortran_int_t lwork, double * rwork, fortran_int_t & info) { 
+   char uplo='U'; LAPACK_ZHEEV(&jobz,&uplo,&n,a,&n,w,work,&lwork,rwork,&info);
+  }
+  inline void heevd(char jobz, fortran_int_t n, double * a, double * w, double * work, fortran_int_t lwork, double *, fortran_int_t, 
+    fortran_int_t * iwork, fortran_int_t liwork, fortran_int_t & info) { 
+   char uplo='U'; LAPACK_DSYEVD(&jobz,&uplo,&n,a,&n,w,work,&lwork,iwork,&liwork,&info);
+  }
+  inline void heevd(char jobz, fortran_int_t n, dcomplex * a, double * w, dcomplex * work, fortran_int_t lwork, double * rwork, fortran_int_t lrwork,
+    fortran_int_t * iwork, fortran_int_t liwork, fortran_int_t & info) { 
+   char uplo='U'; LAPACK_ZHEEVD(&jobz,&uplo,&n,a,&n,w,work,&lwork,rwork,&lrwork,iwork,&liwork,&info);
+  }
+ }
+
  template<typename T, typename Opt >
   struct eigenelements_worker_base <T,Opt,false> { 
    private:
@@ -58,26 +87,73 @@ namespace triqs { namespace arrays { namespace linalg {
     matrix_view <T,Opt> mat;
     triqs::arrays::vector<double> ev; 
     triqs::arrays::vector<T> work;
-    int dim,info,lwork;
+    triqs::arrays::vector<double> rwork;
+    triqs::arrays::vector<fortran_int_t> iwork;
+    fortran_int_t dim,info,lwork,lrwork,liwork;
     char uplo,compz;
-    bool has_run;
-
-    eigenelements_worker_base ( matrix_view <T,Opt> the_matrix) : mat(the_matrix) { 
-     if (mat.is_empty())   TRIQS_RUNTIME_ERROR<<"eigenelements_worker : the matrix is empty : matrix =  "<<mat<<"  ";
-     if (!mat.is_square())   TRIQS_RUNTIME_ERROR<<"eigenelements_worker : the matrix "<<mat<<" is not square ";
-     if (!mat.indexmap().is_contiguous())   TRIQS_RUNTIME_ERROR<<"eigenelements_worker : the matrix "<<mat<<" is not contiguous in memory";
-     dim = mat.dim0();
-     ev.resize(dim);
-     lwork = 64*dim;
+    bool has_run, dc, dc_forced;
+
+    eigenelements_worker_base ( matrix_view <T,Opt> the_matrix, char compz_ = 'N') : mat(the_matrix), dim(-1), uplo('U'), compz(compz_), has_run(false), dc_forced(false) { 
+     check(mat); resize_workspace(mat.dim0(), (mat.dim0() >= TRIQS_ARRAYS_EIGENELEMENTS_DIVIDE_AND_CONQUER_DIM));
+    }
+
+    eigenelements_worker_base ( size_t dim_, char compz_ = 'N') : mat(matrix<T,Opt>()), dim(-1), uplo('U'), compz(compz_), has_run(false), dc_forced(false) { 
+     resize_workspace(dim_, (fortran_int_t(dim_) >= TRIQS_ARRAYS_EIGENELEMENTS_DIVIDE_AND_CONQUER_DIM));
+    }
+
+    void check(matrix_view <T,Opt> const & m) const { 
+     if (m.is_empty())   TRIQS_RUNTIME_ERROR<<"eigenelements_worker : the matrix is empty : matrix =  "<<m<<"  ";
+     if (!m.is_square())   TRIQS_RUNTIME_ERROR<<"eigenelements_worker : the matrix "<<m<<" is not square ";
+     if (!m.indexmap().is_contiguous())   TRIQS_RUNTIME_ERROR<<"eigenelements_worker : the matrix "<<m<<" is not contiguous in memory";
+    }
+
+    // the workspace for matrices of dimension d, with the optimal sizes given by lapack
+    void resize_workspace(fortran_int_t d, bool dc_) { 
+     if ((d == dim) && (dc_ == dc)) return;
+     dim = d; dc = dc_;
+     ev.resize(std::max(dim,fortran_int_t(1)));
+     T w = 0; double rw = 0; fortran_int_t iw = 0; // rw is not set by the real heevd
+     rwork.resize(std::max(1,3*dim-2));
+     if (dc) {
+      eigenelements_details::heevd(compz, dim, NULL, NULL, &w, -1, &rw, -1, &iw, -1, info);
+      lrwork = std::max(fortran_int_t(rw), fortran_int_t(1)); liwork = std::max(iw, fortran_int_t(1));
+      rwork.resize(lrwork); iwork.resize(liwork);
+     }
+     else eigenelements_details::heev(compz, dim, NULL, NULL, &w, -1, rwork.data_start(), info);
+     lwork = std::max(fortran_int_t(std::real(w)), fortran_int_t(1));
      work.resize(lwork);
-     uplo='U';compz='N' ;
-     has_run = false;
     }
 
    public :
     array<double,1> values() const { 
      if (!has_run)  TRIQS_RUNTIME_ERROR<<"eigenelements_worker has not been invoked !";
-     return ev;
+     return ev(range(0,dim));
+    }
+
+    /// The eigenvalues without copy : NB they are overwritten by the next invoke
+    vector_view<double> values_view() const { 
+     if (!has_run)  TRIQS_RUNTIME_ERROR<<"eigenelements_worker has not been invoked !";
+     return ev(range(0,dim));
+    }
+
+    /// Force the use of the divide and conquer routine (syevd/heevd) or of the QR one (syev/heev)
+    void use_divide_and_conquer(bool b) { dc_forced = true; resize_workspace(dim, b);}
+
+    /// Diagonalize the matrix given at construction (or at the last invoke(M))
+    void invoke() { 
+     if (dc) 
+      eigenelements_details::heevd(compz, dim, mat.data_start(), ev.data_start(), work.data_start(), lwork, rwork.data_start(), lrwork, iwork.data_start(), liwork, info);
+     else
+      eigenelements_details::heev(compz, dim, mat.data_start(), ev.data_start(), work.data_start(), lwork, rwork.data_start(), info);
+     if (info)  TRIQS_RUNTIME_ERROR<<"eigenelements_worker :error code "<< (dc ? "syevd/heevd" : "syev/heev") << " : "<<info<<" for matrix "<<mat;
+     has_run = true;
+    }
+
+    /// Diagonalize M in place (M must be contiguous), reusing the workspace 
+    void invoke( matrix_view <T,Opt> const & M) { 
+     check(M); mat.rebind(M); has_run = false;
+     resize_workspace(M.dim0(), (dc_forced ? dc : (M.dim0() >= TRIQS_ARRAYS_EIGENELEMENTS_DIVIDE_AND_CONQUER_DIM)));
+     invoke();
     }
   };
 
@@ -86,7 +162,8 @@ namespace triqs { namespace arrays { namespace linalg {
  template<typename T, typename Opt>
   struct eigenelements_worker_base <T,Opt,true> : eigenelements_worker_base <T,Opt,false>  {
    protected:
-    eigenelements_worker_base ( matrix_view <T,Opt> the_matrix) :  eigenelements_worker_base <T,Opt,false>  (the_matrix) {this->compz='V'; }
+    eigenelements_worker_base ( matrix_view <T,Opt> the_matrix) :  eigenelements_worker_base <T,Opt,false>  (the_matrix,'V') {}
+    eigenelements_worker_base ( size_t dim_) :  eigenelements_worker_base <T,Opt,false>  (dim_,'V') {}
    public:
     matrix<T,Opt> vectors() const { 
      if (!this->has_run)  TRIQS_RUNTIME_ERROR<<"eigenelements_worker has not been invoked !";
@@ -96,31 +173,11 @@ namespace triqs { namespace arrays { namespace linalg {
 
  //--------------------------------
 
- template<typename Opt, bool Compute_Eigenvectors >
-  struct eigenelements_worker< matrix_view<double,Opt> ,Compute_Eigenvectors > :eigenelements_worker_base<double,Opt,Compute_Eigenvectors> { 
-   eigenelements_worker ( matrix_view <double,Opt> the_matrix) : eigenelements_worker_base<double,Opt,Compute_Eigenvectors> (the_matrix) {}
-   void invoke() {
-    fortran_int_t info;
-    TRIQS_FORTRAN(dsyev) (&this->compz,&this->uplo,&this->dim,this->mat.data_start(),&this->dim,this->ev.data_start(),this->work.data_start(),&this->lwork,&info);
-    if (info)  TRIQS_RUNTIME_ERROR<<"eigenelements_worker :error code dsyev : "<<info<<" for matrix "<<this->mat;
-    this->has_run = true;
-   }
-  };
-
- //--------------------------------
-
- template<typename Opt, bool Compute_Eigenvectors >
-  struct eigenelements_worker< matrix_view<dcomplex, Opt>,Compute_Eigenvectors > :eigenelements_worker_base<dcomplex,Opt,Compute_Eigenvectors> { 
-   triqs::arrays::vector <double> work2;   
-   public :
-   eigenelements_worker ( matrix_view <dcomplex,Opt> the_matrix) : eigenelements_worker_base<dcomplex,Opt,Compute_Eigenvectors> (the_matrix) {  work2.resize(this->lwork);}
-   void invoke() {
-    fortran_int_t info;
-    TRIQS_FORTRAN(zheev) (&this->compz,&this->uplo,&this->dim,this->mat.data_start(),
-      &this->dim,this->ev.data_start(),this->work.data_start(),&this->lwork,this->work2.data_start(),&info);
-    if (info)  TRIQS_RUNTIME_ERROR<<"eigenelements_worker :error code zheev : "<<info<<" for matrix "<<this->mat;
-    this->has_run = true;
-   }
+ template<typename T, typename Opt, bool Compute_Eigenvectors >
+  struct eigenelements_worker< matrix_view<T,Opt> ,Compute_Eigenvectors > :eigenelements_worker_base<T,Opt,Compute_Eigenvectors> { 
+   eigenelements_worker ( matrix_view <T,Opt> the_matrix) : eigenelements_worker_base<T,Opt,Compute_Eigenvectors> (the_matrix) {}
+   /// A worker for matrices of dimension dim_, without matrix : use invoke(M)
+   explicit eigenelements_worker ( size_t dim_) : eigenelements_worker_base<T,Opt,Compute_Eigenvectors> (dim_) {}
   };
 
  //--------------------------------
@@ -153,6 +210,25 @@ namespace triqs { namespace arrays { namespace linalg {
    eigenelements_worker<MatrixViewType,false> W(take_copy ? make_clone(M)() : M()); W.invoke(); return W.values(); 
   }
 
+ //--------------------------------
+
+ /**
+  * Diagonalization in place, without copy of the matrix.
+  * @param M : the matrix (or a view), it MUST be contiguous. It is overwritten by the eigenvectors (same layout as in eigenelements).
+  * @param ev : a vector (or a view) of size dim, filled with the eigenvalues.
+  * For repeated calls, prefer an eigenelements_worker, which keeps its workspace.
+  */
+ template<typename MatrixType, typename VectorType>   
+  void eigenelements_in_place( MatrixType const & M, VectorType & ev) { 
+   eigenelements_worker<typename MatrixType::view_type,true> W(M); W.invoke(); ev = W.values();
+  }
+
+ /// Same as eigenelements_in_place, but only the eigenvalues are computed : M is destroyed.
+ template<typename MatrixType, typename VectorType>   
+  void eigenvalues_in_place( MatrixType const & M, VectorType & ev) { 
+   eigenelements_worker<typename MatrixType::view_type,false> W(M); W.invoke(); ev = W.values();
+  }
+
 }}} // namespace triqs::arrays::linalg
 #undef dcomplex
 #endif
@@ -202,11 +202,11 @@ namespace triqs { namespace arrays {
 
  template<typename RHS, typename V, typename Opt> 
   typename boost::enable_if<is_scalar_for<RHS,matrix_view<V,Opt> > >::type
-  triqs_arrays_assign_delegation (matrix<V,Opt> & lhs, RHS const & rhs) { indexmaps::foreach( __looper<V,RHS>(rhs),lhs); }
+  triqs_arrays_assign_delegation (matrix<V,Opt> & lhs, RHS const & rhs) { indexmaps::parallel_foreach( __looper<V,RHS>(rhs),lhs); }
 
  template<typename RHS, typename V, typename Opt> 
   typename boost::enable_if<is_scalar_for<RHS,matrix_view<V,Opt> > >::type
-  triqs_arrays_assign_delegation (matrix_view<V,Opt> & lhs, RHS const & rhs) { indexmaps::foreach( __looper<V,RHS>(rhs),lhs); }
+  triqs_arrays_assign_delegation (matrix_view<V,Opt> & lhs, RHS const & rhs) { indexmaps::parallel_foreach( __looper<V,RHS>(rhs),lhs); }
 
 
 }}//namespace triqs::arrays
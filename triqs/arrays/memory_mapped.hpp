@@ -0,0 +1,207 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef TRIQS_ARRAYS_MEMORY_MAPPED_H
+#define TRIQS_ARRAYS_MEMORY_MAPPED_H
+#include <string>
+#include <cstring>
+#include <complex>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/type_traits/is_const.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/type_traits/remove_const.hpp>
+#include "./array.hpp"
+
+namespace triqs { namespace arrays { namespace memory_mapped { 
+
+ /**
+  * Arrays stored in a file and mapped in memory (mmap) : the data is loaded by the system when it is used, 
+  * hence the file can be larger than the RAM.
+  * The file is raw : a header of 128 bytes (magic, value type, rank, memory order, lengths) followed by the data, 
+  * in the native byte order. 
+  * 
+  *   array_view<double,2> A = memory_mapped::create<double,2>("a.dat", make_shape(n1,n2)); // new file, read-write
+  *   array_view<double,2> B = memory_mapped::open<double,2>("a.dat");         // existing file, read-write
+  *   array_view<const double,2> C = memory_mapped::open<const double,2>("a.dat"); // read-only
+  *
+  * The views are usual views (zero copy) : they can be used in expressions, linalg, sliced ...
+  * The file is unmapped when the last view on it is destroyed.
+  * Only the C and Fortran memory orders are supported.
+  */
+
+ /// Hints to the system on the use of the memory (cf madvise)
+ enum advice { normal, sequential, random, will_need, dont_need };
+
+ namespace details { 
+
+  template<typename T> struct value_code;
+  template<> struct value_code<int>                   { static const char c = 'i';};
+  template<> struct value_code<unsigned int>          { static const char c = 'I';};
+  template<> struct value_code<long>                  { static const char c = 'l';};
+  template<> struct value_code<unsigned long>         { static const char c = 'L';};
+  template<> struct value_code<float>                 { static const char c = 'f';};
+  template<> struct value_code<double>                { static const char c = 'd';};
+  template<> struct value_code<std::complex<float> >  { static const char c = 'F';};
+  template<> struct value_code<std::complex<double> > { static const char c = 'D';};
+
+  template<typename OrderTag> struct order_code { 
+   static_assert( (boost::is_same<OrderTag,Tag::C>::value || boost::is_same<OrderTag,Tag::Fortran>::value), 
+     "memory_mapped : only C and Fortran orders are supported");
+   static const char c = (boost::is_same<OrderTag,Tag::C>::value ? 'C' : 'F');
+  };
+
+  struct header { 
+   char magic[8]; 
+   uint32_t version, rank, value_size; 
+   char value_code, order_code, unused[2];
+   uint64_t lengths[ARRAY_NRANK_MAX];
+  };
+  static const size_t header_size = 128; // the data is 64 bytes aligned in the file
+  static_assert( (sizeof(header) <= header_size), "Internal error");
+  inline const char * magic() { return "TRIQSMM";}
+
+  inline int to_madvise(advice a) { 
+   switch(a) { 
+    case sequential : return MADV_SEQUENTIAL;
+    case random : return MADV_RANDOM;
+    case will_need : return MADV_WILLNEED;
+    case dont_need : return MADV_DONTNEED;
+    default : return MADV_NORMAL;
+   }
+  }
+
+  // the mapping of a whole file. Unmapped at destruction
+  struct mapping { 
+   void * addr; size_t length;
+   mapping(void * a, size_t l) : addr(a), length(l) {}
+   ~mapping() { munmap(addr,length);}
+  };
+
+  // close the file descriptor at the end of the scope
+  struct file_guard { int fd; file_guard(int f) : fd(f) {} ~file_guard() { close(fd);} };
+
+  inline void check (bool ok, std::string const & filename, const char * what) { 
+   if (!ok) TRIQS_RUNTIME_ERROR << "memory_mapped : "<< what << " " << filename << " failed : "<< strerror(errno);
+  }
+
+  // map the file fd, and make a view on the data
+  template<typename T, int R, typename Opt> 
+   array_view<T,R,Opt> map(int fd, size_t file_size, mini_vector<size_t,R> const & lengths, advice a, std::string const & filename) { 
+    typedef typename boost::remove_const<T>::type V;
+    const int prot = (boost::is_const<T>::value ? PROT_READ : PROT_READ | PROT_WRITE);
+    void * addr = ::mmap(NULL, file_size, prot, MAP_SHARED, fd, 0);
+    check(addr != MAP_FAILED, filename, "mmap of");
+    boost::shared_ptr<void> owner(new mapping(addr,file_size));
+    madvise(addr, file_size, to_madvise(a));
+    typedef typename array_view<T,R,Opt>::indexmap_type indexmap_type;
+    typename indexmap_type::domain_type dom(lengths);
+    indexmap_type im(dom);
+    V * data = reinterpret_cast<V *>(static_cast<char *>(addr) + header_size);
+    return array_view<T,R,Opt>(im, storages::shared_block<T>(data, im.domain().number_of_elements(), owner));
+   }
+ }
+
+ /**
+  * Create (or overwrite) the file filename, for an array of the given lengths, filled with 0.
+  * Returns a read-write view on it.
+  */
+ template<typename T, int R, typename Opt> 
+  array_view<T,R,Opt> create(std::string const & filename, mini_vector<size_t,R> const & lengths, advice a = normal) { 
+   static_assert( (!boost::is_const<T>::value), "memory_mapped::create : the value type can not be const");
+   details::header h; memset(&h,0,sizeof(h));
+   strncpy(h.magic, details::magic(), 8);
+   h.version = 1; h.rank = R; h.value_size = sizeof(T); 
+   h.value_code = details::value_code<T>::c; h.order_code = details::order_code<typename Opt::IndexOrderTag>::c;
+   size_t n = 1; 
+   for (int r=0; r<R; ++r) { h.lengths[r] = lengths[r]; n *= lengths[r];}
+   const size_t file_size = details::header_size + n * sizeof(T);
+   int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+   details::check(fd>=0, filename, "creation of");
+   details::file_guard g(fd);
+   details::check(pwrite(fd, &h, sizeof(h), 0) == ssize_t(sizeof(h)), filename, "writing the header of");
+   details::check(ftruncate(fd, file_size)==0, filename, "resizing");
+   return details::map<T,R,Opt>(fd, file_size, lengths, a, filename);
+  }
+
+ template<typename T, int R> 
+  array_view<T,R> create(std::string const & filename, mini_vector<size_t,R> const & lengths, advice a = normal) { return create<T,R,Option::Default>(filename,lengths,a);}
+
+ /**
+  * Map the existing file filename. 
+  * Read-only if T is const (e.g. open<const double,2>), read-write otherwise.
+  * Throws if the value type, the rank or the memory order in the file do not match. 
+  */
+ template<typename T, int R, typename Opt> 
+  array_view<T,R,Opt> open(std::string const & filename, advice a = normal) { 
+   typedef typename boost::remove_const<T>::type V;
+   int fd = ::open(filename.c_str(), (boost::is_const<T>::value ? O_RDONLY : O_RDWR));
+   details::check(fd>=0, filename, "opening");
+   details::file_guard g(fd);
+   struct stat st; 
+   details::check(fstat(fd,&st)==0, filename, "stat of");
+   details::header h; 
+   if ((size_t(st.st_size) < details::header_size) || (pread(fd, &h, sizeof(h), 0) != ssize_t(sizeof(h))) || (strncmp(h.magic, details::magic(), 8)!=0)) 
+    TRIQS_RUNTIME_ERROR << "memory_mapped : "<< filename << " is not a memory mapped array file";
+   if ((h.value_code != details::value_code<V>::c) || (h.value_size != sizeof(V))) 
+    TRIQS_RUNTIME_ERROR << "memory_mapped : "<< filename << " : value type mismatch (code "<< h.value_code<< " in the file)";
+   if (h.rank != R) TRIQS_RUNTIME_ERROR << "memory_mapped : "<< filename << " : the rank is "<< h.rank << " in the file, "<< R << " expected";
+   if (h.order_code != details::order_code<typename Opt::IndexOrderTag>::c) 
+    TRIQS_RUNTIME_ERROR << "memory_mapped : "<< filename << " : memory order mismatch ("<< h.order_code << " in the file)";
+   mini_vector<size_t,R> lengths; size_t n = 1; 
+   for (int r=0; r<R; ++r) { lengths[r] = h.lengths[r]; n *= lengths[r];}
+   if (size_t(st.st_size) < details::header_size + n * sizeof(V)) TRIQS_RUNTIME_ERROR << "memory_mapped : "<< filename << " is truncated";
+   return details::map<T,R,Opt>(fd, st.st_size, lengths, a, filename);
+  }
+
+ template<typename T, int R> 
+  array_view<T,R> open(std::string const & filename, advice a = normal) { return open<T,R,Option::Default>(filename,a);}
+
+ // the pages containing the data of A
+ template<typename A> std::pair<char *, size_t> pages(A const & a) { 
+  std::ptrdiff_t last = 0; // offset of the last element
+  for (size_t r=0; r<A::rank; ++r) last += (std::ptrdiff_t(a.indexmap().lengths()[r]) -1) * a.indexmap().strides()[r];
+  const size_t page = sysconf(_SC_PAGESIZE);
+  char * start = (char *)(a.data_start()), * end = (char*)(a.data_start() + last + 1);
+  char * start_page = (char *)( (size_t(start) / page) * page);
+  return std::make_pair(start_page, size_t(end - start_page));
+ }
+
+ /// Change the advice for the part of the file seen by A (a view on a memory mapped file, or a slice of it)
+ template<typename A> void advise(A const & a, advice adv) { 
+  if (a.indexmap().domain().number_of_elements()==0) return;
+  std::pair<char *, size_t> p = pages(a);
+  if (madvise(p.first, p.second, details::to_madvise(adv))!=0) TRIQS_RUNTIME_ERROR << "memory_mapped : madvise failed : "<< strerror(errno);
+ }
+
+ /// Write the modifications of the data of A to the file (cf msync). 
+ template<typename A> void flush(A const & a) { 
+  if (a.indexmap().domain().number_of_elements()==0) return;
+  std::pair<char *, size_t> p = pages(a);
+  if (msync(p.first, p.second, MS_SYNC)!=0) TRIQS_RUNTIME_ERROR << "memory_mapped : msync failed : "<< strerror(errno);
+ }
+
+}}}//namespace triqs::arrays::memory_mapped
+#endif
@@ -0,0 +1,224 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIQS_ARRAYS_MPI_COLLECTIVES_H
+#define TRIQS_ARRAYS_MPI_COLLECTIVES_H
+#include "./common.hpp"
+
+/**
+ * Collective communications of arrays, matrices, vectors and their views, without serialization : 
+ * the data are given directly to MPI, with the native type of the elements (and e.g. MPI_SUM)
+ * for data contiguous in C order, or a derived datatype describing the strides of a view.
+ * 
+ * All the functions take a boost::mpi::communicator. The result of a reduce, bcast, scatter, gather 
+ * is resized if it is an array, or checked if it is a view.
+ * The reductions of a non contiguous view are done through a C ordered copy, since the MPI operations
+ * (MPI_SUM, ...) are not defined on derived datatypes in all implementations. 
+ */
+namespace triqs { namespace arrays { namespace mpi { 
+
+ namespace details { 
+
+  // calls f(pointer, count, type) on the chunks of the buffer b
+  template<typename F> void for_chunks(buffer const & b, F f) { 
+   for (size_t k=0; k< b.count; k+= max_count) f(b.at(k), int(std::min(max_count, b.count - k)), b.type);
+   if (b.count==0) f(b.start, 0, b.type);
+  }
+
+  // same on 2 buffers with the same number of elements
+  template<typename F> void for_chunks(buffer const & b1, buffer const & b2, F f) { 
+   assert(b1.count == b2.count); assert(!b1.derived && !b2.derived);
+   for (size_t k=0; k< b1.count; k+= max_count) f(b1.at(k), b2.at(k), int(std::min(max_count, b1.count - k)), b1.type);
+   if (b1.count==0) f(b1.start, b2.start, 0, b1.type);
+  }
+
+  template<typename A> struct compact { typedef array<typename A::value_type, A::rank> type;};
+
+  // the shape of A on node root, broadcasted to all nodes
+  template<typename A> typename A::shape_type bcast_shape(boost::mpi::communicator const & c, A const & a, int root) { 
+   typename A::shape_type sh = a.shape();
+   MPI_Bcast(&sh[0], A::rank, native_type_from_C(size_t()), root, c);
+   return sh;
+  }
+
+  // the shape of A with a first length n
+  template<typename A> typename A::shape_type with_rows(typename A::shape_type sh, size_t n) { sh[0] = n; return sh;}
+ }
+
+ /**
+  * \brief Reduction of a on the node root : r = op (a on all nodes)
+  * \param c The communicator
+  * \param a The array/view to reduce (same shape on all nodes)
+  * \param r The result, used only on node root (can not be a)
+  * \param op The MPI operation [default MPI_SUM]
+  */
+ template<typename A, typename R>
+  void reduce (boost::mpi::communicator const & c, A const & a, R & r, int root = 0, MPI_Op op = MPI_SUM) { 
+   buffer sa(a);
+   if (sa.derived) { typename details::compact<A>::type tmp(a); reduce(c,tmp,r,root,op); return;}
+   if (c.rank()!=root) { 
+    details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Reduce(p, NULL, n, t, op, root, c);});
+    return;
+   }
+   resize_or_check_if_view(r, a.shape());
+   buffer sr(r);
+   if (sr.derived) { typename details::compact<A>::type tmp(a.shape()); reduce(c,a,tmp,root,op); r = tmp; return;}
+   details::for_chunks(sa, sr, [&](void * p, void * q, int n, MPI_Datatype t) { MPI_Reduce(p, q, n, t, op, root, c);});
+  }
+
+ /// Reduction in place : on the node root, a = op (a on all nodes)
+ template<typename A>
+  void reduce_in_place (boost::mpi::communicator const & c, A & a, int root = 0, MPI_Op op = MPI_SUM) { 
+   buffer sa(a);
+   if (sa.derived) { typename details::compact<A>::type tmp(a); reduce_in_place(c,tmp,root,op); if (c.rank()==root) a = tmp; return;}
+   const bool is_root = (c.rank()==root);
+   details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Reduce((is_root ? MPI_IN_PLACE : p), (is_root ? p : NULL), n, t, op, root, c);});
+  }
+
+ /// Reduction on all nodes : r = op (a on all nodes)
+ template<typename A, typename R>
+  void allreduce (boost::mpi::communicator const & c, A const & a, R & r, MPI_Op op = MPI_SUM) { 
+   buffer sa(a);
+   if (sa.derived) { typename details::compact<A>::type tmp(a); allreduce(c,tmp,r,op); return;}
+   resize_or_check_if_view(r, a.shape());
+   buffer sr(r);
+   if (sr.derived) { typename details::compact<A>::type tmp(a.shape()); allreduce(c,a,tmp,op); r = tmp; return;}
+   details::for_chunks(sa, sr, [&](void * p, void * q, int n, MPI_Datatype t) { MPI_Allreduce(p, q, n, t, op, c);});
+  }
+
+ /// Reduction in place on all nodes : a = op (a on all nodes)
+ template<typename A>
+  void allreduce_in_place (boost::mpi::communicator const & c, A & a, MPI_Op op = MPI_SUM) { 
+   buffer sa(a);
+   if (sa.derived) { typename details::compact<A>::type tmp(a); allreduce_in_place(c,tmp,op); a = tmp; return;}
+   details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Allreduce(MPI_IN_PLACE, p, n, t, op, c);});
+  }
+
+ /// Broadcast of a from node root : a is resized (or checked for a view) on the other nodes
+ template<typename A>
+  void bcast (boost::mpi::communicator const & c, A & a, int root = 0) { 
+   typename A::shape_type sh = details::bcast_shape(c,a,root);
+   if (c.rank()!=root) resize_or_check_if_view(a, sh);
+   buffer sa(a);
+   details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Bcast(p, n, t, root, c);});
+  }
+
+ /**
+  * \brief Scatter of the rows (first index) of a on node root : each node receives a slice of consecutive rows in r
+  * The rows are distributed as evenly as possible, the first nodes receiving one more row if needed.
+  */
+ template<typename A, typename R>
+  void scatter (boost::mpi::communicator const & c, A const & a, R & r, int root = 0) { 
+   typename A::shape_type sh = details::bcast_shape(c,a,root);
+   const std::pair<int,int> mine = slice_rows(sh[0], c.size(), c.rank());
+   resize_or_check_if_view(r, details::with_rows<R>(sh, mine.first));
+   row_buffer sr(r);
+   if (c.rank()!=root) { MPI_Scatterv(NULL, NULL, NULL, sr.type, sr.start, mine.first, sr.type, root, c); return;}
+   row_buffer sa(a);
+   std::vector<int> counts(c.size()), displs(c.size());
+   for (int u=0; u<c.size(); ++u) { std::pair<int,int> x = slice_rows(sh[0], c.size(), u); counts[u] = x.first; displs[u] = x.second;}
+   MPI_Scatterv(sa.start, &counts[0], &displs[0], sa.type, sr.start, mine.first, sr.type, root, c);
+  }
+
+ /// Gather on node root of the rows (first index) of a on all nodes, in the order of the ranks. r is used only on node root.
+ template<typename A, typename R>
+  void gather (boost::mpi::communicator const & c, A const & a, R & r, int root = 0) { 
+   row_buffer sa(a);
+   int n = sa.n_rows;
+   std::vector<int> counts(c.size()), displs(c.size());
+   MPI_Gather(&n, 1, MPI_INT, &counts[0], 1, MPI_INT, root, c);
+   if (c.rank()!=root) { MPI_Gatherv(sa.start, n, sa.type, NULL, NULL, NULL, sa.type, root, c); return;}
+   size_t tot=0;
+   for (int u=0; u<c.size(); ++u) { displs[u] = int(tot); tot += counts[u];}
+   resize_or_check_if_view(r, details::with_rows<R>(a.shape(), tot));
+   row_buffer sr(r);
+   MPI_Gatherv(sa.start, n, sa.type, sr.start, &counts[0], &displs[0], sr.type, root, c);
+  }
+
+ /// Gather on all nodes of the rows (first index) of a on all nodes, in the order of the ranks.
+ template<typename A, typename R>
+  void allgather (boost::mpi::communicator const & c, A const & a, R & r) { 
+   row_buffer sa(a);
+   int n = sa.n_rows;
+   std::vector<int> counts(c.size()), displs(c.size());
+   MPI_Allgather(&n, 1, MPI_INT, &counts[0], 1, MPI_INT, c);
+   size_t tot=0;
+   for (int u=0; u<c.size(); ++u) { displs[u] = int(tot); tot += counts[u];}
+   resize_or_check_if_view(r, details::with_rows<R>(a.shape(), tot));
+   row_buffer sr(r);
+   MPI_Allgatherv(sa.start, n, sa.type, sr.start, &counts[0], &displs[0], sr.type, c);
+  }
+
+#if MPI_VERSION >= 3
+ /*
+  * Non-blocking versions : the shapes must already be the correct ones on all nodes (nothing is resized), 
+  * and a non contiguous view is only accepted in ibcast (no temporary copy is made).
+  * The arrays must not be used before the request is completed.
+  */
+
+ /// Non-blocking reduce (no temporary copy : a and r must be contiguous in C order)
+ template<typename A, typename R>
+  request ireduce (boost::mpi::communicator const & c, A const & a, R & r, int root = 0, MPI_Op op = MPI_SUM) { 
+   request req; buffer sa(a);
+   if (sa.derived) TRIQS_RUNTIME_ERROR << "mpi::ireduce : the array must be contiguous in C order";
+   if (c.rank()!=root) { 
+    details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Request q; MPI_Ireduce(p, NULL, n, t, op, root, c, &q); req.push_back(q);});
+    return req;
+   }
+   if (r.shape() != a.shape()) TRIQS_RUNTIME_ERROR << "mpi::ireduce : shape mismatch "<< r.shape() << " vs " << a.shape();
+   buffer sr(r);
+   if (sr.derived) TRIQS_RUNTIME_ERROR << "mpi::ireduce : the result must be contiguous in C order";
+   details::for_chunks(sa, sr, [&](void * p, void * q, int n, MPI_Datatype t) { MPI_Request x; MPI_Ireduce(p, q, n, t, op, root, c, &x); req.push_back(x);});
+   return req;
+  }
+
+ /// Non-blocking reduce in place
+ template<typename A>
+  request ireduce_in_place (boost::mpi::communicator const & c, A & a, int root = 0, MPI_Op op = MPI_SUM) { 
+   request req; buffer sa(a);
+   if (sa.derived) TRIQS_RUNTIME_ERROR << "mpi::ireduce_in_place : the array must be contiguous in C order";
+   const bool is_root = (c.rank()==root);
+   details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { 
+     MPI_Request q; MPI_Ireduce((is_root ? MPI_IN_PLACE : p), (is_root ? p : NULL), n, t, op, root, c, &q); req.push_back(q);});
+   return req;
+  }
+
+ /// Non-blocking allreduce in place
+ template<typename A>
+  request iallreduce_in_place (boost::mpi::communicator const & c, A & a, MPI_Op op = MPI_SUM) { 
+   request req; buffer sa(a);
+   if (sa.derived) TRIQS_RUNTIME_ERROR << "mpi::iallreduce_in_place : the array must be contiguous in C order";
+   details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Request q; MPI_Iallreduce(MPI_IN_PLACE, p, n, t, op, c, &q); req.push_back(q);});
+   return req;
+  }
+
+ /// Non-blocking broadcast
+ template<typename A>
+  request ibcast (boost::mpi::communicator const & c, A & a, int root = 0) { 
+   request req; buffer sa(a);
+   details::for_chunks(sa, [&](void * p, int n, MPI_Datatype t) { MPI_Request q; MPI_Ibcast(p, n, t, root, c, &q); req.push_back(q);});
+   return req;
+  }
+#endif
+
+}}}
+#endif
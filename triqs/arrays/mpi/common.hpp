@@ -0,0 +1,157 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIQS_ARRAYS_MPI_COMMON_H
+#define TRIQS_ARRAYS_MPI_COMMON_H
+#include "../array.hpp"
+#include <mpi.h>
+#include <boost/mpi/communicator.hpp>
+#include <boost/noncopyable.hpp>
+#include <climits>
+#include <vector>
+
+namespace triqs { namespace arrays { namespace mpi { 
+
+ // conversion of C type to MPI native
+ inline MPI_Datatype native_type_from_C(char)                     { return MPI_CHAR; }
+ inline MPI_Datatype native_type_from_C(signed char)              { return MPI_SIGNED_CHAR; }
+ inline MPI_Datatype native_type_from_C(unsigned char)            { return MPI_UNSIGNED_CHAR; }
+ inline MPI_Datatype native_type_from_C(short)                    { return MPI_SHORT; }
+ inline MPI_Datatype native_type_from_C(unsigned short)           { return MPI_UNSIGNED_SHORT; }
+ inline MPI_Datatype native_type_from_C(int)                      { return MPI_INT; }
+ inline MPI_Datatype native_type_from_C(unsigned)                 { return MPI_UNSIGNED; }
+ inline MPI_Datatype native_type_from_C(long)                     { return MPI_LONG; }
+ inline MPI_Datatype native_type_from_C(unsigned long)            { return MPI_UNSIGNED_LONG; }
+ inline MPI_Datatype native_type_from_C(long long)                { return MPI_LONG_LONG; }
+ inline MPI_Datatype native_type_from_C(unsigned long long)       { return MPI_UNSIGNED_LONG_LONG; }
+ inline MPI_Datatype native_type_from_C(float)                    { return MPI_FLOAT; }
+ inline MPI_Datatype native_type_from_C(double)                   { return MPI_DOUBLE; }
+ inline MPI_Datatype native_type_from_C(long double)              { return MPI_LONG_DOUBLE; }
+ inline MPI_Datatype native_type_from_C(std::complex<float>)      { return MPI_C_FLOAT_COMPLEX; }
+ inline MPI_Datatype native_type_from_C(std::complex<double>)     { return MPI_C_DOUBLE_COMPLEX; }
+ inline MPI_Datatype native_type_from_C(std::complex<long double>){ return MPI_C_LONG_DOUBLE_COMPLEX; }
+
+ // the number of elements sent in one call for contiguous data (MPI counts are int)
+ static const size_t max_count = size_t(1)<<30;
+
+ /**
+  * The data of an array or a view, as seen by MPI, in the C order of the indices.
+  *  - if the data are contiguous in C order, the native type of the elements with count = number of elements. 
+  *    Then the collectives are done by chunks of at most max_count elements.
+  *  - otherwise, a derived datatype (nested hvectors) describing the strides, with count =1 (not for reductions).
+  */
+ struct buffer : boost::noncopyable { 
+  void * start;
+  MPI_Datatype type; size_t count, elem_size;
+  bool derived;
+
+  template<typename ArrayType> 
+   explicit buffer (ArrayType const & A) : 
+    start((void *)(A.data_start())), type(native_type_from_C(typename ArrayType::value_type())), 
+    count(A.indexmap().domain().number_of_elements()), elem_size(sizeof(typename ArrayType::value_type)), derived(false) { 
+     static const int R = ArrayType::rank;
+     init(R, &(A.indexmap().domain().lengths()[0]), &(A.indexmap().strides()[0]));
+    }
+
+  ~buffer() { if (derived) MPI_Type_free(&type);}
+
+  /// A pointer to the element number n (in memory) of the buffer. Only for contiguous data.
+  void * at (size_t n) const { return (void *)( static_cast<char *>(start) + n*elem_size);}
+
+  private: 
+  template<typename L, typename S>
+   void init(int R, L const * lengths, S const * strides) { 
+    // is it contiguous in C order ?
+    bool compact = true; std::ptrdiff_t s = 1;
+    for (int r=R-1; r>=0; --r) { if ((lengths[r]>1) && (strides[r]!=s)) compact = false; s *= lengths[r];}
+    if (compact || (count==0)) return;
+    // nested hvectors, from the last index to the first one
+    MPI_Datatype t = type;
+    for (int r=R-1; r>=0; --r) { 
+     MPI_Datatype t2;
+     MPI_Type_create_hvector(int(lengths[r]), 1, MPI_Aint(strides[r]*elem_size), t, &t2);
+     if (t!=type) MPI_Type_free(&t);
+     t = t2;
+    }
+    MPI_Type_commit(&t);
+    type = t; count = 1; derived = true;
+   }
+ };
+
+ /**
+  * The rows (i.e. the slices at fixed first index) of an array or a view, as seen by MPI : 
+  * a datatype for one row, with an extent equal to the stride of the first index, 
+  * so that the rows [n, n+k[ are (start, offset n, count k) in MPI collectives.
+  */
+ struct row_buffer : boost::noncopyable { 
+  void * start;
+  MPI_Datatype type;
+  size_t n_rows;
+
+  template<typename ArrayType> 
+   explicit row_buffer (ArrayType const & A) : 
+    start((void *)(A.data_start())), n_rows(A.indexmap().domain().lengths()[0]) { 
+     typedef typename ArrayType::value_type V;
+     static const int R = ArrayType::rank;
+     MPI_Datatype t = native_type_from_C(V()), elem = t;
+     for (int r=R-1; r>=1; --r) { 
+      MPI_Datatype t2;
+      MPI_Type_create_hvector(int(A.indexmap().domain().lengths()[r]), 1, MPI_Aint(A.indexmap().strides()[r]*sizeof(V)), t, &t2);
+      if (t!=elem) MPI_Type_free(&t);
+      t = t2;
+     }
+     MPI_Type_create_resized(t, 0, MPI_Aint(A.indexmap().strides()[0]*sizeof(V)), &type);
+     if (t!=elem) MPI_Type_free(&t);
+     MPI_Type_commit(&type);
+    }
+
+  ~row_buffer() { MPI_Type_free(&type);}
+ };
+
+ /// The number of rows and the first row of the node rank when n rows are distributed over size nodes
+ inline std::pair<int,int> slice_rows (size_t n, int size, int rank) { 
+  const size_t q = n/size, r = n%size;
+  const size_t first = rank*q + std::min(size_t(rank),r);
+  return std::make_pair(int(q + (size_t(rank)<r ? 1 : 0)), int(first));
+ }
+
+ /**
+  * The requests of a non-blocking collective. 
+  * The arrays involved must not be touched (nor destroyed) before wait() returns.
+  */
+ class request { 
+  std::vector<MPI_Request> reqs;
+  public:
+  void push_back(MPI_Request r) { reqs.push_back(r);}
+  /// Waits for the completion of the collective
+  void wait() { if (reqs.size()) MPI_Waitall(int(reqs.size()), &reqs[0], MPI_STATUSES_IGNORE); reqs.clear();}
+  /// Is the collective completed ? 
+  bool test() { 
+   int flag = 1;
+   if (reqs.size()) MPI_Testall(int(reqs.size()), &reqs[0], &flag, MPI_STATUSES_IGNORE);
+   if (flag) reqs.clear();
+   return flag;
+  }
+ };
+
+}}}
+#endif
@@ -0,0 +1,221 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef TRIQS_STORAGES_ALIGNED_POOL_H
+#define TRIQS_STORAGES_ALIGNED_POOL_H
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <ostream>
+#include <mutex>
+#include <triqs/utility/exceptions.hpp>
+#include "./common.hpp"
+
+namespace triqs { namespace arrays { 
+ namespace storages  { 
+
+  /**
+   * A pool of 64 bytes aligned memory blocks, used by the arrays with the Tag::aligned_pool option.
+   *
+   *  - The blocks are sorted in size classes (powers of 2, from 64 bytes to 64 MB). 
+   *    A freed block is kept in the pool (up to max_cached_bytes() in total) 
+   *    and reused by the next allocation of the same class : no malloc in the loops which create temporaries.
+   *  - Larger blocks are allocated and freed directly.
+   *  - The pool is shared by all threads. It is protected by a std::mutex, hence it is thread-safe 
+   *    with OpenMP as well as with any other threading library.
+   *  - statistics() counts the allocations, the bytes and the blocks really obtained from the system.
+   */
+  class aligned_pool { 
+   public: 
+
+   static const size_t alignment = 64;
+
+   struct statistics_type { 
+    size_t n_allocations;        // number of calls to allocate
+    size_t n_deallocations;      // number of calls to deallocate
+    size_t n_system_allocations; // number of blocks allocated by the system (i.e. not found in the pool)
+    size_t bytes_requested;      // total number of bytes requested to allocate
+    size_t bytes_in_use;         // bytes (of the size classes) currently used by the arrays
+    size_t peak_bytes_in_use;    // maximum of bytes_in_use
+    size_t bytes_cached;         // bytes kept in the pool for reuse
+    friend std::ostream & operator<<(std::ostream & out, statistics_type const & s) { 
+     return out << "allocations : "<< s.n_allocations << " (system : "<< s.n_system_allocations<< "), deallocations : "<< s.n_deallocations
+      << ", bytes requested : "<< s.bytes_requested << ", in use : "<< s.bytes_in_use << " (peak : "<< s.peak_bytes_in_use 
+      << "), cached : "<< s.bytes_cached;
+    }
+   };
+
+   /// A block of at least n bytes, aligned on 64 bytes
+   static void * allocate (size_t n) { 
+    const int c = size_class(n);
+    const size_t bytes = class_bytes(c,n);
+    void * block = NULL; 
+    pool & P(instance());
+    if (c < n_classes) { 
+     std::lock_guard<std::mutex> lock(P.mutex);
+     if (!P.free_blocks[c].empty()) { 
+      block = P.free_blocks[c].back(); P.free_blocks[c].pop_back(); P.stats.bytes_cached -= bytes; 
+      P.count_allocation(n, bytes, false);
+      return static_cast<char*>(block) + alignment;
+     }
+    }
+    if (posix_memalign(&block, alignment, bytes + alignment)!=0) { 
+     release_after_failure(bytes); // give the cached blocks back to the system and retry once
+     if (posix_memalign(&block, alignment, bytes + alignment)!=0) 
+      TRIQS_RUNTIME_ERROR<< "Memory allocation error : aligned_pool can not allocate "<< bytes << " bytes";
+    }
+    header(block)->size_class = c; header(block)->bytes = bytes;
+    { 
+     std::lock_guard<std::mutex> lock(P.mutex);
+     P.count_allocation(n, bytes, true);
+    }
+    return static_cast<char*>(block) + alignment;
+   }
+
+   /// Give back a block obtained by allocate 
+   static void deallocate (void * p) { 
+    if (p==NULL) return;
+    void * block = static_cast<char*>(p) - alignment;
+    const int c = header(block)->size_class; const size_t bytes = header(block)->bytes;
+    bool keep = false;
+    pool & P(instance());
+    { 
+     std::lock_guard<std::mutex> lock(P.mutex);
+     ++P.stats.n_deallocations; P.stats.bytes_in_use -= bytes;
+     if ((c < n_classes) && (P.stats.bytes_cached + bytes <= P.max_cached_bytes)) { 
+      P.free_blocks[c].push_back(block); P.stats.bytes_cached += bytes; keep = true;
+     }
+    }
+    if (!keep) free(block);
+   }
+
+   /// Statistics since the start or the last reset_statistics
+   static statistics_type statistics() { 
+    pool & P(instance());
+    std::lock_guard<std::mutex> lock(P.mutex);
+    return P.stats;
+   }
+
+   /// Reset the counters (the bytes in use and in the pool are kept)
+   static void reset_statistics() { 
+    pool & P(instance());
+    { 
+     std::lock_guard<std::mutex> lock(P.mutex);
+     statistics_type & s(P.stats);
+     s.n_allocations = s.n_deallocations = s.n_system_allocations = s.bytes_requested = 0; 
+     s.peak_bytes_in_use = s.bytes_in_use;
+    }
+   }
+
+   /// Free all the blocks kept in the pool
+   static void release() { release_after_failure(std::numeric_limits<size_t>::max());}
+
+   /// Maximal number of bytes kept in the pool [default : 256 MB]
+   static size_t max_cached_bytes() { return instance().max_cached_bytes;}
+   static void set_max_cached_bytes(size_t n) { 
+    bool too_much;
+    pool & P(instance());
+    { std::lock_guard<std::mutex> lock(P.mutex); P.max_cached_bytes = n; too_much = (P.stats.bytes_cached > n);}
+    if (too_much) release();
+   }
+
+   private:
+
+   static const int n_classes = 21; // 64 bytes * 2^20 = 64 MB
+   struct block_header { int size_class; size_t bytes;};
+   static block_header * header(void * block) { return static_cast<block_header *>(block);}
+
+   static int size_class(size_t n) { int c=0; for (size_t s = alignment; (s<n) && (c<n_classes); s*=2) ++c; return c; }
+   static size_t class_bytes(int c, size_t n) { return (c < n_classes ? alignment << c : ((n + alignment -1)/alignment)*alignment); }
+
+   struct pool { 
+    std::vector<void *> free_blocks[n_classes];
+    statistics_type stats; 
+    size_t max_cached_bytes;
+    std::mutex mutex; // protects all the above
+    pool() : max_cached_bytes(size_t(1)<<28) { 
+     stats.n_allocations = stats.n_deallocations = stats.n_system_allocations = stats.bytes_requested = 0; 
+     stats.bytes_in_use = stats.peak_bytes_in_use = stats.bytes_cached = 0;
+    }
+    // a successful allocation of n bytes, in a block of the given bytes (mutex is locked)
+    void count_allocation(size_t n, size_t bytes, bool from_system) { 
+     ++stats.n_allocations; stats.bytes_requested += n;
+     stats.bytes_in_use += bytes; 
+     if (stats.bytes_in_use > stats.peak_bytes_in_use) stats.peak_bytes_in_use = stats.bytes_in_use;
+     if (from_system) ++stats.n_system_allocations;
+    }
+   };
+   // never destroyed : arrays may be destructed after the end of main
+   static pool & instance() { static pool * P = new pool; return *P;}
+
+   // free the cached blocks, until at least n bytes are freed
+   static void release_after_failure(size_t n) { 
+    std::vector<void *> to_free;
+    pool & P(instance());
+    { 
+     std::lock_guard<std::mutex> lock(P.mutex);
+     size_t freed = 0;
+     for (int c = n_classes-1; (c>=0) && (freed < n); --c) { 
+      for (size_t u=0; u< P.free_blocks[c].size(); ++u) to_free.push_back(P.free_blocks[c][u]);
+      freed += P.free_blocks[c].size() * (alignment<<c);
+      P.free_blocks[c].clear();
+     }
+     P.stats.bytes_cached -= std::min(freed, P.stats.bytes_cached);
+    }
+    for (size_t u=0; u<to_free.size(); ++u) free(to_free[u]);
+   }
+  };
+
+  /**
+   * A standard allocator which takes its memory from the aligned_pool if use_pool is true, 
+   * and from the operator new otherwise. 
+   */
+  template<typename T> class aligned_pool_allocator { 
+   public:
+   typedef T value_type; typedef T * pointer; typedef T const * const_pointer; typedef T & reference; typedef T const & const_reference;
+   typedef size_t size_type; typedef std::ptrdiff_t difference_type;
+   template<typename U> struct rebind { typedef aligned_pool_allocator<U> other;};
+
+   bool use_pool;
+   aligned_pool_allocator(bool use_pool_ = false) : use_pool(use_pool_) {}
+   template<typename U> aligned_pool_allocator(aligned_pool_allocator<U> const & a) : use_pool(a.use_pool) {}
+
+   pointer allocate(size_type n, const void * = 0) { 
+    if (n > max_size()) throw std::bad_alloc();
+    return static_cast<pointer>( use_pool ? aligned_pool::allocate(n * sizeof(T)) : ::operator new (n * sizeof(T)));
+   }
+   void deallocate(pointer p, size_type) { if (use_pool) aligned_pool::deallocate(p); else ::operator delete(p);}
+
+   void construct(pointer p, const_reference x) { new (p) T(x);}
+   void destroy(pointer p) { p->~T();}
+   size_type max_size() const { return std::numeric_limits<size_type>::max() / sizeof(T);}
+   pointer address(reference x) const { return &x;}
+   const_pointer address(const_reference x) const { return &x;}
+
+   template<typename U> bool operator==(aligned_pool_allocator<U> const & a) const { return use_pool == a.use_pool;}
+   template<typename U> bool operator!=(aligned_pool_allocator<U> const & a) const { return use_pool != a.use_pool;}
+  };
+
+ }
+}}//namespace triqs::arrays 
+#endif
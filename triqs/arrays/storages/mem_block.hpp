@@ -25,6 +25,7 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
 #include "./common.hpp"
+#include "./aligned_pool.hpp"
 
 #ifdef TRIQS_ARRAYS_DEBUG_TRACE_MEM
 #include <iostream>
@@ -41,19 +42,24 @@ namespace triqs { namespace arrays { namespace storages { namespace details {
    size_t size_;
    non_const_value_type * restrict p;
    PyObject * py_obj;
+   bool pooled_; // p is taken from the aligned_pool (only for scalar or pod types, which need no constructor)
    static void import_numpy_array() { if (_import_array()!=0) TRIQS_RUNTIME_ERROR <<"Internal Error in importing numpy";}
 
-   public : 
-
-   mem_block():size_(0),p(NULL),py_obj(NULL){}
-
-   mem_block (size_t s):size_(s),py_obj(NULL){
+   static non_const_value_type * allocate(size_t s, bool pooled) { 
+    if (pooled) return static_cast<non_const_value_type *>(aligned_pool::allocate(s * sizeof(non_const_value_type)));
     //p = new non_const_value_type[s]; // check speed penalty for try ??
-    try { p = new non_const_value_type[s];}
+    try { return new non_const_value_type[s];}
     catch (std::bad_alloc& ba) { TRIQS_RUNTIME_ERROR<< "Memory allocation error : bad_alloc : "<< ba.what();}
+    return NULL;
    }
 
-   mem_block (PyObject * obj, bool borrowed ) { 
+   public : 
+
+   mem_block():size_(0),p(NULL),py_obj(NULL),pooled_(false){}
+
+   mem_block (size_t s, bool pooled = false):size_(s),py_obj(NULL),pooled_(pooled && is_scalar_or_pod<ValueType>::value){ p = allocate(s,pooled_); }
+
+   mem_block (PyObject * obj, bool borrowed ):pooled_(false) { 
     TRACE_MEM_DEBUG(" construct memblock from pyobject"<<obj<< " # ref ="<<obj->ob_refcnt<<" borrowed = "<< borrowed); 
     assert(obj); import_numpy_array(); 
     if (borrowed) Py_INCREF(obj);
@@ -66,7 +72,7 @@ namespace triqs { namespace arrays { namespace storages { namespace details {
 
    ~mem_block(){ // delete memory manually iif py_obj is not set. Otherwise the python interpreter will do that for us.
     TRACE_MEM_DEBUG("deleting mem block p ="<<p<< "  py_obj = "<< py_obj << "    ref of py obj if exists"<<(py_obj ? py_obj->ob_refcnt: -1));
-    if (py_obj==NULL) { if (p) { delete[] p;} } 
+    if (py_obj==NULL) { if (p) { if (pooled_) aligned_pool::deallocate(p); else delete[] p;} } 
     else Py_DECREF(py_obj); 
    } 
 
@@ -88,10 +94,8 @@ namespace triqs { namespace arrays { namespace storages { namespace details {
     this->memcopy (p, X.p, size_);
    }
 
-   mem_block ( mem_block const & X): size_(X.size()), py_obj(NULL) { 
-    //p = new non_const_value_type[s]; // check speed penalty for try ??
-    try { p = new non_const_value_type[X.size()];}
-    catch (std::bad_alloc& ba) { TRIQS_RUNTIME_ERROR<< "Memory allocation error : bad_alloc : "<< ba.what();}
+   mem_block ( mem_block const & X): size_(X.size()), py_obj(NULL), pooled_(X.pooled_) { 
+    p = allocate(X.size(),pooled_);
     if ((X.py_obj==NULL) || (PyCObject_Check(X.py_obj))) { (*this) = X; }
     else { 
      // else make a new copy of the numpy ...
@@ -115,10 +119,15 @@ namespace triqs { namespace arrays { namespace storages { namespace details {
     delete [] ( (non_const_value_type*) ptr) ;
    }   
 
+   static void delete_pointeur_pooled( void *ptr ) { 
+    TRACE_MEM_DEBUG("deleting pooled data block"<<(non_const_value_type*) ptr); 
+    aligned_pool::deallocate(ptr);
+   }   
+
    PyObject * new_ref_to_guard() { 
     if (py_obj==NULL) { 
     TRACE_MEM_DEBUG(" activating python guard for C++ block"<<p<< "  py_obj = "<< py_obj);
-     py_obj = PyCObject_FromVoidPtr( (void*) p, &mem_block<ValueType>::delete_pointeur);
+     py_obj = PyCObject_FromVoidPtr( (void*) p, (pooled_ ? &mem_block<ValueType>::delete_pointeur_pooled : &mem_block<ValueType>::delete_pointeur));
     } 
     Py_INCREF(py_obj); 
     return py_obj;
@@ -128,6 +137,8 @@ namespace triqs { namespace arrays { namespace storages { namespace details {
 
    size_t size() const {return size_;}
 
+   bool pooled() const {return pooled_;}
+
    template<class Archive>
     void save(Archive & ar, const unsigned int version) const { 
      ar << boost::serialization::make_nvp("size",size_);
@@ -138,7 +149,7 @@ namespace triqs { namespace arrays { namespace storages { namespace details {
     void load(Archive & ar, const unsigned int version) { 
      ar >> size_;
      assert (p==NULL); 
-     p = new non_const_value_type[size_]; 
+     p = allocate(size_,pooled_); 
      for (size_t i=0; i<size_; ++i) ar >> p[i]; 
     }
    BOOST_SERIALIZATION_SPLIT_MEMBER();
@@ -22,6 +22,7 @@
 #define TRIQS_STORAGE_SHARED_POINTER_H
 #include <string.h>
 #include <limits>
+#include <algorithm>
 #include <boost/shared_ptr.hpp>
 #include <boost/type_traits/is_const.hpp>
 #include <boost/type_traits/add_const.hpp>
@@ -29,6 +30,7 @@
 #include <boost/type_traits/is_same.hpp> 
 #include <boost/serialization/shared_ptr.hpp>
 #include "./common.hpp"
+#include "./aligned_pool.hpp"
 #include "../impl/make_const.hpp"
 #ifdef TRIQS_WITH_PYTHON_SUPPORT
 #include "./mem_block.hpp"
@@ -38,7 +40,7 @@
 #endif
 
 namespace triqs { namespace arrays { 
- namespace Tag { struct shared_block:storage{}; }
+ namespace Tag { struct shared_block:storage{}; struct aligned_pool:storage{}; }
 
  namespace storages {
 
@@ -66,6 +68,11 @@ namespace triqs { namespace arrays {
   };
 
 
+  namespace details { 
+   // memory which is not allocated by the arrays (e.g. a memory mapped file), kept alive by the owner
+   template<typename T> struct foreign_block { T * p; size_t size; boost::shared_ptr<void> owner; };
+  }
+
   /*  Storage as a shared_ptr to a basic_block
    *  The shared pointer guarantees that the data will not be destroyed during the life of the array. 
    *  Impl: we are not using shared_array directly because of serialization support for shared_ptr */
@@ -77,7 +84,7 @@ namespace triqs { namespace arrays {
     typedef details::mem_block<non_const_value_type> block_type;
 #else
     //  typedef details::basic_block<non_const_value_type> block_type;
-    typedef std::vector<non_const_value_type> block_type;
+    typedef std::vector<non_const_value_type, aligned_pool_allocator<non_const_value_type> > block_type;
 #endif
 
     public:
@@ -88,40 +95,51 @@ namespace triqs { namespace arrays {
 
     ///  Construct a new block of memory of given size
     template<typename InitOpt>
-     explicit shared_block(size_t size, InitOpt opt ): sptr(size ? new block_type(size) : NULL) {
+     explicit shared_block(size_t size, InitOpt ): sptr(size ? new_block(size,false) : NULL) {
+      init_data();
+      __init_value<value_type,InitOpt>::invoke (this-> data_, this->size());
+     }
+
+    ///  Construct a new block of memory of given size, from the aligned_pool if StorageOpt is Tag::aligned_pool
+    template<typename InitOpt, typename StorageOpt>
+     shared_block(size_t size, InitOpt, StorageOpt ): sptr(size ? new_block(size, boost::is_same<StorageOpt,Tag::aligned_pool>::value) : NULL) {
       init_data();
       __init_value<value_type,InitOpt>::invoke (this-> data_, this->size());
      }
 
     explicit shared_block(): sptr() { init_data(); }
 
+    /// The size elements at p, owned by owner (e.g. a memory mapped file), which is kept alive as long as the block
+    shared_block(value_type * p, size_t size, boost::shared_ptr<void> const & owner) : sptr(), fptr(new foreign_block_type) {
+     fptr->p = const_cast<non_const_value_type *>(p); fptr->size = size; fptr->owner = owner; 
+     init_data();
+    }
+
 #ifdef TRIQS_WITH_PYTHON_SUPPORT
     ///  Construct from a numpy object
     explicit shared_block(PyObject * arr, bool borrowed): sptr(new block_type(arr,borrowed)) { init_data();}
 #endif
 
     /// Shallow copy
-    shared_block(const shared_block<const_value_type> & X): sptr(X.sptr) { init_data(); }
+    shared_block(const shared_block<const_value_type> & X): sptr(X.sptr), fptr(X.fptr) { init_data(); }
   
     /// Shallow copy
-    shared_block(const shared_block<non_const_value_type> & X): sptr(X.sptr) { init_data(); }
+    shared_block(const shared_block<non_const_value_type> & X): sptr(X.sptr), fptr(X.fptr) { init_data(); }
 
-    void operator=(const shared_block & X) { sptr=X.sptr; init_data(); } 
+    void operator=(const shared_block & X) { sptr=X.sptr; fptr=X.fptr; init_data(); } 
 
     /// raw copy from another 
-    void raw_copy_from(const shared_block<non_const_value_type> & X){assert(this->size()==X.size()); if (!empty()) (*sptr)=(*X.sptr);}
+    void raw_copy_from(const shared_block<non_const_value_type> & X){assert(this->size()==X.size()); raw_copy_impl(X);}
 
     /// raw copy from another 
-    void raw_copy_from(const shared_block<const_value_type> & X){ assert(this->size()==X.size()); if (!empty()) (*sptr)=(*X.sptr);}
+    void raw_copy_from(const shared_block<const_value_type> & X){ assert(this->size()==X.size()); raw_copy_impl(X);}
 
-    /// True copy of the data
+    /// True copy of the data (in memory, also for a foreign block)
     clone_type clone() const { 
      if (empty()) return clone_type ();
-#ifdef TRIQS_WITH_PYTHON_SUPPORT    
-     clone_type res; res.sptr = boost::make_shared<block_type > (*sptr); res.init_data();
-#else
-     clone_type res(this->size(), Tag::no_init() ); (*res.sptr) = (*sptr);
-#endif
+     clone_type res; 
+     if (sptr) { res.sptr = boost::make_shared<block_type > (*sptr); res.init_data();} // the copy is allocated like *sptr
+     else { res = clone_type(this->size(), Tag::no_init()); std::copy(data_, data_ + this->size(), res.data_);}
      return res;
     }
 
@@ -129,20 +147,51 @@ namespace triqs { namespace arrays {
     const_clone_type const_clone() const {return clone();} 
 
     value_type & operator[](size_t i) const { return data_[i];}
-    bool empty() const {return (sptr.get()==NULL);}
-    size_t size() const {return (empty () ? 0 : sptr.get()->size());} 
+    bool empty() const {return (sptr.get()==NULL) && (fptr.get()==NULL);}
+    size_t size() const {return (sptr ? sptr.get()->size() : (fptr ? fptr->size : 0));} 
+
+    /// Is the data allocated in the aligned_pool ?
+#ifdef TRIQS_WITH_PYTHON_SUPPORT    
+    bool from_aligned_pool() const { return sptr && sptr->pooled();}
+#else
+    bool from_aligned_pool() const { return sptr && sptr->get_allocator().use_pool;}
+#endif
+
+    /// Is the data a foreign block (cf constructor) ?
+    bool is_foreign() const { return fptr.get()!=NULL;}
 
 #ifdef TRIQS_WITH_PYTHON_SUPPORT    
-    PyObject * new_ref_to_guard() const {return sptr->new_ref_to_guard();}
+    PyObject * new_ref_to_guard() const {
+     if (sptr) return sptr->new_ref_to_guard();
+     // the python object keeps a reference to the owner of the foreign block
+     return PyCObject_FromVoidPtrAndDesc( (void*) fptr->p, new boost::shared_ptr<foreign_block_type>(fptr), &delete_foreign_guard);
+    }
+    static void delete_foreign_guard(void *, void * desc) { delete static_cast<boost::shared_ptr<foreign_block_type> *>(desc);}
 #endif
 
     private:
+    typedef details::foreign_block<non_const_value_type> foreign_block_type;
     boost::shared_ptr<block_type > sptr;
+    boost::shared_ptr<foreign_block_type > fptr;
     value_type * restrict data_; // for optimization on some compilers.
-    void init_data(){ data_ = (sptr ? &((*sptr)[0]) : NULL); }
+    void init_data(){ data_ = (sptr ? &((*sptr)[0]) : (fptr ? fptr->p : NULL)); }
+    template<typename S> void raw_copy_impl(S const & X) { 
+     if (empty()) return;
+     if (sptr && X.sptr) (*sptr)=(*X.sptr); else std::copy(X.data_, X.data_ + this->size(), const_cast<non_const_value_type *>(data_));
+    }
+#ifdef TRIQS_WITH_PYTHON_SUPPORT    
+    static block_type * new_block(size_t size, bool pooled) { return new block_type(size,pooled);}
+#else
+    static block_type * new_block(size_t size, bool pooled) { 
+     return new block_type(size, non_const_value_type(), aligned_pool_allocator<non_const_value_type>(pooled));
+    }
+#endif
     friend class shared_block <non_const_value_type>; friend class shared_block <const_value_type>;
     friend class boost::serialization::access;
-    template<class Archive> void serialize(Archive & ar, const unsigned int version) { ar & boost::serialization::make_nvp("ptr",sptr); init_data(); }
+    template<class Archive> void serialize(Archive & ar, const unsigned int version) { 
+     if (fptr) TRIQS_RUNTIME_ERROR << "Can not serialize an array on a foreign block (e.g. memory mapped) : serialize a copy";
+     ar & boost::serialization::make_nvp("ptr",sptr); init_data(); 
+    }
    };
  }
 
@@ -0,0 +1,86 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "./python_stuff.hpp"
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+typedef storages::aligned_pool pool;
+typedef Option::options<Tag::C, Tag::aligned_pool> pool_opt;
+
+bool aligned(const void * p) { return (reinterpret_cast<size_t>(p) % pool::alignment) ==0;}
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ array<double,2,pool_opt> A(3,5), B(3,5);
+ for (int i =0; i<3; ++i) for (int j=0; j<5; ++j) { A(i,j) = i+j; B(i,j) = i*j;}
+ cout << " aligned : " << aligned(A.data_start()) << aligned(B.data_start()) << " from pool : "<< A.storage().from_aligned_pool()<< endl;
+
+ // the temporaries in a loop : one block from the system, reused
+ pool::reset_statistics();
+ for (int u=0; u<100; ++u) { array<double,2,pool_opt> C(A); C += B; }
+ pool::statistics_type s = pool::statistics();
+ cout << " allocations : "<< s.n_allocations << " from the system : "<< s.n_system_allocations << " deallocations : "<< s.n_deallocations << endl;
+ cout << " bytes requested : "<< s.bytes_requested << " in use : "<< s.bytes_in_use << " cached : "<< s.bytes_cached << endl;
+
+ // the arrays with the default storage do not use the pool
+ pool::reset_statistics();
+ { array<double,2> D(A); D = A + B; cout << " D = "<< D << endl;}
+ cout << " allocations for a default array : "<< pool::statistics().n_allocations << endl;
+
+ // views and copies with other options 
+ array_view<double,2> V(A(range(1,3),range()));
+ V *= 2;
+ matrix<double> M(2,2); M(0,0) = 1; M(0,1) = 2; M(1,0) = 3; M(1,1) = 4;
+ matrix<double,pool_opt> M2(M), M3(M2);
+ matrix<double> M4(M2);
+ M3 = M2; M4 = M3;
+ cout << " A = "<< A << endl << " M4 = "<< M4 << endl;
+ cout << " from pool : "<< M2.storage().from_aligned_pool() << M3.storage().from_aligned_pool() << M4.storage().from_aligned_pool() << endl;
+
+ // complex and large blocks (not cached)
+ array<std::complex<double>,1,pool_opt> Z(17);
+ array<double,1,pool_opt> L(10000000);
+ cout << " aligned : " << aligned(Z.data_start()) << aligned(L.data_start()) << endl;
+
+ // the pool is shared by threads which are not OpenMP ones
+ pool::reset_statistics();
+ std::vector<std::thread> th;
+ for (int t=0; t<4; ++t) 
+  th.push_back(std::thread([&A]() { for (int u=0; u<1000; ++u) { array<double,2,pool_opt> C(A); C *= 2;} }));
+ for (int t=0; t<4; ++t) th[t].join();
+ s = pool::statistics();
+ cout << " threads : allocations "<< s.n_allocations << " deallocations "<< s.n_deallocations << " in use : "<< s.bytes_in_use << endl;
+
+ // release the cached blocks
+ pool::release();
+ cout << " cached after release : "<< pool::statistics().bytes_cached << endl;
+ return 0;
+}
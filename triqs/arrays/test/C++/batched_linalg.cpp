@@ -0,0 +1,108 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./python_stuff.hpp"
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/linalg/batched.hpp"
+#include "./src/linalg/inverse.hpp"
+#include "./src/linalg/determinant.hpp"
+#include "./src/linalg/eigenelements.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include "./src/proto/matrix_algebra.hpp"
+#include <iostream>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+using namespace triqs::arrays::linalg;
+typedef std::complex<double> dcomplex;
+
+template<typename T> double max_diff(T const & a, T const & b) { double r=0; for (typename T::const_iterator it= a.begin(), it2 = b.begin(); it!= a.end(); ++it, ++it2) r = std::max(r, std::abs(*it - *it2)); return r;}
+
+// a well conditioned batch of N matrices of size n
+template<typename T> array<T,3> make_batch(int N, int n) { 
+ array<T,3> A(N,n,n);
+ for (int k=0; k<N; ++k) for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) A(k,i,j) = T(std::cos(1.0+k+3*i+7*j)) + (i==j ? T(n) : T(0));
+ return A;
+}
+
+// compare to the functions on one matrix
+template<typename T> void check(int n) { 
+ const int N = 7;
+ array<T,3> A = make_batch<T>(N,n), B = make_batch<T>(N,n);
+ for (int k=0; k<N; ++k) for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) B(k,i,j) = A(N-1-k,j,i);
+ matrix<T> L(n,n), R(n,n); 
+ for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) { L(i,j) = i-2*j; R(i,j) = std::sin(i+j);}
+
+ array<T,1> D = batched_determinant(A);
+ array<T,3> Inv = batched_inverse(A), P = batched_matmul(A,B), S = batched_sandwich(L,A,R);
+ double dd=0, di=0, dp=0, ds=0;
+ for (int k=0; k<N; ++k) { 
+  matrix<T> a(A(k,range(),range())), b(B(k,range(),range()));
+  dd = std::max(dd, std::abs(D(k) - T(determinant(a))));
+  matrix<T> ia = inverse(a), p = matmul(a,b), s1 = matmul(a,R), s= matmul(L,s1);
+  di = std::max(di, max_diff(ia, matrix<T>(Inv(k,range(),range()))));
+  dp = std::max(dp, max_diff(p, matrix<T>(P(k,range(),range()))));
+  ds = std::max(ds, max_diff(s, matrix<T>(S(k,range(),range()))));
+ }
+ cout << " n = "<< n << " det : "<< (dd < 1.e-10) << " inverse : "<< (di < 1.e-10) << " matmul : "<< (dp < 1.e-10) << " sandwich : "<< (ds < 1.e-10) << endl;
+
+ // in place, on a view of a different memory order
+ array<T,3,Option::Fortran> F(A);
+ batched_inverse_in_place(F(range(1,N),range(),range()));
+ cout << "   in place on a Fortran view : "<< (max_diff(array<T,3>(F(range(1,N),range(),range())), array<T,3>(Inv(range(1,N),range(),range()))) < 1.e-10) 
+  << (max_diff(array<T,2>(F(0,range(),range())), array<T,2>(A(0,range(),range()))) ==0) << endl;
+}
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ for (int n=1; n<=6; ++n) { check<double>(n); check<dcomplex>(n);}
+
+ array<double,3> A(2,2,2);
+ A(0,range(),range()) = 0; A(0,0,0) = 2; A(0,1,1) = 4; A(0,0,1) = 1; A(0,1,0) = 1;
+ A(1,range(),range()) = 0; A(1,0,0) = 1; A(1,1,1) = -1;
+ array<double,3> IA = batched_inverse(A);
+ cout << " det = "<< batched_determinant(A) << endl;
+ for (int k=0; k<2; ++k) cout << " A("<<k<<") = "<< A(k,range(),range()) << endl << " inverse = "<< IA(k,range(),range()) << endl;
+
+ // eigenelements : compared to eigenelements
+ array<dcomplex,3> H(3,5,5); 
+ for (int k=0; k<3; ++k) for (int i=0; i<5; ++i) for (int j=0; j<=i; ++j) { H(k,i,j) = dcomplex(i+j+k, (i==j ? 0 : i-j)); H(k,j,i) = std::conj(H(k,i,j));}
+ std::pair<array<double,2>, array<dcomplex,3> > E = batched_eigenelements(H);
+ double de=0, dv=0;
+ for (int k=0; k<3; ++k) { 
+  std::pair<array<double,1>, matrix<dcomplex> > e = eigenelements(matrix_view<dcomplex>(H(k,range(),range())), true);
+  de = std::max(de, max_diff(e.first, array<double,1>(E.first(k,range()))));
+  dv = std::max(dv, max_diff(e.second, matrix<dcomplex>(E.second(k,range(),range()))));
+ }
+ cout << " eigenelements : "<< (de < 1.e-10) << (dv < 1.e-10) << " eigenvalues : "<< (max_diff(batched_eigenvalues(H), E.first) < 1.e-10) << endl;
+ cout << " eigenvalues of A = "<< batched_eigenvalues(A) << endl;
+
+ // errors
+ A(1,range(),range()) = 0;
+ try { batched_inverse(A);} catch (triqs::runtime_error const & e) { cout << " singular matrix"<< endl;}
+ array<double,3> A2(2,5,5); A2() = 0;
+ try { batched_inverse(A2);} catch (triqs::runtime_error const & e) { cout << " singular matrix"<< endl;}
+ try { batched_determinant(array<double,3>(2,2,3));} catch (triqs::runtime_error const & e) { cout << " non square matrices"<< endl;}
+ return 0;
+}
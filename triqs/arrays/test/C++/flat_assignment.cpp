@@ -0,0 +1,89 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "./python_stuff.hpp"
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include "./src/proto/matrix_algebra.hpp"
+#include "./src/mapped_functions.hpp"
+#include <iostream>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+
+template<typename LHS, typename RHS> bool flat(LHS const & lhs, RHS const & rhs) { return flat_evaluation_possible(lhs,rhs);}
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ array<double,2> A(3,4), B(3,4), C(3,4);
+ array<double,2,Option::Fortran> F(3,4);
+ for (int i =0; i<3; ++i) for (int j=0; j<4; ++j) { A(i,j) = i+2*j; B(i,j) = 10*i-j;}
+ F = A;
+
+ // same layout : the flat loop is used
+ cout << " flat : " << flat(C,A+2*B) << flat(C, -A/2 + B*3 - 1) << flat(C, exp(A) + abs(B)) << endl;
+ C = A + 2*B - 1;
+ cout << " A + 2*B - 1 = " << C << endl;
+ C = -A/2 + abs(B)*3;
+ cout << " -A/2 + abs(B)*3 = " << C << endl;
+ C += sqrt(A*4);
+ cout << " += sqrt(A*4) : " << C << endl;
+ C = A; C -= B; C *= 2; C /= 4;
+ cout << " (A-B)/2 = " << C << endl;
+
+ // different memory order or non contiguous view : the foreach is used, with the same result
+ cout << " flat : " << flat(C,F+B) << flat(F,A+B) << endl;
+ C = F + B;
+ array<double,2,Option::Fortran> G(3,4);
+ G = A + B;
+ cout << " F + B = " << C << endl << " Fortran A + B = " << G << endl;
+ array<double,2> D(6,4); D() = 0;
+ array_view<double,2> V = D(range(0,6,2),range());
+ cout << " flat : " << flat(V, A+B) << flat(C, A + D(range(0,3),range())) << flat(C,A + V)<< endl;
+ V = A + B;
+ cout << " V = A + B : " << D << endl;
+
+ // the rhs is the lhs itself : ok. Partial overlap : not flat
+ cout << " flat : " << flat(A, A*2 + B) << flat(D(range(1,4),range()), D(range(0,3),range()) + A)<< endl;
+ A = A*2 + B;
+ cout << " A = A*2 + B : " << A << endl;
+
+ // matrices : a scalar in a sum is the identity matrix, not flat
+ matrix<double> M(2,2), N(2,2);
+ M(0,0) = 1; M(0,1) = 2; M(1,0) = 3; M(1,1) = 4;
+ cout << " flat : " << flat(N, 2*M) << flat(N, M + 1) << endl;
+ N = 2*M; 
+ cout << " 2*M = " << N << endl;
+ N = M + 1.0; 
+ cout << " M + 1 = " << N << endl;
+
+ // complex 
+ array<std::complex<double>,1> Z(3), W(3);
+ for (int i =0; i<3; ++i) Z(i) = std::complex<double>(i,1);
+ W = Z * std::complex<double>(0,1) + Z;
+ cout << " flat : " << flat(W, Z * std::complex<double>(0,1) + Z) << " W = "<< W << endl;
+
+ return 0;
+}
@@ -0,0 +1,80 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./python_stuff.hpp"
+#include "./src/array.hpp"
+#include <boost/mpi.hpp>
+#include "./src/mpi.hpp"
+#include "./src/h5/parallel.hpp"
+#include <iostream>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+
+int main(int argc, char* argv[]) 
+{
+ init_python_stuff(argc,argv);
+
+ boost::mpi::environment env(argc, argv);
+ boost::mpi::communicator world;
+ const int r = world.rank();
+ const bool master = (r==0);
+
+ {
+  h5::H5File file = h5::mpi::open_file(world, "h5_mpi.h5", H5F_ACC_TRUNC);
+
+  // each node writes its rows (r+1 rows)
+  array<long,2> A(r+1,3);
+  for (int i =0; i<r+1; ++i) for (int j=0; j<3; ++j) A(i,j) = 100*r + 10*i + j;
+  h5::mpi::h5_write(world, file, "A", A);
+
+  // a complex vector, written from a strided view
+  array<std::complex<double>,1> Z(4); 
+  for (int i =0; i<4; ++i) Z(i) = std::complex<double>(r,i);
+  h5::mpi::h5_write(world, file, "Z", Z(range(0,4,2)));
+
+  // the stacks : the nodes push different numbers of elements (7 + 2r, then r), more than the buffer size
+  h5::mpi::array_stack< array<double,1> > S(world, file, "S", make_shape(2), 3);
+  h5::mpi::array_stack< double > SC(world, file, "SC", 3);
+  array<double,1> B(2);
+  for (int u=0; u<7+2*r; ++u) { B(0) = r; B(1) = u; S << B; SC << 10*r + u;}
+  S.flush(); SC.flush();
+  for (int u=0; u<r; ++u) { B(0) = r; B(1) = 100+u; S << B; SC << 10*r + 100 + u;}
+  S.flush(); SC.flush();
+  if (master) cout << "stack size " << S.size() << endl;
+
+  // read back : each node reads a slice of rows
+  array<long,2> A2;
+  h5::mpi::h5_read(world, file, "A", A2);
+  array<long,2> A2g; 
+  triqs::arrays::mpi::gather(world, A2, A2g);
+  if (master) cout << "A read and gathered " << A2g << endl;
+ }
+
+ // the file read by one node
+ if (master) { 
+  h5::H5File file( "h5_mpi.h5", H5F_ACC_RDONLY );
+  array<long,2> A; array<std::complex<double>,1> Z; array<double,2> S; array<double,1> SC;
+  h5_read(file, "A", A); h5_read(file, "Z", Z); h5_read(file, "S", S); h5_read(file, "SC", SC);
+  cout << "A = " << A << endl << "Z = " << Z << endl << "S = " << S << endl << "SC = " << SC << endl;
+ }
+}
+
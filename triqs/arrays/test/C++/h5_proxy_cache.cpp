@@ -0,0 +1,99 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./python_stuff.hpp"
+#include "./src/h5/array_proxy.hpp"
+#include "./src/h5/simple_read_write.hpp"
+#include <iostream>
+#include "./src/asserts.hpp"
+
+using namespace triqs::arrays;
+
+template<typename S> void print_statistics (std::string const & s, S const & st) { 
+ std::cout << s << " : hits " << st.hits << " misses " << st.misses << " prefetched " << st.prefetched << " evicted " << st.evicted << std::endl;
+}
+
+template < class T>
+void test(std::string filename, T init) { 
+
+ const size_t N = 12, d= 2;
+ array<T,3> A_keep(N,d,d+1);
+ array<T,2> A(d,d+1);
+ for (int u = 0; u<N; ++u)  
+  for (int i = 0; i<d; ++i)  
+   for (int j = 0; j<d+1; ++j) A_keep(u,i,j) = double(100*u + 10*i +j)* init; 
+
+ { 
+  h5::H5File file( filename.c_str(), H5F_ACC_TRUNC );
+  h5_write( file, "A", A_keep);
+ }
+
+ h5::H5File file( filename.c_str(), H5F_ACC_RDWR );
+ const size_t block_bytes = 4*d*(d+1)*sizeof(T);
+
+ // sequential reading with read ahead : blocks of 4 rows, 2 blocks in memory
+ h5::array_proxy<T,3,3> P( file, "A");
+ P.enable_cache(2*block_bytes, 1, 4);
+ for (int u = 0; u<N; ++u) { 
+  A = P(u, range(), range());
+  assert_all_close (A, A_keep(u,range(),range()), 1.e-15);
+ }
+ print_statistics("sequential", P.cache()->statistics());
+ std::cout << "bytes in cache " << P.cache()->bytes_in_cache() / block_bytes << " blocks"<< std::endl;
+
+ // strided slice, with an integer index : across all the blocks
+ array<T,2> B;
+ B = P(range(1,12,3), range(), 1);
+ assert_all_close (B, A_keep(range(1,12,3), range(), 1), 1.e-15);
+ A = P(11, range(), range());
+ assert_all_close (A, A_keep(11,range(),range()), 1.e-15);
+
+ // a write through the proxy empties the cache
+ array<T,2> A0 (A_keep(0,range(),range()));
+ P(0, range(), range()) = T(2) * A0;
+ A = P(0, range(), range());
+ assert_all_close (A, T(2) * A0, 1.e-15);
+ P(0, range(), range()) = A0;
+
+ // prefetch the next slice while the current one is used 
+ h5::array_proxy<T,3,3> P2( file, "A");
+ P2.enable_cache(100*block_bytes, 0, 4);
+ for (int u = 0; u<N; ++u) { 
+  if (u+1<N) P2(u+1, range(), range()).prefetch();
+  A = P2(u, range(), range());
+  assert_all_close (A, A_keep(u,range(),range()), 1.e-15);
+ }
+ print_statistics("prefetch", P2.cache()->statistics());
+
+ // the full array through the cache
+ array<T,3> A_all;
+ A_all = P2;
+ assert_all_close (A_all, A_keep, 1.e-15);
+}
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ test("proxy_cache_d.h5", 1.0 );
+ test("proxy_cache_c.h5", std::complex<double>(1,2) );
+}
+
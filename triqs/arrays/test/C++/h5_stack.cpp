@@ -30,7 +30,7 @@ using std::cout; using std::endl;
 using namespace triqs::arrays;
 
 template < class T>
-void test(std::string filename, T init) { 
+void test(std::string filename, T init, h5::array_stack_options const & opt = h5::array_stack_options()) { 
 
  h5::H5File file( filename.c_str(), H5F_ACC_TRUNC );
 
@@ -48,9 +48,9 @@ void test(std::string filename, T init) {
  //h5::array_stack<T,2> SA( file, "A", A.shape() , bufsize);
  //h5::array_stack<T,1> SB( file, "B", B.shape() , bufsize);
  //h5::array_stack<T,0> SC( file, "C", mini_vector<size_t,0>() , bufsize);
- h5::array_stack< array<T,2 > > SA( file, "A", A.shape() , bufsize);
- h5::array_stack< array<T,1 > > SB( file, "B", B.shape() , bufsize);
- h5::array_stack< T> SC( file, "C", bufsize);
+ h5::array_stack< array<T,2 > > SA( file, "A", A.shape() , bufsize, opt);
+ h5::array_stack< array<T,1 > > SB( file, "B", B.shape() , bufsize, opt);
+ h5::array_stack< T> SC( file, "C", bufsize, opt);
  //h5::array_stack< T> SC( file, "C", mini_vector<size_t,0>() , bufsize); // also valid ...
  //h5::array_stack< array<T,1 > > SB2( file, "B", bufsize); // does not compile
  
@@ -105,5 +105,11 @@ int main(int argc, char **argv) {
  test("stack_d.h5", 1.0 );
  test("stack_c.h5", std::complex<double>(1,2) );
 
+ // asynchronous writer, compression, and a flush of the file every 2 buffers
+ h5::array_stack_options opt;
+ opt.asynchronous = true; opt.deflate_level = 6; opt.shuffle = true; opt.flush_every = 2;
+ test("stack_d_async.h5", 1.0, opt );
+ test("stack_c_async.h5", std::complex<double>(1,2), opt );
+
 }
 
@@ -0,0 +1,122 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./python_stuff.hpp"
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/vector.hpp"
+#include "./src/linalg/inverse.hpp"
+#include "./src/linalg/determinant.hpp"
+#include "./src/linalg/eigenelements.hpp"
+#include "./src/linalg/matmul.hpp"
+#include "./src/proto/matrix_algebra.hpp"
+#include <iostream>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+using namespace triqs::arrays::linalg;
+typedef std::complex<double> dcomplex;
+
+template<typename T> double max_diff(T const & a, T const & b) { double r=0; for (typename T::const_iterator it= a.begin(), it2 = b.begin(); it!= a.end(); ++it, ++it2) r = std::max(r, std::abs(*it - *it2)); return r;}
+
+double conj_(double x) { return x;}
+dcomplex conj_(dcomplex x) { return std::conj(x);}
+
+template<typename T> matrix<T> hermitian(int n, int k) { 
+ matrix<T> H(n,n);
+ for (int i=0; i<n; ++i) for (int j=0; j<=i; ++j) { H(i,j) = std::cos(1.0+k+3*i+7*j) + (i==j ? 0 : 0.5*std::sin(i-j+k)); H(j,i) = H(i,j);}
+ return H;
+}
+template<> matrix<dcomplex> hermitian<dcomplex>(int n, int k) { 
+ matrix<dcomplex> H(n,n);
+ for (int i=0; i<n; ++i) for (int j=0; j<=i; ++j) { H(i,j) = dcomplex(std::cos(1.0+k+3*i+7*j), (i==j ? 0 : std::sin(i-j+k))); H(j,i) = std::conj(H(i,j));}
+ return H;
+}
+
+// one worker for many matrices (and two dimensions), compared to the one shot functions
+template<typename T> void check_eigen() { 
+ eigenelements_worker<matrix_view<T>,true> W(3);
+ eigenelements_worker<matrix_view<T>,false> W2(3);
+ double dv=0, de =0;
+ for (int k=0; k<10; ++k) { 
+  int n = (k<5 ? 3 : 6);
+  matrix<T> H = hermitian<T>(n,k), H2(H);
+  std::pair<array<double,1>, matrix<T> > ref = eigenelements(H(),true);
+  W.invoke(H); W2.invoke(H2);
+  de = std::max(de, max_diff(ref.first, W.values()));
+  de = std::max(de, max_diff(ref.first, W2.values()));
+  dv = std::max(dv, max_diff(ref.second, H));
+ }
+ cout << " worker : values "<< (de < 1.e-10) << " vectors "<< (dv < 1.e-10) << endl;
+
+ // divide and conquer : H * v = e v 
+ const int n = 80;
+ matrix<T> H = hermitian<T>(n,1), V(H);
+ vector<double> ev(n);
+ eigenelements_worker<matrix_view<T>,true> Wd(n);
+ Wd.invoke(V);
+ ev = Wd.values();
+ double r=0;
+ for (int i=0; i<n; ++i) { 
+  vector<T> v(n); for (int j=0; j<n; ++j) v(j) = conj_(V(i,j)); // the rows are the (conjugated) eigenvectors
+  for (int j=0; j<n; ++j) { T s = 0; for (int l=0; l<n; ++l) s += H(j,l) * v(l); r = std::max(r, std::abs(s - ev(i) * v(j)));}
+ }
+ matrix<T> V2(H); 
+ eigenelements_worker<matrix_view<T>,true> Wq(n);
+ Wq.use_divide_and_conquer(false);
+ Wq.invoke(V2);
+ cout << " divide and conquer : "<< (r < 1.e-10) << " same eigenvalues as QR : "<< (max_diff(Wq.values(), Wd.values()) < 1.e-10) << endl;
+
+ // in place 
+ matrix<T> A = hermitian<T>(4,2), B(A);
+ vector<double> e(4);
+ eigenelements_in_place(A, e);
+ std::pair<array<double,1>, matrix<T> > ref = eigenelements(B(),true);
+ cout << " in place : "<< (max_diff(ref.first, array<double,1>(e)) < 1.e-10) << (max_diff(ref.second, A) < 1.e-10);
+ vector<double> e2(4);
+ eigenvalues_in_place(B(), e2);
+ cout << (max_diff(e, e2) < 1.e-10) << endl;
+}
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ check_eigen<double>();
+ check_eigen<dcomplex>();
+
+ // one det_and_inverse_worker for several matrices
+ det_and_inverse_worker<matrix_view<double> > W(2);
+ for (int n=2; n<5; ++n) for (int k=0; k<2; ++k) { 
+  matrix<double> M(n,n); 
+  for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) M(i,j) = std::cos(1.0+k+3*i+7*j) + (i==j ? n : 0);
+  matrix<double> R = inverse(M), M2(M);
+  double d = determinant(M);
+  W.reset(M2);
+  cout << " n = "<< n << " det : "<< (std::abs(W.det() - d) < 1.e-10) << " inverse : "<< (max_diff(matrix<double>(W.inverse()), R) < 1.e-10) << (max_diff(M2, R) < 1.e-10) << endl;
+ }
+
+ // in place inverse
+ matrix<double> M(2,2); M(0,0) = 2; M(0,1) = 1; M(1,0) = 1; M(1,1) = 4;
+ inverse_in_place(M);
+ cout << " inverse in place : "<< M << endl;
+ return 0;
+}
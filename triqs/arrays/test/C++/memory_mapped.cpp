@@ -0,0 +1,90 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./python_stuff.hpp"
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/linalg/matmul.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include "./src/memory_mapped.hpp"
+#include <iostream>
+#include <cstdio>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ // a new file, filled through the view
+ {
+  array_view<double,2> A = memory_mapped::create<double,2>("memory_mapped.dat", make_shape(size_t(3),size_t(3)));
+  for (int i =0; i<3; ++i) for (int j=0; j<3; ++j) A(i,j) = 10*i+j;
+  memory_mapped::flush(A);
+  cout << " foreign : "<< A.storage().is_foreign() << " A = "<< A << endl;
+ }
+
+ // read-only, sequential access : the views are used as usual
+ array_view<const double,2> B = memory_mapped::open<const double,2>("memory_mapped.dat", memory_mapped::sequential);
+ array<double,2> C(B); 
+ array<double,2> D = 2*B + C;
+ cout << " D = "<< D << endl;
+ matrix_view<const double> M(B);
+ matrix<double> P = matmul(M,M);
+ cout << " M*M = "<< P << endl;
+ cout << " slice = "<< B(range(1,3),1) << endl;
+
+ // read-write, a slice modified in the file
+ {
+  array_view<double,2> W = memory_mapped::open<double,2>("memory_mapped.dat");
+  memory_mapped::advise(W(1,range()), memory_mapped::random);
+  W(1,range()) *= -1;
+  memory_mapped::flush(W);
+ }
+ cout << " B after modification = "<< B << endl;
+ cout << " C (a copy) = "<< C << endl;
+
+ // a clone is in memory
+ array_view<const double,2> B2 (B);
+ array<double,2> E (B2);
+ E(0,0) = 100;
+ cout << " B(0,0) = "<< B(0,0) << endl;
+
+ // Fortran order
+ {
+  array_view<long,2,Option::Fortran> F = memory_mapped::create<long,2,Option::Fortran>("memory_mapped_f.dat", make_shape(size_t(2),size_t(3)));
+  for (int i =0; i<2; ++i) for (int j=0; j<3; ++j) F(i,j) = 10*i+j;
+ }
+ cout << " F = "<< memory_mapped::open<const long,2,Option::Fortran>("memory_mapped_f.dat") << endl;
+
+ // errors
+ try { memory_mapped::open<const double,2,Option::Fortran>("memory_mapped.dat");} 
+ catch (triqs::runtime_error const & e) { cout << " error : memory order"<< endl;}
+ try { memory_mapped::open<const double,3>("memory_mapped.dat");} 
+ catch (triqs::runtime_error const & e) { cout << " error : rank"<< endl;}
+ try { memory_mapped::open<const int,2>("memory_mapped.dat");} 
+ catch (triqs::runtime_error const & e) { cout << " error : value type"<< endl;}
+ try { memory_mapped::open<const double,2>("memory_mapped_none.dat");} 
+ catch (triqs::runtime_error const & e) { cout << " error : no file"<< endl;}
+ std::remove("memory_mapped.dat"); std::remove("memory_mapped_f.dat");
+ return 0;
+}
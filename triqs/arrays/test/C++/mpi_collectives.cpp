@@ -0,0 +1,94 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "./python_stuff.hpp"
+
+#include "./src/array.hpp"
+#include <boost/mpi.hpp>
+#include "./src/mpi.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include <iostream>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+
+int main(int argc, char* argv[]) 
+{
+ init_python_stuff(argc,argv);
+
+ boost::mpi::environment env(argc, argv);
+ boost::mpi::communicator world;
+ const int s = world.size();
+ const bool master = (world.rank()==0);
+
+ array<long,2> A (4,3), C;
+ for (int i =0; i<4; ++i)
+  for (int j=0; j<3; ++j) 
+  { A(i,j) = (1+world.rank())*(10*i+ j);}
+ array<long,2> A0 ( A / (1+world.rank()));
+
+ // reduce, in an array and in a strided view
+ triqs::arrays::mpi::reduce(world, A, C);
+ if (master) std::cout<<" C = "<<C<< "  should be "<< array<long,2>( (s*(s+1)/2) * A0) <<std::endl;
+
+ array<long,2> D(4,6); D() = 0;
+ array_view<long,2> Dv ( D(range(), range(0,6,2)));
+ triqs::arrays::mpi::reduce(world, A, Dv);
+ if (master) std::cout<<" D = "<<D<<std::endl;
+
+ // allreduce of complex, in place on a view
+ array<std::complex<double>,2> Z (2,2); Z() = std::complex<double>(1,2);
+ array_view<std::complex<double>,1> Zv ( Z(range(),1));
+ triqs::arrays::mpi::allreduce_in_place(world, Zv);
+ if (master) std::cout<<" Z = "<<Z<< "  should be (1,2) and ("<< s <<","<< 2*s << ")"<< std::endl;
+
+ // bcast : resize on the other nodes
+ array<double,1> B;
+ if (master) { B.resize(make_shape(3)); B(0) = 1; B(1) = 2; B(2) = 3;}
+ triqs::arrays::mpi::bcast(world, B);
+ if (world.rank()==s-1) std::cout<<" B = "<<B<<std::endl;
+
+ // scatter the rows then gather them back, from a Fortran ordered array (non contiguous rows)
+ array<long,2,Option::Fortran> AF (A0);
+ array<long,2> S, G;
+ triqs::arrays::mpi::scatter(world, AF, S);
+ triqs::arrays::mpi::gather(world, S, G);
+ if (master) std::cout<<" G = "<<G<< "  should be "<< A0 <<std::endl;
+
+ array<long,2> AG;
+ triqs::arrays::mpi::allgather(world, S, AG);
+ if (world.rank()==s-1) std::cout<<" AG = "<<AG<<std::endl;
+
+#if MPI_VERSION >= 3
+ // non-blocking
+ array<double,1> X(5), Y(5);
+ for (int i=0; i<5; ++i) X(i) = i;
+ triqs::arrays::mpi::request r = triqs::arrays::mpi::ireduce(world, X, Y);
+ r.wait();
+ if (master) std::cout<<" Y = "<<Y<< "  should be "<< s << " * [0,1,2,3,4]" << std::endl;
+ r = triqs::arrays::mpi::iallreduce_in_place(world, X);
+ r.wait();
+ if (master) std::cout<<" X = "<<X<<std::endl;
+#endif
+
+ return 0;
+}
@@ -0,0 +1,71 @@
+
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "./python_stuff.hpp"
+
+// with OpenMP, use the threads even for these small arrays
+#ifdef _OPENMP
+#define TRIQS_ARRAYS_FOREACH_USE_OPENMP
+#define TRIQS_ARRAYS_FOREACH_PARALLEL_THRESHOLD 10
+#endif
+
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include "./src/algorithms.hpp"
+#include <iostream>
+
+using std::cout; using std::endl;
+using namespace triqs::arrays;
+
+int main(int argc, char **argv) {
+
+ init_python_stuff(argc,argv);
+
+ array<long,3> A(7,3,2), B(7,3,2), C;
+ for (int i =0; i<7; ++i) for (int j=0; j<3; ++j) for (int k=0; k<2; ++k) { A(i,j,k) = 100*i + 10*j +k; B(i,j,k) = i-j*k;}
+
+ // assignment of an expression, compound operators, scalar
+ C = A + 2*B;
+ C += A;
+ C -= B;
+ C *= 2;
+ long ok =0;
+ for (int i =0; i<7; ++i) for (int j=0; j<3; ++j) for (int k=0; k<2; ++k) ok += (C(i,j,k) != 2*(2*A(i,j,k)+B(i,j,k)));
+ std::cout << " errors in C : "<< ok << std::endl;
+
+ // on a Fortran array and on a view
+ array<long,3,Option::Fortran> F(A);
+ array_view<long,2> V ( C(range(1,6,2),range(),1));
+ V = 3;
+ std::cout << " F = A : " << (F(4,2,1) == A(4,2,1)) << " V = "<< V << std::endl;
+
+ matrix<double> M(20,20); 
+ for (int i =0; i<20; ++i) for (int j=0; j<20; ++j) M(i,j) = i+j;
+ M *= 2.0;
+ std::cout << " M(3,4) = "<< M(3,4)<< " M(19,19) = "<< M(19,19) << std::endl;
+
+ // folds
+ std::cout << " sum = " << sum(A) << " max = " << max_element(A) << " min = "<< min_element(A)<< std::endl;
+
+ return 0;
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "./src/array.hpp"
+#include "./src/matrix.hpp"
+#include "./src/linalg/batched.hpp"
+#include "./src/linalg/inverse.hpp"
+#include "./src/linalg/matmul.hpp"
+
+using namespace triqs::arrays;
+// e.g. the 4x4 blocks of G(k) for the k points of a k-sum
+const int N = 20000, n = 4, N_iter = 10;
+typedef array<double,3> A3;
+
+struct batch { 
+ A3 A, R; 
+ batch() : A(N,n,n), R(N,n,n) { 
+  for (int k=0; k<N; ++k) for (int i=0; i<n; ++i) for (int j=0; j<n; ++j) A(k,i,j) = std::cos(k+3*i+7*j) + (i==j ? n : 0);
+ }
+};
+
+struct inverse_loop : batch { 
+ void operator()() { 
+  for (int u =0; u<N_iter; ++u) for (int k=0; k<N; ++k) { matrix_view<double> r(R(k,range(),range())); r = inverse(matrix_view<double>(A(k,range(),range())));}
+ }
+};
+
+struct inverse_batched : batch { 
+ void operator()() { for (int u =0; u<N_iter; ++u) R = linalg::batched_inverse(A); }
+};
+
+struct matmul_loop : batch { 
+ void operator()() { 
+  for (int u =0; u<N_iter; ++u) for (int k=0; k<N; ++k) { matrix_view<double> r(R(k,range(),range())), a(A(k,range(),range())); r = matmul(a,a);}
+ }
+};
+
+struct matmul_batched : batch { 
+ void operator()() { for (int u =0; u<N_iter; ++u) linalg::batched_matmul(A,A,R); }
+};
+
+#include "./speed_tester.hpp"
+int main() {
+ const int l = 1;
+ speed_tester<inverse_loop> (l);
+ speed_tester<inverse_batched> (l);
+ speed_tester<matmul_loop> (l);
+ speed_tester<matmul_batched> (l);
+ return 0;
+}
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include "./src/array.hpp"
+#include "./src/proto/array_algebra.hpp"
+#include "./src/mapped_functions.hpp"
+
+using namespace triqs::arrays;
+// e.g. a Green function g(tau) with small 2x2 blocks : the innermost loops of foreach are too short to be vectorized
+const int N1= 2000, N2 = 2, N3 = 2, N_iter = 20000;
+typedef array<double,3> A3;
+
+// reference : the hand written loop on restrict pointers
+struct plain_pointers { 
+ A3 A,B,C;
+ plain_pointers() : A(N1,N2,N3), B(N1,N2,N3), C(N1,N2,N3) { B() = 1; C() = 2;}
+ void operator()() { 
+  double * restrict a = A.data_start(); double const * restrict b = B.data_start(), * restrict c = C.data_start();
+  for (int u =0; u<N_iter; ++u)
+   for (std::ptrdiff_t n =0; n<N1*N2*N3; ++n) a[n] = b[n] + 3*c[n] - 0.5;
+ }
+};
+
+// same layout : the assignment uses a flat loop
+struct expression { 
+ A3 A,B,C;
+ expression() : A(N1,N2,N3), B(N1,N2,N3), C(N1,N2,N3) { B() = 1; C() = 2;}
+ void operator()() { for (int u =0; u<N_iter; ++u) A = B + 3*C - 0.5; }
+};
+
+// different memory order : the assignment goes through foreach
+struct expression_transposed_layout { 
+ A3 A,B; array<double,3,Option::Fortran> C;
+ expression_transposed_layout() : A(N1,N2,N3), B(N1,N2,N3), C(N1,N2,N3) { B() = 1; C() = 2;}
+ void operator()() { for (int u =0; u<N_iter; ++u) A = B + 3*C - 0.5; }
+};
+
+struct compound_scalar { 
+ A3 A;
+ compound_scalar() : A(N1,N2,N3) { A() = 1;}
+ void operator()() { for (int u =0; u<N_iter; ++u) A *= 1.0000001; }
+};
+
+struct compound_array { 
+ A3 A,B;
+ compound_array() : A(N1,N2,N3), B(N1,N2,N3) { A() = 1; B()= 1.e-7;}
+ void operator()() { for (int u =0; u<N_iter; ++u) A += B; }
+};
+
+struct mapped_function { 
+ A3 A,B;
+ mapped_function() : A(N1,N2,N3), B(N1,N2,N3) { B() = 1;}
+ void operator()() { for (int u =0; u<N_iter/10; ++u) A = 2*sqrt(B) + B; }
+};
+
+#include "./speed_tester.hpp"
+int main() {
+ const int l = 1;
+ speed_tester<plain_pointers> (l);
+ speed_tester<expression> (l);
+ speed_tester<expression_transposed_layout> (l);
+ speed_tester<compound_scalar> (l);
+ speed_tester<compound_array> (l);
+ speed_tester<mapped_function> (l);
+ return 0;
+}
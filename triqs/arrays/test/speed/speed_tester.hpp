@@ -36,11 +36,11 @@ void speed_tester(size_t n_iter) {
  using namespace boost::posix_time;
  using namespace boost::gregorian;
 
- boost::posix_time::ptime start_time = boost::posix_time::second_clock::local_time();
+ boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
 
  for (size_t u=0; u<n_iter; ++u) x();
 
- boost::posix_time::ptime stop_time = boost::posix_time::second_clock::local_time();
+ boost::posix_time::ptime stop_time = boost::posix_time::microsec_clock::local_time();
 
  time_duration td = stop_time - start_time;
 
@@ -32,12 +32,50 @@
 #include <triqs/arrays/linalg/mat_vec_mul.hpp>
 #include <boost/numeric/bindings/blas/level1/dot.hpp>
 #include <triqs/arrays/proto/matrix_algebra.hpp>
+#include <boost/mpl/bool.hpp>
+
+// Size up to which the single row/col operations use plain loops instead of BLAS (cf det_manip::small_size)
+#ifndef TRIQS_DET_MANIP_SMALL_SIZE
+#define TRIQS_DET_MANIP_SMALL_SIZE 16
+#endif
 
 namespace triqs { namespace det_manip { 
 
+ namespace details { 
+  // has_member_fill_row<F>::value is true iff F has a member named fill_row (resp. fill_col).
+#define TRIQS_DET_MANIP_HAS_MEMBER(NAME)\
+  template<typename F> struct has_member_##NAME { \
+   struct fallback { int NAME; };\
+   struct derived : F, fallback {};\
+   template<typename U, U> struct check;\
+   template<typename U> static char (&test(check<int fallback::*, &U::NAME> *))[1];\
+   template<typename U> static char (&test(...))[2];\
+   static const bool value = (sizeof(test<derived>(0)) == 2);\
+  };
+  TRIQS_DET_MANIP_HAS_MEMBER(fill_row)
+  TRIQS_DET_MANIP_HAS_MEMBER(fill_col)
+#undef TRIQS_DET_MANIP_HAS_MEMBER
+ }
+
  /**
- */ 
- template<typename FunctionTypeArg>
+  * The function object FunctionType must define result_type, argument_type and 
+  *   result_type operator()(argument_type const & x, argument_type const & y) const
+  *
+  * Optionally, it can evaluate a whole row or column at once, e.g. to vectorize or to keep a table hot, with :
+  *   void fill_row(argument_type const & x, argument_type const * y, size_t n, result_type * out, std::ptrdiff_t stride) const
+  *     // out[k*stride] = f(x, y[k]),  0 <= k < n
+  *   void fill_col(argument_type const * x, size_t n, argument_type const & y, result_type * out, std::ptrdiff_t stride) const
+  *     // out[k*stride] = f(x[k], y),  0 <= k < n
+  * If both are present, they are used instead of operator() to build the rows and columns.
+  *
+  * MatValueType is the type used to store and update the inverse matrix (default : result_type).
+  * With e.g. det_manip<F,float>, the fast updates of the inverse matrix are done in single precision 
+  * (half the memory traffic), while the ratios of det and the log of the det are accumulated in double. 
+  * The regeneration of the inverse matrix is always done in the precision of result_type, and corrects the drift
+  * of the single precision updates; the default precisions of the regeneration policy are relaxed accordingly.
+  * NB : the accuracy of the ratios is then ~ 1e-7 times the condition number of the matrix : use it for well conditioned matrices.
+  */ 
+ template<typename FunctionTypeArg, typename MatValueType = typename boost::unwrap_reference<FunctionTypeArg>::type::result_type>
   class det_manip {
    public:
 
@@ -47,27 +85,33 @@ namespace triqs { namespace det_manip {
     typedef triqs::arrays::vector<value_type>                        vector_type;
     typedef triqs::arrays::matrix<value_type>                        matrix_type;
     typedef triqs::arrays::matrix_view<value_type>                   matrix_view_type;
+    typedef MatValueType                                             mat_value_type;
 
    protected: // the data
     typedef std::ptrdiff_t int_type;
     typedef triqs::arrays::range range;
+    typedef triqs::arrays::vector<mat_value_type> mat_vector_type;
+    typedef triqs::arrays::matrix<mat_value_type> mat_matrix_type;
 
     FunctionType f;
     
     // serialized data
-    value_type det;
+    // the det of the stored matrix is det_phase * exp(log_abs_det), so that it does not overflow at large N.
+    double log_abs_det;
+    value_type det_phase;
     size_t Nmax,N, last_try;
     std::vector<size_t> row_num,col_num;
     std::vector<xy_type> x_values,y_values;
     int sign;
-    matrix_type mat_inv;
+    mat_matrix_type mat_inv;
     long long n_opts, n_opts_max_before_check;
+    double precision_increase, precision_reduce; // bounds on the deviation of mat_inv for the regeneration policy
 
    private:
     // temporary work data, not saved, serialized, etc....  
     struct work_data_type1 { 
      xy_type x, y;
-     vector_type MB,MC, B, C;
+     mat_vector_type MB,MC, B, C;
      value_type ksi;
      size_t i,j,ireal,jreal;
      void reserve(size_t s) { B.resize(s); C.resize(s); MB.resize(s); MC.resize(s); MB()=0; MC()=0; }
@@ -75,17 +119,101 @@ namespace triqs { namespace det_manip {
     
     struct work_data_type2 { 
      xy_type x[2], y[2];
-     matrix_type MB,MC, B, C,ksi;
+     mat_matrix_type MB,MC, B, C,ksi;
      size_t i[2],j[2],ireal[2],jreal[2];
      void reserve(size_t s) { MB.resize(s,2); MC.resize(2,s); B.resize(s,2), C.resize(2,s); ksi.resize(2,2); MB() = 0; MC() = 0; }
-     value_type det_ksi() const { return ksi(0,0) * ksi(1,1) - ksi(1,0)* ksi(0,1);}
+     value_type det_ksi() const { return value_type(ksi(0,0)) * ksi(1,1) - value_type(ksi(1,0))* ksi(0,1);}
     };
 
     work_data_type1 w1;
     work_data_type2 w2;
-    value_type newdet;
+    value_type det_ratio; // det_new / det_old, computed by the try_xxx
     int newsign;
 
+    // Evaluation of a row/column of f : use the batched version of the function if it exists.
+    typedef boost::mpl::bool_<details::has_member_fill_row<FunctionType>::value && details::has_member_fill_col<FunctionType>::value> has_fill;
+
+    // out[k*stride] = f(x, y[k]), 0 <= k < n
+    template<typename T> void fill_row(xy_type const & x, xy_type const * y, size_t n, T * out, std::ptrdiff_t stride) const { 
+     fill_row_impl(x,y,n,out,stride,has_fill());
+    }
+    void fill_row_impl(xy_type const & x, xy_type const * y, size_t n, value_type * out, std::ptrdiff_t stride, boost::mpl::true_) const { 
+     f.fill_row(x,y,n,out,stride);
+    }
+    template<typename T> void fill_row_impl(xy_type const & x, xy_type const * y, size_t n, T * out, std::ptrdiff_t stride, boost::mpl::true_) const { 
+     fill_buffer.resize(n); 
+     if (n) f.fill_row(x,y,n,&fill_buffer[0],1);
+     for (size_t k=0; k<n; ++k) out[k*stride] = fill_buffer[k];
+    }
+    template<typename T> void fill_row_impl(xy_type const & x, xy_type const * y, size_t n, T * out, std::ptrdiff_t stride, boost::mpl::false_) const { 
+     for (size_t k=0; k<n; ++k) out[k*stride] = f(x,y[k]);
+    }
+
+    // out[k*stride] = f(x[k], y), 0 <= k < n
+    template<typename T> void fill_col(xy_type const * x, size_t n, xy_type const & y, T * out, std::ptrdiff_t stride) const { 
+     fill_col_impl(x,n,y,out,stride,has_fill());
+    }
+    void fill_col_impl(xy_type const * x, size_t n, xy_type const & y, value_type * out, std::ptrdiff_t stride, boost::mpl::true_) const { 
+     f.fill_col(x,n,y,out,stride);
+    }
+    template<typename T> void fill_col_impl(xy_type const * x, size_t n, xy_type const & y, T * out, std::ptrdiff_t stride, boost::mpl::true_) const { 
+     fill_buffer.resize(n); 
+     if (n) f.fill_col(x,n,y,&fill_buffer[0],1);
+     for (size_t k=0; k<n; ++k) out[k*stride] = fill_buffer[k];
+    }
+    template<typename T> void fill_col_impl(xy_type const * x, size_t n, xy_type const & y, T * out, std::ptrdiff_t stride, boost::mpl::false_) const { 
+     for (size_t k=0; k<n; ++k) out[k*stride] = f(x[k],y);
+    }
+
+    // the batched evaluation works in result_type : when mat_value_type differs, it goes through this buffer.
+    mutable std::vector<value_type> fill_buffer;
+
+    // For small matrices (N <= small_size), the BLAS calls of the single row/col operations are replaced by
+    // plain loops on the storage of mat_inv : at this size, the call overhead dominates the arithmetic
+    // (2 to 4 times faster for N <= 8, cf test/speed/small_size.cpp).
+    // Only the kernels change : the storage, the work vectors and the row/col permutations are the same for all N,
+    // and insert2/remove2 always use BLAS. Kernels instantiated for each size, with the operands on the stack, 
+    // were measured : they are not faster than these loops, so there is no fixed size specialisation.
+    static const size_t small_size = TRIQS_DET_MANIP_SMALL_SIZE;
+
+    // res[i] = sum_j mat_inv(i,j) x[j] (or mat_inv(j,i) if transpose), 0 <= i,j < N
+    void small_mult(mat_value_type const * x, std::ptrdiff_t sx, mat_value_type * res, std::ptrdiff_t sr, bool transpose) const { 
+     mat_value_type const * M = mat_inv.data_start(); 
+     const std::ptrdiff_t si = (transpose ? stride1(mat_inv) : stride0(mat_inv)), sj = (transpose ? stride0(mat_inv) : stride1(mat_inv));
+     for (size_t i=0; i<N; ++i) { 
+      mat_value_type r = 0;
+      for (size_t j=0; j<N; ++j) r += M[i*si + j*sj] * x[j*sx];
+      res[i*sr] = r;
+     }
+    }
+
+    // mat_inv(i,j) += a x[i] y[j], 0 <= i,j < N
+    void small_rank1(mat_value_type a, mat_value_type const * x, std::ptrdiff_t sx, mat_value_type const * y, std::ptrdiff_t sy) { 
+     mat_value_type * M = mat_inv.data_start(); 
+     const std::ptrdiff_t s0 = stride0(mat_inv), s1 = stride1(mat_inv);
+     for (size_t i=0; i<N; ++i) { 
+      const mat_value_type ax = a * x[i*sx];
+      for (size_t j=0; j<N; ++j) M[i*s0 + j*s1] += ax * y[j*sy];
+     }
+    }
+
+    // sign of the permutation p of [0,N[
+    int permutation_sign(std::vector<size_t> const & p) const { 
+     std::vector<bool> seen(N,false); 
+     int s = 1;
+     for (size_t i=0; i<N; ++i) { 
+      if (seen[i]) continue;
+      size_t len = 0;
+      for (size_t k=i; !seen[k]; k=p[k]) { seen[k] = true; ++len;}
+      if (len%2==0) s = -s;
+     }
+     return s;
+    }
+
+    // stride of the first (resp. second) index of a vector or a matrix
+    template<typename A> static std::ptrdiff_t stride0(A const & a) { return a.indexmap().strides()[0];}
+    template<typename A> static std::ptrdiff_t stride1(A const & a) { return a.indexmap().strides()[1];}
+
    public:
 
     /** 
@@ -95,7 +223,7 @@ namespace triqs { namespace det_manip {
      */
     void reserve (size_t new_size) { 
      if (new_size <= Nmax) return;
-     matrix_type Mcopy(mat_inv);
+     mat_matrix_type Mcopy(mat_inv);
      size_t N0 = Nmax; Nmax = new_size;
      mat_inv.resize(Nmax,Nmax); mat_inv(range(0,N0), range(0,N0)) = Mcopy; // keep the content of mat_inv ---> into the lib ?
      row_num.reserve(Nmax);col_num.reserve(Nmax); x_values.reserve(Nmax);y_values.reserve(Nmax);
@@ -105,7 +233,11 @@ namespace triqs { namespace det_manip {
    private:
     void _construct_common() { 
      last_try=0; sign =1;
+     log_abs_det = 0; det_phase = 1;
      n_opts=0; n_opts_max_before_check = 100;
+     // single precision storage : the fast updates can not do better than ~ 1e-6
+     const bool reduced_precision = (sizeof(mat_value_type) < sizeof(value_type));
+     precision_increase = (reduced_precision ? 1.e-5 : 1.e-12); precision_reduce = (reduced_precision ? 1.e-3 : 1.e-8);
     }
 
    public:
@@ -121,7 +253,6 @@ namespace triqs { namespace det_manip {
      f(boost::unwrap_ref(F)), Nmax(0) , N(0){ 
       reserve(init_size);
       mat_inv()=0;
-      det = 1; 
      _construct_common();
      }
 
@@ -136,23 +267,18 @@ namespace triqs { namespace det_manip {
       if (X.size() != Y.size()) TRIQS_RUNTIME_ERROR<< " X.size != Y.size";
       _construct_common();
       N =X.size(); 
-      if (N==0) { det = 1; reserve(30); return;} 
+      if (N==0) { reserve(30); return;} 
       if (N>Nmax) reserve(2*N); // put some margin..
       std::copy(X.begin(),X.end(), std::back_inserter(x_values));
       std::copy(Y.begin(),Y.end(), std::back_inserter(y_values));
       mat_inv()=0;
-      for (size_t i=0; i<N; ++i) { 
-       row_num.push_back(i);col_num.push_back(i); 
-       for (size_t j=0; j<N; ++j)
-	mat_inv(i,j) = f(x_values[i],y_values[j]);
-      }
-      mat_inv = inverse(mat_inv);
-      det = determinant(mat_inv);
+      for (size_t i=0; i<N; ++i) { row_num.push_back(i);col_num.push_back(i);} 
+      regenerate();
      }
 
     /// Put to size 0 : like a vector 
     void clear () { 
-     N = 0; sign = 1;det =1; last_try = 0;
+     N = 0; sign = 1; log_abs_det = 0; det_phase = 1; last_try = 0;
      row_num.clear(); col_num.clear(); x_values.clear(); y_values.clear(); 
     }
 
@@ -167,8 +293,14 @@ namespace triqs { namespace det_manip {
     /// Returns the j-th values of y
     xy_type const & get_y(size_t j) const { return y_values[col_num[j]];}
 
-    /** det M of the current state of the matrix.  */
-    value_type determinant() const {return sign*det;}
+    /** det M of the current state of the matrix. NB : it may overflow at large N, cf log_abs_determinant */
+    value_type determinant() const {return sign*det_phase*std::exp(log_abs_det);}
+
+    /** log |det M| of the current state of the matrix.  */
+    double log_abs_determinant() const {return log_abs_det;}
+
+    /** det M / |det M| of the current state of the matrix.  */
+    value_type determinant_phase() const {return sign*det_phase;}
 
     /** Returns M^{-1}(i,j) */
     value_type inverse_matrix(size_t i,size_t j) const {return mat_inv(col_num[i],row_num[j]);} // warning : need to invert the 2 permutations.
@@ -185,9 +317,10 @@ namespace triqs { namespace det_manip {
     /// Rebuild the matrix. Warning : this is slow, since it create a new matrix and re-evaluate the function. 
     matrix_view_type matrix() const {
      matrix_type res(N,N);
-     for (size_t i=0; i<N;i++)
-      for (size_t j=0; j<N;j++)
-       res(i,j) = f(get_x(i), get_y(j));
+     if (N==0) return res;
+     std::vector<xy_type> x(N);
+     for (size_t i=0; i<N;i++) x[i] = get_x(i);
+     for (size_t j=0; j<N;j++) fill_col(&x[0], N, get_y(j), &res(0,j), stride0(res));
      return res;
     }
 
@@ -199,7 +332,8 @@ namespace triqs { namespace det_manip {
       using boost::serialization::make_nvp;
       ar & make_nvp("Nmax",Nmax) & make_nvp("N",N) 
        & make_nvp("n_opts",n_opts) & make_nvp("n_opts_max_before_check",n_opts_max_before_check) 
-       & make_nvp("det",det) & make_nvp("sign",sign) 
+       & make_nvp("log_abs_det",log_abs_det) & make_nvp("det_phase",det_phase) & make_nvp("sign",sign) 
+       & make_nvp("precision_increase",precision_increase) & make_nvp("precision_reduce",precision_reduce) 
        & make_nvp("Minv",mat_inv) 
        & make_nvp("row_num",row_num) & make_nvp("col_num",col_num) 
        & make_nvp("x_values",x_values) & make_nvp("y_values",y_values); 
@@ -236,21 +370,26 @@ namespace triqs { namespace det_manip {
      w1.i=i; w1.j=j; w1.x=x; w1.y = y;
 
      // treat empty matrix separately 
-     if (N==0) { newdet = f(x,y); newsign = 1; return newdet; }
+     if (N==0) { det_ratio = f(x,y); newsign = 1; return det_ratio; }
 
      // I add the row and col and the end. If the move is rejected,
      // no effect since N will not be changed : Minv(i,j) for i,j>=N 
      // has no meaning.
-     for (size_t k= 0; k< N; k++) {
-      w1.B(k) = f(x_values[k],y);
-      w1.C(k) = f(x, y_values[k]);
-     }
+     fill_col(&x_values[0], N, y, &w1.B(0), stride0(w1.B));
+     fill_row(x, &y_values[0], N, &w1.C(0), stride0(w1.C));
      range R(0,N);
-     w1.MB(R) = mat_inv(R,R) * w1.B(R);
-     w1.ksi = f(x,y) - boost::numeric::bindings::blas::dot( w1.C(R) , w1.MB(R) );
-     newdet = det*w1.ksi;
+     if (N <= small_size) { 
+      small_mult(&w1.B(0), stride0(w1.B), &w1.MB(0), stride0(w1.MB), false);
+      w1.ksi = f(x,y);
+      for (size_t k= 0; k< N; k++) w1.ksi -= value_type(w1.C(k)) * w1.MB(k);
+     }
+     else { 
+      w1.MB(R) = mat_inv(R,R) * w1.B(R);
+      w1.ksi = f(x,y) - boost::numeric::bindings::blas::dot( w1.C(R) , w1.MB(R) );
+     }
+     det_ratio = w1.ksi;
      newsign = ((i + j)%2==0 ? sign : -sign);   // since N-i0 + N-j0  = i0+j0 [2]
-     return (newdet/det)*(newsign*sign);          // sign is unity, hence 1/sign == sign
+     return det_ratio*(newsign*sign);          // sign is unity, hence 1/sign == sign
     } 
 
     //------------------------------------------------------------------------------------------
@@ -262,10 +401,11 @@ namespace triqs { namespace det_manip {
      row_num.push_back(0); col_num.push_back(0);
 
      // special empty case again
-     if (N==0) { N=1; mat_inv(0,0) = 1/newdet; return; }
+     if (N==0) { N=1; mat_inv(0,0) = 1/det_ratio; return; }
 
      range R1(0,N);  
-     w1.MC(R1) = mat_inv(R1,R1).transpose() * w1.C(R1); 
+     if (N <= small_size) small_mult(&w1.C(0), stride0(w1.C), &w1.MC(0), stride0(w1.MC), true);
+     else w1.MC(R1) = mat_inv(R1,R1).transpose() * w1.C(R1); 
      w1.MC(N) = -1;
      w1.MB(N) = -1;
 
@@ -288,7 +428,8 @@ namespace triqs { namespace det_manip {
      range R(0,N);
      mat_inv(R,N-1) = 0;
      mat_inv(N-1,R) = 0;
-     mat_inv(R,R) += triqs::arrays::a_x_ty(w1.ksi, w1.MB(R) ,w1.MC(R)) ;//mat_inv(R,R) += w1.ksi* w1.MB(R) * w1.MC(R)
+     if (N <= small_size) small_rank1(w1.ksi, &w1.MB(0), stride0(w1.MB), &w1.MC(0), stride0(w1.MC));
+     else mat_inv(R,R) += triqs::arrays::a_x_ty(mat_value_type(w1.ksi), w1.MB(R) ,w1.MC(R)) ;//mat_inv(R,R) += w1.ksi* w1.MB(R) * w1.MC(R)
     }
 
    public : 
@@ -325,25 +466,23 @@ namespace triqs { namespace det_manip {
 
      // treat empty matrix separately 
      if (N==0) {
-      newdet = w2.det_ksi(); 
+      det_ratio = w2.det_ksi(); 
       newsign = 1;
-      return newdet;
+      return det_ratio;
      }
 
      // I add the rows and cols and the end. If the move is rejected,
      // no effect since N will not be changed : inv_mat(i,j) for i,j>=N has no meaning.
-     for (size_t k= 0; k< N; k++) {
-      w2.B(k,0) = f(x_values[k],y0);
-      w2.B(k,1) = f(x_values[k],y1);
-      w2.C(0,k) = f(x0, y_values[k]);
-      w2.C(1,k) = f(x1, y_values[k]);
-     }
+     fill_col(&x_values[0], N, y0, &w2.B(0,0), stride0(w2.B));
+     fill_col(&x_values[0], N, y1, &w2.B(0,1), stride0(w2.B));
+     fill_row(x0, &y_values[0], N, &w2.C(0,0), stride1(w2.C));
+     fill_row(x1, &y_values[0], N, &w2.C(1,0), stride1(w2.C));
      range R(0,N), R2(0,2);
      w2.MB(R,R2) = mat_inv(R,R) * w2.B(R,R2); 
      w2.ksi -= w2.C (R2, R) * w2.MB(R, R2);
-     newdet = det * w2.det_ksi();
+     det_ratio = w2.det_ksi();
      newsign = ((i0 + j0 + i1 + j1)%2==0 ? sign : -sign); // since N-i0 + N-j0 + N + 1 -i1 + N+1 -j1 = i0+j0 [2]
-     return (newdet/det)*(newsign*sign); // sign is unity, hence 1/sign == sign
+     return det_ratio*(newsign*sign); // sign is unity, hence 1/sign == sign
     } 
 
     //------------------------------------------------------------------------------------------
@@ -395,13 +534,13 @@ namespace triqs { namespace det_manip {
      w1.i=i;w1.j=j;last_try = 2;
      w1.jreal = col_num[w1.j];
      w1.ireal = row_num[w1.i];
-     // compute the newdet
+     // compute the ratio of the dets
      // first we resolve the w1.ireal,w1.jreal, with the permutation of the Minv, then we pick up what
      // will become the 'corner' coefficient, if the move is accepted, after the exchange of row and col.
      w1.ksi = mat_inv(w1.jreal,w1.ireal);
-     newdet = det*w1.ksi;
+     det_ratio = w1.ksi;
      newsign = ((i + j)%2==0 ? sign : -sign);
-     return (newdet/det)*(newsign*sign); // sign is unity, hence 1/sign == sign
+     return det_ratio*(newsign*sign); // sign is unity, hence 1/sign == sign
     }
     //------------------------------------------------------------------------------------------
    private:
@@ -430,7 +569,8 @@ namespace triqs { namespace det_manip {
      w1.ksi = - 1/mat_inv(N,N);
      range R(0,N);
 
-     mat_inv(R,R) += triqs::arrays::a_x_ty(w1.ksi,mat_inv(R,N),mat_inv(N,R));
+     if (N <= small_size) small_rank1(w1.ksi, &mat_inv(0,N), stride0(mat_inv), &mat_inv(N,0), stride1(mat_inv));
+     else mat_inv(R,R) += triqs::arrays::a_x_ty(mat_value_type(w1.ksi),mat_inv(R,N),mat_inv(N,R));
 
      // modify the permutations
      for (size_t k =w1.i; k<N; k++) {row_num[k]= row_num[k+1];}
@@ -470,16 +610,16 @@ namespace triqs { namespace det_manip {
      w2.jreal[0] = col_num[w2.j[0]]; 
      w2.jreal[1] = col_num[w2.j[1]];
 
-     // compute the newdet
+     // compute the ratio of the dets
      w2.ksi(0,0) = mat_inv(w2.jreal[0],w2.ireal[0]);
      w2.ksi(1,0) = mat_inv(w2.jreal[1],w2.ireal[0]);
      w2.ksi(0,1) = mat_inv(w2.jreal[0],w2.ireal[1]);
      w2.ksi(1,1) = mat_inv(w2.jreal[1],w2.ireal[1]);
 
-     newdet = det * w2.det_ksi();
+     det_ratio = w2.det_ksi();
      newsign = ((i0 + j0+ i1 + j1)%2==0 ? sign : -sign);
 
-     return (newdet/det)*(newsign*sign); // sign is unity, hence 1/sign == sign
+     return det_ratio*(newsign*sign); // sign is unity, hence 1/sign == sign
     }
     //------------------------------------------------------------------------------------------
    private:
@@ -536,6 +676,7 @@ namespace triqs { namespace det_manip {
      for (int u=0; u<2; ++u) { row_num.pop_back(); col_num.pop_back(); x_values.pop_back(); y_values.pop_back(); } 
     }
     //------------------------------------------------------------------------------------------
+   public:
 
     /**
      * Consider the change the column j and the corresponding y.
@@ -550,15 +691,18 @@ namespace triqs { namespace det_manip {
      w1.y = y;
 
      // Compute the col B.
-     for (size_t i= 0; i<N;i++) w1.MC(i) = f(x_values[i] , w1.y) - f(x_values[i], y_values[w1.jreal]);
+     fill_col(&x_values[0], N, w1.y, &w1.MC(0), stride0(w1.MC));
+     fill_col(&x_values[0], N, y_values[w1.jreal], &w1.B(0), stride0(w1.B));
+     for (size_t i= 0; i<N;i++) w1.MC(i) -= w1.B(i);
      range R(0,N);
-     w1.MB(R) = mat_inv(R,R) * w1.MC(R);
+     if (N <= small_size) small_mult(&w1.MC(0), stride0(w1.MC), &w1.MB(0), stride0(w1.MB), false);
+     else w1.MB(R) = mat_inv(R,R) * w1.MC(R);
 
-     // compute the newdet
+     // compute the ratio of the dets
      w1.ksi = (1+w1.MB(w1.jreal));
-     newdet = det*w1.ksi;
+     det_ratio = w1.ksi;
      newsign = sign;
-     return (newdet/det)*(newsign*sign); // sign is unity, hence 1/sign == sign
+     return det_ratio*(newsign*sign); // sign is unity, hence 1/sign == sign
     }
     //------------------------------------------------------------------------------------------
    private:
@@ -572,8 +716,9 @@ namespace triqs { namespace det_manip {
      // Cf notes : simply multiply by -w1.ksi
      w1.ksi = - 1/(1+ w1.MB(w1.jreal));
      w1.MB(w1.jreal) = 0;
-     mat_inv(R,R) += triqs::arrays::a_x_ty(w1.ksi,w1.MB(R), mat_inv(w1.jreal,R));
-     mat_inv(w1.jreal,R)*= -w1.ksi; 
+     if (N <= small_size) small_rank1(w1.ksi, &w1.MB(0), stride0(w1.MB), &mat_inv(w1.jreal,0), stride1(mat_inv));
+     else mat_inv(R,R) += triqs::arrays::a_x_ty(mat_value_type(w1.ksi),w1.MB(R), mat_inv(w1.jreal,R));
+     mat_inv(w1.jreal,R)*= mat_value_type(-w1.ksi); 
     }
 
     //------------------------------------------------------------------------------------------
@@ -592,15 +737,18 @@ namespace triqs { namespace det_manip {
      w1.x = x;
 
      // Compute the col B.
-     for (size_t i= 0; i<N;i++) w1.MB(i) = f(w1.x, y_values[i] ) -  f(x_values[w1.ireal], y_values[i] ); 
+     fill_row(w1.x, &y_values[0], N, &w1.MB(0), stride0(w1.MB));
+     fill_row(x_values[w1.ireal], &y_values[0], N, &w1.C(0), stride0(w1.C));
+     for (size_t i= 0; i<N;i++) w1.MB(i) -= w1.C(i); 
      range R(0,N);
-     w1.MC(R) = mat_inv(R,R).transpose() * w1.MB(R); 
+     if (N <= small_size) small_mult(&w1.MB(0), stride0(w1.MB), &w1.MC(0), stride0(w1.MC), true);
+     else w1.MC(R) = mat_inv(R,R).transpose() * w1.MB(R); 
 
-     // compute the newdet
+     // compute the ratio of the dets
      w1.ksi = (1+w1.MC(w1.ireal));
-     newdet = det*w1.ksi;
+     det_ratio = w1.ksi;
      newsign = sign;
-     return (newdet/det)*(newsign*sign); // sign is unity, hence 1/sign == sign
+     return det_ratio*(newsign*sign); // sign is unity, hence 1/sign == sign
     }
     //------------------------------------------------------------------------------------------
    private:
@@ -613,28 +761,88 @@ namespace triqs { namespace det_manip {
      // impl. Cf case 3
      w1.ksi = - 1/(1+ w1.MC(w1.ireal));
      w1.MC(w1.ireal) = 0;
-     mat_inv(R,R) += triqs::arrays::a_x_ty(w1.ksi,mat_inv(R,w1.ireal),w1.MC);
-     mat_inv(R,w1.ireal) *= -w1.ksi;
+     if (N <= small_size) small_rank1(w1.ksi, &mat_inv(0,w1.ireal), stride0(mat_inv), &w1.MC(0), stride0(w1.MC));
+     else mat_inv(R,R) += triqs::arrays::a_x_ty(mat_value_type(w1.ksi),mat_inv(R,w1.ireal),w1.MC);
+     mat_inv(R,w1.ireal) *= mat_value_type(-w1.ksi);
+    }
+    //------------------------------------------------------------------------------------------
+   public:
+
+    /**
+     * Consider the simultaneous change of the row i and the column j, and the corresponding x and y.
+     * (e.g. the move of a pair of operators). 
+     * It is a rank-2 update : M' = M + U V^T, with U = (e_i, Delta col), V = (Delta row, e_j).
+     *
+     * Returns the ratio of det Minv_new / det Minv.
+     * This routine does NOT make any modification. It has to be completed with complete_operation().
+     */
+    value_type try_change_col_row(size_t i, size_t j, xy_type const & x, xy_type const & y) {
+     assert(i<N); assert(j<N);
+     w1.i=i; w1.j=j; last_try = 5;
+     w1.ireal = row_num[i]; w1.jreal = col_num[j];
+     w1.x = x; w1.y = y;
+     range R(0,N), R2(0,2);
+
+     // U = w2.B(R,R2) : e_ireal and the change of the column jreal (including the corner). 
+     w2.B(R,0) = 0; w2.B(w1.ireal,0) = 1;
+     fill_col(&x_values[0], N, y, &w2.B(0,1), stride0(w2.B));
+     fill_col(&x_values[0], N, y_values[w1.jreal], &w1.B(0), stride0(w1.B));
+     for (size_t k= 0; k<N;k++) w2.B(k,1) -= w1.B(k);
+     w2.B(w1.ireal,1) = f(x,y) - w1.B(w1.ireal);
+
+     // V^T = w2.C(R2,R) : the change of the row ireal (without the corner) and e_jreal.
+     fill_row(x, &y_values[0], N, &w2.C(0,0), stride1(w2.C));
+     fill_row(x_values[w1.ireal], &y_values[0], N, &w1.C(0), stride0(w1.C));
+     for (size_t k= 0; k<N;k++) w2.C(0,k) -= w1.C(k);
+     w2.C(0,w1.jreal) = 0;
+     w2.C(1,R) = 0; w2.C(1,w1.jreal) = 1;
+
+     // ksi = 1 + V^T Minv U, and the ratio of the dets is det(ksi).
+     w2.MB(R,R2) = mat_inv(R,R) * w2.B(R,R2); 
+     w2.MC(R2,R) = w2.C(R2,R) * mat_inv(R,R);
+     w2.ksi = w2.C(R2,R) * w2.MB(R,R2);
+     w2.ksi(0,0) += 1; w2.ksi(1,1) += 1;
+     det_ratio = w2.det_ksi();
+     newsign = sign;
+     return det_ratio; 
+    }
+    //------------------------------------------------------------------------------------------
+   private:
+    void complete_change_col_row() {
+     range R(0,N), R2(0,2);
+     x_values[w1.ireal] = w1.x;
+     y_values[w1.jreal] = w1.y;
+     // Woodbury formula : Minv' = Minv - (Minv U) ksi^{-1} (V^T Minv)
+     w2.ksi = inverse(w2.ksi);
+     w2.ksi *= -1;
+     mat_inv(R,R) += w2.MB(R,R2) * (w2.ksi * w2.MC(R2,R));
     }
     //------------------------------------------------------------------------------------------
    private: 
 
-    bool check_mat_inv (double precision) const { 
-     if (N==0) return true;
-     const bool relative = true;
+    // mat_inv recomputed from scratch in value_type, with the log of the det. Returns the relative deviation from the previous mat_inv.
+    // When mat_inv is stored in a lower precision, this is also where the drift of the fast updates is corrected.
+    double _regenerate() { 
+     if (N==0) { log_abs_det = 0; det_phase = 1; return 0;}
      matrix_type res(N,N);
+     for (size_t j=0; j<N;j++) fill_col(&x_values[0], N, y_values[j], &res(0,j), stride0(res));
+     triqs::arrays::det_and_inverse_worker<matrix_view_type> worker(res);
+     log_abs_det = worker.log_abs_det(); det_phase = worker.det_phase();
+     // res is in the order of the storage : det = sign(row_num) sign(col_num) det(res).
+     // NB : the sign tracked by the moves can differ, since a remove moves the last row and column of the storage.
+     sign = permutation_sign(row_num) * permutation_sign(col_num);
+     matrix_view_type inv = worker.inverse();
+     double diff = 0, norm = 0;
      for (size_t i=0; i<N;i++)
-      for (size_t j=0; j<N;j++)
-       res(i,j) = f(x_values[i], y_values[j]);
-     res = inverse(res); 
-     value_type r = max_element (abs(res - mat_inv(range(0,N),range(0,N))));
-     value_type r2= max_element (abs(res + mat_inv(range(0,N),range(0,N))));
-     //#define TRIQS_DET_MANIP_VERBOSE_CHECK
+      for (size_t j=0; j<N;j++) { 
+       diff = std::max(diff, double(std::abs(inv(i,j) - value_type(mat_inv(i,j)))));
+       norm = std::max(norm, double(std::abs(inv(i,j))));
+       mat_inv(i,j) = inv(i,j);
+      }
 #ifdef TRIQS_DET_MANIP_VERBOSE_CHECK
-     std::cout  << "----------------"<<std::endl 
-      << "check " << "N = "<< N <<"  " <<"r,r2 =   "<< r << "  "<< r2 << std::endl;  
+     std::cout  << "----------------"<<std::endl << "regenerate " << "N = "<< N <<"  diff = "<< diff <<"  norm = "<<norm<< std::endl;  
 #endif
-     return ( r <  (relative ? precision * r2 : precision));
+     return (norm > 0 ? diff/norm : diff);
     }
 
     //------------------------------------------------------------------------------------------
@@ -657,6 +865,9 @@ namespace triqs { namespace det_manip {
       case(4): 
        complete_change_row();
        break;
+      case(5): 
+       complete_change_col_row();
+       break;
       case(10): 
        complete_insert2();
        break;
@@ -669,17 +880,39 @@ namespace triqs { namespace det_manip {
       default: 
        TRIQS_RUNTIME_ERROR<< "Misuing det_manip";
      }
-     det = newdet;
      sign = newsign;
+     if (N==0) { sign = 1; log_abs_det = 0; det_phase = 1;} // the det of the empty matrix is 1
+     else { log_abs_det += std::log(std::abs(det_ratio)); det_phase *= det_ratio / std::abs(det_ratio);} 
      last_try =0;
      ++n_opts;
-     if (n_opts > n_opts_max_before_check) { 
-      if (!check_mat_inv(1.e-10))
-       TRIQS_RUNTIME_ERROR << "Deviation too large ";
+     // Adaptive regeneration : the interval between two regenerations is doubled when the
+     // deviation of mat_inv is negligible, and halved when it is too large.
+     if (n_opts >= n_opts_max_before_check) { 
+      double diff = _regenerate();
+      if (diff < precision_increase) n_opts_max_before_check *= 2;
+      if (diff > precision_reduce) n_opts_max_before_check = std::max(n_opts_max_before_check/2, 1LL);
       n_opts=0;
      }
     }
 
+    /** 
+     * Recompute the inverse matrix and the det from scratch. 
+     * Returns the relative deviation of the inverse matrix accumulated by the fast updates.
+     */
+    double regenerate() { last_try =0; n_opts =0; return _regenerate();}
+
+    /**
+     * The inverse matrix is regenerated every n operations at first. 
+     * The interval is then doubled (halved) when the deviation found at regeneration is 
+     * below precision_increase (above precision_reduce).
+     */
+    void set_regeneration_policy(long long n, double precision_increase_ = 1.e-12, double precision_reduce_ = 1.e-8) { 
+     n_opts_max_before_check = std::max(n,1LL); precision_increase = precision_increase_; precision_reduce = precision_reduce_;
+    }
+
+    /// Current number of operations between two regenerations of the inverse matrix
+    long long n_operations_before_regeneration() const { return n_opts_max_before_check;}
+
     ///
     enum RollDirection {None,Up, Down,Left,Right};
 
@@ -66,10 +66,10 @@ struct test {
    size_t s = D.size();
    size_t i0,j0,i1,j1;
    det_old = D.determinant();
-   detratio=1;
+   detratio=0; // no try_xxx : nothing to complete
    double x,y,x1,y1; 
  
-   switch(RNG(( i>10 ? 4 : 1))) {
+   switch(RNG(( i>10 ? 7 : 1))) {
     case 0 :
      x = RNG(10.0), y = RNG(10.0);
      std::cerr  << " x,y = "<< x << "  "<< y << std::endl; 
@@ -97,6 +97,19 @@ struct test {
       }
      }
      break;
+    case 4:
+     if (s>0) detratio = D.try_change_col(RNG(s), RNG(10.0));
+     break;
+    case 5:
+     if (s>0) detratio = D.try_change_row(RNG(s), RNG(10.0));
+     break;
+    case 6:
+     std::cerr  << " Change col row" << std::endl;
+     if (s>0) { 
+      i0 = RNG(s); j0 = RNG(s); x = RNG(10.0); y = RNG(10.0);
+      detratio = D.try_change_col_row(i0,j0,x,y);
+     }
+     break;
     default :
      TRIQS_RUNTIME_ERROR <<" TEST INTERNAL ERROR" ;
    };
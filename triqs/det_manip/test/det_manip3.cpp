@@ -0,0 +1,110 @@
+#include <triqs/det_manip/det_manip.hpp>
+#include <triqs/mc_tools/random_generator.hpp>
+#include <triqs/arrays/linalg/det_and_inverse.hpp>
+#include <triqs/arrays/asserts.hpp>
+#include <iostream>
+
+// Same function as in det_manip1
+struct fun {
+
+ typedef double result_type;
+ typedef double argument_type;
+
+ double operator()(double x, double y) const {
+  const double pi = acos(-1);
+  const double beta = 10.0;
+  const double epsi = 0.1;
+  double tau = x-y;
+  bool s = (tau>0);
+  tau = (s ? tau : beta + tau);
+  double r = epsi + tau/beta *(1-2*epsi);
+  return - 2*(pi/beta)/ std::sin ( pi *r);
+ }
+
+};
+
+// number of calls to the batched evaluation (det_manip makes a copy of the function)
+long n_calls = 0;
+
+// The same function, with the batched evaluation of rows and columns
+struct fun_batched : fun {
+
+ void fill_row(double const & x, double const * y, size_t n, double * out, std::ptrdiff_t stride) const {
+  ++n_calls; for (size_t k=0; k<n; ++k) out[k*stride] = (*this)(x,y[k]);
+ }
+
+ void fill_col(double const * x, size_t n, double const & y, double * out, std::ptrdiff_t stride) const {
+  ++n_calls; for (size_t k=0; k<n; ++k) out[k*stride] = (*this)(x[k],y);
+ }
+};
+
+template<class T1, class T2 >
+void assert_close( T1 const & A, T2 const & B, double precision) {
+ if ( std::abs(A-B) > precision) TRIQS_RUNTIME_ERROR<<"assert_close error : "<<A<<"\n"<<B;
+}
+const double PRECISION = 1.e-10;
+
+struct test {
+
+ triqs::det_manip::det_manip<fun> D1;
+ triqs::det_manip::det_manip<fun_batched> D2;
+ double detratio1, detratio2;
+
+ test() : D1(fun(),100), D2(fun_batched(),100) {}
+
+ void check() {
+  std::cerr  << "det = " << D1.determinant() <<  " == " << D2.determinant()<< std::endl;
+  assert_close(D1.determinant() , D2.determinant(), PRECISION);
+  triqs::arrays::assert_all_close( D1.inverse_matrix() , D2.inverse_matrix(), PRECISION, true);
+  triqs::arrays::assert_all_close( D1.matrix() , D2.matrix(), PRECISION, true);
+ }
+
+ void run() {
+  triqs::mc_tools::random_generator RNG("mt19937", 23432);
+  for (size_t i =0; i< 100; ++i) {
+   std::cerr <<" i = "<< i << " size = "<< D1.size() << std::endl;
+   size_t s = D1.size();
+   size_t i0,j0,i1,j1;
+   detratio1 = detratio2 = 1;
+   double x,y,x1,y1;
+
+   switch(RNG(( i>10 ? 3 : 1))) {
+    case 0 :
+     x = RNG(10.0), y = RNG(10.0); i0 = RNG(s); j0 = RNG(s);
+     detratio1 = D1.try_insert(i0,j0, x,y);
+     detratio2 = D2.try_insert(i0,j0, x,y);
+     break;
+    case 1 :
+     if (s>0) { i0 = RNG(s); j0 = RNG(s); detratio1 = D1.try_remove(i0,j0); detratio2 = D2.try_remove(i0,j0);}
+     break;
+    case 2:
+     x = RNG(10.0); x1 = RNG(10.0);
+     y = RNG(10.0); y1 = RNG(10.0);
+     i0 = RNG(s); i1 = RNG(s+1);
+     j0 = RNG(s); j1 = RNG(s+1);
+     if ((i0 !=i1)&& (j0!=j1))  {
+      detratio1 = D1.try_insert2(i0,i1,j0,j1, x,x1,y,y1);
+      detratio2 = D2.try_insert2(i0,i1,j0,j1, x,x1,y,y1);
+     }
+     break;
+    default :
+     TRIQS_RUNTIME_ERROR <<" TEST INTERNAL ERROR" ;
+   };
+
+   assert_close(detratio1, detratio2, PRECISION);
+   if (std::abs(detratio1*D1.determinant())> 1.e-6)  {
+    D1.complete_operation();
+    D2.complete_operation();
+    if (D1.size() >0) check();
+   }
+  }
+  // the batched evaluation must have been used
+  if (n_calls ==0) TRIQS_RUNTIME_ERROR <<" fill_row/fill_col not used";
+ }
+
+};
+
+int main(int argc, char **argv) {
+ test().run();
+}
+
@@ -0,0 +1,48 @@
+#include <triqs/det_manip/det_manip.hpp>
+#include <triqs/mc_tools/random_generator.hpp>
+#include <triqs/arrays/linalg/det_and_inverse.hpp>
+#include <triqs/arrays/asserts.hpp>
+#include <iostream>
+
+// A function with large, pseudo random values : at large size, the det overflows a double
+struct fun {
+
+ typedef double result_type;
+ typedef double argument_type;
+
+ double operator()(double x, double y) const { return 1.e3 * std::sin(1.e3*x*y + x);}
+
+};
+
+template<class T1, class T2 >
+void assert_close( T1 const & A, T2 const & B, double precision) {
+ if ( std::abs(A-B) > precision) TRIQS_RUNTIME_ERROR<<"assert_close error : "<<A<<"\n"<<B;
+}
+
+int main(int argc, char **argv) {
+
+ triqs::det_manip::det_manip<fun> D(fun(),100);
+ D.set_regeneration_policy(10);
+ triqs::mc_tools::random_generator RNG("mt19937", 23432);
+
+ while (D.size() < 400) {
+  double x = RNG(10.0), y = RNG(10.0);
+  double r = D.try_insert(RNG(D.size()+1),RNG(D.size()+1), x,y);
+  if (!std::isfinite(r)) TRIQS_RUNTIME_ERROR <<" ratio of det is not finite";
+  if (std::abs(r) > 1.e-3) D.complete_operation();
+ }
+
+ // compare log |det| and the phase with a direct computation
+ triqs::arrays::matrix<double> M (D.matrix());
+ triqs::arrays::det_and_inverse_worker<triqs::arrays::matrix_view<double> > worker(M);
+ std::cerr  << "log |det| = " << D.log_abs_determinant() <<  " == " << worker.log_abs_det()<< std::endl;
+ if (std::isfinite(D.determinant())) TRIQS_RUNTIME_ERROR <<" the det was expected to overflow";
+ assert_close(D.log_abs_determinant() , worker.log_abs_det(), 1.e-8 * std::abs(worker.log_abs_det()));
+ assert_close(D.determinant_phase() , worker.det_phase(), 1.e-12);
+
+ // the deviation is small : the regeneration interval must have grown.
+ std::cerr  << "regeneration every " << D.n_operations_before_regeneration() << " operations"<< std::endl;
+ if (D.n_operations_before_regeneration() <= 10) TRIQS_RUNTIME_ERROR <<" regeneration interval did not adapt";
+ if (D.regenerate() > 1.e-6) TRIQS_RUNTIME_ERROR <<" deviation too large";
+}
+
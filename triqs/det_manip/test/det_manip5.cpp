@@ -0,0 +1,111 @@
+#include <triqs/det_manip/det_manip.hpp>
+#include <triqs/mc_tools/random_generator.hpp>
+#include <triqs/arrays/linalg/det_and_inverse.hpp>
+#include <triqs/arrays/asserts.hpp>
+#include <iostream>
+
+// A function with pseudo random values : the matrix is well conditioned, as required by a single precision inverse
+struct fun {
+
+ typedef double result_type;
+ typedef double argument_type;
+
+ double operator()(double x, double y) const { return std::sin(1.e3*x*y + x);}
+
+ // batched evaluation, in double : used through a buffer by the single precision det_manip
+ void fill_col(double const * x, size_t n, double const & y, double * out, std::ptrdiff_t stride) const {
+  for (size_t k=0; k<n; ++k) out[k*stride] = (*this)(x[k],y);
+ }
+ void fill_row(double const & x, double const * y, size_t n, double * out, std::ptrdiff_t stride) const {
+  for (size_t k=0; k<n; ++k) out[k*stride] = (*this)(x,y[k]);
+ }
+};
+
+// Small integer matrices, for which the dets and the inverses are computed by hand
+struct fun_int {
+
+ typedef double result_type;
+ typedef double argument_type;
+
+ double operator()(double x, double y) const { return (x-y)*(x-y) + x;}
+};
+
+template<class T1, class T2 >
+void assert_close( T1 const & A, T2 const & B, double precision) {
+ if ( std::abs(A-B) > precision) TRIQS_RUNTIME_ERROR<<"assert_close error : "<<A<<"\n"<<B;
+}
+
+// det of the matrix of D, computed directly
+template<typename DM> double direct_det(DM const & D) { 
+ if (D.size()==0) return 1;
+ triqs::arrays::matrix<double> M (D.matrix());
+ triqs::arrays::det_and_inverse_worker<triqs::arrays::matrix_view<double> > worker(M);
+ return worker.det();
+}
+
+// The ratios on the hand computed case :
+//   M1 = (1),  M2 = (1 2)   M3 = (1 2 5)
+//                   (3 2),       (3 2 3)
+//                                (7 4 3)
+// det M1 = 1, det M2 = -4, det M3 = 8, and removing the second row and column of M3 gives det (1 5 ; 7 3) = -32.
+// All the inverses are exactly representable, even in single precision.
+template<typename MatValueType> void hand_computed() { 
+ triqs::det_manip::det_manip<fun_int,MatValueType> D(fun_int(),10);
+ assert_close(D.try_insert(0,0,1,1), 1.0, 1.e-14); D.complete_operation();
+ assert_close(D.try_insert(1,1,2,2), -4.0, 1.e-14); D.complete_operation();
+ assert_close(D.try_insert(2,2,3,3), -2.0, 1.e-14); D.complete_operation();
+ assert_close(D.determinant(), 8.0, 1.e-13);
+ assert_close(D.inverse_matrix(0,0), -6/8.0, 1.e-14);
+ assert_close(D.inverse_matrix(2,1), 10/8.0, 1.e-14);
+ assert_close(D.try_remove(1,1), -4.0, 1.e-14); D.complete_operation();
+ assert_close(D.determinant(), -32.0, 1.e-13);
+}
+
+// The same moves on a det_manip in double and one with the inverse matrix in single precision.
+int main(int argc, char **argv) {
+
+ hand_computed<double>();
+ hand_computed<float>();
+
+ triqs::det_manip::det_manip<fun> D(fun(),100);
+ triqs::det_manip::det_manip<fun,float> Df(fun(),100);
+ Df.set_regeneration_policy(20, 1.e-5, 1.e-3);
+ triqs::mc_tools::random_generator RNG("mt19937", 23432);
+
+ double max_err_f = 0;
+ for (size_t i =0; i< 2000; ++i) {
+  size_t s = D.size();
+  double r =0, rf =0;
+  double x = RNG(10.0), y = RNG(10.0);
+  size_t i0 = RNG(s+1), j0 = RNG(s+1);
+  // N is kept in [40,80]
+  switch( s < 40 ? 0 : (s > 80 ? 1 + RNG(2) : RNG(3))) {
+   case 0 : r = D.try_insert(i0,j0,x,y); rf = Df.try_insert(i0,j0,x,y); break;
+   case 1 : if (s>0) { i0 = RNG(s); j0 = RNG(s); r = D.try_remove(i0,j0); rf = Df.try_remove(i0,j0);} break;
+   case 2 : if (s>0) { i0 = RNG(s); j0 = RNG(s); r = D.try_change_col_row(i0,j0,x,y); rf = Df.try_change_col_row(i0,j0,x,y);} break;
+  }
+  // Metropolis like acceptance : the matrix stays well conditioned
+  if (std::abs(r) < std::max(0.1, RNG(1.0))) continue;
+  // the ratio is exact in double, and accumulated in double from the single precision inverse matrix
+  const double det_old = direct_det(D);
+  D.complete_operation(); Df.complete_operation();
+  const double det_new = direct_det(D);
+  assert_close(r, det_new/det_old, 1.e-10 * std::abs(r));
+  assert_close(D.determinant(), det_new, 1.e-10 * std::abs(det_new));
+  max_err_f = std::max(max_err_f, std::abs(rf-r)/std::abs(r));
+ }
+ std::cerr  << "N = " << D.size() << " max relative error on the single precision ratio : " << max_err_f << std::endl;
+ if (max_err_f > 5.e-3) TRIQS_RUNTIME_ERROR << "single precision ratio too far from the exact one : " << max_err_f;
+
+ // the inverse, compared with a direct inversion
+ triqs::arrays::matrix<double> M (D.matrix());
+ triqs::arrays::det_and_inverse_worker<triqs::arrays::matrix_view<double> > worker(M);
+ triqs::arrays::matrix<double> Minv (worker.inverse());
+ triqs::arrays::assert_all_close( D.inverse_matrix() , Minv, 1.e-10, false);
+ triqs::arrays::assert_all_close( Df.inverse_matrix() , Minv, 1.e-4, false);
+
+ // after a regeneration, the det is computed in double
+ Df.regenerate(); 
+ assert_close(D.log_abs_determinant(), Df.log_abs_determinant(), 1.e-10 * std::abs(D.log_abs_determinant()));
+ assert_close(D.determinant_phase(), Df.determinant_phase(), 1.e-12);
+}
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2011 by M. Ferrero, O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/*
+  Time of a try_insert/try_remove (+ complete_operation if accepted) on a det_manip kept around size n.
+  Compile it as is (plain loops for n <= small_size) and with -DTRIQS_DET_MANIP_SMALL_SIZE=0 (BLAS for all n).
+*/
+#include <triqs/det_manip/det_manip.hpp>
+#include <triqs/mc_tools/random_generator.hpp>
+#include "boost/date_time/posix_time/posix_time.hpp"
+#include <iostream>
+#include <cmath>
+
+// a hybridization like function, as in det_manip1
+struct fun {
+ typedef double result_type;
+ typedef double argument_type;
+ double operator()(double x, double y) const {
+  const double pi = std::acos(-1), beta = 10.0, epsi = 0.1;
+  double tau = x-y;
+  bool s = (tau>0);
+  tau = (s ? tau : beta + tau);
+  double r = epsi + tau/beta * (1-2*epsi);
+  return - 2*(pi/beta)/ std::sin ( pi*r);
+ }
+};
+
+int main() {
+ const int sizes[] = {2,4,6,8,10,12,16};
+ const long n_iter = 2000000;
+ for (int s=0; s<7; ++s) {
+  const size_t n = sizes[s];
+  triqs::det_manip::det_manip<fun> D(fun(),100);
+  triqs::mc_tools::random_generator RNG("mt19937", 23432);
+  for (size_t i=0; i<n; ++i) { D.try_insert(D.size(),D.size(),RNG(10.0),RNG(10.0)); D.complete_operation();}
+  double acc = 0;
+  boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+  for (long it=0; it<n_iter; ++it) {
+   const size_t N = D.size();
+   const double r = (N <= n ? D.try_insert(RNG(N+1),RNG(N+1),RNG(10.0),RNG(10.0)) : D.try_remove(RNG(N),RNG(N)));
+   acc += r;
+   if (std::abs(r) > 1.e-2) D.complete_operation();
+  }
+  boost::posix_time::time_duration td = boost::posix_time::microsec_clock::local_time() - start_time;
+  std::cerr << "N ~ " << n << " : " << td.total_nanoseconds()/double(n_iter) << " ns per operation (" << acc << ")" << std::endl;
+ }
+}
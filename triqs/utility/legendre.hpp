@@ -27,6 +27,7 @@
 #include <boost/math/constants/constants.hpp>
 #include <complex>
 #include <ostream>
+#include <triqs/utility/compiler_details.hpp>
 
 namespace triqs {
 namespace utility {
@@ -99,6 +100,29 @@ public:
 
 };
 
+/*
+  Batched version of legendre_generator : for 0 <= n < n_max, computes
+     res[n] += sum_{0<=i<N} w[i] * P_n(x[i])
+  The recurrence is run for all the points at once, so that the loops on i have
+  no dependency and vectorize.
+  pm1 and p are workspaces of size N.
+*/
+inline void legendre_accumulate(int N, const double * restrict x, const double * restrict w, int n_max,
+                                double * restrict res, double * restrict pm1, double * restrict p) {
+  if ((N==0) || (n_max==0)) return;
+  double s=0;
+  for (int i=0; i<N; ++i) { pm1[i] = w[i]; p[i] = w[i]*x[i]; s += w[i];}
+  res[0] += s;
+  // the recurrence is linear : it is run directly on w[i] * P_n(x[i])
+  for (int n=1; n<n_max; ++n) {
+    s=0;
+    for (int i=0; i<N; ++i) s += p[i];
+    res[n] += s;
+    const double a = (2*n+1)/double(n+1), b = n/double(n+1);
+    for (int i=0; i<N; ++i) { const double t = a*x[i]*p[i] - b*pm1[i]; pm1[i] = p[i]; p[i] = t;}
+  }
+}
+
 }};
 
 #endif